@@ -11,11 +11,25 @@ const QString BaseIni::registryUsedGroup           = "last_used";
 
 ///////////////////////////////////////////////////////////////////////////////////
 const char BaseIni::Parameter::ServerDomain[]   = "ServerDomain";
+const char BaseIni::Parameter::ServerPort[]     = "ServerPort";
 const char BaseIni::Parameter::TargetCompID[]   = "TargetCompID";
 const char BaseIni::Parameter::SenderCompID[]   = "SenderCompID";
 const char BaseIni::Parameter::Password[]       = "Password";
 const char BaseIni::Parameter::Heartbeat[]      = "HeartbeatInterval";
 const char BaseIni::Parameter::SecureProtocol[] = "SecureMethod";
+const char BaseIni::Parameter::MessageRate[]    = "MessageRate";
+const char BaseIni::Parameter::MessageBurst[]   = "MessageBurst";
+const char BaseIni::Parameter::SessionResume[]  = "SessionResume";
+const char BaseIni::Parameter::StandbyDomain[]  = "StandbyDomain";
+const char BaseIni::Parameter::StandbyPort[]    = "StandbyPort";
+const char BaseIni::Parameter::ReconnectDelay[] = "ReconnectDelay";
+const char BaseIni::Parameter::ReconnectMaxDelay[] = "ReconnectMaxDelay";
+const char BaseIni::Parameter::ReconnectJitter[] = "ReconnectJitter";
+const char BaseIni::Parameter::LatencyProfile[] = "LatencyProfile";
+const char BaseIni::Parameter::SocketBuffer[] = "SocketBuffer";
+const char BaseIni::Parameter::SpinCpu[] = "SpinCpu";
+const char BaseIni::Parameter::Transport[] = "Transport";
+const char BaseIni::Parameter::MetricsPort[] = "MetricsPort";
 
 const char BaseIni::Protocol::SSLv2[]          = "SSLv2";
 const char BaseIni::Protocol::SSLv3[]          = "SSLv3";
@@ -27,6 +41,7 @@ const char BaseIni::Protocol::TLSv1_2[]        = "TLSv1.2";
 const char BaseIni::Protocol::TLSv1_2x[]       = "TLSv1.2.later";
 const char BaseIni::Protocol::TLSv1_SSLv3[]    = "TLSv1_and_SSLv3";
 const char BaseIni::Protocol::SSLAny[]         = "SSLvAll_and_TLSv1.0";
+const char BaseIni::Protocol::PlainTCP[]       = "PlainTCP";
 
 ///////////////////////////////////////////////////////////////////////////////////
 const char* DefaultParams[] = {
@@ -35,7 +50,21 @@ const char* DefaultParams[] = {
     "MyLogin", // mkcell
     "MyPassword", // mkcell777
     "10",
-    BaseIni::Protocol::TLSv1_x
+    BaseIni::Protocol::TLSv1_x,
+    "443",
+    "20",
+    "20",
+    "0",
+    "",
+    "0",
+    "500",
+    "30000",
+    "50",
+    "0",
+    "0",
+    "-1",
+    "0",
+    "9464"
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -70,6 +99,20 @@ void BaseIni::registrySaveDefaults()
     registry_.setValue(PasswordParam, DefaultParams[3]);
     registry_.setValue(HeartbeatParam, DefaultParams[4]);
     registry_.setValue(ProtocolParam, DefaultParams[5]);
+    registry_.setValue(ServerPortParam, DefaultParams[6]);
+    registry_.setValue(MessageRateParam, DefaultParams[7]);
+    registry_.setValue(MessageBurstParam, DefaultParams[8]);
+    registry_.setValue(SessionResumeParam, DefaultParams[9]);
+    registry_.setValue(StandbyServerParam, DefaultParams[10]);
+    registry_.setValue(StandbyPortParam, DefaultParams[11]);
+    registry_.setValue(ReconnectDelayParam, DefaultParams[12]);
+    registry_.setValue(ReconnectMaxParam, DefaultParams[13]);
+    registry_.setValue(ReconnectJitterParam, DefaultParams[14]);
+    registry_.setValue(LatencyProfileParam, DefaultParams[15]);
+    registry_.setValue(SocketBufferParam, DefaultParams[16]);
+    registry_.setValue(SpinCpuParam, DefaultParams[17]);
+    registry_.setValue(TransportParam, DefaultParams[18]);
+    registry_.setValue(MetricsPortParam, DefaultParams[19]);
 
     registry_.endGroup();
 }
@@ -103,6 +146,48 @@ void BaseIni::registryReloadDefaults()
     getval = registry_.value(ProtocolParam,DefaultParams[5]).toString();
     ini_.setValue(ProtocolParam,getval);
 
+    getval = registry_.value(ServerPortParam,DefaultParams[6]).toString();
+    ini_.setValue(ServerPortParam,getval);
+
+    getval = registry_.value(MessageRateParam,DefaultParams[7]).toString();
+    ini_.setValue(MessageRateParam,getval);
+
+    getval = registry_.value(MessageBurstParam,DefaultParams[8]).toString();
+    ini_.setValue(MessageBurstParam,getval);
+
+    getval = registry_.value(SessionResumeParam,DefaultParams[9]).toString();
+    ini_.setValue(SessionResumeParam,getval);
+
+    getval = registry_.value(StandbyServerParam,DefaultParams[10]).toString();
+    ini_.setValue(StandbyServerParam,getval);
+
+    getval = registry_.value(StandbyPortParam,DefaultParams[11]).toString();
+    ini_.setValue(StandbyPortParam,getval);
+
+    getval = registry_.value(ReconnectDelayParam,DefaultParams[12]).toString();
+    ini_.setValue(ReconnectDelayParam,getval);
+
+    getval = registry_.value(ReconnectMaxParam,DefaultParams[13]).toString();
+    ini_.setValue(ReconnectMaxParam,getval);
+
+    getval = registry_.value(ReconnectJitterParam,DefaultParams[14]).toString();
+    ini_.setValue(ReconnectJitterParam,getval);
+
+    getval = registry_.value(LatencyProfileParam,DefaultParams[15]).toString();
+    ini_.setValue(LatencyProfileParam,getval);
+
+    getval = registry_.value(SocketBufferParam,DefaultParams[16]).toString();
+    ini_.setValue(SocketBufferParam,getval);
+
+    getval = registry_.value(SpinCpuParam,DefaultParams[17]).toString();
+    ini_.setValue(SpinCpuParam,getval);
+
+    getval = registry_.value(TransportParam,DefaultParams[18]).toString();
+    ini_.setValue(TransportParam,getval);
+
+    getval = registry_.value(MetricsPortParam,DefaultParams[19]).toString();
+    ini_.setValue(MetricsPortParam,getval);
+
     ini_.endGroup();
     registry_.endGroup();
 }
@@ -141,6 +226,20 @@ void BaseIni::saveIni()
     setValue(PasswordParam, value(PasswordParam));
     setValue(HeartbeatParam, value(HeartbeatParam));
     setValue(ProtocolParam, value(ProtocolParam));
+    setValue(ServerPortParam, value(ServerPortParam));
+    setValue(MessageRateParam, value(MessageRateParam));
+    setValue(MessageBurstParam, value(MessageBurstParam));
+    setValue(SessionResumeParam, value(SessionResumeParam));
+    setValue(StandbyServerParam, value(StandbyServerParam));
+    setValue(StandbyPortParam, value(StandbyPortParam));
+    setValue(ReconnectDelayParam, value(ReconnectDelayParam));
+    setValue(ReconnectMaxParam, value(ReconnectMaxParam));
+    setValue(ReconnectJitterParam, value(ReconnectJitterParam));
+    setValue(LatencyProfileParam, value(LatencyProfileParam));
+    setValue(SocketBufferParam, value(SocketBufferParam));
+    setValue(SpinCpuParam, value(SpinCpuParam));
+    setValue(TransportParam, value(TransportParam));
+    setValue(MetricsPortParam, value(MetricsPortParam));
 }
 
 QString BaseIni::value(const char* key) const
@@ -164,6 +263,34 @@ QString BaseIni::value(const char* key) const
         getVal = registry_.value(HeartbeatParam, DefaultParams[4]).toString();
     else if( 0 == stricmp(key,ProtocolParam) )
         getVal = registry_.value(ProtocolParam, DefaultParams[5]).toString();
+    else if( 0 == stricmp(key,ServerPortParam) )
+        getVal = registry_.value(ServerPortParam, DefaultParams[6]).toString();
+    else if( 0 == stricmp(key,MessageRateParam) )
+        getVal = registry_.value(MessageRateParam, DefaultParams[7]).toString();
+    else if( 0 == stricmp(key,MessageBurstParam) )
+        getVal = registry_.value(MessageBurstParam, DefaultParams[8]).toString();
+    else if( 0 == stricmp(key,SessionResumeParam) )
+        getVal = registry_.value(SessionResumeParam, DefaultParams[9]).toString();
+    else if( 0 == stricmp(key,StandbyServerParam) )
+        getVal = registry_.value(StandbyServerParam, DefaultParams[10]).toString();
+    else if( 0 == stricmp(key,StandbyPortParam) )
+        getVal = registry_.value(StandbyPortParam, DefaultParams[11]).toString();
+    else if( 0 == stricmp(key,ReconnectDelayParam) )
+        getVal = registry_.value(ReconnectDelayParam, DefaultParams[12]).toString();
+    else if( 0 == stricmp(key,ReconnectMaxParam) )
+        getVal = registry_.value(ReconnectMaxParam, DefaultParams[13]).toString();
+    else if( 0 == stricmp(key,ReconnectJitterParam) )
+        getVal = registry_.value(ReconnectJitterParam, DefaultParams[14]).toString();
+    else if( 0 == stricmp(key,LatencyProfileParam) )
+        getVal = registry_.value(LatencyProfileParam, DefaultParams[15]).toString();
+    else if( 0 == stricmp(key,SocketBufferParam) )
+        getVal = registry_.value(SocketBufferParam, DefaultParams[16]).toString();
+    else if( 0 == stricmp(key,SpinCpuParam) )
+        getVal = registry_.value(SpinCpuParam, DefaultParams[17]).toString();
+    else if( 0 == stricmp(key,TransportParam) )
+        getVal = registry_.value(TransportParam, DefaultParams[18]).toString();
+    else if( 0 == stricmp(key,MetricsPortParam) )
+        getVal = registry_.value(MetricsPortParam, DefaultParams[19]).toString();
 
     return getVal;
 }
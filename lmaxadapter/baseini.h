@@ -6,11 +6,25 @@
 // Aliases for common using in global namespace
 // [common] parameters
 #define ServerParam         (BaseIni::Parameter::ServerDomain)
+#define ServerPortParam     (BaseIni::Parameter::ServerPort)
 #define TargetCompParam     (BaseIni::Parameter::TargetCompID)
 #define SenderCompParam     (BaseIni::Parameter::SenderCompID)
 #define PasswordParam       (BaseIni::Parameter::Password)
 #define HeartbeatParam      (BaseIni::Parameter::Heartbeat)
 #define ProtocolParam       (BaseIni::Parameter::SecureProtocol)
+#define MessageRateParam    (BaseIni::Parameter::MessageRate)
+#define MessageBurstParam   (BaseIni::Parameter::MessageBurst)
+#define SessionResumeParam  (BaseIni::Parameter::SessionResume)
+#define StandbyServerParam  (BaseIni::Parameter::StandbyDomain)
+#define StandbyPortParam    (BaseIni::Parameter::StandbyPort)
+#define ReconnectDelayParam (BaseIni::Parameter::ReconnectDelay)
+#define ReconnectMaxParam   (BaseIni::Parameter::ReconnectMaxDelay)
+#define ReconnectJitterParam (BaseIni::Parameter::ReconnectJitter)
+#define LatencyProfileParam (BaseIni::Parameter::LatencyProfile)
+#define SocketBufferParam   (BaseIni::Parameter::SocketBuffer)
+#define SpinCpuParam        (BaseIni::Parameter::SpinCpu)
+#define TransportParam      (BaseIni::Parameter::Transport)
+#define MetricsPortParam    (BaseIni::Parameter::MetricsPort)
 
 // SSL protocol names
 #define ProtoSSLv2          (BaseIni::Protocol::SSLv2)
@@ -23,6 +37,7 @@
 #define ProtoTLSv1_2x       (BaseIni::Protocol::TLSv1_2x)
 #define ProtoTLSv1_SSLv3    (BaseIni::Protocol::TLSv1_SSLv3)
 #define ProtoSSLAny         (BaseIni::Protocol::SSLAny)
+#define ProtoPlainTCP       (BaseIni::Protocol::PlainTCP)
 
 
 ////////////////////////////////////////////////////////////////////////
@@ -31,11 +46,25 @@ class BaseIni
 public:
     struct Parameter {
         static const char ServerDomain[];
+        static const char ServerPort[];
         static const char TargetCompID[];
         static const char SenderCompID[];
         static const char Password[];
         static const char Heartbeat[];
         static const char SecureProtocol[];
+        static const char MessageRate[];    // outbound messages per sec, 0 - unpaced
+        static const char MessageBurst[];
+        static const char SessionResume[];  // 1 - logon continues journaled MsgSeqNums
+        static const char StandbyDomain[];  // empty - no standby session
+        static const char StandbyPort[];    // 0 - the port of the primary
+        static const char ReconnectDelay[]; // msecs of the first retry, doubled by every next one
+        static const char ReconnectMaxDelay[];
+        static const char ReconnectJitter[];    // percents of the delay taken off at random
+        static const char LatencyProfile[];     // 0 - default, 1 - low-latency socket, 2 - and spinning receive
+        static const char SocketBuffer[];       // bytes of the socket buffers, 0 - system default
+        static const char SpinCpu[];            // CPU of the spinning receive thread, -1 - any
+        static const char Transport[];          // 0 - QSslSocket, 1 - epoll and OpenSSL (Linux)
+        static const char MetricsPort[];        // localhost port of the metrics endpoint, 0 - disabled
     };
 
     struct Protocol {
@@ -49,6 +78,7 @@ public:
         static const char TLSv1_2x[];
         static const char TLSv1_SSLv3[];
         static const char SSLAny[];
+        static const char PlainTCP[];       // no encryption, for local FIX simulator only
         static const char SSLUndefined[];
     };
 
@@ -0,0 +1,699 @@
+#include "globals.h"
+#include "epollclient.h"
+#include "monoclock.h"
+#include "latencyrecorder.h"
+
+#include <QtCore>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+using namespace std;
+
+// bytes of a single socket read and of a single TLS record read
+#define EPOLL_READ_SIZE         0x10000
+#define EPOLL_MAX_EVENTS        8
+
+namespace {
+    QString sslError()
+    {
+        char text[256];
+        ERR_error_string_n(ERR_get_error(), text, sizeof(text));
+        return QString("SSL error: ") + text;
+    }
+
+    // SO_TIMESTAMPNS stamps are of the realtime clock,
+    // moved here to the monotonic one of Global::nanotime
+    qint64 monotonicOf(const timespec& stamp)
+    {
+        qint64 now = Global::nanotime();
+        qint64 rx = MonoClock::fromWall((qint64)stamp.tv_sec * 1000000000 + stamp.tv_nsec);
+        // a step of the realtime clock must not give a stamp of the future
+        return qMin(rx, now);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+EpollClient::EpollClient(QSsl::SslProtocol proto, RequestHandler* handler)
+    : handler_(handler),
+    proto_(proto),
+    host_("not_configured"),
+    port_(443),
+    encrypted_(true),
+    running_(0),
+    reconnecting_(0),
+    epoll_(-1),
+    wakeup_(-1),
+    connected_(false),
+    socket_(-1),
+    established_(false),
+    ctx_(NULL),
+    ssl_(NULL),
+    rbio_(NULL),
+    wbio_(NULL),
+    session_(NULL),
+    writable_(false),
+    rx_(EPOLL_READ_SIZE),
+    plain_(EPOLL_READ_SIZE)
+{
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.kind_ = EpollTransport;
+    stats_.handshakeTime_ = -1;
+    stats_.spinCpu_ = -1;
+}
+
+EpollClient::~EpollClient()
+{
+    running_ = 0;
+    wake();
+    wait();
+
+    if( session_ )
+        SSL_SESSION_free(session_);
+    if( ctx_ )
+        SSL_CTX_free(ctx_);
+}
+
+void EpollClient::setProfile(const SocketProfile& profile)
+{
+    profile_ = profile;
+}
+
+const SocketProfile& EpollClient::profile() const
+{
+    return profile_;
+}
+
+void EpollClient::establish(const QString& host, quint16 port, bool encrypted)
+{
+    host_ = host;
+    port_ = port;
+    encrypted_ = encrypted;
+
+    // the wakeup exists before a sender or stop may need it
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_ = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeup_;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev);
+
+    running_ = 1;
+    start();
+}
+
+bool EpollClient::reconnect(QSsl::SslProtocol proto, const QString& host, quint16 port, bool encrypted)
+{
+    if( !running_ || !isRunning() || proto != proto_ )
+        return false;
+
+    {
+        QMutexLocker g(&ioLock_);
+        host_ = host;
+        port_ = port;
+        encrypted_ = encrypted;
+    }
+    reconnecting_ = 1;
+    wake();
+    return true;
+}
+
+void EpollClient::wake()
+{
+    if( wakeup_ < 0 )
+        return;
+    quint64 one = 1;
+    ssize_t written = ::write(wakeup_, &one, sizeof(one));
+    Q_UNUSED(written);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void EpollClient::run()
+{
+    qint32 pinned = -1;
+    if( profile_.level_ == SocketProfile::SpinLevel && profile_.cpu_ >= 0 ) {
+        if( Global::pinThread(profile_.cpu_) )
+            pinned = profile_.cpu_;
+        else
+            CDebug() << "EpollClient: cannot pin the receiving thread to CPU " << profile_.cpu_;
+    }
+    {
+        QMutexLocker g(&statsLock_);
+        stats_.spinCpu_ = pinned;
+    }
+
+    if( encrypted_ && !createContext() ) {
+        handler_->onStateChanged(ForcedClosingState);
+        running_ = 0;
+    }
+    else
+        openSocket();
+
+    // the spinning thread polls without sleeping
+    int timeout = (profile_.level_ == SocketProfile::SpinLevel) ? 0 : -1;
+    epoll_event events[EPOLL_MAX_EVENTS];
+    while( running_ )
+    {
+        int count = epoll_wait(epoll_, events, EPOLL_MAX_EVENTS, timeout);
+        if( count < 0 && errno != EINTR ) {
+            CDebug() << "EpollClient: epoll_wait failed, errno " << errno;
+            break;
+        }
+
+        for(int i = 0; i < count && running_; ++i)
+        {
+            if( events[i].data.fd == wakeup_ ) {
+                quint64 value;
+                ssize_t got = ::read(wakeup_, &value, sizeof(value));
+                Q_UNUSED(got);
+                if( reconnecting_ ) {
+                    reconnecting_ = 0;
+                    closeSocket();
+                    if( encrypted_ && !createContext() )
+                        handler_->onStateChanged(ForcedClosingState);
+                    else
+                        openSocket();
+                    break;  // events of the closed socket are stale
+                }
+                continue;
+            }
+            if( socket_ < 0 || events[i].data.fd != socket_ )
+                continue;
+
+            quint32 flags = events[i].events;
+            if( !connected_ ) {
+                onConnected();
+                continue;
+            }
+            if( flags & (EPOLLIN|EPOLLERR|EPOLLHUP) )
+                onReadable();
+            if( socket_ >= 0 && (flags & EPOLLOUT) )
+                onWritable();
+        }
+    }
+
+    closeSocket();
+    ::close(wakeup_);
+    ::close(epoll_);
+    wakeup_ = epoll_ = -1;
+    handler_->onStateChanged(UnconnectState);
+}
+
+bool EpollClient::createContext()
+{
+    if( ctx_ )
+        return true;
+
+    ctx_ = SSL_CTX_new(TLS_client_method());
+    if( ctx_ == NULL ) {
+        setError(sslError());
+        return false;
+    }
+
+    // the same as of QSslSocket: no peer verification, no SNI
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, NULL);
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, &EpollClient::newSession);
+
+    switch( proto_ )
+    {
+    case QSsl::TlsV1_0:
+        SSL_CTX_set_max_proto_version(ctx_, TLS1_VERSION);
+        break;
+    case QSsl::TlsV1_1:
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_1_VERSION);
+        SSL_CTX_set_max_proto_version(ctx_, TLS1_1_VERSION);
+        break;
+    case QSsl::TlsV1_1OrLater:
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_1_VERSION);
+        break;
+    case QSsl::TlsV1_2:
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        SSL_CTX_set_max_proto_version(ctx_, TLS1_2_VERSION);
+        break;
+    case QSsl::TlsV1_2OrLater:
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void EpollClient::openSocket()
+{
+    handler_->onStateChanged(ProgressState);
+
+    QByteArray host;
+    QByteArray port;
+    {
+        QMutexLocker g(&ioLock_);
+        host = host_.toLatin1();
+        port = QByteArray::number(port_);
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* found = NULL;
+    int ret = getaddrinfo(host.constData(), port.constData(), &hints, &found);
+    if( ret != 0 || found == NULL ) {
+        dropConnection(ForcedClosingState, QString("Host %1 not found: %2").arg(host.constData()).arg(gai_strerror(ret)));
+        return;
+    }
+
+    int fd = ::socket(found->ai_family, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+    if( fd < 0 ) {
+        freeaddrinfo(found);
+        dropConnection(ForcedClosingState, QString("Cannot create socket: %1").arg(strerror(errno)));
+        return;
+    }
+
+    // buffers before connect to have them in the window scale
+    if( profile_.buffer_ > 0 ) {
+        int size = profile_.buffer_;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+    int stamps = 1;
+    bool kernelStamps = (0 == setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &stamps, sizeof(stamps)));
+    int busyPoll = 0;
+    if( profile_.level_ >= SocketProfile::LowLatencyLevel ) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_BUSY_POLL
+        int usecs = SOCKET_BUSY_POLL_USECS;
+        if( 0 == setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) )
+            busyPoll = usecs;
+        else
+            CDebug() << "EpollClient: SO_BUSY_POLL is not permitted, errno " << errno;
+#endif
+    }
+
+    {
+        QMutexLocker g(&statsLock_);
+        ++stats_.connects_;
+        stats_.level_ = profile_.level_;
+        stats_.busyPoll_ = busyPoll;
+        stats_.kernelStamps_ = kernelStamps;
+    }
+    connectClock_.start();
+
+    {
+        QMutexLocker g(&ioLock_);
+        socket_ = fd;
+        connected_ = false;
+        established_ = false;
+        framer_.reset();
+
+        // EPOLLOUT reports the completed connect
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN|EPOLLOUT;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+        writable_ = true;
+    }
+
+    ret = ::connect(fd, found->ai_addr, found->ai_addrlen);
+    int error = errno;
+    freeaddrinfo(found);
+    if( ret != 0 && error != EINPROGRESS )
+        dropConnection(ClosedFailureState, QString("Cannot connect to %1:%2: %3")
+                                       .arg(host.constData()).arg(port.constData()).arg(strerror(error)));
+}
+
+void EpollClient::closeSocket()
+{
+    QMutexLocker g(&ioLock_);
+    if( ssl_ ) {
+        if( established_ ) {
+            SSL_shutdown(ssl_);
+            flushTls();
+        }
+        SSL_free(ssl_);     // the BIOs too
+        ssl_ = NULL;
+        rbio_ = wbio_ = NULL;
+    }
+    if( socket_ >= 0 ) {
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, socket_, NULL);
+        ::close(socket_);
+        socket_ = -1;
+    }
+    connected_ = false;
+    established_ = false;
+    writable_ = false;
+    unsent_.clear();
+    framer_.reset();
+}
+
+void EpollClient::dropConnection(RequestHandler::ConnectionState state, const QString& error)
+{
+    setError(error);
+    closeSocket();
+    handler_->onStateChanged(state);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void EpollClient::onConnected()
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if( getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &len) != 0 )
+        error = errno;
+    if( error != 0 ) {
+        dropConnection(ClosedFailureState, QString("Cannot connect to %1:%2: %3").arg(host_).arg(port_).arg(strerror(error)));
+        return;
+    }
+
+    int noDelay = 0, recvBuffer = 0, sendBuffer = 0;
+    len = sizeof(int);
+    getsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &noDelay, &len);
+    len = sizeof(int);
+    getsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &recvBuffer, &len);
+    len = sizeof(int);
+    getsockopt(socket_, SOL_SOCKET, SO_SNDBUF, &sendBuffer, &len);
+    {
+        QMutexLocker g(&statsLock_);
+        stats_.connectTime_ = qint32(connectClock_.elapsed());
+        stats_.handshakeTime_ = -1;
+        stats_.lastResumeOffered_ = false;
+        stats_.noDelay_ = noDelay;
+        stats_.recvBuffer_ = recvBuffer;
+        stats_.sendBuffer_ = sendBuffer;
+        CDebug() << "EpollClient: connected in " << stats_.connectTime_ << " msecs, socket profile "
+                 << stats_.level_ << ", nodelay " << noDelay << ", buffers " << recvBuffer << "/" << sendBuffer
+                 << ", busy poll " << stats_.busyPoll_ << " usecs, spin CPU " << stats_.spinCpu_
+                 << (stats_.kernelStamps_ ? ", kernel receive stamps" : "");
+    }
+    connectClock_.start();
+
+    Handshake result = HandshakeDone;
+    {
+        QMutexLocker g(&ioLock_);
+        connected_ = true;
+        watchWritable(false);
+        if( encrypted_ )
+        {
+            ssl_ = SSL_new(ctx_);
+            rbio_ = BIO_new(BIO_s_mem());
+            wbio_ = BIO_new(BIO_s_mem());
+            SSL_set_bio(ssl_, rbio_, wbio_);
+            SSL_set_connect_state(ssl_);
+            SSL_set_app_data(ssl_, this);
+
+            bool resume = (session_ != NULL && SSL_set_session(ssl_, session_) == 1);
+            {
+                QMutexLocker s(&statsLock_);
+                stats_.resumeOffered_ += resume ? 1 : 0;
+                stats_.lastResumeOffered_ = resume;
+            }
+            result = handshake();
+        }
+    }
+
+    if( result == HandshakeDone )
+        onEstablished();
+    else if( result == HandshakeFailed )
+        dropConnection(ClosedRemoteState, "SSL handshake failed");
+}
+
+void EpollClient::onEstablished()
+{
+    {
+        QMutexLocker g(&ioLock_);
+        established_ = true;
+    }
+    handler_->onStateChanged(EstablishState);
+}
+
+EpollClient::Handshake EpollClient::handshake()
+{
+    int ret = SSL_do_handshake(ssl_);
+    flushTls();
+    if( ret == 1 )
+    {
+        bool reused = (SSL_session_reused(ssl_) == 1);
+        QMutexLocker g(&statsLock_);
+        stats_.handshakeTime_ = qint32(connectClock_.elapsed());
+        CDebug() << "EpollClient: SSL " << SSL_get_version(ssl_) << " " << SSL_get_cipher_name(ssl_)
+                 << ", handshake " << stats_.handshakeTime_ << " msecs" << (reused ? ", session resumed" : "");
+        return HandshakeDone;
+    }
+
+    int error = SSL_get_error(ssl_, ret);
+    if( error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE )
+        return HandshakeWait;
+
+    setError(sslError());
+    return HandshakeFailed;
+}
+
+// Sessions come with the handshake or later (TLS 1.3 tickets), called with ioLock_
+int EpollClient::newSession(SSL* ssl, SSL_SESSION* session)
+{
+    EpollClient* self = static_cast<EpollClient*>(SSL_get_app_data(ssl));
+    if( self->session_ )
+        SSL_SESSION_free(self->session_);
+    self->session_ = session;
+    return 1;   // the reference is kept
+}
+
+ssize_t EpollClient::receive(qint64& rxNanos)
+{
+    iovec iov;
+    iov.iov_base = &rx_[0];
+    iov.iov_len = rx_.size();
+
+    char control[CMSG_SPACE(sizeof(timespec))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got = ::recvmsg(socket_, &msg, 0);
+    rxNanos = 0;
+    if( got > 0 )
+    {
+        for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS ) {
+                timespec stamp;
+                memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                rxNanos = monotonicOf(stamp);
+            }
+        }
+        if( rxNanos == 0 )
+            rxNanos = Global::nanotime();
+    }
+    return got;
+}
+
+void EpollClient::deliver(qint64 rxNanos)
+{
+    QByteArray message;
+    while( framer_.next(message) ) {
+        LatencyRecorder::record(LatencyRecorder::ReadToFrame, Global::nanotime() - rxNanos);
+        handler_->onMessageReceived(message, rxNanos);
+    }
+}
+
+void EpollClient::onReadable()
+{
+    bool closed = false;
+    bool tlsFailed = false;
+    int failure = 0;
+    Handshake result = HandshakeWait;
+    bool handshaking = encrypted_ && !established_;
+
+    while( true )
+    {
+        // messages completed by a read carry the stamp of that read
+        qint64 rxNanos = 0;
+        ssize_t got = receive(rxNanos);
+        if( got == 0 ) {
+            closed = true;
+            break;
+        }
+        if( got < 0 ) {
+            if( errno == EINTR )
+                continue;
+            if( errno != EAGAIN && errno != EWOULDBLOCK )
+                failure = errno;
+            break;
+        }
+
+        if( !encrypted_ )
+            framer_.append(&rx_[0], qint32(got));
+        else
+        {
+            QMutexLocker g(&ioLock_);
+            BIO_write(rbio_, &rx_[0], int(got));
+            if( handshaking && result == HandshakeWait )
+                result = handshake();
+            if( result == HandshakeFailed )
+                break;
+
+            if( !handshaking || result == HandshakeDone )
+            {
+                int read;
+                while( (read = SSL_read(ssl_, &plain_[0], int(plain_.size()))) > 0 )
+                    framer_.append(&plain_[0], read);
+
+                int error = SSL_get_error(ssl_, read);
+                if( error == SSL_ERROR_ZERO_RETURN )
+                    closed = true;
+                else if( error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE ) {
+                    setError(sslError());
+                    tlsFailed = true;
+                }
+                // alerts of the server, tickets go to newSession
+                flushTls();
+            }
+        }
+
+        if( handshaking && result == HandshakeDone ) {
+            onEstablished();
+            handshaking = false;
+        }
+        deliver(rxNanos);
+
+        if( closed || tlsFailed || got < ssize_t(rx_.size()) )
+            break;
+    }
+
+#ifdef TCP_QUICKACK
+    // the kernel falls back to delayed ACKs after every read
+    if( socket_ >= 0 && profile_.level_ >= SocketProfile::LowLatencyLevel ) {
+        int on = 1;
+        setsockopt(socket_, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    }
+#endif
+
+    if( result == HandshakeFailed || tlsFailed )
+        dropConnection(ClosedRemoteState, "");
+    else if( failure )
+        dropConnection(ClosedRemoteState, QString("Connection failed: %1").arg(strerror(failure)));
+    else if( closed )
+        dropConnection(ClosedRemoteState, "The remote host closed the connection");
+}
+
+void EpollClient::onWritable()
+{
+    QMutexLocker g(&ioLock_);
+    if( unsent_.isEmpty() ) {
+        watchWritable(false);
+        return;
+    }
+
+    ssize_t sent = ::send(socket_, unsent_.constData(), unsent_.size(), MSG_NOSIGNAL);
+    if( sent > 0 )
+        unsent_.remove(0, int(sent));
+    if( unsent_.isEmpty() )
+        watchWritable(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void EpollClient::send(const QByteArray& message)
+{
+    QMutexLocker g(&ioLock_);
+    if( !established_ || socket_ < 0 )
+        return;     // the same as of unconnected QSslSocket
+
+    if( !encrypted_ ) {
+        writeOut(message.constData(), message.size());
+        return;
+    }
+
+    // memory BIO takes everything, the records go to the socket at once
+    SSL_write(ssl_, message.constData(), message.size());
+    flushTls();
+}
+
+void EpollClient::flushTls()
+{
+    char buffer[0x4000];
+    while( BIO_ctrl_pending(wbio_) > 0 )
+    {
+        int size = BIO_read(wbio_, buffer, sizeof(buffer));
+        if( size <= 0 )
+            break;
+        writeOut(buffer, size);
+    }
+}
+
+void EpollClient::writeOut(const char* data, qint32 size)
+{
+    if( socket_ < 0 )
+        return;
+
+    ssize_t sent = 0;
+    if( unsent_.isEmpty() ) {
+        sent = ::send(socket_, data, size, MSG_NOSIGNAL);
+        if( sent < 0 ) {
+            if( errno != EAGAIN && errno != EWOULDBLOCK )
+                return;     // the failure is reported by the reading side
+            sent = 0;
+        }
+    }
+
+    // the rest goes when the socket is writable again
+    if( sent < size ) {
+        unsent_.append(data + sent, int(size - sent));
+        watchWritable(true);
+    }
+}
+
+void EpollClient::watchWritable(bool on)
+{
+    if( writable_ == on || socket_ < 0 )
+        return;
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+    ev.data.fd = socket_;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, socket_, &ev);
+    writable_ = on;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void EpollClient::setError(const QString& error)
+{
+    if( error.isEmpty() )
+        return;
+    QMutexLocker g(&errorLock_);
+    ioError_ = error;
+    CDebug() << "EpollClient: " << error;
+}
+
+QString EpollClient::lastError() const
+{
+    QMutexLocker g(&errorLock_);
+    QString tmp = ioError_;
+    ioError_.clear();
+    return tmp;
+}
+
+TransportStats EpollClient::stats() const
+{
+    QMutexLocker g(&statsLock_);
+    return stats_;
+}
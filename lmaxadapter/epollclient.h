@@ -0,0 +1,111 @@
+#ifndef __epollclient_h__
+#define __epollclient_h__
+
+#include "fixtransport.h"
+#include "fixframer.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <vector>
+#include <sys/types.h>
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+typedef struct bio_st BIO;
+typedef struct ssl_session_st SSL_SESSION;
+
+////////////////////////////////////////////////////////////////////////////////
+// EpollTransport: non-blocking socket on the epoll of the own thread, TLS by
+// OpenSSL over memory BIOs. Reads are decrypted into one reused buffer and
+// framed there, messages are encrypted and written on the sending thread.
+// The TLS context and the last session are kept over reconnects. Messages
+// carry the SO_TIMESTAMPNS stamp of the read that completed them. Linux only,
+// built with LMAX_EPOLL_TRANSPORT
+class EpollClient : public QThread, public FixTransport
+{
+    enum Handshake {
+        HandshakeWait = 0,
+        HandshakeDone,
+        HandshakeFailed,
+    };
+
+public:
+    EpollClient(QSsl::SslProtocol proto, RequestHandler* handler);
+    ~EpollClient();
+
+    void setProfile(const SocketProfile& profile);
+    const SocketProfile& profile() const;
+
+    void establish(const QString& host, quint16 port, bool encrypted = true);
+    bool reconnect(QSsl::SslProtocol proto, const QString& host, quint16 port, bool encrypted);
+    void send(const QByteArray& message);
+    QString lastError() const;
+    TransportStats stats() const;
+
+protected:
+    void run();
+
+private:
+    bool createContext();
+    void openSocket();
+    void closeSocket();
+    void onConnected();
+    // a socket read with its kernel stamp, the read time when there is none
+    ssize_t receive(qint64& rxNanos);
+    void deliver(qint64 rxNanos);
+    void onReadable();
+    void onWritable();
+    void onEstablished();
+    void dropConnection(RequestHandler::ConnectionState state, const QString& error);
+
+    // called with ioLock_
+    Handshake handshake();
+    void flushTls();
+    static int newSession(SSL* ssl, SSL_SESSION* session);
+    void writeOut(const char* data, qint32 size);
+    void watchWritable(bool on);
+
+    void setError(const QString& error);
+    void wake();
+
+private:
+    RequestHandler*     handler_;
+    QSsl::SslProtocol   proto_;
+    QString             host_;
+    quint16             port_;
+    bool                encrypted_;
+    SocketProfile       profile_;
+
+    QAtomicInt          running_;
+    QAtomicInt          reconnecting_;
+    int                 epoll_;
+    int                 wakeup_;        // eventfd of stop and reconnect
+    bool                connected_;     // TCP connect is completed
+
+    // the socket, TLS state and unsent bytes, taken by the receiving
+    // thread and by the senders
+    QMutex              ioLock_;
+    int                 socket_;
+    bool                established_;   // connected and handshaken, messages may be sent
+    SSL_CTX*            ctx_;
+    SSL*                ssl_;
+    BIO*                rbio_;
+    BIO*                wbio_;
+    SSL_SESSION*        session_;
+    QByteArray          unsent_;
+    bool                writable_;      // EPOLLOUT is watched
+
+    std::vector<char>   rx_;
+    std::vector<char>   plain_;
+    FixFramer           framer_;
+
+    QElapsedTimer       connectClock_;
+    mutable QMutex      statsLock_;
+    TransportStats      stats_;
+    mutable QMutex      errorLock_;
+    mutable QString     ioError_;
+};
+
+#endif // __epollclient_h__
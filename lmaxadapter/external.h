@@ -14,9 +14,43 @@
 #define FILENAME_SETTINGS           "lmax.ini"
 #define FILENAME_FIXMESSAGES        "lmax_messages.log"
 #define FILENAME_DEBUGINFO          "lmax_debug.log"
+#define FILENAME_REPLAYREPORT       "lmax_replay.txt"
+#define FILENAME_JOURNAL            "lmax_journal.dat"
+#define FILENAME_JOURNAL_STANDBY    "lmax_journal_standby.dat"
+#define FILENAME_LATENCYSTATS       "lmax_latency.txt"
+#define FILENAME_LOCKPROFILE        "lmax_locks.txt"
 #define MAX_FIXMESSAGES_FILESIZE    (1024*1024*50)
 #define MAX_DEBUGINFO_FILESIZE      (1024*1024*100)
 
+// outbound messages journal, the index holds the last JOURNAL_INDEX_SIZE MsgSeqNums
+#define JOURNAL_FILESIZE            (1024*1024*16)
+#define JOURNAL_INDEX_SIZE          65536
+
+// quotes table repaints per second at most, updates between are coalesced
+#define GUI_REFRESH_RATE            20
+// secs between GUI thread load reports in the debug log
+#define GUI_REFRESH_STATS_PERIOD    10
+// msecs between merges of the per-thread latency histograms
+#define LATENCY_MERGE_PERIOD        1000
+// merges between writes of the latency stats file
+#define LATENCY_FILE_MERGES         10
+
+// msecs without quotes of a subscribed instrument before it's reported as stale
+#define QUOTES_STALE_TIMEOUT        (60*1000)
+// msecs a quote of the other session repeating the cached one is taken as the same tick
+#define QUOTES_DEDUP_WINDOW         500
+// msecs before the standby session reconnects
+#define STANDBY_RECONNECT_DELAY     2000
+// usecs of SO_BUSY_POLL of the low-latency socket profile (Linux)
+#define SOCKET_BUSY_POLL_USECS      50
+// bytes of a request header to the metrics endpoint, longer ones are dropped
+#define METRICS_REQUEST_LIMIT       4096
+
+// lock contention profiler of rwlock-dbg.h, off in release builds
+//#define LMAX_LOCK_PROFILE
+// call sites recorded per thread by the profiler
+#define LOCK_PROFILE_SITES          256
+
 // file logging is disabled by default
 #define MQL_LOGGING_ENABLED         0
 
@@ -25,44 +59,18 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #define MQL_PROXY_PIPE              "mqlpipe"
-#define MAX_SYMBOLS                 300
-#define MAX_SYMBOL_LENGTH           30
 
 //////////////////////////////////////////////////////////////////////////////
 // Typedefs for mql.dll exported routines
 //////////////////////////////////////////////////////////////////////////////
+#ifdef WIN32
 typedef double (__stdcall *importGetFunction)(const char*);
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
-// Structs for common using by mean of mql.dll of MQL client and LMAX adapter
-
+// Pipe protocol for common using by mean of mql.dll of MQL client and LMAX adapter
+// is declared in mqlprotocol.h
 //////////////////////////////////////////////////////////////////////////////
-#pragma pack(push,r1,2) // set memory alignment to 2 bytes (for members with short type)
-// Transaction from mql proxy server (LMAX adapter)
-struct MqlProxyQuotes
-{
-    short numOfQuotes_;
-    struct Quote 
-    {
-        double ask_;
-        double bid_;
-        char   symbol_[MAX_SYMBOL_LENGTH];
-    } quotes_[1];
-
-    static int maxProxyServerBufferSize() 
-    { return (sizeof(Quote)*MAX_SYMBOLS + 16); }
-};
-
-// Transaction from mql proxy client (mql.dll)
-struct MqlProxySymbols
-{
-    short numOfSymbols_;
-    char  symbols_[1][MAX_SYMBOL_LENGTH];
-
-    static int maxProxyClientBufferSize() 
-    { return (sizeof(MqlProxySymbols)*MAX_SYMBOLS); }
-};
-#pragma pack(pop,r1) // restore memory alignment
 
 //////////////////////////////////////////////////////////////////////////////
 // Disable VisualC compiler deprication warnings
@@ -72,4 +80,23 @@ struct MqlProxySymbols
 #pragma warning(disable:4996)
 #endif
 
+//////////////////////////////////////////////////////////////////////////////
+// Thread local storage of POD variables
+//////////////////////////////////////////////////////////////////////////////
+#ifdef _MSC_VER
+#define THREAD_LOCAL        __declspec(thread)
+#else
+#define THREAD_LOCAL        __thread
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+// CRT names of VisualC used by the sources shared with the headless service
+//////////////////////////////////////////////////////////////////////////////
+#ifndef WIN32
+#include <stdio.h>
+#include <strings.h>
+#define sprintf_s   snprintf
+#define stricmp     strcasecmp
+#endif
+
 #endif // __external_h__
@@ -1,27 +1,36 @@
 #include "globals.h"
 #include "baseini.h"
 #include "fix.h"
+#include "rwlock-dbg.h"
 
 #include <QtCore>
+#ifdef WIN32
 #include <windows.h>
+#endif
 #include <time.h>
 
 using namespace std;
 
 FIX::FIX() 
     : ini_( NULL ),
-    flagLock_(new QReadWriteLock()),
+    flagLock_(new RWLockDbg("flagLock_")),
     msgSeqNum_(0),
     loggedIn_(),
     lastIncomingTime_(0),
     lastOutgoingTime_(0),
     testRequestSent_(false),
-    hbi_(0)
+    hbi_(0),
+    inSeqNum_(1),
+    resendFrom_(0),
+    resendTo_(0),
+    inSequencing_(true),
+    inSeqFailed_(false),
+    journalFile_(FILENAME_JOURNAL)
 {}
 
 FIX::~FIX()
 {
-    { QWriteLocker g(flagLock_); }
+    { DWriteLocker g(flagLock_, LOCK_SITE); }
     delete flagLock_;
     flagLock_ = NULL;
 }
@@ -66,31 +75,29 @@ string FIX::getField(const QByteArray& message, const char* field, unsigned char
 
 std::string FIX::makeTime()
 {
-	struct tm *area;
-	time_t t = time(NULL);
-	area = gmtime(&t);
-
-	SYSTEMTIME st;
-	GetLocalTime(&st);
-
-    char buf[25];
-	sprintf(buf,"%4d%02d%02d-%02d:%02d:%02d.%03d",
-			area->tm_year + 1900, area->tm_mon + 1, area->tm_mday,
-			area->tm_hour, area->tm_min, area->tm_sec, st.wMilliseconds);
-
-	return string(buf);
+    return QDateTime::currentDateTimeUtc().toString("yyyyMMdd-hh:mm:ss.zzz").toStdString();
 }
 
 QByteArray FIX::makeHeader(const char* msgType) const
+{
+    return makeHeader(msgType, ++msgSeqNum_, NULL);
+}
+
+// origSendingTime is given for PossDup messages only
+QByteArray FIX::makeHeader(const char* msgType, quint32 seqNum, const char* origSendingTime) const
 {
 	char buff[256];
-	sprintf(buff, "35=%s%c49=%s%c56=%s%c34=%d%c52=%s%c", 
+	sprintf(buff, "35=%s%c49=%s%c56=%s%c34=%u%c52=%s%c", 
         msgType, SOH,
         ini_->value(SenderCompParam).toStdString().c_str(), SOH,
         ini_->value(TargetCompParam).toStdString().c_str(), SOH,
-        ++msgSeqNum_, SOH,
+        seqNum, SOH,
         makeTime().c_str(), SOH );
-	return buff;
+
+    QByteArray header(buff);
+    if( origSendingTime )
+        header.append("43=Y").append(SOH).append("122=").append(origSendingTime).append(SOH);
+	return header;
 }
 
 void FIX::completeMessage(QByteArray& message) const
@@ -105,12 +112,32 @@ void FIX::completeMessage(QByteArray& message) const
 
 QByteArray FIX::makeLogon()
 {
-	msgSeqNum_ = 0;
+    QByteArray session = (ini_->value(SenderCompParam) + ">" + ini_->value(TargetCompParam)).toLatin1();
+    journal_.open(journalFile_, session);
+
+    // the journaled sequence numbers are resumed if allowed, reset otherwise
+    bool resume = (ini_->value(SessionResumeParam).toInt() != 0 && journal_.lastOutSeqNum() > 0);
+    if( resume ) {
+        msgSeqNum_ = journal_.lastOutSeqNum();
+        inSeqNum_ = journal_.lastInSeqNum() + 1;
+        CDebug() << "Logon resumes MsgSeqNum " << msgSeqNum_ + 1 << ", expected inbound " << inSeqNum_;
+    }
+    else {
+        journal_.reset();
+        msgSeqNum_ = 0;
+        inSeqNum_ = 1;
+    }
+    resendFrom_ = resendTo_ = 0;
+    inSeqFailed_ = false;
     hbi_ = ini_->value(HeartbeatParam).toInt();
 
+    char resetFlag[8] = "";
+    if( !resume )
+        sprintf(resetFlag, "141=Y%c", SOH);
+
     char buf[128];
-	sprintf_s(buf, 128, "98=0%c108=%d%c141=Y%c553=%s%c554=%s%c", 
-        SOH, hbi_, SOH, SOH, 
+	sprintf_s(buf, 128, "98=0%c108=%d%c%s553=%s%c554=%s%c", 
+        SOH, hbi_, SOH, resetFlag, 
         ini_->value(SenderCompParam).toStdString().c_str(), SOH,
         ini_->value(PasswordParam).toStdString().c_str(), SOH);
 
@@ -121,9 +148,11 @@ QByteArray FIX::makeLogon()
     return logon;
 }
 
-QByteArray FIX::makeLogout() const
+QByteArray FIX::makeLogout(const char* text) const
 {
     QByteArray logout = makeHeader("5");
+    if( text )
+        logout.append("58=").append(text).append(SOH);
 	completeMessage( logout );
     return logout;
 }
@@ -135,25 +164,18 @@ QByteArray FIX::makeHeartBeat() const
 	return hearbeat;
 }
 
-QByteArray FIX::makeTestRequest()
+QByteArray FIX::makeTestRequest(const char* testReqId)
 {
     {
-        QWriteLocker guard(flagLock_);
+        DWriteLocker guard(flagLock_, LOCK_SITE);
         testRequestSent_ = true;
     }
 
-    QByteArray test = makeHeader("1").append("112=TSTTST").append(SOH);
+    QByteArray test = makeHeader("1").append("112=").append(testReqId).append(SOH);
     completeMessage( test );
     return test;
 }
 
-QByteArray FIX::makeOnTestRequest(const char* TestReqID) const
-{
-    QByteArray ontest = makeHeader("0").append("112=").append(TestReqID).append(SOH);
-	completeMessage(ontest);
-    return ontest;
-}
-
 QByteArray FIX::makeMarketSubscribe(const char* symbol, qint32 code) const
 {
     char buf[100];
@@ -181,6 +203,88 @@ QByteArray FIX::makeMarketUnSubscribe(const char* symbol, qint32 code) const
     return request;
 };
 
+QByteArray FIX::makeGapFill(quint32 beginSeqNo, quint32 newSeqNo) const
+{
+    char buf[48];
+    sprintf(buf, "123=Y%c36=%u%c", SOH, newSeqNo, SOH);
+
+    QByteArray reset = makeHeader("4", beginSeqNo, makeTime().c_str()).append(buf);
+    completeMessage( reset );
+    return reset;
+}
+
+// Journaled message with its MsgSeqNum and a new SendingTime
+QByteArray FIX::makeResent(const QByteArray& original) const
+{
+    string f35 = getField(original,"35");
+    string f52 = getField(original,"52");
+    quint32 seqNum = strtoul(getField(original,"34").c_str(), NULL, 10);
+    if( f35.empty() || f52.empty() || seqNum == 0 )
+        return QByteArray();
+
+    // the body is between SendingTime and CheckSum
+    char buf[10]; sprintf_s(buf,10,"%c10=",SOH);
+    qint32 endpos = original.lastIndexOf(buf) + 1;
+    qint32 firstpos = original.indexOf(f52.c_str()) + f52.length() + 1;
+    if( endpos <= 0 || firstpos > endpos )
+        return QByteArray();
+
+    QByteArray resent = makeHeader(f35.c_str(), seqNum, f52.c_str());
+    resent.append(original.constData() + firstpos, endpos - firstpos);
+    completeMessage( resent );
+    return resent;
+}
+
+// Market data requests are resent from the journal, session messages and
+// the ones out of the journal are gap filled
+void FIX::resend(quint32 beginSeqNo, quint32 endSeqNo)
+{
+    quint32 last = msgSeqNum_;
+    if( endSeqNo == 0 || endSeqNo > last )
+        endSeqNo = last;
+    if( beginSeqNo > endSeqNo ) {
+        CDebug() << "Resend of " << beginSeqNo << "-" << endSeqNo << ": nothing was sent";
+        return;
+    }
+
+    quint32 resent = 0, gapFrom = 0;
+    for(quint32 seq = beginSeqNo; seq <= endSeqNo; ++seq)
+    {
+        QByteArray original = journal_.find(seq);
+        QByteArray message;
+        if( !original.isEmpty() && getField(original,"35") == "V" )
+            message = makeResent(original);
+
+        if( message.isEmpty() ) {
+            if( gapFrom == 0 )
+                gapFrom = seq;
+            continue;
+        }
+        if( gapFrom ) {
+            outgoing_.push_back( makeGapFill(gapFrom, seq) );
+            gapFrom = 0;
+        }
+        outgoing_.push_back(message);
+        ++resent;
+    }
+    if( gapFrom )
+        outgoing_.push_back( makeGapFill(gapFrom, endSeqNo + 1) );
+
+    CDebug() << "Resend of " << beginSeqNo << "-" << endSeqNo << ": " << resent 
+             << " messages resent, the rest gap filled";
+}
+
+void FIX::journalOutgoing(const QByteArray& message)
+{
+    // PossDup messages are journaled by their first sending
+    if( getField(message,"43") == "Y" )
+        return;
+
+    quint32 seqNum = strtoul(getField(message,"34").c_str(), NULL, 10);
+    if( seqNum )
+        journal_.append(seqNum, message);
+}
+
 bool FIX::normalize(QByteArray& rawFix)
 {
     string f35 = getField(rawFix,"35");
@@ -203,6 +307,12 @@ bool FIX::normalize(QByteArray& rawFix)
     return true;
 }
 
+// Queued as "35=type|body", resent messages and gap fills keep their MsgSeqNum
+void FIX::queueOutgoing(const char* msgType, const QByteArray& body)
+{
+    outgoing_.push_back( QByteArray("35=").append(msgType).append(SOH).append(body) );
+}
+
 QByteArray FIX::takeOutgoing()
 {
     if( outgoing_.empty() )
@@ -212,36 +322,175 @@ QByteArray FIX::takeOutgoing()
     nocopyObj.swap(outgoing_.front());
     outgoing_.pop_front();
 
+    if( !nocopyObj.startsWith("8=") ) {
+        qint32 end = nocopyObj.indexOf(SOH);
+        QByteArray message = makeHeader(nocopyObj.mid(3, end - 3).constData());
+        message.append(nocopyObj.constData() + end + 1, nocopyObj.size() - end - 1);
+        completeMessage(message);
+        nocopyObj.swap(message);
+    }
+
     lastOutgoingTime_ = Global::time();
     return nocopyObj;
 }
 
 bool FIX::loggedIn() const
 {
-    QReadLocker g(flagLock_);
+    DReadLocker g(flagLock_, LOCK_SITE);
     return loggedIn_;
 }
 
 void FIX::setLoggedIn(bool on)
 {
-    QWriteLocker guard(flagLock_);
+    DWriteLocker guard(flagLock_, LOCK_SITE);
     loggedIn_ = on;
 }
 
 bool FIX::testRequestSent() const
 {
-    QReadLocker guard(flagLock_);
+    DReadLocker guard(flagLock_, LOCK_SITE);
     return testRequestSent_;
 }
 
 void FIX::setTestRequestSent(bool on)
 {
-    QWriteLocker guard(flagLock_);
+    DWriteLocker guard(flagLock_, LOCK_SITE);
     testRequestSent_ = on;
 }
 
 void FIX::resetMsgSeqNum(quint32 newMsgSeqNum)
 {
-    QReadLocker g(flagLock_);
+    DWriteLocker g(flagLock_, LOCK_SITE);
     msgSeqNum_ = newMsgSeqNum;
 }
+
+FIX::SeqCheck FIX::checkInSeqNum(const QByteArray& message)
+{
+    quint32 seq = strtoul(getField(message,"34").c_str(), NULL, 10);
+    bool possDup = (getField(message,"43") == "Y");
+
+    if( seq == inSeqNum_ ) {
+        ++inSeqNum_;
+        if( resendTo_ && seq >= resendTo_ ) {
+            CDebug() << "Resend of MsgSeqNum " << resendFrom_ << "-" << resendTo_ << " completed";
+            resendFrom_ = resendTo_ = 0;
+        }
+        journalIncoming();
+        return SeqInOrder;
+    }
+
+    if( seq > inSeqNum_ ) {
+        CDebug() << "Warning: MsgSeqNum gap, expected " << inSeqNum_ << " received " << seq 
+                 << ", resend is requested";
+        char range[48];
+        sprintf(range, "7=%u%c16=%u%c", inSeqNum_, SOH, seq-1, SOH);
+        queueOutgoing("2", range);
+        if( resendTo_ == 0 )
+            resendFrom_ = inSeqNum_;
+        resendTo_ = seq-1;
+        inSeqNum_ = seq+1;
+        journalIncoming();
+        return SeqGap;
+    }
+
+    // FIX 4.4: Logout with the reason, then disconnect. Logout itself is obeyed
+    if( !possDup ) {
+        if( inSeqFailed_ )
+            return SeqTooLow;
+        char text[80];
+        sprintf(text, "MsgSeqNum too low, expecting %u but received %u", inSeqNum_, seq);
+        CDebug() << "Error: " << text;
+        if( getField(message,"35") != "5" ) {
+            queueOutgoing("5", QByteArray("58=").append(text).append(SOH));
+            inSeqFailed_ = true;
+        }
+        return SeqTooLow;
+    }
+
+    if( resendTo_ && seq >= resendFrom_ && seq <= resendTo_ ) {
+        if( seq == resendTo_ ) {
+            CDebug() << "Resend of MsgSeqNum " << resendFrom_ << "-" << resendTo_ << " completed";
+            resendFrom_ = resendTo_ = 0;
+        }
+        journalIncoming();
+        return SeqResent;
+    }
+    return SeqDuplicate;
+}
+
+FIX::Admission FIX::admitInbound(const QByteArray& message, char type)
+{
+    if( type == '4' || !inSequencing_ )
+        return AdmitProcess;
+
+    bool failed = inSeqFailed_;
+    SeqCheck seq = checkInSeqNum(message);
+    if( seq == SeqTooLow && type != '5' )
+        return failed ? AdmitIgnore : AdmitDrop;
+
+    bool ignore = (seq == SeqDuplicate);
+    // resent session messages aren't replayed
+    ignore |= (seq == SeqResent && (type == 'A' || type == '0' || type == '1' || type == '2'));
+    return (ignore && type != '5') ? AdmitIgnore : AdmitProcess;
+}
+
+void FIX::applySequenceReset(const QByteArray& message)
+{
+    string tag = getField(message,"36");
+    if( tag.empty() ) {
+        CDebug() << "Error corrupted message: tag \"NewSeqNo\":36 is empty";
+        return;
+    }
+
+    quint32 newSeq = strtoul(tag.c_str(), NULL, 10);
+    if( getField(message,"123") != "Y" ) {
+        // Reset mode ignores MsgSeqNum
+        resetInSeqNum(newSeq, false);
+        CDebug() << "Reset expected \"MsgSeqNum\" to " << newSeq;
+        return;
+    }
+
+    SeqCheck seq = checkInSeqNum(message);
+    if( seq == SeqResent ) {
+        fillResent(newSeq);
+    }
+    else if( seq == SeqInOrder || seq == SeqGap ) {
+        resetInSeqNum(newSeq, true);
+        CDebug() << "GapFill, expected \"MsgSeqNum\" is " << inSeqNum_;
+    }
+}
+
+void FIX::resetInSeqNum(quint32 newSeqNo, bool gapFill)
+{
+    if( newSeqNo < inSeqNum_ ) {
+        // gap fill can't move back, reset mode is obeyed with a warning
+        CDebug() << "Warning: NewSeqNo " << newSeqNo << " is lower than expected " << inSeqNum_;
+        if( gapFill )
+            return;
+    }
+
+    inSeqNum_ = newSeqNo;
+    if( !gapFill )
+        resendFrom_ = resendTo_ = 0;
+    journalIncoming();
+}
+
+void FIX::fillResent(quint32 newSeqNo)
+{
+    if( resendTo_ == 0 || newSeqNo <= resendFrom_ )
+        return;
+
+    if( newSeqNo > resendTo_ ) {
+        CDebug() << "Resend of MsgSeqNum " << resendFrom_ << "-" << resendTo_ << " gap filled";
+        resendFrom_ = resendTo_ = 0;
+    }
+    else
+        resendFrom_ = newSeqNo;
+    journalIncoming();
+}
+
+// A restarted session asks for the unrecovered gap again
+void FIX::journalIncoming()
+{
+    journal_.setLastInSeqNum( resendTo_ ? resendFrom_ - 1 : inSeqNum_ - 1 );
+}
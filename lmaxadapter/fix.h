@@ -2,6 +2,7 @@
 #define __fix_h__
 
 #include "responsehandler.h"
+#include "fixjournal.h"
 #include <QList>
    
 #include <string>
@@ -9,15 +10,27 @@
 #define SOH (char(0x01))
 
 class BaseIni;
-
-QT_BEGIN_NAMESPACE;
-class QReadWriteLock;
-QT_END_NAMESPACE;
+class RWLockDbg;
 
 ///////////////////////////////////////////////////////////
 class FIX : public ResponseHandler
 {
 public:
+    // Result of the inbound MsgSeqNum check
+    enum SeqCheck {
+        SeqInOrder = 0,
+        SeqGap,         // ahead of expected, ResendRequest is queued to outgoing
+        SeqResent,      // PossDup of the range requested for resend
+        SeqDuplicate,   // PossDup already received, to be ignored
+        SeqTooLow,      // below expected without PossDup, Logout is queued to outgoing
+    };
+    // What the session does with an inbound message after the MsgSeqNum check
+    enum Admission {
+        AdmitProcess = 0,
+        AdmitIgnore,    // duplicate or resent session message, or the session is being dropped
+        AdmitDrop,      // MsgSeqNum too low, the session is dropped after the queued Logout
+    };
+
     FIX();
     ~FIX();
 
@@ -27,11 +40,15 @@ public:
     static std::string makeTime();
 
     QByteArray  makeLogon();
-    QByteArray  makeTestRequest();
-    QByteArray  makeLogout() const;
+    QByteArray  makeTestRequest(const char* testReqId = "TSTTST");
+    QByteArray  makeLogout(const char* text = NULL) const;
     QByteArray  makeHeartBeat() const;
     QByteArray  makeMarketSubscribe(const char* symbol, qint32 code) const;
     QByteArray  makeMarketUnSubscribe(const char* symbol, qint32 code) const;
+    QByteArray  makeGapFill(quint32 beginSeqNo, quint32 newSeqNo) const;
+    QByteArray  makeResent(const QByteArray& original) const;
+    // The answers queued by processing of inbound messages get MsgSeqNum here,
+    // so they are taken under the send lock of the session
     QByteArray  takeOutgoing();
 
     bool normalize(QByteArray& rawFix);
@@ -41,15 +58,35 @@ public:
     bool loggedIn() const;
     bool testRequestSent() const;
 
+    // Sequencing of inbound message shared by the primary and standby sessions,
+    // SequenceReset is sequenced by applySequenceReset, Logout is processed on any MsgSeqNum
+    Admission admitInbound(const QByteArray& message, char type);
+    // SequenceReset(4): Reset mode sets the expected MsgSeqNum, GapFill moves it
+    // forward or fills the resend range
+    void applySequenceReset(const QByteArray& message);
+
+    // Queues to outgoing the answer on ResendRequest, endSeqNo 0 - up to the last
+    void resend(quint32 beginSeqNo, quint32 endSeqNo);
+    // Every sent message is journaled for resend and session resume
+    void journalOutgoing(const QByteArray& message);
+    inline quint32 expectedInSeqNum() const { 
+        return inSeqNum_; 
+    }
+    // off for the log replay which skips session messages
+    inline void setInSequencing(bool on) {
+        inSequencing_ = on;
+    }
+
     static inline quint16 getChecksum(const char* buf, int buflen) {
 	    quint32 cks = 0;
 	    for(int i = 0; i < buflen; ++i) cks += (unsigned char)buf[i];
 	    return cks % 256;
     }
-    inline qint32 getLastIncoming() const { 
+    // msecs of Global::time()
+    inline qint64 getLastIncoming() const { 
         return lastIncomingTime_; 
     }
-    inline qint32 getLastOutgoing() const { 
+    inline qint64 getLastOutgoing() const { 
         return lastOutgoingTime_; 
     }
     inline int getHeartbeatInterval() const { 
@@ -58,25 +95,51 @@ public:
     inline void setIniModel(const BaseIni* ini) {
         ini_ = ini;
     }
+    // every session keeps its own journal
+    inline void setJournalFile(const QString& filename) {
+        journalFile_ = filename;
+    }
 
 protected:
     QByteArray makeHeader(const char* msgType) const;
-    QByteArray makeOnTestRequest(const char* testReqID) const;
+    QByteArray makeHeader(const char* msgType, quint32 seqNum, const char* origSendingTime) const;
+    // Queues a message to be stamped by takeOutgoing
+    void queueOutgoing(const char* msgType, const QByteArray& body);
     void completeMessage(QByteArray& message) const;
+    void journalIncoming();
+
+    // Checks MsgSeqNum(34) of inbound message against the expected one,
+    // moves the expected one forward and requests resend of the gaps.
+    // Too low one is fatal, the session has to be dropped after the Logout
+    SeqCheck checkInSeqNum(const QByteArray& message);
+    // Next expected inbound MsgSeqNum is set by SequenceReset
+    void resetInSeqNum(quint32 newSeqNo, bool gapFill);
+    // Resent GapFill covers the resend range up to newSeqNo
+    void fillResent(quint32 newSeqNo);
 
 protected:
     QList<QByteArray> outgoing_;
 
-    qint32  lastIncomingTime_;
-    qint32  lastOutgoingTime_;
+    qint64  lastIncomingTime_;
+    qint64  lastOutgoingTime_;
     int     hbi_;
-    QReadWriteLock* flagLock_;
+    bool    inSequencing_;
+    RWLockDbg* flagLock_;
 
 private:
     bool  loggedIn_;
     bool  testRequestSent_;
     const BaseIni* ini_;
+    // stamped by makeHeader and takeOutgoing under the send lock of the session
     mutable quint32 msgSeqNum_;
+
+    // inbound sequencing, touched by the receiving thread after logon
+    quint32 inSeqNum_;          // next expected
+    quint32 resendFrom_;        // range requested for resend, 0 - none
+    quint32 resendTo_;
+    bool    inSeqFailed_;       // Logout on too low MsgSeqNum is queued, the rest are ignored up to logon
+    FixJournal journal_;
+    QString    journalFile_;
 };
 
 #endif // __fix_h__
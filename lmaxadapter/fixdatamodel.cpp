@@ -4,9 +4,13 @@
 #include "scheduler.h"
 #include "fixlogger.h"
 #include "mqlproxyserver.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
 
 #include <QReadWriteLock>
+#ifdef WIN32
 #include <Windows.h>
+#endif
 
 using namespace std;
 
@@ -24,8 +28,8 @@ namespace {
 
         char tmp[20] = {0};
         if( diffSecs > 86400 ) {
-            report += ltoa(qint32(diffSecs/86400),tmp,10);
-            report += "d ";
+            sprintf(tmp, "%dd ", qint32(diffSecs/86400));
+            report += tmp;
             diffSecs %= 86400;
         }
 
@@ -45,28 +49,50 @@ namespace {
 }
 
 //////////////////////////////////////////////////////////////
-FixDataModel::FixDataModel(QSharedPointer<MqlProxyServer>& mqlProxy, QWidget* parent) 
+FixDataModel::FixDataModel(QSharedPointer<MqlProxyServer>& mqlProxy, QObject* parent) 
     : SymbolsModel(parent),
-    cacheLock_(new QReadWriteLock()),
-    mqlProxy_(mqlProxy)
+    cacheLock_(new RWLockDbg("cacheLock_")),
+    mqlProxy_(mqlProxy),
+    lastIncomingNanos_(0),
+    lastFramedNanos_(0),
+    profiling_(false)
 {
+    memset(&stages_, 0, sizeof(stages_));
     setIniModel(dynamic_cast<const BaseIni*>(this));
     fixlog_.reset(new FixLog(this));
 }
 
 FixDataModel::~FixDataModel()
 {
-    { QWriteLocker g(cacheLock_); }
+    { DWriteLocker g(cacheLock_, LOCK_SITE); }
     delete cacheLock_;
     cacheLock_ = NULL;
 }
 
-int FixDataModel::process(const QByteArray& message)
+int FixDataModel::process(const QByteArray& message, qint64 rxNanos)
 {
     lastIncomingTime_ = Global::time();
+    lastFramedNanos_ = Global::nanotime();
+    lastIncomingNanos_ = rxNanos ? rxNanos : lastFramedNanos_;
+    if( profiling_ )
+        stages_.received_ = lastIncomingNanos_;
 
     string value = getField(message, "35");
-    switch(value[0])
+    char type = value.empty() ? 0 : value[0];
+    if( !profiling_ )
+        Metrics::messageIn(Metrics::Primary, type);
+
+    Admission admission = admitInbound(message, type);
+    if( admission != AdmitProcess ) {
+        CDebug(false) << "<< " << message;
+        if( admission == AdmitIgnore )
+            return 0;
+        msglog().inmsg(message);
+        setLoggedIn(false);
+        return -2;
+    }
+
+    switch(type)
     {
     case 'A':
         onLogon(message);
@@ -101,7 +127,7 @@ int FixDataModel::process(const QByteArray& message)
         CDebug(false) << "<< " << message;
         break;
     }
-    return 0;
+    return outgoing_.isEmpty() ? 0 : 1;
 }
 
 void FixDataModel::beforeLogout()
@@ -174,7 +200,7 @@ void FixDataModel::onTestRequest(const QByteArray& message)
     msglog().inmsg(message);
     if( !reqId.empty() ) {
         CDebug(false) << "tag \"TestReqID\":112=" << reqId.c_str();
-        outgoing_.push_back( makeOnTestRequest(reqId.c_str()) );
+        queueOutgoing("0", QByteArray("112=").append(reqId.c_str()).append(SOH));
     }
     else
         CDebug(false) << "Error corrupted message: tag \"TestReqID\":112 is empty";
@@ -185,20 +211,19 @@ void FixDataModel::onResendRequest(const QByteArray& message)
     CDebug() << "ResendRequest type=\"2\" received:";
     CDebug(false) << "<< " << message;
 
+    msglog().inmsg(message);
     string tag = getField(message,"7");
-    if( tag.empty() )
+    quint32 beginSeq = strtoul(tag.c_str(), NULL, 10);
+    if( beginSeq == 0 ) {
         CDebug(false) << "Error corrupted message: tag \"BeginSeqNo\":7 is empty";
-    else
-        CDebug(false) << "tag \"BeginSeqNo\":7=" << tag.c_str();
+        return;
+    }
+    CDebug(false) << "tag \"BeginSeqNo\":7=" << tag.c_str();
 
     tag = getField(message,"16");
-    if( tag.empty() )
-        CDebug(false) << "Error corrupted message: tag \"EndSeqNo\":16 is empty";
-    else
-        CDebug(false) << "tag \"EndSeqNo\":16=" << tag.c_str();
+    CDebug(false) << "tag \"EndSeqNo\":16=" << (tag.empty() ? "<empty>" : tag.c_str());
 
-    msglog().inmsg(message);
-    CDebug() << "Warning: behaviour on ResendRequest is not implemented!";
+    resend(beginSeq, strtoul(tag.c_str(), NULL, 10));
 }
 
 void FixDataModel::onSequenceReset(const QByteArray& message)
@@ -206,32 +231,32 @@ void FixDataModel::onSequenceReset(const QByteArray& message)
     CDebug() << "SequenceReset type=\"4\" received:";
     CDebug(false) << "<< " << message;
 
-    string tag = getField(message,"36");
     msglog().inmsg(message);
-    if( tag.empty() ) {
-        CDebug(false) << "Error corrupted message: tag \"NewSeqNo\":36 is empty";
-        return;
-    }
-
-    int newSeq = atol(tag.c_str());
 
-    tag = getField(message,"123");
+    string tag = getField(message,"123");
     if( !tag.empty() )
         CDebug(false) << "tag \"GapFillFlag\":123=" << tag.c_str();
 
-    if( "tag" == "N" ) {
-        resetMsgSeqNum(0);
-        CDebug(false) << "Reset \"MsgSeqNum\"";
-    }
-    else {
-        resetMsgSeqNum(newSeq-1);
-        CDebug(false) << "Change \"MsgSeqNum\", this GapFill message";
-    }
+    applySequenceReset(message);
 }
 
 void FixDataModel::onMarketData(const QByteArray& message)
 {
-    CDebug() << "MarketDataSnapshotFullRefresh type=\"W\" received";
+    applyMarketData(message, lastIncomingNanos_, lastFramedNanos_, false);
+}
+
+void FixDataModel::feedMarketData(const QByteArray& message, qint64 rxNanos)
+{
+    qint64 framedNanos = Global::nanotime();
+    applyMarketData(message, rxNanos ? rxNanos : framedNanos, framedNanos, true);
+}
+
+void FixDataModel::applyMarketData(const QByteArray& message, qint64 rxNanos, qint64 framedNanos, bool standby)
+{
+    // both sessions publish in the order of the cache updates
+    QMutexLocker g(&marketLock_);
+
+    CDebug() << (standby ? "Standby " : "") << "MarketDataSnapshotFullRefresh type=\"W\" received";
     string sym = getField(message,"262");
     if( sym.empty() ) {
         CDebug(false) << "Error corrupted message: tag \"MDReqID\":262 is empty";
@@ -299,18 +324,45 @@ void FixDataModel::onMarketData(const QByteArray& message)
         }
     }
     response_noinfo |= (bid.empty() && ask.empty());
+    qint64 parsedNanos = Global::nanotime();
+    if( profiling_ )
+        stages_.parsed_ = parsedNanos;
+
+    // resent quotes carry the original time and must not override later ones
+    bool possDup = (getField(message,"43") == "Y");
+    qint64 serverTime = Global::timestamp2time(getField(message, possDup ? "122" : "52"));
 
-    QSharedPointer<QWriteLocker> autolock;
+    QSharedPointer<DWriteLocker> autolock;
     Snapshot* dest = snapshotDelegate(sym.c_str(), code, autolock);
     if( NULL == dest ) {
         CDebug(false) << "Warning: request for \"" << sym.c_str() << "\" not found in cache.";
         return;
     }
 
-    // set request time to delta msecs only after requested source
-    dest->responseTime_ = Global::time();
-    if( dest->statuscode_ == Snapshot::StatSubscribe )
+    if( possDup && serverTime <= dest->serverTime_ ) {
+        CDebug(false) << "Resent quote of \"" << sym.c_str() << "\" is older than cached: message ignored.";
+        return;
+    }
+
+    // quotes of both sessions are merged, the freshest one is taken
+    if( serverTime && serverTime < dest->serverTime_ ) {
+        CDebug(false) << "Quote of \"" << sym.c_str() << "\" is older than cached: message ignored.";
+        return;
+    }
+    if( standby != dest->standby_ && serverTime - dest->serverTime_ <= QUOTES_DEDUP_WINDOW &&
+        dest->bid_ == bid.c_str() && dest->ask_ == ask.c_str() ) 
+    {
+        CDebug(false) << "Quote of \"" << sym.c_str() << "\" is received by the other session: message ignored.";
+        return;
+    }
+
+    // set request time to delta nsecs only after requested source
+    dest->responseTime_ = Global::nanotime();
+    if( dest->statuscode_ == Snapshot::StatSubscribe ) {
         dest->requestTime_ = dest->responseTime_ - dest->requestTime_;
+        if( !profiling_ )
+            LatencyRecorder::record(LatencyRecorder::RequestToResponse, dest->requestTime_);
+    }
 
     if(dest->statuscode_ == Snapshot::StatUnSubscribed || response_noinfo) 
     {
@@ -344,11 +396,28 @@ void FixDataModel::onMarketData(const QByteArray& message)
         dest->description_ = "Bid&Ask changed"; break;
     }
 
+    dest->serverTime_ = serverTime;
+    dest->rxNanos_ = rxNanos;
+    dest->standby_ = standby;
+    quint32 sequence = ++dest->updates_;
+
     // unlock region
     string copysym  = sym, copybid = bid, copyask = ask;
     autolock.reset();
-
-    mqlSendQuotes(copysym, copybid, copyask);
+    qint64 cachedNanos = Global::nanotime();
+    if( profiling_ )
+        stages_.cached_ = cachedNanos;
+
+    mqlSendQuotes(copysym, copybid, copyask, serverTime, rxNanos, sequence);
+    qint64 publishedNanos = Global::nanotime();
+    if( profiling_ )
+        stages_.published_ = publishedNanos;
+    else {
+        // replayed messages are not timed by the recorder
+        LatencyRecorder::record(LatencyRecorder::FrameToParse, parsedNanos - framedNanos);
+        LatencyRecorder::record(LatencyRecorder::ParseToCache, cachedNanos - parsedNanos);
+        LatencyRecorder::record(LatencyRecorder::CacheToPublish, publishedNanos - cachedNanos);
+    }
     emit activateResponse(instrument);
 }
 
@@ -398,17 +467,20 @@ void FixDataModel::onMarketDataReject(const QByteArray& message)
         }
     }
 
-    QSharedPointer<QWriteLocker> autolock;
+    QSharedPointer<DWriteLocker> autolock;
     Snapshot* dest = snapshotDelegate(sym.c_str(), code, autolock);
     if( NULL == dest ) {
         CDebug(false) << "Warning: request for \"" << sym.c_str() << "\" not found in cache.";
         return;
     }
 
-    // set request time to delta msecs only after requested source
-    dest->responseTime_ = Global::time();
-    if( dest->statuscode_ == Snapshot::StatSubscribe )
+    // set request time to delta nsecs only after requested source
+    dest->responseTime_ = Global::nanotime();
+    if( dest->statuscode_ == Snapshot::StatSubscribe ) {
         dest->requestTime_ = dest->responseTime_ - dest->requestTime_;
+        if( !profiling_ )
+            LatencyRecorder::record(LatencyRecorder::RequestToResponse, dest->requestTime_);
+    }
 
     dest->statuscode_ = Snapshot::StatBusinessReject;
     if( reason.isEmpty() )
@@ -436,17 +508,20 @@ void FixDataModel::onSessionReject(const QByteArray& message)
         return;
     }
 
-    QSharedPointer<QWriteLocker> autolock;
+    QSharedPointer<DWriteLocker> autolock;
     Snapshot* dest = snapshotDelegate(seqnum, autolock);
     if( NULL == dest ) {
         CDebug(false) << "Error corrupted message: request with \"MsgSeqNum\"=" << seqnum << " not found in cache";
         return;
     }
 
-    // set request time to delta msecs only after requested source
-    dest->responseTime_ = Global::time();
-    if( dest->statuscode_ == Snapshot::StatSubscribe )
+    // set request time to delta nsecs only after requested source
+    dest->responseTime_ = Global::nanotime();
+    if( dest->statuscode_ == Snapshot::StatSubscribe ) {
         dest->requestTime_ = dest->responseTime_ - dest->requestTime_;
+        if( !profiling_ )
+            LatencyRecorder::record(LatencyRecorder::RequestToResponse, dest->requestTime_);
+    }
 
     dest->statuscode_ = Snapshot::StatSessionReject;
     if( reason.isEmpty() )
@@ -465,28 +540,28 @@ void FixDataModel::onSessionReject(const QByteArray& message)
         emit activateResponse(instrument);
 }
 
-Snapshot* FixDataModel::snapshotDelegate(const char* symbol, qint32 code, QSharedPointer<QWriteLocker>& autolock)
+Snapshot* FixDataModel::snapshotDelegate(const char* symbol, qint32 code, QSharedPointer<DWriteLocker>& autolock)
 {
     // on first ReadLock simply to find in the cache
     Snapshot* snap = NULL;
     {
-        QReadLocker g(cacheLock_);
+        DReadLocker g(cacheLock_, LOCK_SITE);
         snap = cache_[code];
         if( snap == NULL )
             return snap;
     }
     
     // create the write locker what should be destroyed above of the method
-    autolock.reset(new QWriteLocker(cacheLock_));
+    autolock.reset(new DWriteLocker(cacheLock_, LOCK_SITE));
     return snap;
 }
 
-Snapshot* FixDataModel::snapshotDelegate(qint32 msgSeqNum, QSharedPointer<QWriteLocker>& autolock)
+Snapshot* FixDataModel::snapshotDelegate(qint32 msgSeqNum, QSharedPointer<DWriteLocker>& autolock)
 {
     // on first ReadLock simply to find in the cache
     Snapshot* snap = NULL;
     {
-        QReadLocker g(cacheLock_);
+        DReadLocker g(cacheLock_, LOCK_SITE);
         qint32 code;
         SeqnumToSymT::const_iterator seq_It = seqnumMap_.find(msgSeqNum);
         if( seq_It != seqnumMap_.end() && -1 != (code = getCode(seq_It.value().c_str())) )
@@ -498,18 +573,18 @@ Snapshot* FixDataModel::snapshotDelegate(qint32 msgSeqNum, QSharedPointer<QWrite
     
     // create the write locker what should be destroyed above of the method
     if( snap )
-        autolock.reset(new QWriteLocker(cacheLock_));
+        autolock.reset(new DWriteLocker(cacheLock_, LOCK_SITE));
     return snap;
 }
 
-Snapshot* FixDataModel::getSnapshot(const char* sym, QSharedPointer<QReadLocker>& autolock) const
+Snapshot* FixDataModel::getSnapshot(const char* sym, QSharedPointer<DReadLocker>& autolock) const
 {
     qint32 code = getCode(sym);
     if( code == -1 ) // is compatible?
         return NULL;
 
     if( autolock.isNull() )
-        autolock.reset(new QReadLocker(cacheLock_));
+        autolock.reset(new DReadLocker(cacheLock_, LOCK_SITE));
 
     SnapshotSet& cache = *const_cast<SnapshotSet*>(&cache_);
     return cache[code];
@@ -517,17 +592,21 @@ Snapshot* FixDataModel::getSnapshot(const char* sym, QSharedPointer<QReadLocker>
 
 void FixDataModel::activateMonitoring()
 {
+    // all go to the scheduler at once to be sent in one pass
+    QVector<Instrument> batch;
     qint16 countOf = monitoredCount();
     for(qint16 row = 0; row < countOf; ++row) 
     {
         Instrument inst = getByOrderRow(row);
-        QSharedPointer<QReadLocker> autolock;
+        QSharedPointer<DReadLocker> autolock;
         Snapshot* sp = getSnapshot(inst.first.c_str(), autolock);
         if( sp && sp->statuscode_ & Snapshot::StatUnSubscribed )
             continue;
         autolock.reset();
-        emit activateRequest(inst);
+        batch.push_back(inst);
     }
+    if( !batch.isEmpty() )
+        emit activateRequests(batch);
 }
 
 QByteArray FixDataModel::makeSubscribe(const Instrument& inst)
@@ -536,11 +615,11 @@ QByteArray FixDataModel::makeSubscribe(const Instrument& inst)
     qint32 code = inst.second;
     CDebug() << "makeSubscribe: \"" << symbol << ":" << code << "\"";
 
-    QSharedPointer<QWriteLocker> autolock;
+    QSharedPointer<DWriteLocker> autolock;
     Snapshot* exsp = snapshotDelegate(symbol, code, autolock);
     if( exsp && loggedIn() ) {
         exsp->statuscode_   = Snapshot::StatSubscribe;
-        exsp->requestTime_  = Global::time();
+        exsp->requestTime_  = Global::nanotime();
         exsp->responseTime_ = 0;
         exsp->description_  = "Subscribing";
         return makeMarketSubscribe(symbol, code);
@@ -560,7 +639,7 @@ QByteArray FixDataModel::makeSubscribe(const Instrument& inst)
     snap.responseTime_ = snap.requestTime_  = 0;
 
     if( loggedIn() ) {
-        snap.requestTime_  =  Global::time();
+        snap.requestTime_  =  Global::nanotime();
         snap.statuscode_   = Snapshot::StatSubscribe;
         snap.description_  = "Subscribing";
         cache_.insert(snap);
@@ -581,7 +660,7 @@ QByteArray FixDataModel::makeUnSubscribe(const Instrument& inst)
     qint32 code = inst.second;
     CDebug() << "makeUnSubscribe: \"" << symbol << ":" << code << "\"";
 
-    QSharedPointer<QWriteLocker> autolock;
+    QSharedPointer<DWriteLocker> autolock;
     Snapshot* exsp = snapshotDelegate(symbol, code, autolock);
     if( exsp)
     {
@@ -604,7 +683,7 @@ QByteArray FixDataModel::makeUnSubscribe(const Instrument& inst)
 
 void FixDataModel::clearCache()
 {
-    QWriteLocker g(cacheLock_);
+    DWriteLocker g(cacheLock_, LOCK_SITE);
     QSet<Snapshot>::iterator It = cache_.begin();
     while( It != cache_.end() ) {
         Instrument copy = It->instrument_;
@@ -626,7 +705,7 @@ void FixDataModel::serverLogoutError(const std::string& reason)
     {
         Instrument inst(*It,getCode(It->c_str()));
 
-        QSharedPointer<QWriteLocker> autolock;
+        QSharedPointer<DWriteLocker> autolock;
         Snapshot* dest = snapshotDelegate(inst.first.c_str(), inst.second, autolock);
         if( dest == NULL ) {
             Snapshot snap;
@@ -657,14 +736,14 @@ void FixDataModel::storeRequestSeqnum(const QByteArray& requestMessage, const ch
         return;
 
     if( symbol && strlen(symbol) ) {
-        QWriteLocker g(cacheLock_);
+        DWriteLocker g(cacheLock_, LOCK_SITE);
         seqnumMap_.insert(seqNum,symbol);
         return;
     }
 
     string sym = getField(requestMessage,"262");
     if( !sym.empty() )  {
-        QWriteLocker g(cacheLock_);
+        DWriteLocker g(cacheLock_, LOCK_SITE);
         seqnumMap_.insert(seqNum,symbol);
     }
 }
@@ -672,7 +751,7 @@ void FixDataModel::storeRequestSeqnum(const QByteArray& requestMessage, const ch
 void FixDataModel::removeCached(qint32 byCode)
 {
     {
-        QReadLocker g(cacheLock_);
+        DReadLocker g(cacheLock_, LOCK_SITE);
         Snapshot* snap = cache_[byCode];
         if( snap ) 
         {
@@ -688,7 +767,7 @@ void FixDataModel::removeCached(qint32 byCode)
             return;
     }
 
-    QWriteLocker g(cacheLock_);
+    DWriteLocker g(cacheLock_, LOCK_SITE);
     cache_.erase(byCode);
 }
 
@@ -697,35 +776,26 @@ void FixDataModel::mqlClearPrices()
     // send nulls instead prices
     QVector<string> monitored;
     getSymbolsUnderMonitoring(monitored);
-    MqlProxyQuotes* transaction = (MqlProxyQuotes*)malloc(2+monitored.size()*sizeof(MqlProxyQuotes::Quote));
-    transaction->numOfQuotes_ = monitored.size();
     for(int i = 0; i < monitored.size(); ++i) {
-        transaction->quotes_[i].ask_ = 0;
-        transaction->quotes_[i].bid_ = 0;
-        strcpy_s(transaction->quotes_[i].symbol_, MAX_SYMBOL_LENGTH, monitored[i].c_str());
+        MqlOutQuote quote;
+        mqlProxy_->broadcastQuote(monitored[i], quote);
     }
-    mqlProxy_->sendMessageBroadcast((const char*)transaction);
-
-    free(transaction);
 }
 
-void FixDataModel::mqlSendQuotes(const string& sym, const string& bid, const string& ask)
+void FixDataModel::mqlSendQuotes(const string& sym, const string& bid, const string& ask,
+                                 qint64 serverTime, qint64 rxNanos, quint32 sequence)
 {
-//    QThread::msleep(65);
-
 /*    CDebug() << "FixDataModel::mqlSendQuotes \"" << sym.c_str() 
              << "\": ask=" << ask.c_str() << ", bid=" << bid.c_str();
 */
-    MqlProxyQuotes transaction;
-    transaction.numOfQuotes_ = 1;
-    strcpy_s(transaction.quotes_[0].symbol_, MAX_SYMBOL_LENGTH, sym.c_str());
-    if( ask.empty() )
-        transaction.quotes_[0].ask_ = -1;
-    else
-        Global::reinterpretDouble(ask.c_str(), &transaction.quotes_[0].ask_);
-    if( bid.empty() )
-        transaction.quotes_[0].bid_ = -1;
-    else
-        Global::reinterpretDouble(bid.c_str(), &transaction.quotes_[0].bid_);
-    mqlProxy_->sendMessageBroadcast((const char*)&transaction);
+    MqlOutQuote quote;
+    quote.ask_ = quote.bid_ = -1;
+    if( !ask.empty() )
+        Global::reinterpretDouble(ask.c_str(), &quote.ask_);
+    if( !bid.empty() )
+        Global::reinterpretDouble(bid.c_str(), &quote.bid_);
+    quote.serverTime_ = serverTime;
+    quote.rxNanos_ = rxNanos;
+    quote.sequence_ = sequence;
+    mqlProxy_->broadcastQuote(sym, quote);
 }
@@ -8,7 +8,6 @@
 #include <QSharedPointer>
 
 class Scheduler;
-class QWriteLocker;
 class FixLog;
 class MqlProxyServer;
 
@@ -16,14 +15,15 @@ class MqlProxyServer;
 class FixDataModel : public SymbolsModel, public FIX
 {
 public:
-    FixDataModel(QSharedPointer<MqlProxyServer>& mqlProxy, QWidget* parent);
+    FixDataModel(QSharedPointer<MqlProxyServer>& mqlProxy, QObject* parent);
     ~FixDataModel();
 
-    // Returned > 0 when outgoing messages has to be sent
+    // Returned 1 when outgoing messages are queued (responses, ResendRequest), see takeOutgoing
     // 0 when doesn't need sending after process
-    // 1 when processed login message from server and heartbeat timer should be activated
     // -1 when processed logout message from server and logging out should be activated
-    int process(const QByteArray& message);
+    // -2 when MsgSeqNum is too low: the queued Logout has to be sent and the connection dropped
+    // rxNanos is the receive time of the message, 0 - now
+    int process(const QByteArray& message, qint64 rxNanos = 0);
 
     // Make FIX message type "35=V" - request subscribe market data by instrument 
     QByteArray makeSubscribe(const Instrument& inst);
@@ -33,7 +33,7 @@ public:
 
     // Gets snapshot by the table data fetching (readonly)
     // check autolock after calling - it must be not empty when getSnapshot has owned the section
-    Snapshot* getSnapshot(const char* symbol, QSharedPointer<QReadLocker>& autolock) const;
+    Snapshot* getSnapshot(const char* symbol, QSharedPointer<DReadLocker>& autolock) const;
 
     // Store MsgSeqNum of requesting message (symbols by msgSeqNums association)
     void storeRequestSeqnum(const QByteArray& requestMessage, const char* symbol = NULL);
@@ -41,9 +41,25 @@ public:
     // Actions before logout
     void beforeLogout();
 
+    // Market data of the standby session, merged into the cache with the own one
+    void feedMarketData(const QByteArray& message, qint64 rxNanos);
+
     FixLog& msglog() const 
     { return *fixlog_.data(); }
 
+    // Nanotimes of the stages of the last processed market data message,
+    // stamped only while profiling is on (log replay)
+    struct StageTimes {
+        qint64 received_;   // process() entered
+        qint64 parsed_;     // fields extracted
+        qint64 cached_;     // snapshot updated
+        qint64 published_;  // quote broadcasted to MQL clients
+    };
+    inline void setStageProfiling(bool on)
+    { profiling_ = on; }
+    inline const StageTimes& lastStageTimes() const
+    { return stages_; }
+
 protected:
     // Remove from cache by code
     void removeCached(qint32 byCode);
@@ -60,6 +76,10 @@ protected:
     void onSessionReject(const QByteArray& message);
 
 private:
+    // Updates the cache and publishes the quote if it's fresher than the cached one
+    // framedNanos is the time the message was taken from the transport
+    void applyMarketData(const QByteArray& message, qint64 rxNanos, qint64 framedNanos, bool standby);
+
     // Activate requests for all viewed instruments
     void activateMonitoring();
 
@@ -73,26 +93,32 @@ private:
     void mqlClearPrices();
 
     // Send out quotes with ask/bid to Mql client(s)
-    void mqlSendQuotes(const std::string& sym, const std::string& bid, const std::string& ask);
+    void mqlSendQuotes(const std::string& sym, const std::string& bid, const std::string& ask,
+                       qint64 serverTime = 0, qint64 rxNanos = 0, quint32 sequence = 0);
 
     // Gets snapshot by symbol and code of instrument
     // Check autolock after calling - it must be not empty when snapshotDelegate has owned write section
     Snapshot* snapshotDelegate(const char* symbol, qint32 code, 
-                               QSharedPointer<QWriteLocker>& autolock);
+                               QSharedPointer<DWriteLocker>& autolock);
 
     // Gets snapshot by message sequence number (for session reject only)
     // check autolock after calling - it must be not empty when snapshotDelegate has owned write section
     Snapshot* snapshotDelegate(qint32 msgSeqNum, 
-                               QSharedPointer<QWriteLocker>& autolock);
+                               QSharedPointer<DWriteLocker>& autolock);
 
 private:
     typedef QMap<qint32,std::string> SeqnumToSymT;
 
     SeqnumToSymT seqnumMap_;
-    QReadWriteLock* cacheLock_;
+    RWLockDbg* cacheLock_;
+    QMutex marketLock_;
     SnapshotSet cache_;
     QSharedPointer<FixLog> fixlog_;
     QSharedPointer<MqlProxyServer> mqlProxy_;
+    qint64 lastIncomingNanos_;
+    qint64 lastFramedNanos_;
+    bool profiling_;
+    StageTimes stages_;
 };
 
 #endif // __fixdatamodel_h__
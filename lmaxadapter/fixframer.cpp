@@ -0,0 +1,100 @@
+#include "fixframer.h"
+#include "fix.h"
+
+#include <string.h>
+
+namespace {
+    // "10=nnn<SOH>"
+    const qint32 TrailerSize = 7;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FixFramer::FixFramer()
+    : pos_(0),
+    skipped_(0)
+{
+    buffer_.reserve(FIX_FRAMER_RESERVE);
+}
+
+void FixFramer::reset()
+{
+    buffer_.resize(0);
+    pos_ = 0;
+}
+
+void FixFramer::append(const char* data, qint32 size)
+{
+    // taken messages are dropped from the front before the buffer grows
+    if( pos_ > 0 ) {
+        buffer_.remove(0, pos_);
+        pos_ = 0;
+    }
+    buffer_.append(data, size);
+}
+
+bool FixFramer::next(QByteArray& message)
+{
+    while( true )
+    {
+        qint32 size = buffer_.size();
+        const char* data = buffer_.constData();
+        if( size - pos_ < 2 )
+            return false;
+
+        if( data[pos_] != '8' || data[pos_+1] != '=' ) {
+            resync(pos_ + 1);
+            continue;
+        }
+
+        // 8=FIX.4.4<SOH>9=nnn<SOH>
+        const char* soh = (const char*)memchr(data + pos_, SOH, size - pos_);
+        if( soh == NULL )
+            return false;
+        qint32 lenPos = qint32(soh - data) + 1;
+        if( size - lenPos < 2 )
+            return false;
+        if( data[lenPos] != '9' || data[lenPos+1] != '=' ) {
+            resync(pos_ + 1);
+            continue;
+        }
+
+        const char* lenEnd = (const char*)memchr(data + lenPos, SOH, size - lenPos);
+        if( lenEnd == NULL )
+            return false;
+
+        qint32 bodyLength = 0;
+        const char* digit = data + lenPos + 2;
+        for(; digit < lenEnd && *digit >= '0' && *digit <= '9' && bodyLength <= FIX_MAX_BODY_LENGTH; ++digit)
+            bodyLength = bodyLength*10 + (*digit - '0');
+        if( digit != lenEnd || bodyLength == 0 || bodyLength > FIX_MAX_BODY_LENGTH ) {
+            resync(pos_ + 1);
+            continue;
+        }
+
+        qint32 bodyPos = qint32(lenEnd - data) + 1;
+        qint32 total = bodyPos - pos_ + bodyLength + TrailerSize;
+        if( size - pos_ < total )
+            return false;
+
+        const char* trailer = data + pos_ + total - TrailerSize;
+        if( trailer[0] != '1' || trailer[1] != '0' || trailer[2] != '=' || trailer[TrailerSize-1] != SOH ) {
+            resync(pos_ + 1);
+            continue;
+        }
+
+        message = buffer_.mid(pos_, total);
+        pos_ += total;
+        return true;
+    }
+}
+
+void FixFramer::resync(qint32 from)
+{
+    qint32 found = buffer_.indexOf("8=FIX", from);
+    if( found < 0 ) {
+        // the tail may be the start of the next message
+        found = qMax(from, buffer_.size() - 4);
+    }
+    skipped_ += found - pos_;
+    pos_ = found;
+}
@@ -0,0 +1,37 @@
+#ifndef __fixframer_h__
+#define __fixframer_h__
+
+#include <QByteArray>
+
+// bytes reserved by the receive buffer, it grows for longer messages
+#define FIX_FRAMER_RESERVE      0x10000
+// BodyLength(9) above that is taken as garbage
+#define FIX_MAX_BODY_LENGTH     (1024*1024)
+
+////////////////////////////////////////////////////////////////////////////////
+// Splits the received stream into FIX messages by BodyLength(9),
+// a read may carry several messages or a part of one. The buffer is
+// kept between reads, garbage is skipped up to the next "8=FIX"
+class FixFramer
+{
+public:
+    FixFramer();
+
+    void append(const char* data, qint32 size);
+    // False when no complete message is buffered
+    bool next(QByteArray& message);
+    void reset();
+
+    inline quint64 skipped() const
+    { return skipped_; }
+
+private:
+    void resync(qint32 from);
+
+private:
+    QByteArray buffer_;
+    qint32  pos_;       // start of the first not taken message
+    quint64 skipped_;   // garbage bytes
+};
+
+#endif // __fixframer_h__
@@ -0,0 +1,178 @@
+#include "globals.h"
+#include "fixjournal.h"
+
+#include <string.h>
+
+using namespace std;
+
+namespace {
+    const char    JournalMagic[8] = { 'L','M','X','J','R','N','L','1' };
+    const quint64 HeaderSize = 128;
+    const quint64 IndexSize  = JOURNAL_INDEX_SIZE;
+
+    inline quint64 align8(quint64 size)
+    { return (size + 7) & ~quint64(7); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FixJournal::FixJournal()
+    : map_(NULL),
+    header_(NULL),
+    index_(NULL),
+    ring_(NULL),
+    ringSize_(0)
+{}
+
+FixJournal::~FixJournal()
+{
+    close();
+}
+
+bool FixJournal::open(const QString& filename, const QByteArray& session)
+{
+    QMutexLocker g(&lock_);
+    QByteArray name = session.left(sizeof(header_->session_) - 1);
+    if( map_ ) {
+        if( file_.fileName() == filename && name == header_->session_ )
+            return true;
+        // the sequence numbers of another session are not resumed
+        CDebug() << "Journal: session changed to " << name.constData() << ", reopening";
+        unmap();
+    }
+
+    quint64 filesize = JOURNAL_FILESIZE;
+    quint64 ringOffset = HeaderSize + IndexSize*sizeof(IndexEntry);
+    if( filesize <= ringOffset ) {
+        CDebug() << "Journal: file size " << filesize << " is too small";
+        return false;
+    }
+
+    file_.setFileName(filename);
+    bool created = !file_.exists() || file_.size() != (qint64)filesize;
+    if( !file_.open(QIODevice::ReadWrite) || !file_.resize(filesize) ) {
+        CDebug() << "Journal: cannot open \"" << filename << "\": " << file_.errorString();
+        file_.close();
+        return false;
+    }
+
+    map_ = file_.map(0, filesize);
+    if( map_ == NULL ) {
+        CDebug() << "Journal: cannot map \"" << filename << "\": " << file_.errorString();
+        file_.close();
+        return false;
+    }
+
+    header_ = reinterpret_cast<Header*>(map_);
+    index_ = reinterpret_cast<IndexEntry*>(map_ + HeaderSize);
+    ring_ = map_ + ringOffset;
+    ringSize_ = filesize - ringOffset;
+
+    if( created || memcmp(header_->magic_, JournalMagic, sizeof(JournalMagic)) != 0 ||
+        name != header_->session_ )
+    {
+        clear();
+        memcpy(header_->session_, name.constData(), name.size() + 1);
+        memcpy(header_->magic_, JournalMagic, sizeof(JournalMagic));
+        CDebug() << "Journal: \"" << filename << "\" started for " << name.constData();
+    }
+    else
+        CDebug() << "Journal: \"" << filename << "\" opened, last sent " << header_->lastOut_
+                 << ", last received " << header_->lastIn_;
+    return true;
+}
+
+void FixJournal::close()
+{
+    QMutexLocker g(&lock_);
+    unmap();
+}
+
+void FixJournal::unmap()
+{
+    if( map_ == NULL )
+        return;
+
+    file_.unmap(map_);
+    file_.close();
+    map_ = ring_ = NULL;
+    header_ = NULL;
+    index_ = NULL;
+}
+
+void FixJournal::reset()
+{
+    QMutexLocker g(&lock_);
+    if( map_ )
+        clear();
+}
+
+void FixJournal::clear()
+{
+    memset(header_, 0, sizeof(Header));
+    memset(index_, 0, IndexSize*sizeof(IndexEntry));
+}
+
+void FixJournal::append(quint32 seqNum, const QByteArray& message)
+{
+    QMutexLocker g(&lock_);
+    if( map_ == NULL )
+        return;
+
+    quint64 need = align8(sizeof(RecordHead) + message.size());
+    if( need > ringSize_/4 )
+        return;
+
+    // records don't wrap, the tail of the ring is skipped
+    quint64 pos = header_->head_;
+    if( pos % ringSize_ + need > ringSize_ )
+        pos += ringSize_ - pos % ringSize_;
+
+    RecordHead* record = reinterpret_cast<RecordHead*>(ring_ + pos % ringSize_);
+    record->seqNum_ = seqNum;
+    record->length_ = message.size();
+    memcpy(record + 1, message.constData(), message.size());
+
+    IndexEntry& entry = index_[seqNum % IndexSize];
+    entry.seqNum_ = seqNum;
+    entry.length_ = message.size();
+    entry.pos_ = pos;
+
+    // senders may journal out of order, the resumed MsgSeqNum never goes back
+    header_->head_ = pos + need;
+    header_->lastOut_ = qMax(header_->lastOut_, seqNum);
+}
+
+QByteArray FixJournal::find(quint32 seqNum) const
+{
+    QMutexLocker g(&lock_);
+    if( map_ == NULL )
+        return QByteArray();
+
+    const IndexEntry& entry = index_[seqNum % IndexSize];
+    if( entry.seqNum_ != seqNum || entry.pos_ + ringSize_ < header_->head_ )
+        return QByteArray();    // not journaled or overwritten
+
+    const RecordHead* record = reinterpret_cast<const RecordHead*>(ring_ + entry.pos_ % ringSize_);
+    if( record->seqNum_ != seqNum || record->length_ != entry.length_ )
+        return QByteArray();
+    return QByteArray(reinterpret_cast<const char*>(record + 1), record->length_);
+}
+
+quint32 FixJournal::lastOutSeqNum() const
+{
+    QMutexLocker g(&lock_);
+    return map_ ? header_->lastOut_ : 0;
+}
+
+quint32 FixJournal::lastInSeqNum() const
+{
+    QMutexLocker g(&lock_);
+    return map_ ? header_->lastIn_ : 0;
+}
+
+void FixJournal::setLastInSeqNum(quint32 seqNum)
+{
+    QMutexLocker g(&lock_);
+    if( map_ )
+        header_->lastIn_ = seqNum;
+}
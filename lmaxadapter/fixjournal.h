@@ -0,0 +1,68 @@
+#ifndef __fixjournal_h__
+#define __fixjournal_h__
+
+#include <QFile>
+#include <QMutex>
+#include <QByteArray>
+
+////////////////////////////////////////////////////////////////////////////////
+// Outbound FIX messages journal in a memory mapped file: the fixed header with
+// the last sequence numbers of the session, the index of JOURNAL_INDEX_SIZE
+// entries by MsgSeqNum and the ring of records behind it. A record is alive
+// while the ring hasn't passed over it, so the latest messages up to the ring
+// size are found for resend, also after the adapter restart
+class FixJournal
+{
+public:
+    FixJournal();
+    ~FixJournal();
+
+    // Maps the journal file, the journal of another session is started anew.
+    // An open journal of another file or session is closed first
+    bool open(const QString& filename, const QByteArray& session);
+    void close();
+    inline bool isOpen() const
+    { return map_ != NULL; }
+
+    // Drops the records and sequence numbers, on logon resetting them
+    void reset();
+
+    void append(quint32 seqNum, const QByteArray& message);
+    QByteArray find(quint32 seqNum) const;
+
+    quint32 lastOutSeqNum() const;
+    quint32 lastInSeqNum() const;
+    void setLastInSeqNum(quint32 seqNum);
+
+private:
+    struct Header {
+        char    magic_[8];
+        char    session_[64];
+        quint64 head_;      // ring position of the next record, never wraps
+        quint32 lastOut_;
+        quint32 lastIn_;
+    };
+    struct IndexEntry {
+        quint32 seqNum_;
+        quint32 length_;
+        quint64 pos_;
+    };
+    struct RecordHead {
+        quint32 seqNum_;
+        quint32 length_;
+    };
+
+    void clear();
+    void unmap();
+
+private:
+    mutable QMutex lock_;
+    QFile   file_;
+    uchar*  map_;
+    Header* header_;
+    IndexEntry* index_;
+    uchar*  ring_;
+    quint64 ringSize_;
+};
+
+#endif // __fixjournal_h__
@@ -1,18 +1,58 @@
 #include "globals.h"
 #include "fixlogger.h"
 #include "fix.h"
+#include "rwlock-dbg.h"
 
 #include <QtCore>
+#ifdef WIN32
 #include <Windows.h>
+#endif
 #include <algorithm>
 
 ////////////////////////////////////////////////////////////////////////////////
+#ifdef WIN32
 // Macros for Windows API Event
 #define InitEvent() ((quintptr)CreateEvent(NULL,FALSE,FALSE,NULL))
 #define DeleteEvent(waiter) (CloseHandle((HANDLE)waiter))
 #define SignalEvent(waiter) (SetEvent((HANDLE)waiter))
 #define WaitForEvent(waiter) (WAIT_OBJECT_0 == WaitForSingleObject((HANDLE)waiter,INFINITE))
 #define TimedWaitForEvent(waiter,tm) (WAIT_OBJECT_0 == WaitForSingleObject((HANDLE)waiter,tm))
+#else
+#include <limits.h>
+
+// Auto-reset event of the same semantics on QWaitCondition
+namespace {
+    struct AutoResetEvent {
+        AutoResetEvent() : signaled_(false) {}
+        QMutex mutex_;
+        QWaitCondition cond_;
+        bool signaled_;
+    };
+
+    inline bool signalEvent(quintptr waiter) {
+        AutoResetEvent* ev = (AutoResetEvent*)waiter;
+        QMutexLocker g(&ev->mutex_);
+        ev->signaled_ = true;
+        ev->cond_.wakeOne();
+        return true;
+    }
+
+    inline bool waitForEvent(quintptr waiter, unsigned long tm) {
+        AutoResetEvent* ev = (AutoResetEvent*)waiter;
+        QMutexLocker g(&ev->mutex_);
+        while( !ev->signaled_ )
+            if( !ev->cond_.wait(&ev->mutex_, tm) )
+                return false;
+        ev->signaled_ = false;
+        return true;
+    }
+}
+#define InitEvent() ((quintptr)new AutoResetEvent())
+#define DeleteEvent(waiter) (delete (AutoResetEvent*)waiter)
+#define SignalEvent(waiter) (signalEvent(waiter))
+#define WaitForEvent(waiter) (waitForEvent(waiter,ULONG_MAX))
+#define TimedWaitForEvent(waiter,tm) (waitForEvent(waiter,tm))
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 const char sampleTimestamp[] = 
@@ -49,18 +89,19 @@ struct FixRecord
 
 class AutoLocker {
 public:
-    AutoLocker(QReadWriteLock* autolock) : autolock_(autolock) {}
+    AutoLocker(RWLockDbg* autolock) : autolock_(autolock) {}
 
-    inline void lockRead() {
+    // site is the LOCK_SITE of the caller
+    inline void lockRead(const char* site) {
         writelock_.reset();
         if( readlock_.isNull() ) 
-            readlock_.reset(new QReadLocker(autolock_) );
+            readlock_.reset(new DReadLocker(autolock_, site) );
     }
 
-    inline void lockWrite() {
+    inline void lockWrite(const char* site) {
         readlock_.reset();
         if( writelock_.isNull() ) 
-            writelock_.reset(new QWriteLocker(autolock_) );
+            writelock_.reset(new DWriteLocker(autolock_, site) );
     }
 
     inline void unlock() {
@@ -69,9 +110,9 @@ public:
     }
 
 private:
-    QReadWriteLock* autolock_;
-    QScopedPointer<QReadLocker> readlock_;
-    QScopedPointer<QWriteLocker> writelock_;
+    RWLockDbg* autolock_;
+    QScopedPointer<DReadLocker> readlock_;
+    QScopedPointer<DWriteLocker> writelock_;
 };
 
 ///////////////////////////////////////////////////////////
@@ -98,7 +139,11 @@ bool FixLogFile::checkLoggingEnabled()
         if( !open(QIODevice::ReadWrite|QIODevice::Append|QIODevice::Unbuffered) ) {
             std::string text = "Cannot open file \"" + std::string(FILENAME_FIXMESSAGES) + "\" for logging\n"
                 "Fix messages logging will be unavailable for opened sessions";
+#if defined(WIN32) && !defined(LMAX_HEADLESS)
             ::MessageBoxA(NULL, text.c_str(), "Error", MB_OK|MB_ICONSTOP);
+#else
+            CDebug() << "Error: " << text.c_str();
+#endif
             return false;
         }
     }
@@ -123,7 +168,7 @@ bool FixLogFile::checkLoggingEnabled()
 ///////////////////////////////////////////////////////////
 FixLog::FixLog(QObject* parent)
     : QThread(parent),
-    qLock_(new QReadWriteLock()),
+    qLock_(new RWLockDbg("qLock_")),
     qEvent_(InitEvent()),
     reader_(FILENAME_FIXMESSAGES),
     readerPos_(0),
@@ -155,7 +200,7 @@ void FixLog::stop()
         do {
             msleep(20);
             {
-                QReadLocker g(qLock_);
+                DReadLocker g(qLock_, LOCK_SITE);
                 qempty = queue_.empty();
             }
         } 
@@ -163,7 +208,7 @@ void FixLog::stop()
     }
 
     {
-        QWriteLocker g(qLock_); 
+        DWriteLocker g(qLock_, LOCK_SITE); 
         SignalEvent(qEvent_);
     }
     exit();
@@ -179,7 +224,7 @@ void FixLog::run()
     AutoLocker autolock(qLock_);
 
     do{ 
-        autolock.lockRead();
+        autolock.lockRead(LOCK_SITE);
         qempty = queue_.empty();
         if( qempty )
         {
@@ -215,7 +260,7 @@ void FixLog::inmsg(const QByteArray& fixmessage, const char* sym, qint32 code)
 
     AutoLocker autolock(qLock_);
     if(online_ == 1) {
-        autolock.lockWrite();
+        autolock.lockWrite(LOCK_SITE);
         queue_.push_back(rec);
         queue_.back().message_ = fixmessage;
         SignalEvent(qEvent_);
@@ -239,7 +284,7 @@ void FixLog::outmsg(const QByteArray& fixmessage, const char* sym, qint32 code)
 
     AutoLocker autolock(qLock_);
     if(online_ == 1) {
-        autolock.lockWrite();
+        autolock.lockWrite(LOCK_SITE);
         queue_.push_back(rec);
         queue_.back().message_ = fixmessage;
         SignalEvent(qEvent_);
@@ -251,11 +296,19 @@ void FixLog::outmsg(const QByteArray& fixmessage, const char* sym, qint32 code)
     }
 }
 
+qint32 FixLog::queueDepth() const
+{
+    if( qLock_ == NULL )
+        return 0;
+    DReadLocker g(qLock_, LOCK_SITE);
+    return queue_.size();
+}
+
 void FixLog::dequeue(AutoLocker& autolock)
 {
     FixRecord& rec = queue_.front();
     if( !parse(rec) ) {
-        autolock.lockWrite();
+        autolock.lockWrite(LOCK_SITE);
         queue_.pop_front();
         return;
     }
@@ -275,7 +328,7 @@ void FixLog::dequeue(AutoLocker& autolock)
         *(QTextStream*)(this) << str;
         flush();
         rec.position_ = (qint32)writer_.size()-1;
-        autolock.lockWrite();
+        autolock.lockWrite(LOCK_SITE);
     }
     else {
         rec.position_ = reader_.pos();
@@ -387,7 +440,7 @@ bool FixLog::selectViewBy(const char* sym, qint32 code, bool incoming)
     matching_.type_ = incoming ? Incoming : Outgoing;
 
     AutoLocker autolock(qLock_);
-    autolock.lockRead();
+    autolock.lockRead(LOCK_SITE);
 
     RecordsMap::const_iterator It = msgmap_.begin(); 
     for(; It != msgmap_.end(); ++It) 
@@ -395,7 +448,7 @@ bool FixLog::selectViewBy(const char* sym, qint32 code, bool incoming)
         if( (It->code_ == -1) || 
             ((It->type_ & matching_.type_) && (It->code_ == code || It->symbol_ == sym)) )
         {
-            autolock.lockWrite();
+            autolock.lockWrite(LOCK_SITE);
             viewmap_.insert(It.key(), &It.value());
         }
     }
@@ -405,14 +458,14 @@ bool FixLog::selectViewBy(const char* sym, qint32 code, bool incoming)
 
 void FixLog::deselectView()
 {
-    QWriteLocker g(qLock_);
+    DWriteLocker g(qLock_, LOCK_SITE);
     viewmap_.clear();
     readerPos_ = 0;
 }
 
 QByteArray FixLog::getReadFirst()
 {
-    QReadLocker g(qLock_);
+    DReadLocker g(qLock_, LOCK_SITE);
 
     qint32 countOf = viewmap_.size();
     if( countOf == 0 )
@@ -432,7 +485,7 @@ QByteArray FixLog::getReadFirst()
 
 QByteArray FixLog::getReadLast()
 {
-    QReadLocker g(qLock_);
+    DReadLocker g(qLock_, LOCK_SITE);
 
     qint32 countOf = viewmap_.size();
     if( countOf == 0 )
@@ -452,7 +505,7 @@ QByteArray FixLog::getReadLast()
 
 QByteArray FixLog::getReadNext()
 {
-    QReadLocker g(qLock_);
+    DReadLocker g(qLock_, LOCK_SITE);
 
     if( readerPos_ == 0 )
         return QByteArray();
@@ -483,7 +536,7 @@ QByteArray FixLog::getReadNext()
 QByteArray FixLog::getReadPrev()
 {
     AutoLocker autolock(qLock_);
-    autolock.lockRead();
+    autolock.lockRead(LOCK_SITE);
 
     if( readerPos_ == 0 )
         return QByteArray();
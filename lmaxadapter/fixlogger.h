@@ -7,12 +7,10 @@
 #include <QList>
 
 struct FixRecord;
-typedef public QMap<qint32,FixRecord> RecordsMap;
-typedef public QMap<qint32,const FixRecord*> RecordsPtrs;
+typedef QMap<qint32,FixRecord> RecordsMap;
+typedef QMap<qint32,const FixRecord*> RecordsPtrs;
 
-QT_BEGIN_NAMESPACE;
-class QReadWriteLock;
-QT_END_NAMESPACE;
+class RWLockDbg;
 
 /////////////////////////////////////////////////////////////////
 class FixLogFile: public QFile
@@ -44,6 +42,9 @@ public:
     bool selectViewBy(const char* sym, qint32 code, bool incoming);
     void deselectView();
 
+    // records waiting for the writer thread
+    qint32 queueDepth() const;
+
 Q_SIGNALS:
     void notifyHasPrev(bool has);
     void notifyHasNext(bool has);
@@ -72,7 +73,7 @@ private:
     FixLogFile writer_;
 
     QList<FixRecord> queue_;
-    QReadWriteLock*  qLock_;
+    RWLockDbg*  qLock_;
     quintptr qEvent_;
 
     RecordsMap msgmap_;
@@ -1,6 +1,7 @@
 #include "globals.h"
 #include "fixmessagedialog.h"
 #include "quotestablemodel.h"
+#include "fixdatamodel.h"
 #include "fixlogger.h"
 
 #include <QtWidgets>
@@ -19,7 +20,7 @@ FixMessageDialog::FixMessageDialog(const QString& symbol,
                                    bool readOnly, 
                                    QuotesTableModel* model)
     : QDialog(model->view()),
-    model_(model),
+    model_(model->core()),
     doc_(NULL),
     next_(NULL),
     prev_(NULL),
@@ -124,9 +125,9 @@ void FixMessageDialog::onSend()
 {
     QByteArray text = doc_->toPlainText().trimmed().toLocal8Bit();
     toAscii(text);
-    if( text.left(9) == "8=FIX.4.4" ) 
-        if( model_->normalize(text) )
-            emit model_->notifySendingManual(text);
+    // the header is stamped by the pacer when the message goes out
+    if( text.left(9) == "8=FIX.4.4" && !FIX::getField(text,"35").empty() )
+        emit model_->notifySendingManual(text);
 }
 
 void FixMessageDialog::onHasNext(bool has)
@@ -4,6 +4,7 @@
 #include <QDialog>
 
 class QuotesTableModel;
+class FixDataModel;
 
 QT_BEGIN_NAMESPACE
 class QPushButton;
@@ -39,7 +40,7 @@ private:
     void toAscii(QByteArray& text) const;
 
 private:
-    QuotesTableModel* model_;
+    FixDataModel* model_;
     QTextEdit* doc_;
     QPushButton* next_;
     QPushButton* prev_;
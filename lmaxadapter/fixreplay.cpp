@@ -0,0 +1,208 @@
+#include "globals.h"
+#include "fixreplay.h"
+#include "fixdatamodel.h"
+
+#include <QFile>
+#include <QElapsedTimer>
+#include <QMap>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    const char* StageNames[] = { "process", "parse", "cache", "publish", "lag" };
+
+    qint64 percentile(const vector<qint64>& sorted, double quantile)
+    {
+        if( sorted.empty() )
+            return 0;
+        size_t rank = (size_t)(quantile * sorted.size());
+        return sorted[qMin(rank, sorted.size() - 1)];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FixReplay::FixReplay(FixDataModel* model, const QString& filename, double speed, QObject* parent)
+    : QThread(parent),
+    model_(model),
+    filename_(filename),
+    speed_(speed),
+    stopping_(0),
+    skipped_(0),
+    loadNanos_(0),
+    replayed_(0),
+    elapsedNanos_(0)
+{
+}
+
+qint64 FixReplay::recordedTime(const QByteArray& line, const QByteArray& message)
+{
+    // "[YYYYMMDD-HH:MM:SS.msc]  << 8=FIX.4.4..." or SendingTime of older logs
+    // which have broken stamps
+    qint64 time = 0;
+    if( line.size() > 22 && line[0] == '[' && line[22] == ']' )
+        time = Global::timestamp2time(string(line.constData() + 1, 21));
+    if( time <= 0 )
+        time = Global::timestamp2time(FIX::getField(message, "52"));
+    return (time > 0) ? time : 0;
+}
+
+bool FixReplay::load(QString* error)
+{
+    qint64 started = Global::nanotime();
+
+    QFile file(filename_);
+    if( !file.open(QIODevice::ReadOnly) ) {
+        if( error )
+            *error = "Cannot open \"" + filename_ + "\": " + file.errorString();
+        return false;
+    }
+    QByteArray content = file.readAll();
+    file.close();
+
+    QMap<string,qint32> seen;
+    qint32 begin = 0;
+    while( begin < content.size() )
+    {
+        qint32 end = content.indexOf('\n', begin);
+        if( end < 0 )
+            end = content.size();
+        QByteArray line = content.mid(begin, end - begin);
+        begin = end + 1;
+
+        qint32 fixpos = line.indexOf("8=FIX.4.4");
+        if( fixpos < 3 )
+            continue;
+        if( memcmp(line.constData() + fixpos - 3, "<< ", 3) != 0 ) {
+            // outgoing
+            ++skipped_;
+            continue;
+        }
+
+        Record rec;
+        rec.message_ = line.mid(fixpos);
+        if( rec.message_.endsWith('\r') )
+            rec.message_.chop(1);
+
+        string type = FIX::getField(rec.message_, "35");
+        if( type != "W" && type != "Y" && type != "3" ) {
+            ++skipped_;
+            continue;
+        }
+        rec.time_ = recordedTime(line, rec.message_);
+
+        if( type == "W" ) {
+            string sym = FIX::getField(rec.message_, "262");
+            qint32 code = atol(FIX::getField(rec.message_, "48").c_str());
+            if( !sym.empty() && code > 0 && !seen.contains(sym) ) {
+                seen.insert(sym, code);
+                instruments_.push_back(Instrument(sym, code));
+            }
+        }
+        records_.push_back(rec);
+    }
+    loadNanos_ = Global::nanotime() - started;
+
+    if( records_.empty() ) {
+        if( error )
+            *error = "No incoming market data messages in \"" + filename_ + "\"";
+        return false;
+    }
+
+    CDebug() << "Replay: " << records_.size() << " messages of " << instruments_.size()
+             << " instruments loaded from \"" << filename_ << "\", " << skipped_ << " skipped";
+    return true;
+}
+
+void FixReplay::run()
+{
+    for(qint32 i = 0; i < StageCount; i++) {
+        stages_[i].clear();
+        stages_[i].reserve(records_.size());
+    }
+    replayed_ = 0;
+
+    qint64 firstTime = 0;
+    for(qint32 i = 0; i < records_.size() && firstTime == 0; i++)
+        firstTime = records_[i].time_;
+
+    model_->setStageProfiling(true);
+    model_->setInSequencing(false);
+    QElapsedTimer clock;
+    clock.start();
+
+    for(qint32 i = 0; i < records_.size() && stopping_.loadAcquire() == 0; i++)
+    {
+        const Record& rec = records_[i];
+        if( speed_ > 0 && rec.time_ > 0 )
+        {
+            qint64 due = (qint64)((rec.time_ - firstTime) * 1000000 / speed_);
+            qint64 wait = due - clock.nsecsElapsed();
+            if( wait > 2000000 )
+                msleep((unsigned long)(wait / 1000000 - 1));
+            while( clock.nsecsElapsed() < due )
+                yieldCurrentThread();
+            stages_[StageLag].push_back(clock.nsecsElapsed() - due);
+        }
+
+        qint64 started = Global::nanotime();
+        model_->process(rec.message_);
+        stages_[StageProcess].push_back(Global::nanotime() - started);
+
+        // stage stamps belong to this message only when all of them are fresh
+        const FixDataModel::StageTimes& st = model_->lastStageTimes();
+        if( st.received_ >= started && st.parsed_ >= st.received_ &&
+            st.cached_ >= st.parsed_ && st.published_ >= st.cached_ )
+        {
+            stages_[StageParse].push_back(st.parsed_ - st.received_);
+            stages_[StageCache].push_back(st.cached_ - st.parsed_);
+            stages_[StagePublish].push_back(st.published_ - st.cached_);
+        }
+        ++replayed_;
+    }
+
+    elapsedNanos_ = clock.nsecsElapsed();
+    model_->setStageProfiling(false);
+    model_->setInSequencing(true);
+}
+
+QString FixReplay::report() const
+{
+    double secs = elapsedNanos_ / 1e9;
+    QString text;
+    text += QString("Replay of \"%1\" at %2\n").arg(filename_)
+            .arg(speed_ > 0 ? QString("x%1 of the recorded pacing").arg(speed_) : QString("full speed"));
+    text += QString("Loaded %1 messages in %2 ms, %3 session or outgoing skipped\n")
+            .arg(records_.size()).arg(loadNanos_ / 1e6, 0, 'f', 1).arg(skipped_);
+    text += QString("Replayed %1 messages in %2 secs, %3 msg/sec\n")
+            .arg(replayed_).arg(secs, 0, 'f', 3).arg(secs > 0 ? replayed_ / secs : 0.0, 0, 'f', 0);
+    text += "stage         count       p50       p99     p99.9       max      mean (nsecs)\n";
+
+    for(qint32 i = 0; i < StageCount; i++)
+    {
+        vector<qint64> sorted(stages_[i]);
+        if( sorted.empty() )
+            continue;
+        sort(sorted.begin(), sorted.end());
+
+        double sum = 0;
+        for(size_t j = 0; j < sorted.size(); j++)
+            sum += sorted[j];
+
+        text += QString("%1 %2 %3 %4 %5 %6 %7\n")
+                .arg(StageNames[i], -8)
+                .arg(sorted.size(), 10)
+                .arg(percentile(sorted, 0.5), 9)
+                .arg(percentile(sorted, 0.99), 9)
+                .arg(percentile(sorted, 0.999), 9)
+                .arg(sorted.back(), 9)
+                .arg(sum / sorted.size(), 9, 'f', 0);
+    }
+    return text;
+}
+
+bool FixReplay::writeReport(const QString& filename) const
+{
+    return Global::writeReport(filename, report());
+}
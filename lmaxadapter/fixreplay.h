@@ -0,0 +1,75 @@
+#ifndef __fixreplay_h__
+#define __fixreplay_h__
+
+#include "marketabstractmodel.h"
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QList>
+
+#include <vector>
+
+class FixDataModel;
+
+////////////////////////////////////////////////////////////////////////////////
+// Replays the incoming market data messages (W, Y, 3) captured in the FIX
+// messages log through FixDataModel::process without LMAX connection.
+// Pacing is the recorded one scaled by speed, or as fast as possible when
+// speed is 0. Session messages are skipped, they need a live counterparty.
+// Timings of the parse, cache and MQL publish stages are collected per message.
+class FixReplay : public QThread
+{
+public:
+    FixReplay(FixDataModel* model, const QString& filename, double speed, QObject* parent);
+
+    // Reads the whole log before replay, so the disk isn't measured
+    bool load(QString* error);
+
+    // Instruments of the recorded market data, must be monitored before start
+    inline const QList<Instrument>& instruments() const
+    { return instruments_; }
+
+    inline void stop()
+    { stopping_ = 1; }
+
+    // Valid after the thread is finished
+    QString report() const;
+    bool writeReport(const QString& filename) const;
+
+protected:
+    void run();
+
+private:
+    struct Record {
+        qint64     time_;       // recorded msecs since epoch, 0 - unknown
+        QByteArray message_;
+    };
+
+    enum StageID {
+        StageProcess = 0,       // whole FixDataModel::process
+        StageParse,
+        StageCache,
+        StagePublish,
+        StageLag,               // behind the recorded pacing
+        StageCount
+    };
+
+    static qint64 recordedTime(const QByteArray& line, const QByteArray& message);
+
+private:
+    FixDataModel* model_;
+    QString filename_;
+    double speed_;
+    QAtomicInt stopping_;
+
+    QList<Record> records_;
+    QList<Instrument> instruments_;
+    quint32 skipped_;
+    qint64  loadNanos_;
+
+    std::vector<qint64> stages_[StageCount];
+    quint32 replayed_;
+    qint64  elapsedNanos_;
+};
+
+#endif // __fixreplay_h__
@@ -0,0 +1,29 @@
+#include "globals.h"
+#include "fixtransport.h"
+#include "sslclient.h"
+
+#ifdef LMAX_EPOLL_TRANSPORT
+#include "epollclient.h"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+qint32 FixTransport::available(qint32 kind)
+{
+#ifdef LMAX_EPOLL_TRANSPORT
+    if( kind == EpollTransport )
+        return EpollTransport;
+#endif
+    return QtTransport;
+}
+
+FixTransport* FixTransport::create(qint32 kind, QSsl::SslProtocol proto, RequestHandler* handler)
+{
+    if( available(kind) != kind )
+        CDebug() << "Transport " << kind << " is not built in, QSslSocket is used";
+
+#ifdef LMAX_EPOLL_TRANSPORT
+    if( available(kind) == EpollTransport )
+        return new EpollClient(proto, handler);
+#endif
+    return new SslClient(proto, handler);
+}
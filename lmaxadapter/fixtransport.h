@@ -0,0 +1,84 @@
+#ifndef __fixtransport_h__
+#define __fixtransport_h__
+
+#include "requesthandler.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QSsl>
+
+// Values of TransportParam
+enum TransportKind {
+    QtTransport = 0,        // QSslSocket on its own event loop
+    EpollTransport,         // epoll and OpenSSL memory BIOs, Linux only
+};
+
+//////////////////////////////////////////////////////////////
+// Transport settings of the connection, see LatencyProfileParam
+struct SocketProfile
+{
+    enum Level {
+        DefaultLevel = 0,
+        LowLatencyLevel,    // TCP_NODELAY, quick ACKs and busy poll of the socket
+        SpinLevel,          // and the receiving thread spins instead of sleeping
+    };
+
+    qint32 level_;
+    qint32 buffer_;         // SO_RCVBUF and SO_SNDBUF bytes, 0 - system default
+    qint32 cpu_;            // CPU of the spinning thread, -1 - any
+
+    SocketProfile() : level_(DefaultLevel), buffer_(0), cpu_(-1) {}
+
+    inline bool operator==(const SocketProfile& other) const
+    { return level_ == other.level_ && buffer_ == other.buffer_ && cpu_ == other.cpu_; }
+};
+
+//////////////////////////////////////////////////////////////
+struct TransportStats
+{
+    qint32  kind_;              // TransportKind
+    quint32 connects_;          // connects of the socket
+    quint32 resumeOffered_;     // handshakes offered a cached session
+    qint32  connectTime_;       // msecs of the last TCP connect
+    qint32  handshakeTime_;     // msecs of the last TLS handshake, -1 - not encrypted
+    bool    lastResumeOffered_; // the last handshake offered a session
+
+    // socket options as applied to the last connection
+    qint32  level_;             // SocketProfile::Level
+    qint32  noDelay_;
+    qint32  recvBuffer_;
+    qint32  sendBuffer_;
+    qint32  busyPoll_;          // usecs, 0 - off or not supported
+    qint32  spinCpu_;           // CPU the thread is pinned to, -1 - not pinned
+    bool    kernelStamps_;      // receive times are kernel stamps, the read time otherwise
+};
+
+//////////////////////////////////////////////////////////////
+// Connection of a FIX session. Whole FIX messages and the connection states
+// go to the RequestHandler on the thread of the transport, send() is called
+// from any thread
+class FixTransport
+{
+public:
+    virtual ~FixTransport() {}
+
+    // The kind as it's created: QtTransport when the kind isn't built in
+    static qint32 available(qint32 kind);
+    static FixTransport* create(qint32 kind, QSsl::SslProtocol proto, RequestHandler* handler);
+
+    // The profile is taken once before establish
+    virtual void setProfile(const SocketProfile& profile) = 0;
+    virtual const SocketProfile& profile() const = 0;
+
+    // Plain TCP connection when encrypted is false (local FIX simulator)
+    virtual void establish(const QString& host, quint16 port, bool encrypted = true) = 0;
+    // Connects anew keeping the thread and the TLS context,
+    // false when the transport has to be recreated
+    virtual bool reconnect(QSsl::SslProtocol proto, const QString& host, quint16 port, bool encrypted) = 0;
+
+    virtual void send(const QByteArray& message) = 0;
+    virtual QString lastError() const = 0;
+    virtual TransportStats stats() const = 0;
+};
+
+#endif // __fixtransport_h__
@@ -1,13 +1,22 @@
 #include "globals.h"
+#include "monoclock.h"
 #include "resource.h"
 
+#ifndef LMAX_HEADLESS
 #include <QDesktopWidget>
 #include <QFont>
 #include <QPixmap>
+#endif
 #include <QTime>
 
 #include <string>
+#ifdef WIN32
 #include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace {
     typedef unsigned char  u8;
@@ -25,12 +34,14 @@ namespace {
                                 char *hour, char *minute, char *second, char *msec);
 }
 
+#ifndef LMAX_HEADLESS
 /* external routine */
 QPixmap qt_pixmapFromWinHICON(HICON icon);
 
 const int   compactPx    = 9;
 const float nativePx     = 12;
 const float buttonsPx    = 13;
+#endif
 
 #if !defined(MQL_LOGGING_ENABLED) || !(MQL_LOGGING_ENABLED)
 bool Global::logging_ = false;
@@ -38,6 +49,7 @@ bool Global::logging_ = false;
 bool Global::logging_ = true;
 #endif
 
+#ifndef LMAX_HEADLESS
 QSize    Global::desktop;
 QFont*   Global::compact;
 QFont*   Global::native;
@@ -65,7 +77,7 @@ QPixmap* Global::pxInstEdtMoved;
 QPixmap* Global::pxSubscribe;
 QPixmap* Global::pxUnSubscribe;
 QPixmap* Global::pxRemoveRow;
-
+#endif
 
 QFile*   Global::infoLogFile = NULL;
 
@@ -87,8 +99,14 @@ void Global::setDebugLog(bool on)
 
 void Global::init()
 {
+    MonoClock::init();
     if( logging_ ) setDebugLog(true);
+    if( MonoClock::tsc() )
+        CDebug() << "Clock: TSC of " << MonoClock::tscGHz() << " GHz";
+    else
+        CDebug() << "Clock: monotonic clock of the OS";
 
+#ifndef LMAX_HEADLESS
     QDesktopWidget desk;
     QRect rcScreen( desk.screenGeometry() );
     desktop.setHeight( rcScreen.height()+1 );
@@ -196,40 +214,60 @@ void Global::init()
     hIco = (HICON)::LoadImage(hInst, 
                             MAKEINTRESOURCE(IDI_REMOVEROW), IMAGE_ICON, 0, 0, LR_DEFAULTCOLOR);
     pxRemoveRow = new QPixmap( qt_pixmapFromWinHICON(hIco) );
+#endif
 }
 
-qint32 Global::time()
+// msecs of MonoClock, not wrapped
+qint64 Global::time()
 {
-    return ::GetTickCount();
+    return MonoClock::millis();
 }
 
-qint64 Global::systemtime()
+// Monotonic clock shared by all processes of the host, see MonoClock
+qint64 Global::nanotime()
 {
-    SYSTEMTIME st;
-    ::GetSystemTime(&st);
-    FILETIME ft;
-    ::SystemTimeToFileTime(&st, &ft);
+    return MonoClock::nanos();
+}
 
-	ULARGE_INTEGER v;
-	v.LowPart = ft.dwLowDateTime;
-	v.HighPart = ft.dwHighDateTime;
-	return (v.QuadPart - WIN_TIME_CORRECTOR) / 10000;    
+// msecs since epoch by the wall clock offset of MonoClock
+qint64 Global::systemtime()
+{
+    return MonoClock::toWall(MonoClock::nanos()) / 1000000;
 }
 
 std::string Global::timestamp()
 {
-    char out[timestamp_ms_size];
-    SYSTEMTIME t;
-    ::GetSystemTime(&t);
-	sprintfTimeStampWithMSec(t.wYear, t.wMonth , t.wDay, t.wHour , t.wMinute , t.wSecond, t.wMilliseconds, out);
-    return out;
+    return timestamp(systemtime());
+}
+
+#ifdef WIN32
+// Nanosecs of CPU consumed by the calling thread, kernel and user
+qint64 Global::threadCpuTime()
+{
+    FILETIME created, exited, kernel, user;
+    if( !::GetThreadTimes(::GetCurrentThread(), &created, &exited, &kernel, &user) )
+        return 0;
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+    return (qint64)(k.QuadPart + u.QuadPart) * 100;
 }
 
+bool Global::pinThread(qint32 cpu)
+{
+    return 0 != ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu);
+}
+
+// timet is msecs since epoch as returned by systemtime() and timestamp2time()
 std::string Global::timestamp(qint64 timet)
 {
+    quint64 filetime = quint64(timet) * 10000 + WIN_TIME_CORRECTOR;
     FILETIME ft;
-    ft.dwHighDateTime = (DWORD)((timet&0xFFFFFFFF00000000)>>32);
-    ft.dwLowDateTime = (DWORD)((timet&0xFFFFFFFF));
+    ft.dwHighDateTime = (DWORD)((filetime&0xFFFFFFFF00000000)>>32);
+    ft.dwLowDateTime = (DWORD)((filetime&0xFFFFFFFF));
     SYSTEMTIME t;
     ::FileTimeToSystemTime(&ft, &t);
 
@@ -263,6 +301,59 @@ qint64 Global::timestamp2time(const std::string& st)
 	return (v.QuadPart - WIN_TIME_CORRECTOR) / 10000;    
 }
 
+#else
+qint64 Global::threadCpuTime()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool Global::pinThread(qint32 cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    return false;
+#endif
+}
+
+std::string Global::timestamp(qint64 timet)
+{
+    time_t secs = (time_t)(timet / 1000);
+    struct tm t;
+    ::gmtime_r(&secs, &t);
+
+    char out[timestamp_ms_size];
+	sprintfTimeStampWithMSec(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, timet % 1000, out);
+    return out;
+}
+
+qint64 Global::timestamp2time(const std::string& st)
+{
+	char year[5], month[3], day[3], hour[3], minute[3], second[3], milliseconds[4];
+    if( !parseTimeStampWithMSec(st, year, month, day, hour, minute, second, milliseconds) )
+        return 0;
+
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+	t.tm_year = atoi(year) - 1900;
+	t.tm_mon = atoi(month) - 1;
+	t.tm_mday = atoi(day);
+	t.tm_hour = atoi(hour);    
+	t.tm_min = atoi(minute);
+	t.tm_sec = atoi(second);
+
+    time_t secs = ::timegm(&t);
+    if( secs == (time_t)-1 )
+        return 0;
+	return (qint64)secs * 1000 + atoi(milliseconds);
+}
+#endif
+
 namespace 
 {
     u8 sprintfTimeStamp( u16 year, 
@@ -358,6 +449,21 @@ namespace
 }
 
 
+bool Global::writeReport(const QString& filename, const QString& report)
+{
+    if( report.isEmpty() )
+        return false;
+
+    QFile file(filename);
+    if( !file.open(QIODevice::WriteOnly|QIODevice::Truncate|QIODevice::Text) ) {
+        CDebug() << "Cannot write \"" << filename << "\": " << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    out << timestamp().c_str() << "\n" << report;
+    return true;
+}
+
 void Global::truncateMbFromLog(const char* filename, quint32 sizeLimit)
 {
     QFile file(filename);
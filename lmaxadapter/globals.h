@@ -4,6 +4,10 @@
 #include "logger.h"
 
 #include <QSize>
+#include <QMutex>
+#include <QThreadStorage>
+#include <vector>
+#ifndef LMAX_HEADLESS
 #include <QFont>
 #include <QPixmap>
 
@@ -11,6 +15,7 @@ QT_BEGIN_NAMESPACE
 class QFont;
 class QPixmap;
 QT_END_NAMESPACE
+#endif
 
 ////////////////////////////////////////////////////////////////////////
 // Global objects and constants
@@ -29,6 +34,7 @@ QT_END_NAMESPACE
 
 struct Global {
     static bool     logging_;
+#ifndef LMAX_HEADLESS
     static QSize    desktop;
     static QFont*   compact;
     static QFont*   native;
@@ -56,16 +62,24 @@ struct Global {
     static QPixmap* pxSubscribe;
     static QPixmap* pxUnSubscribe;
     static QPixmap* pxRemoveRow;
+#endif
     static QFile*   infoLogFile;
 
     static void init();
     static void setDebugLog(bool on);
     static std::string timestamp();
     static std::string timestamp(qint64 timet);
-    static qint32 time();
+    // msecs and nsecs of the monotonic clock (MonoClock)
+    static qint64 time();
+    static qint64 nanotime();
+    static qint64 threadCpuTime();
+    // Pins the calling thread to the CPU, false when failed or not supported
+    static bool pinThread(qint32 cpu);
     static qint64 systemtime();
     static qint64 timestamp2time(const std::string& st);
     static void truncateMbFromLog(const char* filename, quint32 sizeLimit);
+    // Overwrites the file with the timestamp and the report, false when empty or failed
+    static bool writeReport(const QString& filename, const QString& report);
     static QString organizationName();
     static QString productFullName();
 
@@ -82,4 +96,68 @@ struct Global {
     }
 };
 
+////////////////////////////////////////////////////////////////////////
+// Buffers of the recording threads, each thread acquires one on the first
+// record into its THREAD_LOCAL slot. The buffer of an ended thread keeps its
+// counts for the reports and is handed to the next new thread, so there are
+// no more buffers than threads recording at once
+template<class T>
+class ThreadRegistry
+{
+public:
+    T* acquire(T** slot)
+    {
+        T* buffer = NULL;
+        {
+            QMutexLocker g(&lock_);
+            if( !free_.empty() ) {
+                buffer = free_.back();
+                free_.pop_back();
+            }
+            else {
+                buffer = new T();
+                buffers_.push_back(buffer);
+            }
+        }
+        leases_.setLocalData(new Lease(this, buffer, slot));
+        *slot = buffer;
+        return buffer;
+    }
+
+    // All the buffers, of the ended threads too
+    void take(std::vector<T*>& out) const
+    {
+        QMutexLocker g(&lock_);
+        out = buffers_;
+    }
+
+private:
+    // deleted by QThreadStorage when the thread ends
+    struct Lease {
+        ThreadRegistry* registry_;
+        T*  buffer_;
+        T** slot_;
+
+        Lease(ThreadRegistry* registry, T* buffer, T** slot)
+            : registry_(registry), buffer_(buffer), slot_(slot)
+        {}
+        ~Lease()
+        { registry_->release(buffer_, slot_); }
+    };
+    friend struct Lease;
+
+    void release(T* buffer, T** slot)
+    {
+        *slot = NULL;
+        QMutexLocker g(&lock_);
+        free_.push_back(buffer);
+    }
+
+private:
+    mutable QMutex  lock_;
+    std::vector<T*> buffers_;
+    std::vector<T*> free_;
+    QThreadStorage<Lease*> leases_;
+};
+
 #endif // __globals_h__
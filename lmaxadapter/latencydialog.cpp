@@ -0,0 +1,80 @@
+#include "globals.h"
+#include "latencydialog.h"
+#include "latencyrecorder.h"
+
+#include <QtWidgets>
+
+using namespace std;
+
+namespace {
+    const char* columnNames[] = { "Count", "Negative", "Min", "P50", "P99", "P99.9", "Max", "Mean" };
+    const qint32 columnCount = sizeof(columnNames)/sizeof(columnNames[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+LatencyDialog::LatencyDialog(QWidget* parent)
+    : QDialog(parent),
+    table_(new QTableWidget(LatencyRecorder::StageCount, columnCount, this)),
+    refresh_(new QTimer(this))
+{
+    setWindowTitle(tr("Market data latency, usecs"));
+
+    QStringList columns, rows;
+    for(qint32 i = 0; i < columnCount; i++)
+        columns << tr(columnNames[i]);
+    for(qint32 i = 0; i < LatencyRecorder::StageCount; i++)
+        rows << LatencyRecorder::stageName(LatencyRecorder::Stage(i));
+    table_->setHorizontalHeaderLabels(columns);
+    table_->setVerticalHeaderLabels(rows);
+    table_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table_->setSelectionMode(QAbstractItemView::NoSelection);
+    table_->setFont(*Global::compact);
+
+    for(qint32 row = 0; row < LatencyRecorder::StageCount; row++) {
+        for(qint32 col = 0; col < columnCount; col++) {
+            QTableWidgetItem* item = new QTableWidgetItem();
+            item->setTextAlignment(Qt::AlignRight|Qt::AlignVCenter);
+            table_->setItem(row, col, item);
+        }
+    }
+    table_->resizeColumnsToContents();
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(table_);
+    resize(Global::desktop.width()*0.4f, Global::desktop.height()*0.3f);
+
+    refresh_->setInterval(LATENCY_MERGE_PERIOD);
+    QObject::connect(refresh_, SIGNAL(timeout()), this, SLOT(onRefresh()));
+}
+
+LatencyDialog::~LatencyDialog()
+{}
+
+void LatencyDialog::showEvent(QShowEvent* e)
+{
+    QDialog::showEvent(e);
+    onRefresh();
+    refresh_->start();
+}
+
+void LatencyDialog::hideEvent(QHideEvent* e)
+{
+    refresh_->stop();
+    QDialog::hideEvent(e);
+}
+
+void LatencyDialog::onRefresh()
+{
+    for(qint32 row = 0; row < LatencyRecorder::StageCount; row++)
+    {
+        NanoHistogram h;
+        LatencyRecorder::snapshot(LatencyRecorder::Stage(row), h);
+
+        qint64 values[] = { h.min(), h.percentile(0.5), h.percentile(0.99), h.percentile(0.999), h.max() };
+        table_->item(row, 0)->setText(QString::number(h.count()));
+        table_->item(row, 1)->setText(QString::number(h.negative()));
+        for(qint32 col = 2; col < columnCount - 1; col++)
+            table_->item(row, col)->setText(h.count() ? QString::number(values[col-2]/1000.0, 'f', 1) : "-");
+        table_->item(row, columnCount - 1)->setText(h.count() ? QString::number(h.mean()/1000.0, 'f', 1) : "-");
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef __latencydialog_h__
+#define __latencydialog_h__
+
+#include <QDialog>
+
+QT_BEGIN_NAMESPACE
+class QTableWidget;
+class QTimer;
+QT_END_NAMESPACE
+
+////////////////////////////////////
+// Percentiles of the market data stages from the last merge of
+// LatencyRecorder, refreshed while the dialog is shown
+class LatencyDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    LatencyDialog(QWidget* parent);
+    ~LatencyDialog();
+
+protected slots:
+    void showEvent(QShowEvent* e);
+    void hideEvent(QHideEvent* e);
+    void onRefresh();
+
+private:
+    QTableWidget* table_;
+    QTimer* refresh_;
+};
+
+#endif // __latencydialog_h__
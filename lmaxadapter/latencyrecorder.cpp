@@ -0,0 +1,156 @@
+#include "globals.h"
+#include "latencyrecorder.h"
+
+#include <QMutex>
+
+using namespace std;
+
+namespace {
+    struct ThreadRecorder {
+        ThreadHistogram stages_[LatencyRecorder::StageCount];
+    };
+
+    // a reconnect starts new receiving threads, they reuse the ended ones' recorders
+    ThreadRegistry<ThreadRecorder> recorders;
+    THREAD_LOCAL ThreadRecorder* current = NULL;
+
+    QMutex mergedLock;
+    NanoHistogram merged[LatencyRecorder::StageCount];
+
+    const char* stageNames[LatencyRecorder::StageCount] = {
+        "read->frame",
+        "frame->parse",
+        "parse->cache",
+        "cache->publish",
+        "publish->pipe",
+        "wire->pipe",
+        "request->response",
+    };
+
+    ThreadRecorder* threadRecorder()
+    {
+        if( current == NULL )
+            recorders.acquire(&current);
+        return current;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ThreadHistogram::ThreadHistogram()
+    : buckets_(new QAtomicInteger<quint64>[NanoHistogram::bucketCount()]),
+    count_(0),
+    min_(0),
+    max_(0),
+    sum_(0),
+    negative_(0)
+{
+}
+
+ThreadHistogram::~ThreadHistogram()
+{
+    delete [] buckets_;
+}
+
+// single writer: plain loads and stores, no read-modify-write
+void ThreadHistogram::record(qint64 nanos)
+{
+    if( nanos < 0 ) {
+        negative_.store(negative_.load() + 1);
+        return;
+    }
+
+    QAtomicInteger<quint64>& bucket = buckets_[NanoHistogram::bucketOf(nanos)];
+    bucket.store(bucket.load() + 1);
+
+    quint64 count = count_.load();
+    if( count == 0 || nanos < min_.load() )
+        min_.store(nanos);
+    if( nanos > max_.load() )
+        max_.store(nanos);
+    sum_.store(sum_.load() + nanos);
+    count_.store(count + 1);
+}
+
+void ThreadHistogram::addTo(NanoHistogram& out) const
+{
+    out.negative_ += negative_.load();
+
+    // the count is taken from the buckets to keep the percentiles consistent
+    quint64 count = 0;
+    for(quint32 i = 0; i < NanoHistogram::bucketCount(); i++) {
+        quint64 n = buckets_[i].load();
+        out.buckets_[i] += n;
+        count += n;
+    }
+    if( count == 0 )
+        return;
+
+    qint64 min = min_.load();
+    if( out.count_ == 0 || min < out.min_ )
+        out.min_ = min;
+    out.max_ = qMax(out.max_, max_.load());
+    out.sum_ += sum_.load();
+    out.count_ += count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyRecorder::record(Stage stage, qint64 nanos)
+{
+    threadRecorder()->stages_[stage].record(nanos);
+}
+
+void LatencyRecorder::merge()
+{
+    vector<ThreadRecorder*> taken;
+    recorders.take(taken);
+
+    NanoHistogram sums[StageCount];
+    for(quint32 i = 0; i < taken.size(); i++)
+        for(qint32 stage = 0; stage < StageCount; stage++)
+            taken[i]->stages_[stage].addTo(sums[stage]);
+
+    QMutexLocker g(&mergedLock);
+    for(qint32 stage = 0; stage < StageCount; stage++)
+        merged[stage] = sums[stage];
+}
+
+void LatencyRecorder::snapshot(Stage stage, NanoHistogram& out)
+{
+    QMutexLocker g(&mergedLock);
+    out = merged[stage];
+}
+
+const char* LatencyRecorder::stageName(Stage stage)
+{
+    return stageNames[stage];
+}
+
+QString LatencyRecorder::report()
+{
+    QString report;
+    for(qint32 i = 0; i < StageCount; i++)
+    {
+        NanoHistogram h;
+        snapshot(Stage(i), h);
+        if( h.count() == 0 && h.negative() == 0 )
+            continue;
+
+        report += QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                  .arg(stageNames[i], -18)
+                  .arg(h.count(), 9)
+                  .arg(h.negative(), 9)
+                  .arg(h.min()/1000.0, 9, 'f', 1)
+                  .arg(h.percentile(0.5)/1000.0, 9, 'f', 1)
+                  .arg(h.percentile(0.99)/1000.0, 9, 'f', 1)
+                  .arg(h.percentile(0.999)/1000.0, 9, 'f', 1)
+                  .arg(h.max()/1000.0, 9, 'f', 1);
+    }
+    if( !report.isEmpty() )
+        report.prepend("stage                  count  negative       min       p50       p99     p99.9       max (usecs)\n");
+    return report;
+}
+
+bool LatencyRecorder::writeReport(const QString& filename)
+{
+    return Global::writeReport(filename, report());
+}
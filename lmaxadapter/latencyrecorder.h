@@ -0,0 +1,64 @@
+#ifndef __latencyrecorder_h__
+#define __latencyrecorder_h__
+
+#include "nanohistogram.h"
+
+#include <QString>
+#include <QAtomicInteger>
+
+////////////////////////////////////////////////////////////////////////////////
+// Histogram of a single recording thread: the owner updates it by relaxed
+// atomic stores, the merging thread reads it at any time without locks.
+// A merge may see a record counted but not summed yet
+class ThreadHistogram
+{
+public:
+    ThreadHistogram();
+    ~ThreadHistogram();
+
+    void record(qint64 nanos);
+    void addTo(NanoHistogram& out) const;
+
+private:
+    Q_DISABLE_COPY(ThreadHistogram)
+
+    QAtomicInteger<quint64>* buckets_;
+    QAtomicInteger<quint64>  count_;
+    QAtomicInteger<qint64>   min_;
+    QAtomicInteger<qint64>   max_;
+    QAtomicInteger<qint64>   sum_;
+    QAtomicInteger<quint64>  negative_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Latencies of market data between the stages of the adapter. Every thread
+// records into its own histograms, NetworkManager merges them periodically
+// and writes the stats file, the GUI shows the last merge
+class LatencyRecorder
+{
+public:
+    enum Stage {
+        ReadToFrame = 0,    // received by the socket -> message framed (transport)
+        FrameToParse,       // message framed -> fields extracted (FixDataModel)
+        ParseToCache,       // fields extracted -> snapshot updated
+        CacheToPublish,     // snapshot updated -> quote queued to the MQL clients
+        PublishToPipe,      // quote queued -> written to the MQL pipe (MqlProxyServer)
+        WireToPipe,         // received by the socket -> written to the MQL pipe
+        RequestToResponse,  // subscribe sent -> first response of the instrument
+        StageCount
+    };
+
+    // Lock-free, into the histograms of the calling thread
+    static void record(Stage stage, qint64 nanos);
+
+    // Sums up the histograms of all threads, counts are since the start
+    static void merge();
+    static void snapshot(Stage stage, NanoHistogram& out);
+
+    static const char* stageName(Stage stage);
+    // Table of the last merge in usecs, empty when nothing is recorded
+    static QString report();
+    static bool writeReport(const QString& filename);
+};
+
+#endif // __latencyrecorder_h__
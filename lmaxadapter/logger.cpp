@@ -1,6 +1,9 @@
 #include "globals.h"
 
+#ifdef WIN32
 #include <windows.h>
+#endif
+#include <stdio.h>
 #include <string>
 #include <algorithm>
 
@@ -43,7 +46,11 @@ bool CLogFile::checkLoggingEnabled()
     if( Global::logging_ && !isOpen() ) {
         if( !open(QIODevice::ReadWrite|QIODevice::Append|QIODevice::Text) ) {
             QString info = QString("Cannot open logging file %1\nLogging will be disabled!").arg(FILENAME_DEBUGINFO);
+#if defined(WIN32) && !defined(LMAX_HEADLESS)
             ::MessageBoxA(NULL, info.toStdString().c_str(), "Error", MB_OK|MB_ICONSTOP);
+#else
+            fprintf(stderr, "Error: %s\n", info.toStdString().c_str());
+#endif
             return false;
         }
     }
@@ -17,6 +17,24 @@ int main(int argc, char *argv[])
         QApplication app(argc, argv);
         MainDialog lmxDlg;
         lmxDlg.show();
+
+        // --replay <messages log> [--replay-speed <x>] [--replay-report <file>] [--replay-quit]
+        QStringList args = app.arguments();
+        qint32 pos = args.indexOf("--replay");
+        if( pos > 0 && pos + 1 < args.size() )
+        {
+            double speed = 0;
+            qint32 opt = args.indexOf("--replay-speed");
+            if( opt > 0 && opt + 1 < args.size() )
+                speed = args[opt + 1].toDouble();
+
+            QString report = FILENAME_REPLAYREPORT;
+            opt = args.indexOf("--replay-report");
+            if( opt > 0 && opt + 1 < args.size() )
+                report = args[opt + 1];
+
+            lmxDlg.startReplay(args[pos + 1], speed, report, args.contains("--replay-quit"));
+        }
         app.exec();
     }
     catch(const exception& ex) 
@@ -4,9 +4,11 @@
 #include "netmanager.h"
 #include "quotestableview.h"
 #include "quotestablemodel.h"
+#include "fixdatamodel.h"
 #include "setupdialog.h"
 #include "statusbar.h"
 #include "scheduler.h"
+#include "latencydialog.h"
 
 #include <QtWidgets>
 
@@ -14,6 +16,8 @@
 QPixmap qt_pixmapFromWinHICON(HICON icon);
 
 MainDialog::MainDialog() 
+    : quitAfterReplay_(false),
+    latency_(NULL)
 {
     Global::init();
     setFixedSize(Global::desktop.width()*0.6f, Global::desktop.height()*0.5f);
@@ -44,6 +48,32 @@ void MainDialog::onSettings()
     SetupDialog(*netman_->model(), this).exec();
 }
 
+void MainDialog::onLatency()
+{
+    if( latency_ == NULL )
+        latency_ = new LatencyDialog(this);
+    latency_->show();
+    latency_->raise();
+    latency_->activateWindow();
+}
+
+void MainDialog::startReplay(const QString& filename, double speed, const QString& reportFile, bool quitAtFinish)
+{
+    quitAfterReplay_ = quitAtFinish;
+    reconnectBox_->setCheckState(Qt::Unchecked);
+    QObject::connect(netman_.data(), SIGNAL(notifyReplayFinished(const QString&)), 
+                     this, SLOT(onReplayFinished(const QString&)));
+
+    if( !netman_->replay(filename, speed, reportFile) && quitAtFinish )
+        QTimer::singleShot(0, qApp, SLOT(quit()));
+}
+
+void MainDialog::onReplayFinished(const QString& report)
+{
+    if( quitAfterReplay_ )
+        QTimer::singleShot(0, qApp, SLOT(quit()));
+}
+
 void MainDialog::onReconnectSetCheck(bool on)
 {
     if( reconnectBox_ )
@@ -143,18 +173,25 @@ void MainDialog::setupButtons()
 
     settingsButton_->move(width() - rc.height()*2 - 10, 10);
     settingsButton_->setAutoDefault(false);
+
+    QObject::connect(latencyButton_ = new QPushButton(tr("Latency"), this), SIGNAL(clicked()), this, SLOT(onLatency()));
+    latencyButton_->setToolTip(tr("Latency percentiles of the market data stages\n(also written to \"%1\")").arg(FILENAME_LATENCYSTATS));
+    latencyButton_->setFont(*Global::buttons);
+    latencyButton_->setFixedSize(rc.width()*2, rc.height()*2);
+    latencyButton_->move(settingsButton_->pos().x()-latencyButton_->width()-10, 10);
+    latencyButton_->setAutoDefault(false);
 }
 
 void MainDialog::setupTable()
 {
     tableview_.reset(new QuotesTableView(this));
-    netman_->model()->resetView(tableview_.data());
+    netman_->tableModel()->resetView(tableview_.data());
     tableview_->setFont(*Global::compact);
     tableview_->setFixedSize(width()-20, height() - startButton_->height() - 55);
     tableview_->move(10, startButton_->height() + 20);
     tableview_->show();
     tableview_->updateStyles();
-    tableview_->setModel(netman_->model());
+    tableview_->setModel(netman_->tableModel());
 }
 
 void MainDialog::setupStatus()
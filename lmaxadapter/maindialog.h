@@ -9,6 +9,7 @@ class QuotesTableModel;
 class NetworkManager;
 class MqlProxyClient;
 class StatusBar;
+class LatencyDialog;
 
 QT_BEGIN_NAMESPACE
 class QPushButton;
@@ -24,6 +25,9 @@ public:
     MainDialog();
     ~MainDialog();
 
+    // Log replay instead of LMAX connection (--replay command line)
+    void startReplay(const QString& filename, double speed, const QString& reportFile, bool quitAtFinish);
+
 protected:
     void setupButtons();
     void setupTable();
@@ -38,18 +42,23 @@ protected slots:
     void onStart();
     void onStop();
     void onSettings();
+    void onLatency();
     void asyncStart();
     void asyncStop();
     void onStateChanged(quint8 state, const QString& reason);
+    void onReplayFinished(const QString& report);
     
 private:
     QPushButton* startButton_;
     QPushButton* stopButton_;
     QPushButton* colorButton_;
     QPushButton* settingsButton_;
+    QPushButton* latencyButton_;
     QCheckBox*   reconnectBox_;
     QCheckBox*   loggingBox_;
+    bool         quitAfterReplay_;
     StatusBar*   statusBar_;
+    LatencyDialog* latency_;
 
     QSharedPointer<QuotesTableView> tableview_;
     QSharedPointer<NetworkManager>  netman_;
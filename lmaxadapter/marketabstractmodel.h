@@ -1,13 +1,16 @@
 #ifndef __marketabstractmodel_h__
 #define __marketabstractmodel_h__
 
-#include <QAbstractTableModel>
+#include <QObject>
+#include <QString>
+#include <QMetaType>
 #include <QSet>
+#include <QVector>
 
 ///////////////////////////////////////////////////////////////
+class DReadLocker;
+
 QT_BEGIN_NAMESPACE;
-class QReadWriteLock;
-class QReadLocker;
 template <class T, typename Cleanup = QScopedPointerDeleter<T>> class QScopedPointer;
 QT_END_NAMESPACE;
 
@@ -33,8 +36,16 @@ struct Snapshot
     QString     description_;
     QString     bid_;
     QString     ask_;
-    qint32      requestTime_;
-    qint32      responseTime_;
+    qint64      requestTime_;   // nanotime of the subscribe, then nsecs up to its first response
+    qint64      responseTime_;  // nanotime of the last response
+    qint64      serverTime_;    // SendingTime(52) of the last market data, msecs since epoch
+    qint64      rxNanos_;       // adapter receive time of the last market data, monotonic nsecs
+    quint32     updates_;       // market data counter used as per-instrument sequence
+    bool        standby_;       // the last market data came from the standby session
+
+    Snapshot()
+        : serverTime_(0), rxNanos_(0), updates_(0), standby_(false)
+    {}
 
     inline bool operator==(const Snapshot& rval) const {  
         return (instrument_.second == rval.instrument_.second); 
@@ -85,14 +96,15 @@ public:
 class MarketAbstractModel
 {
 public:
-    MarketAbstractModel() { qRegisterMetaType<Instrument>("Instrument"); }
+    MarketAbstractModel() {
+        qRegisterMetaType<Instrument>("Instrument");
+        qRegisterMetaType<QVector<Instrument> >("QVector<Instrument>");
+    }
     virtual ~MarketAbstractModel() {}
 
     virtual void onInstrumentAdd(const Instrument& inst) = 0;
     virtual void onInstrumentRemove(const Instrument& inst, qint16 orderRow) = 0;
     virtual void onInstrumentChange(const Instrument& old, const Instrument& cur) = 0;
-    virtual void onInstrumentUpdate() = 0;
-    virtual void onInstrumentUpdate(const Instrument& inst) = 0;
 
     virtual bool   isMonitored(const Instrument& inst) const = 0;
     virtual qint16 monitoredCount() const = 0;
@@ -111,7 +123,7 @@ public:
 
     // Gets snapshot by the table data fetching (readonly)
     // check autolock after calling - it must be not empty when getSnapshot has owned the section
-    virtual Snapshot* getSnapshot(const char* sym, QSharedPointer<QReadLocker>& autolock) const = 0;
+    virtual Snapshot* getSnapshot(const char* sym, QSharedPointer<DReadLocker>& autolock) const = 0;
 
     virtual const char* getSymbol(qint32 code) const = 0;
     virtual qint32 getCode(const char* sym) const = 0;
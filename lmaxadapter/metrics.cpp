@@ -0,0 +1,300 @@
+#include "globals.h"
+#include "metrics.h"
+#include "netmanager.h"
+#include "fixdatamodel.h"
+#include "fixlogger.h"
+#include "scheduler.h"
+#include "mqlproxyserver.h"
+#include "latencyrecorder.h"
+#include "fixtransport.h"
+
+#include <QTcpSocket>
+#include <QHostAddress>
+
+using namespace std;
+
+QAtomicInteger<quint64> Metrics::in_[Metrics::SessionCount][128];
+QAtomicInteger<quint64> Metrics::out_[Metrics::SessionCount][128];
+QAtomicInteger<quint64> Metrics::reconnects_[Metrics::SessionCount];
+
+namespace {
+    const char* sessionNames[Metrics::SessionCount] = { "primary", "standby" };
+
+    struct RejectType {
+        char        type_;
+        const char* reason_;
+    };
+    const RejectType rejectTypes[] = {
+        { '3', "session" },
+        { 'Y', "market_data" },
+        { 'j', "business" },
+    };
+
+    const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    void header(QByteArray& out, const char* name, const char* type, const char* help)
+    {
+        out += "# HELP "; out += name; out += " "; out += help; out += "\n";
+        out += "# TYPE "; out += name; out += " "; out += type; out += "\n";
+    }
+
+    void sample(QByteArray& out, const char* name, const QByteArray& labels, const QByteArray& value)
+    {
+        out += name;
+        if( !labels.isEmpty() ) {
+            out += "{"; out += labels; out += "}";
+        }
+        out += " "; out += value; out += "\n";
+    }
+
+    QByteArray label(const char* name, const QByteArray& value)
+    {
+        QByteArray escaped = value;
+        escaped.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+        return QByteArray(name) + "=\"" + escaped + "\"";
+    }
+
+    // read->frame is exposed as read_to_frame
+    QByteArray stageLabel(LatencyRecorder::Stage stage)
+    {
+        QByteArray name = LatencyRecorder::stageName(stage);
+        return label("stage", name.replace("->", "_to_"));
+    }
+
+    QByteArray seconds(qint64 nanos)
+    {
+        return QByteArray::number(nanos / 1e9, 'g', 9);
+    }
+
+    // negative msecs are "not measured" and stay -1
+    QByteArray msecsToSeconds(qint32 msecs)
+    {
+        return msecs < 0 ? QByteArray("-1") : QByteArray::number(msecs / 1000.0, 'g', 6);
+    }
+
+    void sessionCounters(QByteArray& out, const char* name, const char* help,
+                         quint64 (*count)(Metrics::Session, char))
+    {
+        header(out, name, "counter", help);
+        for(qint32 s = 0; s < Metrics::SessionCount; s++) {
+            for(char type = ' '; type < 0x7F; type++) {
+                quint64 n = count(Metrics::Session(s), type);
+                if( n )
+                    sample(out, name, label("session", sessionNames[s]) + "," + label("type", QByteArray(1, type)),
+                           QByteArray::number(n));
+            }
+        }
+    }
+}
+
+const char* Metrics::sessionName(Session session)
+{
+    return sessionNames[session];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+MetricsServer::MetricsServer(NetworkManager* manager)
+    : QTcpServer(manager),
+    manager_(manager)
+{
+    QObject::connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+void MetricsServer::start(quint16 port)
+{
+    if( port == 0 ) {
+        CDebug() << "Metrics endpoint is disabled";
+        return;
+    }
+
+    // never exposed beyond the host
+    if( !listen(QHostAddress::LocalHost, port) )
+        CDebug() << "Error: metrics endpoint cannot listen on 127.0.0.1:" << port << " - " << errorString();
+    else
+        CDebug() << "Metrics endpoint on http://127.0.0.1:" << port << "/metrics";
+}
+
+void MetricsServer::onNewConnection()
+{
+    while( hasPendingConnections() )
+    {
+        QTcpSocket* cnt = nextPendingConnection();
+        if( cnt == NULL )
+            continue;
+        requests_.insert(cnt, QByteArray());
+        QObject::connect(cnt, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        QObject::connect(cnt, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void MetricsServer::onReadyRead()
+{
+    QTcpSocket* cnt = qobject_cast<QTcpSocket*>(sender());
+    if( cnt == NULL || !requests_.contains(cnt) )
+        return;
+
+    QByteArray& request = requests_[cnt];
+    request.append(cnt->readAll());
+    if( request.size() > METRICS_REQUEST_LIMIT ) {
+        requests_.remove(cnt);
+        cnt->abort();
+        cnt->deleteLater();
+        return;
+    }
+
+    // the header is complete, a body is never expected
+    if( request.indexOf("\r\n\r\n") < 0 && request.indexOf("\n\n") < 0 )
+        return;
+
+    QByteArray line = request.left(request.indexOf('\n')).trimmed();
+    requests_.remove(cnt);
+    respond(cnt, line);
+}
+
+void MetricsServer::onDisconnected()
+{
+    QTcpSocket* cnt = qobject_cast<QTcpSocket*>(sender());
+    if( cnt == NULL )
+        return;
+    requests_.remove(cnt);
+    cnt->deleteLater();
+}
+
+void MetricsServer::respond(QTcpSocket* cnt, const QByteArray& request)
+{
+    QList<QByteArray> parts = request.split(' ');
+    QByteArray status, type, body;
+    if( parts.size() < 2 || parts[0] != "GET" ) {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+        body = "GET /metrics only\n";
+    }
+    else if( parts[1] != "/metrics" && !parts[1].startsWith("/metrics?") ) {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "GET /metrics only\n";
+    }
+    else {
+        status = "200 OK";
+        type = "text/plain; version=0.0.4; charset=utf-8";
+        body = render();
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: " + type + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    cnt->write(response);
+    cnt->disconnectFromHost();
+}
+
+QByteArray MetricsServer::render() const
+{
+    QByteArray out;
+    out.reserve(16384);
+
+    header(out, "lmax_session_state", "gauge", "Connection state of the primary session (RequestHandler::ConnectionState)");
+    sample(out, "lmax_session_state", QByteArray(), QByteArray::number(manager_->getState()));
+
+    sessionCounters(out, "lmax_messages_in_total", "FIX messages received by MsgType(35)", &Metrics::messagesIn);
+    sessionCounters(out, "lmax_messages_out_total", "FIX messages sent by MsgType(35)", &Metrics::messagesOut);
+
+    header(out, "lmax_rejects_total", "counter", "Rejects received: session(3), market data request(Y), business(j)");
+    for(qint32 s = 0; s < Metrics::SessionCount; s++) {
+        for(quint32 i = 0; i < sizeof(rejectTypes)/sizeof(rejectTypes[0]); i++)
+            sample(out, "lmax_rejects_total",
+                   label("session", sessionNames[s]) + "," + label("reason", rejectTypes[i].reason_),
+                   QByteArray::number(Metrics::messagesIn(Metrics::Session(s), rejectTypes[i].type_)));
+    }
+
+    header(out, "lmax_reconnects_total", "counter", "Reconnect attempts");
+    for(qint32 s = 0; s < Metrics::SessionCount; s++)
+        sample(out, "lmax_reconnects_total", label("session", sessionNames[s]),
+               QByteArray::number(Metrics::reconnects(Metrics::Session(s))));
+
+    Scheduler* scheduler = manager_->scheduler();
+    header(out, "lmax_reconnect_first_tick_seconds", "gauge",
+           "From the last reconnect attempt of the primary session to its first quote, -1 - not measured yet");
+    sample(out, "lmax_reconnect_first_tick_seconds", QByteArray(), msecsToSeconds(scheduler->lastFirstTick()));
+    header(out, "lmax_reconnect_outage_seconds", "gauge",
+           "From the last disconnect of the primary session to the first quote after it, -1 - not measured yet");
+    sample(out, "lmax_reconnect_outage_seconds", QByteArray(), msecsToSeconds(scheduler->lastOutage()));
+
+    TransportStats st;
+    if( manager_->connectionStats(st) ) {
+        header(out, "lmax_connects_total", "counter", "TCP connects of the primary transport");
+        sample(out, "lmax_connects_total", QByteArray(), QByteArray::number(st.connects_));
+        header(out, "lmax_connect_seconds", "gauge", "TCP connect time of the last primary connection");
+        sample(out, "lmax_connect_seconds", QByteArray(), msecsToSeconds(st.connectTime_));
+        header(out, "lmax_tls_handshake_seconds", "gauge", "TLS handshake time of the last primary connection, -1 - not encrypted");
+        sample(out, "lmax_tls_handshake_seconds", QByteArray(), msecsToSeconds(st.handshakeTime_));
+        header(out, "lmax_tls_resume_offered_total", "counter", "TLS handshakes of the primary transport offering a cached session");
+        sample(out, "lmax_tls_resume_offered_total", QByteArray(), QByteArray::number(st.resumeOffered_));
+    }
+
+    // per-instrument sequences of the cache are the published ticks
+    FixDataModel* model = manager_->model();
+    QVector<string> monitored;
+    model->getSymbolsUnderMonitoring(monitored);
+    header(out, "lmax_ticks_total", "counter", "Market data updates published per instrument");
+    {
+        QSharedPointer<DReadLocker> autolock;
+        for(qint32 i = 0; i < monitored.size(); ++i) {
+            Snapshot* snap = model->getSnapshot(monitored[i].c_str(), autolock);
+            if( snap )
+                sample(out, "lmax_ticks_total", label("symbol", monitored[i].c_str()), QByteArray::number(snap->updates_));
+        }
+    }
+
+    header(out, "lmax_scheduler_queue_depth", "gauge", "Requests waiting for the outbound pacing");
+    sample(out, "lmax_scheduler_queue_depth", QByteArray(), QByteArray::number(manager_->scheduler()->pacingDepth()));
+
+    header(out, "lmax_fixlog_queue_depth", "gauge", "Records waiting for the FIX messages log writer");
+    sample(out, "lmax_fixlog_queue_depth", QByteArray(), QByteArray::number(model->msglog().queueDepth()));
+
+    QVector<MqlClientStats> clients;
+    manager_->mqlProxy()->clientStats(clients);
+    header(out, "lmax_mql_clients", "gauge", "Connected MQL clients");
+    sample(out, "lmax_mql_clients", QByteArray(), QByteArray::number(clients.size()));
+
+    header(out, "lmax_mql_queue_depth", "gauge", "Symbols waiting in the queue of an MQL client");
+    for(qint32 i = 0; i < clients.size(); i++)
+        sample(out, "lmax_mql_queue_depth", label("client", QByteArray::number(i)), QByteArray::number(clients[i].pending_));
+    header(out, "lmax_mql_queue_lag_seconds", "gauge", "Age of the oldest quote waiting for an MQL client");
+    for(qint32 i = 0; i < clients.size(); i++)
+        sample(out, "lmax_mql_queue_lag_seconds", label("client", QByteArray::number(i)),
+               QByteArray::number(clients[i].lagMs_ / 1000.0, 'g', 6));
+    header(out, "lmax_mql_unsent_bytes", "gauge", "Bytes waiting in the pipe buffer of an MQL client");
+    for(qint32 i = 0; i < clients.size(); i++)
+        sample(out, "lmax_mql_unsent_bytes", label("client", QByteArray::number(i)), QByteArray::number(clients[i].unsentBytes_));
+    header(out, "lmax_mql_quotes_total", "counter", "Quotes of an MQL client by outcome");
+    for(qint32 i = 0; i < clients.size(); i++) {
+        QByteArray client = label("client", QByteArray::number(i));
+        sample(out, "lmax_mql_quotes_total", client + "," + label("outcome", "sent"), QByteArray::number(clients[i].sent_));
+        sample(out, "lmax_mql_quotes_total", client + "," + label("outcome", "conflated"), QByteArray::number(clients[i].conflated_));
+        sample(out, "lmax_mql_quotes_total", client + "," + label("outcome", "dropped"), QByteArray::number(clients[i].dropped_));
+    }
+
+    header(out, "lmax_latency_seconds", "summary", "Market data latency between the adapter stages, last merge of LatencyRecorder");
+    for(qint32 s = 0; s < LatencyRecorder::StageCount; s++)
+    {
+        NanoHistogram h;
+        LatencyRecorder::snapshot(LatencyRecorder::Stage(s), h);
+        QByteArray stage = stageLabel(LatencyRecorder::Stage(s));
+        for(quint32 q = 0; q < sizeof(quantiles)/sizeof(quantiles[0]); q++)
+            sample(out, "lmax_latency_seconds", stage + "," + label("quantile", QByteArray::number(quantiles[q])),
+                   seconds(h.percentile(quantiles[q])));
+        sample(out, "lmax_latency_seconds_sum", stage, seconds(h.sum()));
+        sample(out, "lmax_latency_seconds_count", stage, QByteArray::number(h.count()));
+    }
+
+    header(out, "lmax_latency_negative_total", "counter", "Negative deltas between the stages, not in lmax_latency_seconds");
+    for(qint32 s = 0; s < LatencyRecorder::StageCount; s++)
+    {
+        NanoHistogram h;
+        LatencyRecorder::snapshot(LatencyRecorder::Stage(s), h);
+        sample(out, "lmax_latency_negative_total", stageLabel(LatencyRecorder::Stage(s)), QByteArray::number(h.negative()));
+    }
+    return out;
+}
@@ -0,0 +1,82 @@
+#ifndef __metrics_h__
+#define __metrics_h__
+
+#include <QTcpServer>
+#include <QAtomicInteger>
+#include <QHash>
+
+class NetworkManager;
+
+QT_BEGIN_NAMESPACE
+class QTcpSocket;
+QT_END_NAMESPACE
+
+////////////////////////////////////////////////////////////////////////////////
+// Counters of the FIX sessions by message type (35), added on the receiving
+// and sending threads by relaxed atomics, read by the metrics endpoint
+class Metrics
+{
+public:
+    enum Session {
+        Primary = 0,
+        Standby,
+        SessionCount
+    };
+
+    inline static void messageIn(Session session, char type)
+    { in_[session][type & 0x7F].fetchAndAddRelaxed(1); }
+
+    inline static void messageOut(Session session, char type)
+    { out_[session][type & 0x7F].fetchAndAddRelaxed(1); }
+
+    inline static void reconnect(Session session)
+    { reconnects_[session].fetchAndAddRelaxed(1); }
+
+    inline static quint64 messagesIn(Session session, char type)
+    { return in_[session][type & 0x7F].load(); }
+
+    inline static quint64 messagesOut(Session session, char type)
+    { return out_[session][type & 0x7F].load(); }
+
+    inline static quint64 reconnects(Session session)
+    { return reconnects_[session].load(); }
+
+    static const char* sessionName(Session session);
+
+private:
+    static QAtomicInteger<quint64> in_[SessionCount][128];
+    static QAtomicInteger<quint64> out_[SessionCount][128];
+    static QAtomicInteger<quint64> reconnects_[SessionCount];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// HTTP endpoint on localhost serving GET /metrics in the Prometheus text
+// format: session counters, ticks per instrument, queue depths and the last
+// merge of the latency histograms. Runs on the thread of NetworkManager,
+// the connection is closed after every response
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    MetricsServer(NetworkManager* manager);
+
+    // port 0 - disabled
+    void start(quint16 port);
+
+    // Exposition of the current values
+    QByteArray render() const;
+
+protected slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    void respond(QTcpSocket* cnt, const QByteArray& request);
+
+private:
+    NetworkManager* manager_;
+    QHash<QTcpSocket*,QByteArray> requests_;
+};
+
+#endif // __metrics_h__
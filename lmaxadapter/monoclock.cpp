@@ -0,0 +1,275 @@
+#include "external.h"
+#include "monoclock.h"
+
+#include <QAtomicInt>
+#include <QThread>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define MONOCLOCK_TSC
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#include <cpuid.h>
+#define MONOCLOCK_TSC
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+    enum State {
+        Uncalibrated = 0,
+        Calibrating,
+        OsClock,
+        TscClock,
+    };
+
+    // 100 nanoseconds between 1601.01.01-00:00:00 and 1970.01.01-00:00:00
+    quint64 const WIN_TIME_CORRECTOR = 116444736000000000ull;
+
+    QAtomicInt state(Uncalibrated);
+
+    // The anchor is written by a single thread under the odd version,
+    // readers take it when the version is even and the same after reading
+    struct Anchor {
+        quint64 ticks_;
+        qint64  nanos_;         // value of the clock at ticks_, not below the OS clock
+        qint64  osNanos_;       // OS clock at ticks_
+        qint64  wallOffset_;    // wall - monotonic nsecs
+        double  rate_;          // calibrated nsecs per tick
+        double  nanosPerTick_;  // slewed rate of the span
+        qint64  span_;          // ticks up to the next anchor
+    };
+    QAtomicInt version(0);
+    volatile Anchor anchor;
+
+    bool readAnchor(Anchor& out)
+    {
+        int before = version.loadAcquire();
+        if( before & 1 )
+            return false;
+        out.ticks_ = anchor.ticks_;
+        out.nanos_ = anchor.nanos_;
+        out.osNanos_ = anchor.osNanos_;
+        out.wallOffset_ = anchor.wallOffset_;
+        out.rate_ = anchor.rate_;
+        out.nanosPerTick_ = anchor.nanosPerTick_;
+        out.span_ = anchor.span_;
+        return version.loadAcquire() == before;
+    }
+
+    inline qint64 project(const Anchor& last, qint64 passed)
+    {
+        return last.nanos_ + qint64(passed * last.nanosPerTick_);
+    }
+
+    // the last value read by the thread
+    THREAD_LOCAL qint64 lastNanos = 0;
+
+#ifdef MONOCLOCK_TSC
+    QAtomicInt anchoring(0);
+    qint64 maxSpan = 0;         // ticks of MONOCLOCK_ANCHOR_MSECS, set by the calibration
+
+    void writeAnchor(quint64 ticks, qint64 nanos, qint64 osNanos, qint64 wallOffset,
+                     double rate, double nanosPerTick, qint64 span)
+    {
+        version.fetchAndAddOrdered(1);
+        anchor.ticks_ = ticks;
+        anchor.nanos_ = nanos;
+        anchor.osNanos_ = osNanos;
+        anchor.wallOffset_ = wallOffset;
+        anchor.rate_ = rate;
+        anchor.nanosPerTick_ = nanosPerTick;
+        anchor.span_ = span;
+        version.fetchAndAddOrdered(1);
+    }
+
+    inline quint64 ticks()
+    {
+        return __rdtsc();
+    }
+
+    // CPUID 0x80000007, EDX bit 8: the TSC runs at a constant rate in all states
+    bool invariantTsc()
+    {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0x80000000);
+        if( (unsigned)regs[0] < 0x80000007 )
+            return false;
+        __cpuid(regs, 0x80000007);
+        return (regs[3] & (1 << 8)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if( !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) )
+            return false;
+        return (edx & (1 << 8)) != 0;
+#endif
+    }
+
+    // Moves the anchor to the OS clock, the rate follows the OS clock over
+    // the passed interval unless it's off by more than 1%. The first spans
+    // are short and doubled up to MONOCLOCK_ANCHOR_MSECS: the rate of a short
+    // calibration may be off by hundreds of ppm. The clock doesn't go back
+    // to the OS clock, the span runs slower by up to 0.1% to meet it
+    qint64 reanchor(const Anchor& last)
+    {
+        quint64 now = ticks();
+        qint64 os = MonoClock::osNanos();
+        qint64 wall = MonoClock::osWallNanos();
+
+        double rate = last.rate_;
+        if( now > last.ticks_ && os > last.osNanos_ ) {
+            double measured = double(os - last.osNanos_) / double(now - last.ticks_);
+            if( measured > rate*0.99 && measured < rate*1.01 )
+                rate = measured;
+        }
+
+        qint64 span = qMin(last.span_*2, maxSpan);
+        qint64 nanos = qMax(os, project(last, qint64(now - last.ticks_)));
+        double slew = double(nanos - os) / (span * rate);
+        writeAnchor(now, nanos, os, wall - os, rate, rate * (1.0 - qMin(slew, 0.001)), span);
+        return nanos;
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MonoClock::init()
+{
+    if( !state.testAndSetOrdered(Uncalibrated, Calibrating) )
+        return;
+
+#ifdef MONOCLOCK_TSC
+    if( invariantTsc() )
+    {
+        quint64 ticks0 = ticks();
+        qint64 nanos0 = osNanos();
+        QThread::msleep(MONOCLOCK_CALIBRATE_MSECS);
+        quint64 ticks1 = ticks();
+        qint64 nanos1 = osNanos();
+
+        // 0.1 - 10 GHz, anything else is a broken TSC (virtual machines)
+        double rate = (ticks1 > ticks0) ? double(nanos1 - nanos0) / double(ticks1 - ticks0) : 0;
+        if( rate > 0.1 && rate < 10 ) {
+            maxSpan = qint64(MONOCLOCK_ANCHOR_MSECS * 1000000.0 / rate);
+            writeAnchor(ticks1, nanos1, nanos1, osWallNanos() - nanos1, rate, rate,
+                        qint64(MONOCLOCK_CALIBRATE_MSECS * 1000000.0 / rate));
+            state.storeRelease(TscClock);
+            return;
+        }
+    }
+#endif
+    state.storeRelease(OsClock);
+}
+
+qint64 MonoClock::nanos()
+{
+    qint64 nanos = 0;
+#ifdef MONOCLOCK_TSC
+    int current = state.loadAcquire();
+    Anchor last;
+    if( current == TscClock && readAnchor(last) )
+    {
+        // TSC of this core may be a bit behind the one of the anchoring core
+        qint64 passed = qMax(qint64(ticks() - last.ticks_), qint64(0));
+        if( passed < last.span_ )
+            nanos = project(last, passed);
+        // the stale anchor is moved by one thread, the others go on with it
+        else if( anchoring.testAndSetAcquire(0, 1) ) {
+            nanos = reanchor(last);
+            anchoring.storeRelease(0);
+        }
+        else
+            nanos = project(last, passed);
+    }
+    else {
+        if( current == Uncalibrated )
+            init();
+        nanos = osNanos();
+    }
+#else
+    nanos = osNanos();
+#endif
+
+    // a thread never sees the clock going back
+    if( nanos < lastNanos )
+        return lastNanos;
+    lastNanos = nanos;
+    return nanos;
+}
+
+qint64 MonoClock::toWall(qint64 nanos)
+{
+    Anchor last;
+    if( state.loadAcquire() == TscClock && readAnchor(last) )
+        return nanos + last.wallOffset_;
+    return nanos + osWallNanos() - osNanos();
+}
+
+qint64 MonoClock::fromWall(qint64 wallNanos)
+{
+    Anchor last;
+    if( state.loadAcquire() == TscClock && readAnchor(last) )
+        return wallNanos - last.wallOffset_;
+    return wallNanos - osWallNanos() + osNanos();
+}
+
+bool MonoClock::tsc()
+{
+    return state.loadAcquire() == TscClock;
+}
+
+double MonoClock::tscGHz()
+{
+    Anchor last;
+    if( !tsc() || !readAnchor(last) )
+        return 0;
+    return 1.0 / last.nanosPerTick_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#ifdef WIN32
+// QueryPerformanceCounter is shared by all processes of the host
+qint64 MonoClock::osNanos()
+{
+    static LARGE_INTEGER frequency = {0};
+    if( frequency.QuadPart == 0 )
+        ::QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    ::QueryPerformanceCounter(&counter);
+    return (counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           (counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
+// at the resolution of the system timer
+qint64 MonoClock::osWallNanos()
+{
+    FILETIME ft;
+    ::GetSystemTimeAsFileTime(&ft);
+
+    ULARGE_INTEGER v;
+    v.LowPart = ft.dwLowDateTime;
+    v.HighPart = ft.dwHighDateTime;
+    return qint64(v.QuadPart - WIN_TIME_CORRECTOR) * 100;
+}
+
+#else
+qint64 MonoClock::osNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+qint64 MonoClock::osWallNanos()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
@@ -0,0 +1,45 @@
+#ifndef __monoclock_h__
+#define __monoclock_h__
+
+#include <QtGlobal>
+
+// msecs between the anchors of the TSC to the OS clock
+#define MONOCLOCK_ANCHOR_MSECS      1000
+// msecs of the first calibration of the TSC rate
+#define MONOCLOCK_CALIBRATE_MSECS   20
+
+////////////////////////////////////////////////////////////////////////////////
+// Monotonic nanosecond clock of the process. The invariant TSC of the CPU is
+// read when there is one: the ticks are scaled by the rate calibrated against
+// the OS monotonic clock and anchored to it every MONOCLOCK_ANCHOR_MSECS, so
+// the values stay in the domain of QueryPerformanceCounter / CLOCK_MONOTONIC
+// shared with the other processes (mql.dll). An anchoring never steps the
+// clock back: when the TSC ran ahead of the OS clock, the next span is slewed
+// to meet it. A thread never reads a value lower than its previous one, the
+// values of different threads may differ by the TSC skew of their cores.
+// The OS clock is read when there is no usable TSC
+class MonoClock
+{
+public:
+    // Calibrates the TSC, the first read calibrates when it's not called
+    static void init();
+
+    static qint64 nanos();
+    inline static qint64 millis()
+    { return nanos() / 1000000; }
+
+    // Wall clock of a monotonic time and back, nsecs since epoch. The offset
+    // is taken with the last anchor of the TSC, without the TSC it's read anew
+    static qint64 toWall(qint64 nanos);
+    static qint64 fromWall(qint64 wallNanos);
+
+    // The TSC is read and its calibrated rate
+    static bool tsc();
+    static double tscGHz();
+
+    // The clocks of the OS: monotonic nsecs and nsecs since epoch
+    static qint64 osNanos();
+    static qint64 osWallNanos();
+};
+
+#endif // __monoclock_h__
@@ -0,0 +1,324 @@
+#ifndef __mqlprotocol_h__
+#define __mqlprotocol_h__
+
+#include <QByteArray>
+#include <QDateTime>
+#include <stddef.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////
+// Framed protocol of the pipe between LMAX adapter and mql.dll
+//
+// Every frame is a fixed header followed by <length_> bytes of payload.
+// Payload is a sequence of variable-length records of the frame type,
+// all numbers are little-endian, strings are length-prefixed without zero.
+// Receiver skips frames of unknown type so new types may be added freely,
+// the version is changed only when an existing layout is changed.
+//////////////////////////////////////////////////////////////////////////////
+
+#define MQL_FRAME_MAGIC             0x514D584C  // "LXMQ"
+#define MQL_PROTOCOL_VERSION        3
+#define MQL_MAX_FRAME_SIZE          (1024*1024)
+#define MQL_PIPE_BUFFER_SIZE        (64*1024)
+
+enum MqlFrameType
+{
+    MqlQuotesFrame      = 1,    // adapter -> mql.dll: quote records
+    MqlSymbolsFrame     = 2,    // mql.dll -> adapter: symbol records requested for monitoring
+    MqlHeartbeatFrame   = 3,    // both directions: empty payload
+    MqlBarsFrame        = 4,    // reserved for bars
+    MqlDepthFrame       = 5,    // reserved for market depth
+    MqlSymbolMapFrame   = 6     // adapter -> mql.dll: symbol id records, sent before the first quote of a symbol
+};
+
+#pragma pack(push,r1,1)
+struct MqlFrameHeader
+{
+    quint32 magic_;
+    quint8  version_;
+    quint8  type_;
+    quint16 reserved_;
+    quint32 length_;        // payload size without header
+    quint32 sequence_;      // per connection and direction, starts from 1
+    qint64  timestamp_;     // sender's time in msecs since epoch
+};
+#pragma pack(pop,r1)
+
+// Quote record:      quint32 symbol id, double bid, double ask,
+//                    qint64 server SendingTime(52) in msecs since epoch,
+//                    qint64 adapter receive time in monotonic nsecs of MonoClock (the TSC anchored
+//                    to QueryPerformanceCounter / CLOCK_MONOTONIC of the host),
+//                    quint32 per-instrument sequence number
+// Symbol record:     quint16 symbol length, symbol
+// Symbol id record:  quint32 symbol id, quint16 symbol length, symbol
+//
+// Symbol ids are assigned by the adapter and valid during the connection only
+
+//////////////////////////////////////////////////////////////////////////////
+// Builds one frame in a contiguous buffer
+class MqlFrameWriter
+{
+public:
+    MqlFrameWriter(quint8 type)
+    {
+        MqlFrameHeader header;
+        header.magic_ = MQL_FRAME_MAGIC;
+        header.version_ = MQL_PROTOCOL_VERSION;
+        header.type_ = type;
+        header.reserved_ = 0;
+        header.length_ = 0;
+        header.sequence_ = 0;
+        header.timestamp_ = QDateTime::currentMSecsSinceEpoch();
+        frame_.reserve(256);
+        frame_.append((const char*)&header, sizeof(header));
+    }
+
+    void addQuote(quint32 id, double bid, double ask, qint64 serverTime, qint64 rxNanos, quint32 sequence)
+    {
+        frame_.append((const char*)&id, sizeof(id));
+        frame_.append((const char*)&bid, sizeof(bid));
+        frame_.append((const char*)&ask, sizeof(ask));
+        frame_.append((const char*)&serverTime, sizeof(serverTime));
+        frame_.append((const char*)&rxNanos, sizeof(rxNanos));
+        frame_.append((const char*)&sequence, sizeof(sequence));
+    }
+
+    void addSymbolId(quint32 id, const char* symbol, quint16 length)
+    {
+        frame_.append((const char*)&id, sizeof(id));
+        addSymbol(symbol, length);
+    }
+
+    void addSymbol(const char* symbol, quint16 length)
+    {
+        frame_.append((const char*)&length, sizeof(length));
+        frame_.append(symbol, length);
+    }
+
+    // Completes the header, the frame is ready for writing
+    const QByteArray& finish(quint32 sequence)
+    {
+        quint32 length = frame_.size() - sizeof(MqlFrameHeader);
+        memcpy(frame_.data() + offsetof(MqlFrameHeader,length_), &length, sizeof(length));
+        memcpy(frame_.data() + offsetof(MqlFrameHeader,sequence_), &sequence, sizeof(sequence));
+        return frame_;
+    }
+
+    inline bool empty() const
+    { return frame_.size() == sizeof(MqlFrameHeader); }
+
+private:
+    QByteArray frame_;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Decoded frame, payload points into the decoder input or its partial buffer
+// and it's valid until the next call of MqlFrameDecoder::next()
+struct MqlFrame
+{
+    MqlFrameHeader header_;
+    const char*    payload_;
+};
+
+// Incremental decoder: complete frames are returned directly from the fed buffer,
+// only a frame split between two reads is collected into the own buffer
+class MqlFrameDecoder
+{
+public:
+    MqlFrameDecoder()
+        : input_(NULL), inputSize_(0), partialDone_(false), lastSequence_(0), gaps_(0), error_(false)
+    {}
+
+    void reset()
+    {
+        input_ = NULL;
+        inputSize_ = 0;
+        partial_.clear();
+        partialDone_ = false;
+        lastSequence_ = 0;
+        gaps_ = 0;
+        error_ = false;
+    }
+
+    // Buffer must stay valid while frames are taken by next()
+    void feed(const char* data, qint32 size)
+    {
+        input_ = data;
+        inputSize_ = size;
+    }
+
+    // Returns false when more data is needed or the stream is broken (see hasError)
+    bool next(MqlFrame* frame)
+    {
+        if( error_ )
+            return false;
+
+        if( !partial_.isEmpty() )
+        {
+            // previous frame is consumed
+            if( partialDone_ ) {
+                partial_.clear();
+                partialDone_ = false;
+            }
+            else {
+                if( !fillPartial() )
+                    return false;
+                memcpy(&frame->header_, partial_.constData(), sizeof(MqlFrameHeader));
+                frame->payload_ = partial_.constData() + sizeof(MqlFrameHeader);
+                partialDone_ = true;
+                return accept(frame);
+            }
+        }
+
+        if( inputSize_ < (qint32)sizeof(MqlFrameHeader) ) {
+            keepTail();
+            return false;
+        }
+
+        memcpy(&frame->header_, input_, sizeof(MqlFrameHeader));
+        if( !validate(frame->header_) )
+            return false;
+
+        qint32 frameSize = sizeof(MqlFrameHeader) + frame->header_.length_;
+        if( inputSize_ < frameSize ) {
+            keepTail();
+            return false;
+        }
+
+        frame->payload_ = input_ + sizeof(MqlFrameHeader);
+        input_ += frameSize;
+        inputSize_ -= frameSize;
+        return accept(frame);
+    }
+
+    inline bool hasError() const
+    { return error_; }
+
+    // Number of sequence gaps detected since reset
+    inline quint32 gaps() const
+    { return gaps_; }
+
+private:
+    bool validate(const MqlFrameHeader& header)
+    {
+        if( header.magic_ != MQL_FRAME_MAGIC ||
+            header.version_ != MQL_PROTOCOL_VERSION ||
+            header.length_ > MQL_MAX_FRAME_SIZE )
+        {
+            error_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool accept(const MqlFrame* frame)
+    {
+        if( lastSequence_ && frame->header_.sequence_ != lastSequence_ + 1 )
+            ++gaps_;
+        lastSequence_ = frame->header_.sequence_;
+        return true;
+    }
+
+    void keepTail()
+    {
+        partial_ = QByteArray(input_, inputSize_);
+        partialDone_ = false;
+        input_ += inputSize_;
+        inputSize_ = 0;
+    }
+
+    // Appends only the bytes which the split frame is missing
+    bool fillPartial()
+    {
+        qint32 need = sizeof(MqlFrameHeader) - partial_.size();
+        if( need > 0 ) {
+            if( !take(need) )
+                return false;
+            MqlFrameHeader header;
+            memcpy(&header, partial_.constData(), sizeof(header));
+            if( !validate(header) )
+                return false;
+        }
+
+        MqlFrameHeader header;
+        memcpy(&header, partial_.constData(), sizeof(header));
+        need = sizeof(MqlFrameHeader) + header.length_ - partial_.size();
+        return need <= 0 || take(need);
+    }
+
+    bool take(qint32 need)
+    {
+        qint32 bytes = qMin(need, inputSize_);
+        partial_.append(input_, bytes);
+        input_ += bytes;
+        inputSize_ -= bytes;
+        return bytes == need;
+    }
+
+private:
+    const char* input_;
+    qint32      inputSize_;
+    QByteArray  partial_;
+    bool        partialDone_;
+    quint32     lastSequence_;
+    quint32     gaps_;
+    bool        error_;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Reads records of a frame payload without copying of symbols
+class MqlRecordReader
+{
+public:
+    MqlRecordReader(const MqlFrame& frame)
+        : ptr_(frame.payload_), end_(frame.payload_ + frame.header_.length_)
+    {}
+
+    bool readQuote(quint32* id, double* bid, double* ask, qint64* serverTime, qint64* rxNanos, quint32* sequence)
+    {
+        if( end_ - ptr_ < qint32(2*sizeof(quint32) + 2*sizeof(double) + 2*sizeof(qint64)) )
+            return false;
+        read(id, sizeof(quint32));
+        read(bid, sizeof(double));
+        read(ask, sizeof(double));
+        read(serverTime, sizeof(qint64));
+        read(rxNanos, sizeof(qint64));
+        read(sequence, sizeof(quint32));
+        return true;
+    }
+
+    bool readSymbolId(quint32* id, const char** symbol, quint16* length)
+    {
+        if( end_ - ptr_ < qint32(sizeof(quint32)) )
+            return false;
+        read(id, sizeof(quint32));
+        return readSymbol(symbol, length);
+    }
+
+    bool readSymbol(const char** symbol, quint16* length)
+    {
+        if( end_ - ptr_ < qint32(sizeof(quint16)) )
+            return false;
+        memcpy(length, ptr_, sizeof(quint16));
+        if( end_ - ptr_ - qint32(sizeof(quint16)) < *length )
+            return false;
+        *symbol = ptr_ + sizeof(quint16);
+        ptr_ += sizeof(quint16) + *length;
+        return true;
+    }
+
+    inline bool atEnd() const
+    { return ptr_ >= end_; }
+
+private:
+    inline void read(void* dest, qint32 size)
+    {
+        memcpy(dest, ptr_, size);
+        ptr_ += size;
+    }
+
+    const char* ptr_;
+    const char* end_;
+};
+
+#endif // __mqlprotocol_h__
@@ -1,12 +1,99 @@
-#include "logger.h"
+#include "globals.h"
 #include "mqlproxyserver.h"
+#include "latencyrecorder.h"
 
 using namespace std;
 //static FILE* localsocklog = NULL;
 
+/////////////////////////////////////////////////////////////////
+MqlClientChannel::MqlClientChannel(QLocalSocket* writer)
+    : writer_(writer),
+    reader_(NULL),
+    outSequence_(0)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void MqlClientChannel::enqueue(const MqlOutQuote& quote)
+{
+    QMutexLocker g(&queueLock_);
+    ++stats_.enqueued_;
+
+    PendingT::iterator It = pending_.find(quote.id_);
+    if( It != pending_.end() ) {
+        // older quote was not delivered yet, keep its queue position and time but the latest prices
+        It->quote_ = quote;
+        ++stats_.conflated_;
+        return;
+    }
+
+    if( order_.size() >= MQL_CLIENT_QUEUE_LIMIT ) {
+        pending_.remove(order_.front());
+        order_.pop_front();
+        ++stats_.dropped_;
+    }
+
+    Pending p;
+    p.quote_ = quote;
+    p.queued_ = Global::nanotime();
+    pending_.insert(quote.id_, p);
+    order_.push_back(quote.id_);
+}
+
+bool MqlClientChannel::hasPending() const
+{
+    QMutexLocker g(&queueLock_);
+    return !order_.empty();
+}
+
+bool MqlClientChannel::takeFrame(QByteArray& frame, vector<qint64>& queued, vector<qint64>& received)
+{
+    QMutexLocker g(&queueLock_);
+    if( order_.empty() )
+        return false;
+
+    MqlFrameWriter symbols(MqlSymbolMapFrame);
+    MqlFrameWriter quotes(MqlQuotesFrame);
+    stats_.sent_ += order_.size();
+    while( !order_.empty() )
+    {
+        PendingT::iterator It = pending_.find(order_.front());
+        const MqlOutQuote& quote = It->quote_;
+        if( quote.id_ >= (quint32)announced_.size() )
+            announced_.resize(quote.id_ + 64);
+        if( !announced_.testBit(quote.id_) ) {
+            symbols.addSymbolId(quote.id_, quote.symbol_.constData(), quote.symbol_.size());
+            announced_.setBit(quote.id_);
+        }
+        quotes.addQuote(quote.id_, quote.bid_, quote.ask_, quote.serverTime_, quote.rxNanos_, quote.sequence_);
+        queued.push_back(It->queued_);
+        if( quote.rxNanos_ )
+            received.push_back(quote.rxNanos_);
+        pending_.erase(It);
+        order_.pop_front();
+    }
+
+    frame.clear();
+    if( !symbols.empty() )
+        frame = symbols.finish(++outSequence_);
+    frame.append(quotes.finish(++outSequence_));
+    return true;
+}
+
+MqlClientStats MqlClientChannel::stats() const
+{
+    QMutexLocker g(&queueLock_);
+    MqlClientStats out = stats_;
+    out.pending_ = order_.size();
+    out.lagMs_ = order_.empty() ? 0 : qint32((Global::nanotime() - pending_.value(order_.front()).queued_) / 1000000);
+    out.unsentBytes_ = 0;
+    return out;
+}
+
 /////////////////////////////////////////////////////////////////
 MqlProxyServer::MqlProxyServer(QObject* parent) 
-    : QLocalServer(parent)
+    : QLocalServer(parent),
+    clientsLock_("clientsLock_")
 {
 /*    if( localsocklog == NULL)
         localsocklog = fopen("lmax_srv.log", "wc+");
@@ -35,80 +122,136 @@ void MqlProxyServer::start()
 void MqlProxyServer::stop()
 {
     dbgInfo("MqlProxyServer::stop...");
-    { QMutexLocker g(&clientsLock_); }
+    { DMutexLocker g(&clientsLock_, LOCK_SITE); }
     close();
 //    dbgInfo("MqlProxyServer::stop end");
 }
 
-void MqlProxyServer::sendMessageBroadcast(const char* message)
+void MqlProxyServer::broadcastQuote(const string& symbol, MqlOutQuote& quote)
 {
-    //dbgInfo("MqlProxyServer::sendMessageBroadcast...");
-
-    QMutexLocker g(&clientsLock_);
-    if( clients_.empty() ) {
-        dbgInfo("MqlProxyServer::sendMessageBroadcast no clients");
+    // called from FIX thread: only queueing here, pipes are written by server's event loop
+    // so that a slow MQL client never delays the feed and other clients
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
+    if( clients_.empty() )
         return;
-    }
-
-    MqlProxyQuotes* transaction = (MqlProxyQuotes*)message;
 
-/*    if( transaction->numOfQuotes_ > 1 )
-    {
-        string names;
-        for(int i = 0; i < transaction->numOfQuotes_; i++ ) 
-            names += "\"" + string(transaction->quotes_[i].symbol_) + "\"" + string(i == transaction->numOfQuotes_-1 ? "" : ", ");
-        CDebug(false) << QString("to %1 MQL clients: ").arg(clients_.size()) << names.c_str(); 
-    }
-*/
-    vector<QLocalSocket*> writers;
+    vector<MqlClientChannelPtr> channels;
     ChannelsT::iterator It = clients_.begin();
-    qint32 transSize = 2 + transaction->numOfQuotes_*sizeof(transaction->quotes_[0]);
     for(; It != clients_.end(); ++It)
-        writers.push_back(It.key());
+        channels.push_back(It.value());
     g.unlock();
 
-    for(quint32 i = 0; i < writers.size(); i++) {
-        qint32 written = static_cast<qint32>( writers[i]->write(message, transSize) );
-        if( written != transSize ) {
-            logSocketError((QAbstractSocket::SocketError)(*It)->error());
-            continue;
-        }
-//        CDebug(false) << "a broadcast sent sucessfully";
-    }
-//    dbgInfo("MqlProxyServer::sendMessageBroadcast end");
+    assignId(quote, symbol);
+    for(quint32 i = 0; i < channels.size(); i++)
+        channels[i]->enqueue(quote);
+    scheduleDrain();
 }
 
-void MqlProxyServer::sendMessage(const char* message, QLocalSocket* cnt)
+void MqlProxyServer::sendQuote(QLocalSocket* cnt, const string& symbol, MqlOutQuote& quote)
 {
-//    dbgInfo("MqlProxyServer::sendMessage...");
-
-    QLocalSocket* writer = NULL;
-    QMutexLocker g(&clientsLock_);
+    MqlClientChannelPtr channel;
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
     ChannelsT::Iterator It = clients_.begin();
     for(; It != clients_.end(); ++It)
-        if( It.key() == cnt || It.value() == cnt ) {
-            writer = It.key();
+        if( It.key() == cnt || It.value()->reader_ == cnt ) {
+            channel = It.value();
             break;
         }
-    if(writer == NULL) {
-        dbgInfo("MqlProxyServer::sendMessage client pipe writer not found");
+    if( channel.isNull() ) {
+        dbgInfo("MqlProxyServer::sendQuote client pipe writer not found");
         return;
     }
     g.unlock();
 
-    MqlProxyQuotes* transaction = (MqlProxyQuotes*)message;
+    assignId(quote, symbol);
+    channel->enqueue(quote);
+    scheduleDrain();
+}
+
+void MqlProxyServer::assignId(MqlOutQuote& quote, const string& symbol)
+{
+    quote.symbol_ = QByteArray(symbol.data(), symbol.size());
+
+    QMutexLocker g(&symbolsLock_);
+    SymbolIdsT::iterator It = symbolIds_.find(quote.symbol_);
+    if( It == symbolIds_.end() )
+        It = symbolIds_.insert(quote.symbol_, symbolIds_.size());
+    quote.id_ = It.value();
+}
+
+void MqlProxyServer::scheduleDrain()
+{
+    // one pending drain event is enough for any number of enqueued quotes
+    if( drainScheduled_.testAndSetOrdered(0, 1) )
+        QMetaObject::invokeMethod(this, "onDrain", Qt::QueuedConnection);
+}
+
+void MqlProxyServer::onDrain()
+{
+    drainScheduled_.fetchAndStoreOrdered(0);
+
+    vector<MqlClientChannelPtr> channels;
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
+    ChannelsT::iterator It = clients_.begin();
+    for(; It != clients_.end(); ++It)
+        channels.push_back(It.value());
+    g.unlock();
+
+    for(quint32 i = 0; i < channels.size(); i++)
+        drain(channels[i]);
+}
+
+void MqlProxyServer::onBytesWritten(qint64)
+{
+    // pipe buffer of a slow client was released, continue with its queue
+    QLocalSocket* cnt = qobject_cast<QLocalSocket*>(sender());
+    if( cnt == NULL )
+        return;
+
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
+    ChannelsT::iterator It = clients_.find(cnt);
+    if( It == clients_.end() )
+        return;
+    MqlClientChannelPtr channel = It.value();
+    g.unlock();
+
+    drain(channel);
+}
 
-/*    string names;
-    for(int i = 0; i < transaction->numOfQuotes_; i++ ) 
-        names += "\"" + string(transaction->quotes_[i].symbol_) + "\"" + string(i == transaction->numOfQuotes_-1 ? "" : ", ");
-    CDebug(false) << "to MQL client: %s" << names.c_str(); 
-*/
-    qint32 transSize = 2 + transaction->numOfQuotes_*sizeof(transaction->quotes_[0]);
-    qint32 written = static_cast<qint32>(writer->write(message, transSize));
-    if( written != transSize )
+void MqlProxyServer::drain(const MqlClientChannelPtr& channel)
+{
+    QLocalSocket* writer = channel->writer_;
+    if( writer->bytesToWrite() >= MQL_CLIENT_HIGH_WATERMARK )
+        return;
+
+    QByteArray frame;
+    vector<qint64> queued, received;
+    if( !channel->takeFrame(frame, queued, received) )
+        return;
+
+    qint32 written = static_cast<qint32>( writer->write(frame) );
+    if( written != frame.size() ) {
         logSocketError((QAbstractSocket::SocketError)writer->error());
+        return;
+    }
 
-//    dbgInfo("MqlProxyServer::sendMessage end");
+    qint64 now = Global::nanotime();
+    for(quint32 i = 0; i < queued.size(); i++)
+        LatencyRecorder::record(LatencyRecorder::PublishToPipe, now - queued[i]);
+    for(quint32 i = 0; i < received.size(); i++)
+        LatencyRecorder::record(LatencyRecorder::WireToPipe, now - received[i]);
+}
+
+void MqlProxyServer::clientStats(QVector<MqlClientStats>& out)
+{
+    out.clear();
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
+    ChannelsT::iterator It = clients_.begin();
+    for(; It != clients_.end(); ++It) {
+        MqlClientStats st = It.value()->stats();
+        st.unsentBytes_ = It.key()->bytesToWrite();
+        out.push_back(st);
+    }
 }
 
 void MqlProxyServer::onNewConnection()
@@ -120,11 +263,11 @@ void MqlProxyServer::onNewConnection()
         QLocalSocket* cnt = nextPendingConnection();
         if( cnt )
         {
-            QMutexLocker g(&clientsLock_);
+            DMutexLocker g(&clientsLock_, LOCK_SITE);
             ChannelsT::iterator It = clients_.begin();
             // searching for incoming client's reader channel
             for(; It != clients_.end(); ++It) 
-                if( It.value() == NULL)
+                if( It.value()->reader_ == NULL)
                     break;
 
             // assign it as server pipe writer
@@ -132,7 +275,8 @@ void MqlProxyServer::onNewConnection()
             {
                 dbgInfo("New MQL client is connected");
                 QObject::connect(cnt, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-                clients_.insert(cnt, NULL);
+                QObject::connect(cnt, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
+                clients_.insert(cnt, MqlClientChannelPtr(new MqlClientChannel(cnt)));
                 g.unlock();
 
                 // we notice NetworkManager immediatedly about writer because adapter should send syncronization transaction to MQL
@@ -145,8 +289,7 @@ void MqlProxyServer::onNewConnection()
                 // assign it as server pipe reader
                 QObject::connect(cnt, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
                 QObject::connect(cnt, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-                clients_[It.key()] = cnt;
-                cnt->setReadBufferSize(MqlProxySymbols::maxProxyClientBufferSize());
+                It.value()->reader_ = cnt;
             }
         }
     }
@@ -163,20 +306,30 @@ void MqlProxyServer::onDisconnected()
         return;
     }
 
-    QMutexLocker g(&clientsLock_); 
+    MqlClientChannelPtr channel;
+    DMutexLocker g(&clientsLock_, LOCK_SITE); 
     ChannelsT::iterator It = clients_.begin();
     for(; It != clients_.end(); ++It )
         if( It.key() == cnt) {
             dbgInfo("MQL pipe reader is disconnected");
+            channel = It.value();
             clients_.erase(It);
             break;
         }
-        else if( It.value() == cnt )
+        else if( It.value()->reader_ == cnt )
         {
             dbgInfo("MQL pipe writer is disconnected");
+            channel = It.value();
             clients_.erase(It);
             break;
         }
+    g.unlock();
+
+    if( !channel.isNull() ) {
+        MqlClientStats st = channel->stats();
+        CDebug() << QString("MQL client queue: %1 sent, %2 conflated, %3 dropped, %4 pending")
+            .arg(st.sent_).arg(st.conflated_).arg(st.dropped_).arg(st.pending_);
+    }
 }
 
 void MqlProxyServer::onReadyRead()
@@ -199,23 +352,50 @@ void MqlProxyServer::onReadyRead()
     // so we may receive onReadyRead() twice for one message
     // solve it by skipping server writer notification
 
-    bool found = false;
-    QMutexLocker g(&clientsLock_);
+    MqlClientChannelPtr channel;
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
     ChannelsT::Iterator It = clients_.begin();
     for(; It != clients_.end(); ++It) 
-        if( It.value() == cnt && (found = true) ) {
-//            dbgInfo("Pipe reader found for client");
+        if( It.value()->reader_ == cnt ) {
+            channel = It.value();
             break;
         }
     g.unlock();
-    if( found )
-        emit notifyReadyRead(cnt);
+    if( channel.isNull() )
+        return;
+
+    // frames are decoded straight from the read buffer, decoder keeps a split frame only
+    QByteArray data = cnt->readAll();
+    MqlFrameDecoder& decoder = channel->decoder_;
+    decoder.feed(data.constData(), data.size());
+
+    MqlFrame frame;
+    QStringList symbols;
+    while( decoder.next(&frame) )
+    {
+        if( frame.header_.type_ != MqlSymbolsFrame )
+            continue;
+
+        MqlRecordReader records(frame);
+        const char* sym;
+        quint16 length;
+        while( records.readSymbol(&sym, &length) )
+            symbols.push_back(QString::fromLatin1(sym, length));
+    }
+    if( decoder.hasError() ) {
+        dbgInfo("MqlProxyServer::onReadyRead invalid frame received, client is disconnected");
+        cnt->abort();
+        return;
+    }
+
+    if( !symbols.empty() )
+        emit notifySymbols(cnt, symbols);
 //    dbgInfo("MqlProxyServer::onReadyRead end");
 }
 
 qint8 MqlProxyServer::numberOfConnected()
 {
-    QMutexLocker g(&clientsLock_);
+    DMutexLocker g(&clientsLock_, LOCK_SITE);
     return clients_.size();
 }
 
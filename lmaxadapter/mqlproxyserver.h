@@ -1,10 +1,101 @@
 #ifndef __mqlproxyserver_h__
 #define __mqlproxyserver_h__
 
+#include "mqlprotocol.h"
+#include "rwlock-dbg.h"
+
 #include <QtNetwork/qlocalsocket.h>
 #include <QtNetwork/qlocalserver.h>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QMutex>
+#include <QVector>
+#include <QBitArray>
+#include <QHash>
 #include <QMap>
 
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////
+// Maximum of distinct symbols which may wait in a client queue,
+// the oldest symbol is dropped when the limit is reached
+#define MQL_CLIENT_QUEUE_LIMIT      1024
+
+// Client is treated as slow when the pipe has so many bytes unsent,
+// queue draining is paused until the pipe buffer will be released
+#define MQL_CLIENT_HIGH_WATERMARK   (64*1024)
+
+/////////////////////////////////////////////////////////////////
+struct MqlClientStats
+{
+    quint64 enqueued_;      // quotes accepted to the queue
+    quint64 sent_;          // quotes written to the pipe
+    quint64 conflated_;     // quotes replaced by a newer quote for the same symbol
+    quint64 dropped_;       // quotes dropped by queue overflow
+    qint32  pending_;       // symbols waiting in the queue
+    qint32  lagMs_;         // age of the oldest waiting quote
+    qint64  unsentBytes_;   // bytes waiting in the pipe buffer
+};
+
+/////////////////////////////////////////////////////////////////
+// Quote prepared once for all clients
+struct MqlOutQuote
+{
+    quint32    id_;         // symbol id registered by the server
+    QByteArray symbol_;
+    double     bid_;
+    double     ask_;
+    qint64     serverTime_; // SendingTime(52), msecs since epoch
+    qint64     rxNanos_;    // adapter receive time, monotonic nsecs
+    quint32    sequence_;   // per-instrument sequence
+
+    MqlOutQuote()
+        : id_(0), bid_(0), ask_(0), serverTime_(0), rxNanos_(0), sequence_(0)
+    {}
+};
+
+/////////////////////////////////////////////////////////////////
+// Per-client bounded outbound queue.
+// Producer (FIX thread) replaces a waiting quote by the latest one for the same symbol,
+// consumer (server's event loop) writes only when the client pipe is not overfilled
+class MqlClientChannel
+{
+public:
+    MqlClientChannel(QLocalSocket* writer);
+
+    void enqueue(const MqlOutQuote& quote);
+    bool hasPending() const;
+
+    // Takes all waiting quotes as one frame preceded by ids of symbols
+    // not announced to the client yet, returns false when nothing to send
+    // queued gets the queueing times of the taken quotes, received
+    // the receive times of those having one
+    bool takeFrame(QByteArray& frame, std::vector<qint64>& queued, std::vector<qint64>& received);
+
+    MqlClientStats stats() const;
+
+    QLocalSocket* writer_;
+    QLocalSocket* reader_;
+    MqlFrameDecoder decoder_;
+
+private:
+    struct Pending {
+        MqlOutQuote quote_;
+        qint64      queued_;    // monotonic nsecs
+    };
+    typedef QHash<quint32,Pending> PendingT;
+
+    PendingT            pending_;
+    QList<quint32>      order_;
+    QBitArray           announced_;
+    mutable QMutex      queueLock_;
+    MqlClientStats      stats_;
+    quint32             outSequence_;
+};
+
+typedef QSharedPointer<MqlClientChannel> MqlClientChannelPtr;
+
 /////////////////////////////////////////////////////////////////
 class MqlProxyServer: public QLocalServer
 {
@@ -14,31 +105,46 @@ public:
     ~MqlProxyServer();
 
     void  start();
-    void  sendMessageBroadcast(const char* transaction);
-    void  sendMessage(const char* transaction, QLocalSocket* cnt);
+    // Quote prices and times are set by caller, symbol id is assigned here
+    void  broadcastQuote(const std::string& symbol, MqlOutQuote& quote);
+    void  sendQuote(QLocalSocket* cnt, const std::string& symbol, MqlOutQuote& quote);
     qint8 numberOfConnected();
 
+    // Snapshot of per-client queue counters
+    void  clientStats(QVector<MqlClientStats>& out);
+
 Q_SIGNALS:
     void notifyNewConnection(QLocalSocket* cnt);
-    void notifyReadyRead(QLocalSocket* cnt);
+    void notifySymbols(QLocalSocket* cnt, const QStringList& symbols);
 
 protected slots:
     void onNewConnection();
     void onDisconnected();
     void onReadyRead();
+    void onBytesWritten(qint64 bytes);
+    void onDrain();
 
 protected:
     void stop();
 
 private:
+    void assignId(MqlOutQuote& quote, const std::string& symbol);
+    void scheduleDrain();
+    void drain(const MqlClientChannelPtr& channel);
     void dbgInfo(const std::string& info);
     void logSocketError(QAbstractSocket::SocketError code);
 
     // Each client using channels pair: first - reading, second - writing
     // Client's reading channel is connective so channel for server writing used as a key
-    typedef QMap<QLocalSocket*,QLocalSocket*> ChannelsT;
+    typedef QMap<QLocalSocket*,MqlClientChannelPtr> ChannelsT;
     ChannelsT clients_;
-    QMutex clientsLock_;
+    MutexDbg clientsLock_;
+    QAtomicInt drainScheduled_;
+
+    // Symbol ids are never reused while the server lives
+    typedef QHash<QByteArray,quint32> SymbolIdsT;
+    SymbolIdsT symbolIds_;
+    QMutex symbolsLock_;
 };
 
 #endif // __mqlproxyserver_h__
@@ -0,0 +1,100 @@
+#include "nanohistogram.h"
+
+#define SUB_BUCKET_BITS     5
+#define SUB_BUCKETS         (1 << SUB_BUCKET_BITS)
+#define BUCKET_COUNT        ((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+////////////////////////////////////////////////////////////////////////////////
+NanoHistogram::NanoHistogram()
+    : buckets_(BUCKET_COUNT, 0),
+    count_(0),
+    min_(0),
+    max_(0),
+    sum_(0),
+    negative_(0)
+{
+}
+
+quint32 NanoHistogram::bucketCount()
+{
+    return BUCKET_COUNT;
+}
+
+quint32 NanoHistogram::bucketOf(quint64 nanos)
+{
+    if( nanos < SUB_BUCKETS )
+        return (quint32)nanos;
+
+    quint32 exponent = 0;
+    for(quint64 v = nanos; v >>= 1; )
+        ++exponent;
+    quint32 shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (quint32)((nanos >> shift) & (SUB_BUCKETS - 1));
+}
+
+quint64 NanoHistogram::upperBound(quint32 bucket)
+{
+    if( bucket < SUB_BUCKETS )
+        return bucket;
+
+    quint32 shift = bucket / SUB_BUCKETS - 1;
+    quint64 lower = quint64(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + (quint64(1) << shift) - 1;
+}
+
+void NanoHistogram::record(qint64 nanos)
+{
+    if( nanos < 0 ) {
+        ++negative_;
+        return;
+    }
+
+    ++buckets_[bucketOf(nanos)];
+    if( count_ == 0 || nanos < min_ )
+        min_ = nanos;
+    if( nanos > max_ )
+        max_ = nanos;
+    sum_ += nanos;
+    ++count_;
+}
+
+void NanoHistogram::merge(const NanoHistogram& other)
+{
+    negative_ += other.negative_;
+    if( other.count_ == 0 )
+        return;
+
+    for(quint32 i = 0; i < buckets_.size(); i++)
+        buckets_[i] += other.buckets_[i];
+    if( count_ == 0 || other.min_ < min_ )
+        min_ = other.min_;
+    if( other.max_ > max_ )
+        max_ = other.max_;
+    sum_ += other.sum_;
+    count_ += other.count_;
+}
+
+void NanoHistogram::reset()
+{
+    buckets_.assign(buckets_.size(), 0);
+    count_ = negative_ = 0;
+    min_ = max_ = sum_ = 0;
+}
+
+qint64 NanoHistogram::percentile(double quantile) const
+{
+    if( count_ == 0 )
+        return 0;
+
+    quint64 rank = (quint64)(quantile * count_ + 0.5);
+    if( rank == 0 )
+        rank = 1;
+
+    quint64 seen = 0;
+    for(quint32 i = 0; i < buckets_.size(); i++) {
+        seen += buckets_[i];
+        if( seen >= rank )
+            return qMin((qint64)upperBound(i), max_);
+    }
+    return max_;
+}
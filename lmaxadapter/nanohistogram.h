@@ -0,0 +1,46 @@
+#ifndef __nanohistogram_h__
+#define __nanohistogram_h__
+
+#include <QtGlobal>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Log-linear histogram of nanosecs: 32 sub-buckets per power of two,
+// the relative error of reported values is below 3%. Negative deltas are
+// counted apart, they point to stamps of unsynchronized clocks. Shared by
+// the adapter stages and the benchmark client
+class NanoHistogram
+{
+    friend class ThreadHistogram;
+public:
+    NanoHistogram();
+
+    void record(qint64 nanos);
+    void merge(const NanoHistogram& other);
+    void reset();
+
+    // Upper bound of the bucket containing the given quantile (0..1)
+    qint64 percentile(double quantile) const;
+
+    inline quint64 count() const { return count_; }
+    inline qint64  min() const { return count_ ? min_ : 0; }
+    inline qint64  max() const { return max_; }
+    inline qint64  sum() const { return sum_; }
+    inline double  mean() const { return count_ ? double(sum_)/count_ : 0; }
+    inline quint64 negative() const { return negative_; }
+
+    static quint32 bucketCount();
+    static quint32 bucketOf(quint64 nanos);
+
+private:
+    static quint64 upperBound(quint32 bucket);
+
+    std::vector<quint64> buckets_;
+    quint64 count_;
+    qint64  min_;
+    qint64  max_;
+    qint64  sum_;
+    quint64 negative_;
+};
+
+#endif // __nanohistogram_h__
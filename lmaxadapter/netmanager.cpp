@@ -1,43 +1,75 @@
 #include "globals.h"
 #include "netmanager.h"
 
-#include "quotestablemodel.h"
-#include "maindialog.h"
+#include "servicemodel.h"
 #include "scheduler.h"
-#include "sslclient.h"
+#include "fixtransport.h"
 #include "fixlogger.h"
 #include "mqlproxyserver.h"
+#include "fixreplay.h"
+#include "standbysession.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
+#include "rwlock-dbg.h"
 
 #include <QMutex>
-#include <QtWidgets>
+#include <QTimer>
 #include <QSslSocket>
+#ifndef LMAX_HEADLESS
+#include "quotestablemodel.h"
+#include <QWidget>
+#endif
 
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
 
 using namespace std;
 
 ////////////////////////////////////////////////////////
-NetworkManager::NetworkManager(QWidget* parent) 
+NetworkManager::NetworkManager(QObject* parent, bool headless) 
     : QObject(parent),
+    tableModel_(NULL),
+    probeLeft_(0),
+    probeSent_(0),
+    latencyTimer_(new QTimer(this)),
+    latencyMerges_(0),
+    metrics_(NULL),
+    sendLock_(new QMutex(QMutex::Recursive)),
     stateLock_(new QMutex()),
     state_(Initial)
 {
     if( !QSslSocket::supportsSsl() ) {
-        QMessageBox::information(NULL, "SSL", "OpenSSL libraries not found!");
-        throw std::exception();
+        CDebug() << "Error: OpenSSL libraries not found";
+        throw std::runtime_error("OpenSSL libraries not found!");
     }
 
     mqlProxy_.reset(new MqlProxyServer(parent));
     mqlProxy_->start();
     QObject::connect(mqlProxy_.data(), SIGNAL(notifyNewConnection(QLocalSocket*)), this, SLOT(onMqlConnected(QLocalSocket*)));
-    QObject::connect(mqlProxy_.data(), SIGNAL(notifyReadyRead(QLocalSocket*)), this, SLOT(onMqlReadyRead(QLocalSocket*)));
+    QObject::connect(mqlProxy_.data(), SIGNAL(notifySymbols(QLocalSocket*,const QStringList&)), this, SLOT(onMqlSymbols(QLocalSocket*,const QStringList&)));
 
-    model_.reset(new QuotesTableModel(mqlProxy_, parent));
+    model_.reset(new ServiceModel(mqlProxy_, parent));
     scheduler_.reset( new Scheduler(this) );
 
+#ifndef LMAX_HEADLESS
+    // the quotes table observes the core and the drained quote updates
+    if( !headless ) {
+        tableModel_ = new QuotesTableModel(model(), this);
+        scheduler_->setUpdatesObserved(true);
+        QObject::connect( scheduler(), SIGNAL(notifyInstrumentUpdate(Instrument)),
+                          tableModel_, SLOT(onInstrumentUpdate(Instrument)) );
+        QObject::connect( scheduler(), SIGNAL(notifyInstrumentsUpdate()),
+                          tableModel_, SLOT(onInstrumentUpdate()) );
+    }
+#else
+    Q_UNUSED(headless);
+#endif
+
     QObject::connect( model(), SIGNAL(activateRequest(Instrument)), 
                       scheduler(), SLOT(activateRequest(Instrument)) );
+    QObject::connect( model(), SIGNAL(activateRequests(QVector<Instrument>)), 
+                      scheduler(), SLOT(activateRequests(QVector<Instrument>)) );
     QObject::connect( model(), SIGNAL(unsubscribeImmediate(Instrument)),
                       this, SLOT(onHaveToUnSubscribe(Instrument)) );
     QObject::connect( model(), SIGNAL(activateResponse(Instrument)), 
@@ -46,16 +78,44 @@ NetworkManager::NetworkManager(QWidget* parent)
                       parent, SLOT(onStateChanged(quint8, QString)) );
     QObject::connect( model(), SIGNAL(notifyServerLogout(QString)), 
                       this, SLOT(onServerLogout(QString)) );
+    QObject::connect( model(), SIGNAL(notifySendingManual(QByteArray)), 
+                      scheduler(), SLOT(activateManual(QByteArray)) );
+
+    latencyTimer_->setInterval(LATENCY_MERGE_PERIOD);
+    QObject::connect(latencyTimer_, SIGNAL(timeout()), this, SLOT(onLatencyMerge()));
+    latencyTimer_->start();
+
+    metrics_ = new MetricsServer(this);
+    metrics_->start(model_->value(MetricsPortParam).toInt());
 }
 
 NetworkManager::~NetworkManager()
 {
+    // the scheduler and standby timers run on the wheel thread and reach
+    // the model and the locks, no callback may run past this point
+    scheduler_->wheel()->stop();
+
+    if( replay_ ) {
+        replay_->stop();
+        replay_->wait();
+    }
     if(model_->loggedIn())
         stop();
 
+    // the receiving threads are joined before the locks are gone
+    standby_.reset();
+    connection_.reset();
+
     { QMutexLocker g(stateLock_); }
     delete stateLock_;
     stateLock_ = NULL;
+    delete sendLock_;
+    sendLock_ = NULL;
+}
+
+QuotesTableModel* NetworkManager::tableModel()
+{
+    return tableModel_;
 }
 
 void NetworkManager::start()
@@ -87,22 +147,118 @@ void NetworkManager::start()
     else if( proto == ProtoTLSv1_SSLv3 )
         ssnproto = QSsl::TlsV1SslV3; 
 
-    connection_.reset(new SslClient(ssnproto, this));
-    connection_->establish(model_->value(ServerParam), 443);
+    bool encrypted = (proto != ProtoPlainTCP);
+    if( !encrypted )
+        CDebug() << "Warning: FIX session is not encrypted (" << proto << ")";
 
-    QObject::connect( model(), SIGNAL(notifySendingManual(QByteArray)), 
-                      this, SLOT(onHaveToSendMessage(QByteArray)) );
+    quint16 port = model_->value(ServerPortParam).toUShort();
+    if( port == 0 )
+        port = 443;
+
+    scheduler_->configurePacing(model_->value(MessageRateParam).toInt(), 
+                                model_->value(MessageBurstParam).toInt());
+
+    qint32 transport = FixTransport::available(model_->value(TransportParam).toInt());
+    SocketProfile profile;
+    profile.level_ = model_->value(LatencyProfileParam).toInt();
+    profile.buffer_ = model_->value(SocketBufferParam).toInt();
+    profile.cpu_ = model_->value(SpinCpuParam).toInt();
+
+    // the thread and the socket of the dropped connection are reused
+    if( !connection_ || connection_->stats().kind_ != transport || !(connection_->profile() == profile) ||
+        !connection_->reconnect(ssnproto, model_->value(ServerParam), port, encrypted) ) 
+    {
+        connection_.reset();
+        connection_.reset(FixTransport::create(transport, ssnproto, this));
+        connection_->setProfile(profile);
+        connection_->establish(model_->value(ServerParam), port, encrypted);
+    }
+
+    // the standby session keeps running over reconnects of the primary one
+    QString standbyHost = model_->value(StandbyServerParam);
+    if( !standbyHost.isEmpty() && !standby_ ) {
+        quint16 standbyPort = model_->value(StandbyPortParam).toUShort();
+        standby_.reset(new StandbySession(model(), scheduler(), this));
+        standby_->start(standbyHost, standbyPort ? standbyPort : port, ssnproto, encrypted);
+    }
 }
 
 void NetworkManager::stop()
 {
+    if( replay_ && replay_->isRunning() ) {
+        replay_->stop();
+        return;
+    }
+
     {
         QMutexLocker g(stateLock_);
         state_ = ForcedClosingState;
     }
 
+    standby_.reset();
     onHaveToLogout();
     connection_.reset();
+
+    LatencyRecorder::merge();
+    QString latency = LatencyRecorder::report();
+    if( !latency.isEmpty() )
+        CDebug() << "Market data latency of the session:\n" << latency;
+
+    // empty unless built with LMAX_LOCK_PROFILE
+    QString locks = LockProfiler::report();
+    if( !locks.isEmpty() )
+        CDebug() << "Lock contention since the start:\n" << locks;
+}
+
+bool NetworkManager::replay(const QString& filename, double speed, const QString& reportFile)
+{
+    if( replay_ && replay_->isRunning() )
+        return false;
+
+    replay_.reset(new FixReplay(model(), filename, speed, this));
+    QString error;
+    if( !replay_->load(&error) ) {
+        CDebug() << "Replay: " << error;
+        emit notifyStateChanged(ForcedClosingState, error);
+        replay_.reset();
+        return false;
+    }
+
+    // the recorded instruments are served as subscribed, no requests are sent offline
+    scheduler_->setReconnectEnabled(false);
+    const QList<Instrument>& instruments = replay_->instruments();
+    for(qint32 i = 0; i < instruments.size(); ++i)
+    {
+        const Instrument& inst = instruments[i];
+        qint32 code = model_->getCode(inst.first.c_str());
+        if( code == -1 && model_->getSymbol(inst.second) == NULL )
+            model_->instrumentCommit(inst, false);
+        else if( code != inst.second ) {
+            CDebug() << "Replay: \"" << inst.first.c_str() << ":" << inst.second 
+                     << "\" conflicts with the configured instruments, its quotes are ignored";
+            continue;
+        }
+        model_->setMonitoring(inst, true, false);
+        model_->makeSubscribe(inst);
+    }
+
+    replayReport_ = reportFile;
+    QObject::connect(replay_.data(), SIGNAL(finished()), this, SLOT(onReplayFinished()));
+    replay_->start();
+
+    emit notifyStateChanged(EstablishState, "Replay of " + filename);
+    return true;
+}
+
+void NetworkManager::onReplayFinished()
+{
+    QString report = replay_->report();
+    CDebug() << "Replay finished:\n" << report;
+    if( !replayReport_.isEmpty() )
+        replay_->writeReport(replayReport_);
+
+    emit notifyStateChanged(ForcedClosingState, report.section('\n', 2, 2));
+    emit notifyReplayFinished(report);
 }
 
 void NetworkManager::reconnect()
@@ -180,9 +336,8 @@ void NetworkManager::onStateChanged(ConnectionState state)
 
 void NetworkManager::onServerLogout(const QString& reason)
 {
-    MainDialog* md = qobject_cast<MainDialog*>(parent());
-    if(md)
-        emit md->onReconnectSetCheck(false);
+    if( parent() )
+        QMetaObject::invokeMethod(parent(), "onReconnectSetCheck", Q_ARG(bool, false));
     scheduler_->setReconnectEnabled(false);
     state_ = ForcedClosing;
     emit notifyStateChanged(ForcedClosing, reason);
@@ -194,90 +349,128 @@ RequestHandler::ConnectionState NetworkManager::getState() const
     return state_;
 }
 
+bool NetworkManager::connectionStats(TransportStats& out) const
+{
+    if( connection_.isNull() )
+        return false;
+    out = connection_->stats();
+    return true;
+}
+
+void NetworkManager::startProbe(qint32 count)
+{
+    probeRtts_.clear();
+    probeRtts_.reserve(count);
+    probeLeft_ = count;
+}
+
+void NetworkManager::sendProbe()
+{
+    probeId_ = "PROBE" + QByteArray::number(qint32(probeRtts_.size()));
+    probeSent_ = Global::nanotime();
+    QMutexLocker s(sendLock_);
+    onHaveToSendMessage( model_->makeTestRequest(probeId_.constData()) );
+}
+
+void NetworkManager::onProbeReply(const QByteArray& message)
+{
+    qint64 received = Global::nanotime();
+    if( FIX::getField(message,"35") != "0" || FIX::getField(message,"112") != probeId_.constData() )
+        return;
+
+    probeRtts_.push_back(received - probeSent_);
+    if( --probeLeft_ > 0 ) {
+        sendProbe();
+        return;
+    }
+
+    vector<qint64> sorted(probeRtts_);
+    sort(sorted.begin(), sorted.end());
+    TransportStats st;
+    connectionStats(st);
+
+    QString report = QString("Probe: %1 TestRequest round trips, Transport %2, LatencyProfile %3, "
+                             "nodelay %4, buffers %5/%6, busy poll %7 usecs, spin CPU %8, %9 receive stamps\n")
+                     .arg(sorted.size()).arg(st.kind_).arg(st.level_).arg(st.noDelay_)
+                     .arg(st.recvBuffer_).arg(st.sendBuffer_).arg(st.busyPoll_).arg(st.spinCpu_)
+                     .arg(st.kernelStamps_ ? "kernel" : "read time");
+    report += QString("Connect %1 msecs, TLS handshake %2, %3 of %4 handshakes offered a cached session\n")
+              .arg(st.connectTime_)
+              .arg(st.handshakeTime_ < 0 ? QString("off") : QString("%1 msecs").arg(st.handshakeTime_))
+              .arg(st.resumeOffered_).arg(st.connects_);
+    report += "      min       p50       p99     p99.9       max (nsecs)\n";
+    report += QString("%1 %2 %3 %4 %5\n")
+              .arg(sorted.front(), 9)
+              .arg(sorted[sorted.size()/2], 9)
+              .arg(sorted[qMin(size_t(sorted.size()*0.99), sorted.size()-1)], 9)
+              .arg(sorted[qMin(size_t(sorted.size()*0.999), sorted.size()-1)], 9)
+              .arg(sorted.back(), 9);
+    LatencyRecorder::merge();
+    report += LatencyRecorder::report();
+    emit notifyProbeFinished(report);
+}
+
+void NetworkManager::onLatencyMerge()
+{
+    LatencyRecorder::merge();
+    if( ++latencyMerges_ < LATENCY_FILE_MERGES )
+        return;
+
+    latencyMerges_ = 0;
+    LatencyRecorder::writeReport(FILENAME_LATENCYSTATS);
+    LockProfiler::writeReport(FILENAME_LOCKPROFILE);
+}
+
 void NetworkManager::onMqlConnected(QLocalSocket* cnt)
 {
     QVector<string> allMonitored;
     model_->getSymbolsUnderMonitoring(allMonitored);
 
-    qint16 countOf = allMonitored.size();
-
-    // create transaction even with 0 monitoring instruments (mql client does a same)
-    // this is well to test the first connection and structures parsing
-    MqlProxyQuotes* transaction = (MqlProxyQuotes*)malloc(2 + countOf * sizeof(MqlProxyQuotes::Quote));
-    transaction->numOfQuotes_ = countOf;
-
     // retrive all snapshots which been subscribed before
-    QSharedPointer<QReadLocker> autolock; // autolock aquired inside getSnapshot only once 
-    for(qint16 i = 0; i < countOf; ++i) {
-        strcpy_s(transaction->quotes_[i].symbol_, MAX_SYMBOL_LENGTH,allMonitored[i].c_str());
+    QSharedPointer<DReadLocker> autolock; // autolock aquired inside getSnapshot only once 
+    for(qint32 i = 0; i < allMonitored.size(); ++i) {
+        MqlOutQuote quote;
         Snapshot* snap = model_->getSnapshot(allMonitored[i].c_str(), autolock);
         if(snap) {
             // copy quotes from snapshot into transaction structure
-            Global::reinterpretDouble(snap->ask_.toStdString().c_str(), &transaction->quotes_[i].ask_);
-            Global::reinterpretDouble(snap->bid_.toStdString().c_str(), &transaction->quotes_[i].bid_);
-        }
-        else {
-            transaction->quotes_[i].ask_ = 0;
-            transaction->quotes_[i].bid_ = 0;
+            Global::reinterpretDouble(snap->ask_.toStdString().c_str(), &quote.ask_);
+            Global::reinterpretDouble(snap->bid_.toStdString().c_str(), &quote.bid_);
+            quote.serverTime_ = snap->serverTime_;
+            quote.rxNanos_ = snap->rxNanos_;
+            quote.sequence_ = snap->updates_;
         }
+        mqlProxy_->sendQuote(cnt, allMonitored[i], quote);
     }
     autolock.reset();
-
-    mqlProxy_->sendMessage((const char*)transaction, cnt);
-    free(transaction); // don't need
 }
 
-void NetworkManager::onMqlReadyRead(QLocalSocket* cnt)
+void NetworkManager::onMqlSymbols(QLocalSocket* cnt, const QStringList& symbols)
 {
-//    CDebug() << "NetworkManager::onMqlReadyRead";
-    qint64 bytes = cnt->bytesAvailable();
-    if( bytes < 2 ) {
-        CDebug() << "Error: onMqlReadyRead received an empty data";
-        return;
-    }
-
-    char* buffer = (char*)malloc(bytes);
-    const char* ptr = buffer;
-    cnt->read((char*)buffer, bytes);
-
-    qint32 parsed = 0;
-    while( parsed < bytes )
+    for(int i = 0; i < symbols.size(); i++)
     {
-        const MqlProxySymbols* mqlPtr = (MqlProxySymbols*)ptr;
-        if(mqlPtr->numOfSymbols_ >= MAX_SYMBOLS ) 
-        {
-            CDebug() << "Error: onMqlReadyRead received an unexpected amount of symbols (" << mqlPtr->numOfSymbols_ << ")";
-            return;
+        string sym = symbols[i].toStdString();
+        qint32 code = model_->getCode(sym.c_str());
+        if( code == -1) {
+            CDebug() << "Error: onMqlSymbols received an unsupported symbol \"" << sym.c_str() << "\"";
+            continue;
         }
 
-        for(int i = 0; i < mqlPtr->numOfSymbols_; i++)
-        {
-            const char* sym = mqlPtr->symbols_[i];
-            qint32 code = model_->getCode(sym);
-            if( code == -1) {
-                CDebug() << "Error: onMqlReadyRead received an unsupported symbol \"" << sym << "\"";
-                continue;
-            }
-
-            Instrument inst(sym,code);
-            if( model_->isMonitored(inst) ) {
-                //CDebug() << "onMqlReadyRead skips symbol \"" << sym << "\" adding because it already monitored";
-                continue;
-            }
-
-            model_->setMonitoring(inst, true, false);
-            CDebug(false) << "symbol \"" << sym << "\" added to monitoring";
+        Instrument inst(sym,code);
+        if( model_->isMonitored(inst) ) {
+            //CDebug() << "onMqlSymbols skips symbol \"" << sym.c_str() << "\" adding because it already monitored";
+            continue;
         }
-        parsed += (2 + mqlPtr->numOfSymbols_*sizeof(mqlPtr->symbols_[0]));
-        ptr += (2 + mqlPtr->numOfSymbols_*sizeof(mqlPtr->symbols_[0]));
+
+        model_->setMonitoring(inst, true, false);
+        CDebug(false) << "symbol \"" << sym.c_str() << "\" added to monitoring";
     }
-    free(buffer);
 }
 
 void NetworkManager::onHaveToLogin()
 {
     if( model_->loggedIn() )
         return;
+    QMutexLocker s(sendLock_);
     onHaveToSendMessage( model_->makeLogon() );
 }
 
@@ -288,6 +481,7 @@ void NetworkManager::onHaveToLogout()
     if( !model_->loggedIn() )
         return;
 
+    QMutexLocker s(sendLock_);
     onHaveToSendMessage( model_->makeLogout() );
     model_->setLoggedIn(false);
 }
@@ -299,11 +493,12 @@ void NetworkManager::onHaveToTestRequest()
 
     int hbi = model_->getHeartbeatInterval() + 1000;
 
-    int delta = Global::time() - model_->getLastIncoming();
+    qint64 delta = Global::time() - model_->getLastIncoming();
     if( delta >= hbi )
     {
         if( !model_->testRequestSent() )
         {
+            QMutexLocker s(sendLock_);
             onHaveToSendMessage( model_->makeTestRequest() );
         }
         else
@@ -316,7 +511,7 @@ void NetworkManager::onHaveToTestRequest()
     else 
         delta = hbi - delta;
 
-    scheduler_->activateTestrequest(delta);
+    scheduler_->activateTestrequest(qint32(delta));
 }
 
 void NetworkManager::onHaveToHeartbeat()
@@ -326,39 +521,65 @@ void NetworkManager::onHaveToHeartbeat()
 
     int hbi = model_->getHeartbeatInterval();
 
-    int delta = Global::time() - model_->getLastOutgoing();
+    qint64 delta = Global::time() - model_->getLastOutgoing();
     if( delta >= hbi )
     {
+        QMutexLocker s(sendLock_);
         onHaveToSendMessage( model_->makeHeartBeat() );
         delta = hbi;
     }
     else
         delta = hbi-delta;
 
-    scheduler_->activateHeartbeat(delta);
+    scheduler_->activateHeartbeat(qint32(delta));
 }
 
 void NetworkManager::onHaveToSubscribe(const Instrument& inst)
 {
-    QByteArray message = model_->makeSubscribe(inst);
-    if( !message.isNull() )
-        onHaveToSendMessage(message);
+    {
+        QMutexLocker s(sendLock_);
+        QByteArray message = model_->makeSubscribe(inst);
+        if( !message.isNull() )
+            onHaveToSendMessage(message);
+    }
+    if( standby_ )
+        standby_->subscribe(inst);
     model()->activateResponse(Instrument("FullUpdate",-1));
 }
 
 void NetworkManager::onHaveToUnSubscribe(const Instrument& inst)
 {
-    QByteArray message = model_->makeUnSubscribe(inst);
-    if( !message.isNull() )
-        onHaveToSendMessage(message);
+    {
+        QMutexLocker s(sendLock_);
+        QByteArray message = model_->makeUnSubscribe(inst);
+        if( !message.isNull() )
+            onHaveToSendMessage(message);
+    }
+    if( standby_ )
+        standby_->unsubscribe(inst);
     model()->activateResponse(Instrument("FullUpdate",-1));
 }
 
-void NetworkManager::onMessageReceived(const QByteArray& message)
+void NetworkManager::onMessageReceived(const QByteArray& message, qint64 rxNanos)
 {
-    int ret = model_->process(message);
+    bool wasLoggedIn = model_->loggedIn();
+    int ret = model_->process(message, rxNanos);
+
+    // Server Login
+    if( !wasLoggedIn && model_->loggedIn() ) {
+        scheduler_->activateLoggedIn(model_->getHeartbeatInterval());
+        if( probeLeft_ )
+            sendProbe();
+    }
+    else if( scheduler_->awaitingFirstTick() && FIX::getField(message,"35") == "W" )
+        scheduler_->recordFirstTick();
+    else if( probeLeft_ )
+        onProbeReply(message);
+
+    // the answers get MsgSeqNum when taken, under the send lock only
     if( ret > 0 ) 
     {
+        QMutexLocker s(sendLock_);
         QByteArray message;
         do {
             message.swap( model_->takeOutgoing() );
@@ -369,14 +590,18 @@ void NetworkManager::onMessageReceived(const QByteArray& message)
         }
         while( model_->loggedIn() );
     }
-    else if( ret == 1 ) // Server Login
+    else if( ret == -1 ) // Server Logout
     {
-        scheduler_->activateHeartbeat(model_->getHeartbeatInterval());
-        scheduler_->activateTestrequest(model_->getHeartbeatInterval());
+        scheduler_->activateLogout();
     }
-    else if( ret == -1 ) // Server Logout
+    else if( ret == -2 ) // MsgSeqNum too low, the session is dropped
     {
+        QMutexLocker s(sendLock_);
+        QByteArray logout = model_->takeOutgoing();
+        for(; !logout.isEmpty(); logout = model_->takeOutgoing())
+            onHaveToSendMessage(logout);
         scheduler_->activateLogout();
+        reconnect();
     }
 }
 
@@ -402,8 +627,9 @@ bool NetworkManager::onHaveToSendMessage(const QByteArray& message)
     case 'V': { 
             f262sym = FIX::getField(message,"262");
             f48code = model_->getCode( f262sym.c_str() );
-            char buf[10];
-            string insname = f262sym + ":" + string(ltoa(f48code, buf, 10));
+            char buf[12];
+            sprintf(buf, "%d", f48code);
+            string insname = f262sym + ":" + buf;
             info = "Market Request type=\"V\" for \"" + insname + "\" is sent";
             model_->storeRequestSeqnum(message, f262sym.c_str() );
         }
@@ -417,11 +643,21 @@ bool NetworkManager::onHaveToSendMessage(const QByteArray& message)
     case '1':
         info = "TestRequest type=\"1\" is sent";
         break;
+    case '2':
+        info = "ResendRequest type=\"2\" is sent";
+        break;
+    case '4':
+        info = "SequenceReset-GapFill type=\"4\" is sent";
+        break;
     default:
         return false;
     }
 
-    emit connection_->asyncSending(message);
+    QMutexLocker s(sendLock_);
+    scheduler_->pacer().consume();
+    model_->journalOutgoing(message);
+    connection_->send(message);
+    Metrics::messageOut(Metrics::Primary, type[0]);
     if( info != "skip" ) {
         CDebug() << QString::fromStdString(info);
         CDebug(false) << ">> " << message;
@@ -4,17 +4,25 @@
 #include "requesthandler.h"
 #include "marketabstractmodel.h"
 
-#include <QDialog>
+#include <QObject>
 #include <QMutex>
 
+#include <vector>
+
+class FixDataModel;
 class QuotesTableModel;
-class SslClient;
+class FixTransport;
 class Scheduler;
 class MqlProxyServer;
+class FixReplay;
+class StandbySession;
+class MetricsServer;
+struct TransportStats;
 
 QT_BEGIN_NAMESPACE;
 class QMutex;
 class QLocalSocket;
+class QTimer;
 QT_END_NAMESPACE;
 
 /////////////////////////////////////
@@ -24,32 +32,61 @@ class NetworkManager : public QObject, public RequestHandler
 
     friend class Scheduler;
 public:
-    NetworkManager(QWidget* parent);
+    // The parent observes notifyStateChanged by its onStateChanged slot and
+    // serves asyncStart of reconnects. Headless manager has no table model
+    NetworkManager(QObject* parent, bool headless = false);
     ~NetworkManager();
 
     void start();
     void stop();
+
+    // Feeds the market data of the FIX messages log instead of LMAX connection,
+    // speed 0 - as fast as possible, the report is written to reportFile at finish
+    bool replay(const QString& filename, double speed, const QString& reportFile);
     void reconnect();
     void onStateChanged(ConnectionState state);
     ConnectionState getState() const;
 
-    inline QuotesTableModel* model() 
+    // Connect and TLS handshake times of the primary connection, false when none
+    bool connectionStats(TransportStats& out) const;
+
+    // Round trips of count TestRequests sent one by one after logon, the latency
+    // of the socket profile to the local simulator. Reported by notifyProbeFinished
+    void startProbe(qint32 count);
+
+    inline FixDataModel* model() 
     { return model_.data(); }
 
+    // NULL when headless
+    QuotesTableModel* tableModel();
+
     inline Scheduler* scheduler() 
     { return scheduler_.data(); }
 
+    inline MqlProxyServer* mqlProxy()
+    { return mqlProxy_.data(); }
+
 Q_SIGNALS:
     void notifyStateChanged(quint8 state, const QString& reason);
+    void notifyReplayFinished(const QString& report);
+    void notifyProbeFinished(const QString& report);
 
 protected slots:
     void onServerLogout(const QString& reason);
     bool onHaveToSendMessage(const QByteArray& message);
     void onHaveToSubscribe(const Instrument& inst);
     void onHaveToUnSubscribe(const Instrument& inst);
-    void onMessageReceived(const QByteArray& message);
+    void onMessageReceived(const QByteArray& message, qint64 rxNanos);
     void onMqlConnected(QLocalSocket* cnt);
-    void onMqlReadyRead(QLocalSocket* cnt);
+    void onMqlSymbols(QLocalSocket* cnt, const QStringList& symbols);
+    void onReplayFinished();
+    // Merges the latency histograms of the threads, writes the stats file
+    // and the lock profile every LATENCY_FILE_MERGES merges
+    void onLatencyMerge();
+
+protected:
+    void sendProbe();
+    void onProbeReply(const QByteArray& message);
 
 protected:
     void onHaveToLogin();
@@ -59,11 +96,28 @@ protected:
 
 protected:
     QScopedPointer<Scheduler> scheduler_;
-    QScopedPointer<QuotesTableModel> model_;
-    QScopedPointer<SslClient>  connection_;
+    QScopedPointer<FixDataModel> model_;
+    QuotesTableModel* tableModel_;     // observer of model_, NULL when headless
+    QScopedPointer<FixTransport>  connection_;
+    QScopedPointer<StandbySession> standby_;   // NULL when not configured
     QSharedPointer<MqlProxyServer> mqlProxy_;
+    QScopedPointer<FixReplay>  replay_;
+    QString replayReport_;
+
+    QAtomicInt probeLeft_;
+    QByteArray probeId_;
+    qint64 probeSent_;
+    std::vector<qint64> probeRtts_;
+
+    QTimer* latencyTimer_;
+    qint32  latencyMerges_;
+    MetricsServer* metrics_;
 
 private:
+    // MsgSeqNum stamping, journaling and sending of the primary session in one
+    // step: the connection and the wheel threads send. Recursive, held from
+    // making of a message up to its sending
+    QMutex* sendLock_;
     QMutex* stateLock_;
     ConnectionState state_;
 };
@@ -1,19 +1,31 @@
 #include "globals.h"
 #include "quotestablemodel.h"
 #include "quotestableview.h"
-#include "mqlproxyserver.h"
+#include "fixdatamodel.h"
 
 #include <QtWidgets>
 
 static qint16 rows_before_view = 0;
 
 //////////////////////////////////////////////////////////////
-QuotesTableModel::QuotesTableModel(QSharedPointer<MqlProxyServer>& mqlProxy, QWidget* parent)
-    : FixDataModel(mqlProxy, parent)
+QuotesTableModel::QuotesTableModel(FixDataModel* core, QObject* parent)
+    : QAbstractTableModel(parent),
+    core_(core),
+    view_(NULL),
+    refresh_(new QTimer(this)),
+    dirtyLayout_(false),
+    statCpuStart_(0),
+    statUpdates_(0),
+    statRefreshes_(0),
+    statRows_(0)
 {
-    QObject::connect(this, SIGNAL(notifyInstrumentAdd(Instrument)), this, SLOT(onInstrumentAdd(Instrument)), Qt::DirectConnection);
-    QObject::connect(this, SIGNAL(notifyInstrumentRemove(Instrument,qint16)), this, SLOT(onInstrumentRemove(Instrument,qint16)), Qt::DirectConnection);
-    QObject::connect(this, SIGNAL(notifyInstrumentChange(Instrument,Instrument)), this, SLOT(onInstrumentChange(Instrument,Instrument)), Qt::DirectConnection);
+    refresh_->setSingleShot(true);
+    refresh_->setInterval(1000/GUI_REFRESH_RATE);
+    QObject::connect(refresh_, SIGNAL(timeout()), this, SLOT(onRefresh()));
+
+    // the core handles the cache and the subscriptions before the rows are changed
+    QObject::connect(core_, SIGNAL(notifyInstrumentAdd(Instrument)), this, SLOT(onInstrumentAdd(Instrument)), Qt::DirectConnection);
+    QObject::connect(core_, SIGNAL(notifyInstrumentRemove(Instrument,qint16)), this, SLOT(onInstrumentRemove(Instrument,qint16)), Qt::DirectConnection);
 }
 
 QuotesTableModel::~QuotesTableModel()
@@ -24,13 +36,13 @@ void QuotesTableModel::resetView(QuotesTableView* view)
     QMutexLocker g(&monitorLock_);
     view_ = view;
     monitored_.clear();
-    rows_before_view = monitoredCount();
+    rows_before_view = core_->monitoredCount();
 }
 
 int QuotesTableModel::rowCount(const QModelIndex& parent) const
 {
     Q_UNUSED(parent);
-    return monitoredCount();
+    return core_->monitoredCount();
 }
 
 int QuotesTableModel::columnCount(const QModelIndex& parent) const
@@ -48,7 +60,7 @@ QVariant QuotesTableModel::data(const QModelIndex& index, int role) const
     if( c == 0 ) {
         QMutexLocker g(&monitorLock_);
         if( monitored_.count() < rows_before_view ) {
-            Instrument ri = getByOrderRow(r);
+            Instrument ri = core_->getByOrderRow(r);
             monitored_.insert(ri.second, ri.first.c_str());
         }
         else if( monitored_.count() > rows_before_view )
@@ -58,14 +70,14 @@ QVariant QuotesTableModel::data(const QModelIndex& index, int role) const
     }
 
     if( c == 0 ) {
-        return getByOrderRow(r).second;
+        return core_->getByOrderRow(r).second;
     }
     else if( c == 1 )
-        return QString::fromStdString(getByOrderRow(r).first);
+        return QString::fromStdString(core_->getByOrderRow(r).first);
 
-    QSharedPointer<QReadLocker> autolock;
+    QSharedPointer<DReadLocker> autolock;
     std::string sym = QuotesTableModel::index(r,1).data().toString().toStdString();
-    const Snapshot* snapshot = getSnapshot(sym.c_str(), autolock);
+    const Snapshot* snapshot = core_->getSnapshot(sym.c_str(), autolock);
     if( snapshot == NULL )
         return QVariant();
 
@@ -77,7 +89,7 @@ QVariant QuotesTableModel::data(const QModelIndex& index, int role) const
         return snapshot->bid_;
     case 4:
         if( snapshot->statuscode_ != Snapshot::StatSubscribe )
-            return snapshot->requestTime_;
+            return QString::number(snapshot->requestTime_ / 1000000.0, 'f', 3);
         break;
     case 5:
         return snapshot->description_;
@@ -185,7 +197,7 @@ void QuotesTableModel::onInstrumentAdd(const Instrument& inst)
     if(It == monitored_.end()) 
     {
         if( row == -1) 
-            row = getOrderRow(qSym);
+            row = core_->getOrderRow(qSym);
 
         QModelIndex rowIndex = index(row, 0);
         monitored_.insert(inst.second, qSym);
@@ -197,7 +209,9 @@ void QuotesTableModel::onInstrumentAdd(const Instrument& inst)
     }
 
     setRowHeight(row);
-    view_->doItemsLayout();
+    // the rows below are shifted, the dirty ones are repainted by the layout
+    dirtyLayout_ = true;
+    scheduleRefresh();
 }
 
 void QuotesTableModel::onInstrumentRemove(const Instrument& inst, qint16 orderRow)
@@ -205,8 +219,6 @@ void QuotesTableModel::onInstrumentRemove(const Instrument& inst, qint16 orderRo
     QString qSym = inst.first.c_str();
     CDebug() << "QuotesTableModel::onInstrumentRemove: \"" + qSym + "\"";
 
-    removeCached( inst.second );
-
     QModelIndex prevIndex;
     if( orderRow == -1 ) {
         prevIndex = index(0,1);
@@ -234,50 +246,88 @@ void QuotesTableModel::onInstrumentRemove(const Instrument& inst, qint16 orderRo
     view_->clearSelection();
     view_->setCurrentIndex(prevIndex);
     view_->scrollTo(prevIndex, orderRow > 0 ? QAbstractItemView::PositionAtCenter : QAbstractItemView::PositionAtTop);
-    view_->doItemsLayout();
+    dirtyLayout_ = true;
+    scheduleRefresh();
+}
+
+void QuotesTableModel::onInstrumentUpdate()
+{
+    dirtyLayout_ = true;
+    scheduleRefresh();
 }
 
-void QuotesTableModel::onInstrumentChange(const Instrument& old, const Instrument& cur)
+void QuotesTableModel::onInstrumentUpdate(const Instrument& inst)
 {
-    QString oldSym  = old.first.c_str();
-    QString newSym  = cur.first.c_str();
-    qint32  oldCode = old.second;
-    qint32 newCode  = cur.second;
-
-    QString nameOld = "\"" + oldSym + ":" + QString("%1").arg(oldCode) + "\"";
-    QString nameNew = "\"" + newSym + ":" + QString("%1").arg(newCode) + "\"";
-    CDebug() << "QuotesTableModel::onInstrumentChange: " << nameOld << " --> " << nameNew;
-
-    if(oldCode != newCode)
-        setMonitoring(old, false, true);
-    else if( oldSym != newSym )
-        setMonitoring(cur, false, true);
-    else
+    int row = core_->getOrderRow(inst.first.c_str());
+    if( row < 0 )
         return;
 
-    setMonitoring(cur, true, true);
+    if( row >= dirtyRows_.size() )
+        dirtyRows_.resize(row + 1);
+    dirtyRows_.setBit(row);
+    ++statUpdates_;
+    scheduleRefresh();
 }
 
-void QuotesTableModel::onInstrumentUpdate()
+void QuotesTableModel::scheduleRefresh()
 {
-//    CDebug() << "onInstrumentUpdate layout all";
-    view_->doItemsLayout();
+    if( !refresh_->isActive() )
+        refresh_->start();
 }
 
-void QuotesTableModel::onInstrumentUpdate(const Instrument& inst)
+void QuotesTableModel::onRefresh()
+{
+    if( NULL == view_ )
+        return;
+
+    ++statRefreshes_;
+    if( dirtyLayout_ ) {
+        dirtyLayout_ = false;
+        dirtyRows_.fill(false);
+        view_->doItemsLayout();
+        reportRefreshStats();
+        return;
+    }
+
+    // Ask, Bid, Msecs and Status of the runs of dirty rows
+    qint32 rows = qMin(dirtyRows_.size(), rowCount(QModelIndex()));
+    for(qint32 first = 0; first < rows; ++first)
+    {
+        if( !dirtyRows_.testBit(first) )
+            continue;
+
+        qint32 last = first;
+        while( last + 1 < rows && dirtyRows_.testBit(last + 1) )
+            ++last;
+        emit dataChanged(index(first, 2), index(last, 5));
+        statRows_ += last - first + 1;
+        first = last;
+    }
+    dirtyRows_.fill(false);
+    reportRefreshStats();
+}
+
+void QuotesTableModel::reportRefreshStats()
 {
-    view_->doItemsLayout();
-/*
-    int row = getOrderRow(inst.first.c_str());
-    if( row != -1 ) {
-        view_->update(QuotesTableModel::index(row,2));
-        view_->update(QuotesTableModel::index(row,3));
-        view_->update(QuotesTableModel::index(row,4));
-        view_->update(QuotesTableModel::index(row,5));
+    if( !statClock_.isValid() ) {
+        statClock_.start();
+        statCpuStart_ = Global::threadCpuTime();
+        return;
     }
-    CDebug() << "\"" << inst.first.c_str() << "\":" << inst.second
-             << " - row " << row << " updated";
-    */
+
+    qint64 elapsed = statClock_.elapsed();
+    if( elapsed < GUI_REFRESH_STATS_PERIOD*1000 )
+        return;
+
+    qint64 cpu = Global::threadCpuTime() - statCpuStart_;
+    CDebug() << "GUI refresh: " << qint32(statUpdates_*1000/elapsed) << " quote updates/sec, "
+             << qint32(statRefreshes_*1000/elapsed) << " refreshes/sec, "
+             << qint32(statRefreshes_ ? statRows_/statRefreshes_ : 0) << " rows/refresh, GUI thread CPU "
+             << QString::number(cpu/(elapsed*10000.0), 'f', 1) << "%";
+
+    statClock_.restart();
+    statCpuStart_ += cpu;
+    statUpdates_ = statRefreshes_ = statRows_ = 0;
 }
 
 QAbstractItemView* QuotesTableModel::view() const
@@ -1,26 +1,37 @@
 #ifndef __quotestablemodel_h__
 #define __quotestablemodel_h__
 
-#include "fixdatamodel.h"
+#include "marketabstractmodel.h"
 
+#include <QAbstractTableModel>
 #include <QList>
 #include <QMutex>
+#include <QBitArray>
+#include <QElapsedTimer>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 class QAbstractItemView;
 class QuotesTableView;
-class Scheduler;
-class MqlProxyServer;
+class FixDataModel;
 
-class QuotesTableModel : public FixDataModel
+// Table of the quotes of the market core for the GUI. It only observes
+// the core: instrument notifications of the core and quote updates of the Scheduler
+class QuotesTableModel : public QAbstractTableModel
 {
     Q_OBJECT
 public:
-    QuotesTableModel(QSharedPointer<MqlProxyServer>& mqlProxy, QWidget* parent);
+    QuotesTableModel(FixDataModel* core, QObject* parent);
     ~QuotesTableModel();
 
     void resetView(QuotesTableView* view);
     QAbstractItemView* view() const;
 
+    inline FixDataModel* core() const
+    { return core_; }
+
 protected:
     int rowCount(const QModelIndex& parent) const;
     int columnCount(const QModelIndex& parent) const;
@@ -30,20 +41,37 @@ protected:
 protected slots:
     void onInstrumentAdd(const Instrument& inst);
     void onInstrumentRemove(const Instrument& inst, qint16 orderRow);
-    void onInstrumentChange(const Instrument& old, const Instrument& cur);
     void onInstrumentUpdate();
     void onInstrumentUpdate(const Instrument& inst);
+    void onRefresh();
 
 private:
+    void scheduleRefresh();
+    void reportRefreshStats();
+
     QSize columnProportionWidth(int column) const;
     void setColumnWidth(int column) const;
     void setRowHeight(int row) const;
 
+    FixDataModel* core_;
     mutable QMutex monitorLock_;
     
     typedef QMap<qint32,QString> Code2SymT;
     mutable Code2SymT monitored_;
     QuotesTableView* view_;
+
+    // Quote updates only mark rows dirty, the view is refreshed by the timer 
+    // at GUI_REFRESH_RATE with dataChanged of contiguous dirty rows
+    QTimer*   refresh_;
+    QBitArray dirtyRows_;
+    bool      dirtyLayout_;
+
+    // GUI thread load per tick rate, see GUI_REFRESH_STATS_PERIOD
+    QElapsedTimer statClock_;
+    qint64  statCpuStart_;
+    quint32 statUpdates_;
+    quint32 statRefreshes_;
+    quint32 statRows_;
 };
 
 #endif // __quotestablemodel_h__
@@ -2,6 +2,7 @@
 #include "logger.h"
 #include "quotestableview.h"
 #include "quotestablemodel.h"
+#include "fixdatamodel.h"
 #include "symboleditdialog.h"
 #include "fixmessagedialog.h"
 
@@ -99,8 +100,8 @@ void QuotesTableView::contextMenuEvent(QContextMenuEvent* e)
     bool unsubscribed = false;
     bool rejected = false;
     {
-        QSharedPointer<QReadLocker> autolock;
-        Snapshot* snap = model()->getSnapshot(model()->getByOrderRow(sourceIdx.row()).first.c_str(),autolock);
+        QSharedPointer<DReadLocker> autolock;
+        Snapshot* snap = core()->getSnapshot(core()->getByOrderRow(sourceIdx.row()).first.c_str(),autolock);
         if(snap) {
             unsubscribed = (snap->statuscode_ & Snapshot::StatUnSubscribed);
             rejected = (snap->statuscode_ & (Snapshot::StatBusinessReject|Snapshot::StatSessionReject));
@@ -139,7 +140,7 @@ void QuotesTableView::onEditCode()
     if( code == 0 )
         return;
 
-    SymbolEditDialog("", sourceIdx.data().toString(), *model(), this).exec();
+    SymbolEditDialog("", sourceIdx.data().toString(), *core(), this).exec();
 }
 
 void QuotesTableView::onEditSymbol()
@@ -153,7 +154,7 @@ void QuotesTableView::onEditSymbol()
     if( symbol.isEmpty() )
         return;
 
-    SymbolEditDialog(symbol, "", *model(), this).exec();
+    SymbolEditDialog(symbol, "", *core(), this).exec();
 }
 
 void QuotesTableView::onRemoveRow()
@@ -166,9 +167,9 @@ void QuotesTableView::onRemoveRow()
     if( row < 0)
         return;
 
-    Instrument inst = model()->getByOrderRow(row);
+    Instrument inst = core()->getByOrderRow(row);
     if( inst.second != -1 ) 
-        model()->setMonitoring(inst, false, true);
+        core()->setMonitoring(inst, false, true);
 }
 
 void QuotesTableView::onSendRequest(bool subscribe)
@@ -181,20 +182,20 @@ void QuotesTableView::onSendRequest(bool subscribe)
     if( row < 0)
         return;
 
-    Instrument inst = model()->getByOrderRow(row);
+    Instrument inst = core()->getByOrderRow(row);
     if( inst.second != -1 )
     {
         bool sendSubscription = false;
-        QSharedPointer<QReadLocker> autolock;
-        Snapshot* snap = model()->getSnapshot(model()->getByOrderRow(row).first.c_str(),autolock);
+        QSharedPointer<DReadLocker> autolock;
+        Snapshot* snap = core()->getSnapshot(core()->getByOrderRow(row).first.c_str(),autolock);
         if(snap) 
             sendSubscription = (snap->statuscode_ & Snapshot::StatUnSubscribed);
         autolock.reset();
 
         if( sendSubscription && subscribe)
-            emit model()->activateRequest(inst);
+            emit core()->activateRequest(inst);
         else if( !(sendSubscription || subscribe) )
-            emit model()->activateRequest( Instrument("Disable_" + inst.first, inst.second) );
+            emit core()->activateRequest( Instrument("Disable_" + inst.first, inst.second) );
         else
         { /*do nothing */}
     }
@@ -210,7 +211,7 @@ void QuotesTableView::onFIXOutgoing()
     if( row < 0)
         return;
 
-    Instrument inst = model()->getByOrderRow(row);
+    Instrument inst = core()->getByOrderRow(row);
     if( inst.second != -1 )
         FixMessageDialog(inst.first.c_str(), inst.second, false, model()).exec();
 }
@@ -226,7 +227,7 @@ void QuotesTableView::onFIXIncoming()
     if( row < 0)
         return;
 
-    Instrument inst = model()->getByOrderRow(row);
+    Instrument inst = core()->getByOrderRow(row);
     if( inst.second != -1 )
         FixMessageDialog(inst.first.c_str(), inst.second, true, model()).exec();
 }
@@ -245,3 +246,8 @@ QuotesTableModel* QuotesTableView::model() const
 {
     return qobject_cast<QuotesTableModel*>(sortingModel_.sourceModel());
 }
+
+FixDataModel* QuotesTableView::core() const
+{
+    return model()->core();
+}
@@ -6,6 +6,7 @@
 
 ////////////////////////////////////////////////////////////////
 class QuotesTableModel;
+class FixDataModel;
 
 ////////////////////////////////////////////////////////////////
 class QuotesTableView : public QTableView
@@ -19,6 +20,8 @@ public:
     qint16 toSourceRow(qint16 currentRow);
     qint16 fromSourceRow(qint16 sourceRow);
     QuotesTableModel* model() const;
+    // market core observed by the model
+    FixDataModel* core() const;
 
 protected:
     bool event(QEvent* e);
@@ -39,7 +39,9 @@ public:
     virtual ~RequestHandler() {};
 
     virtual void onStateChanged(RequestHandler::ConnectionState state) = 0;
-    virtual void onMessageReceived(const QByteArray& message) = 0;
+    // rxNanos is the receive time of the message (Global::nanotime), the
+    // kernel stamp of the socket when the transport has it
+    virtual void onMessageReceived(const QByteArray& message, qint64 rxNanos) = 0;
     virtual void onHaveToLogin() = 0;
     virtual void onHaveToLogout() = 0;
     virtual void onHaveToTestRequest() = 0;
@@ -1,84 +1,253 @@
-#include "external.h"
+#include "globals.h"
 #include "rwlock-dbg.h"
 
+#ifdef LMAX_LOCK_PROFILE
+
+#include "monoclock.h"
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    // Counters of a call site in the buffer of one thread: the owner thread
+    // updates them by relaxed stores, the report reads them at any time
+    struct SiteStats {
+        QAtomicPointer<const char> site_;   // NULL - free slot
+        const char*                lock_;   // set before the site is published
+        QAtomicInteger<quint64>    acquires_;
+        QAtomicInteger<quint64>    contended_;
+        QAtomicInteger<quint64>    waitNanos_;
+        QAtomicInteger<quint64>    waitMax_;
+        QAtomicInteger<quint64>    holdNanos_;
+        QAtomicInteger<quint64>    holdMax_;
+
+        SiteStats()
+            : site_(NULL), lock_(NULL), acquires_(0), contended_(0),
+            waitNanos_(0), waitMax_(0), holdNanos_(0), holdMax_(0)
+        {}
+    };
+
+    struct ThreadBuffer {
+        SiteStats               sites_[LOCK_PROFILE_SITES];
+        QAtomicInteger<quint64> dropped_;   // records of sites over LOCK_PROFILE_SITES
+    };
+
+    ThreadRegistry<ThreadBuffer> buffers;
+    THREAD_LOCAL ThreadBuffer* current = NULL;
+
+    inline void add(QAtomicInteger<quint64>& counter, quint64 value)
+    {
+        counter.store(counter.load() + value);
+    }
+
+    inline void raise(QAtomicInteger<quint64>& counter, quint64 value)
+    {
+        if( value > counter.load() )
+            counter.store(value);
+    }
+
+    ThreadBuffer* threadBuffer()
+    {
+        if( current == NULL )
+            buffers.acquire(&current);
+        return current;
+    }
+
+    // The sites are string literals: the same site has the same address
+    SiteStats* siteStats(const char* lock, const char* site)
+    {
+        ThreadBuffer* buffer = threadBuffer();
+        quint32 start = quint32((quintptr(site) >> 3) % LOCK_PROFILE_SITES);
+        for(quint32 i = 0; i < LOCK_PROFILE_SITES; i++)
+        {
+            SiteStats& stats = buffer->sites_[(start + i) % LOCK_PROFILE_SITES];
+            const char* taken = stats.site_.loadAcquire();
+            if( taken == site )
+                return &stats;
+            if( taken == NULL ) {
+                stats.lock_ = lock;
+                stats.site_.storeRelease(site);
+                return &stats;
+            }
+        }
+        add(buffer->dropped_, 1);
+        return NULL;
+    }
+
+    struct SiteTotals {
+        QString lock_;
+        QString site_;
+        quint64 acquires_;
+        quint64 contended_;
+        quint64 waitNanos_;
+        quint64 waitMax_;
+        quint64 holdNanos_;
+        quint64 holdMax_;
+    };
+
+    bool moreWait(const SiteTotals& a, const SiteTotals& b)
+    {
+        if( a.waitNanos_ != b.waitNanos_ )
+            return a.waitNanos_ > b.waitNanos_;
+        return a.holdNanos_ > b.holdNanos_;
+    }
+}
 
-#include <QThread>
-#include <windows.h>
+////////////////////////////////////////////////////////////////////////////////
+qint64 LockProfiler::now()
+{
+    return MonoClock::nanos();
+}
 
-FILE* RWLockDbg::fglob_     = NULL;
-quint32 RWLockDbg::tmdiff_  = 0;
+void LockProfiler::acquired(const char* lock, const char* site, qint64 waitNanos, bool contended)
+{
+    SiteStats* stats = siteStats(lock, site);
+    if( stats == NULL )
+        return;
+
+    add(stats->acquires_, 1);
+    if( contended ) {
+        add(stats->contended_, 1);
+        add(stats->waitNanos_, waitNanos);
+        raise(stats->waitMax_, waitNanos);
+    }
+}
 
-RWLockDbg::RWLockDbg()
+void LockProfiler::released(const char* lock, const char* site, qint64 holdNanos)
 {
-    if( tmdiff_ == 0 )
-        tmdiff_ = ::GetTickCount();
-    if( fglob_ == NULL )
-        fglob_ = fopen("rwlock.dbg","wc+");
+    SiteStats* stats = siteStats(lock, site);
+    if( stats == NULL )
+        return;
+
+    add(stats->holdNanos_, holdNanos);
+    raise(stats->holdMax_, holdNanos);
 }
 
-RWLockDbg::~RWLockDbg()
+QString LockProfiler::report()
 {
-    if( fglob_ )
-        fclose(fglob_);
-    tmdiff_ = 0;
-    fglob_ = NULL;
+    vector<ThreadBuffer*> taken;
+    buffers.take(taken);
+
+    // the same site of all threads is summed up
+    vector<SiteTotals> totals;
+    quint64 dropped = 0;
+    for(quint32 t = 0; t < taken.size(); t++)
+    {
+        dropped += taken[t]->dropped_.load();
+        for(quint32 i = 0; i < LOCK_PROFILE_SITES; i++)
+        {
+            const SiteStats& stats = taken[t]->sites_[i];
+            const char* site = stats.site_.loadAcquire();
+            if( site == NULL )
+                continue;
+
+            // __FILE__ may be a full path
+            QString name = site;
+            qint32 slash = qMax(name.lastIndexOf('/'), name.lastIndexOf('\\'));
+            if( slash >= 0 )
+                name = name.mid(slash + 1);
+
+            quint32 n = 0;
+            while( n < totals.size() && !(totals[n].site_ == name && totals[n].lock_ == stats.lock_) )
+                ++n;
+            if( n == totals.size() ) {
+                SiteTotals empty = { stats.lock_, name, 0, 0, 0, 0, 0, 0 };
+                totals.push_back(empty);
+            }
+
+            SiteTotals& total = totals[n];
+            total.acquires_ += stats.acquires_.load();
+            total.contended_ += stats.contended_.load();
+            total.waitNanos_ += stats.waitNanos_.load();
+            total.waitMax_ = qMax(total.waitMax_, stats.waitMax_.load());
+            total.holdNanos_ += stats.holdNanos_.load();
+            total.holdMax_ = qMax(total.holdMax_, stats.holdMax_.load());
+        }
+    }
+    if( totals.empty() )
+        return QString();
+
+    sort(totals.begin(), totals.end(), moreWait);
+
+    QString report = "lock          site                              acquires contended  wait ms  wait max   hold ms  hold max (usecs)\n";
+    for(quint32 n = 0; n < totals.size(); n++)
+    {
+        const SiteTotals& total = totals[n];
+        report += QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                  .arg(total.lock_, -13)
+                  .arg(total.site_, -33)
+                  .arg(total.acquires_, 9)
+                  .arg(total.acquires_ ? QString("%1%").arg(total.contended_*100.0/total.acquires_, 0, 'f', 1) : QString("-"), 9)
+                  .arg(total.waitNanos_/1000000.0, 8, 'f', 2)
+                  .arg(total.waitMax_/1000.0, 9, 'f', 1)
+                  .arg(total.holdNanos_/1000000.0, 9, 'f', 2)
+                  .arg(total.holdMax_/1000.0, 9, 'f', 1);
+    }
+    if( dropped )
+        report += QString("%1 acquires of sites over %2 per thread are not counted\n").arg(dropped).arg(LOCK_PROFILE_SITES);
+    return report;
 }
 
-void RWLockDbg::checkpoint(const char* name)
+bool LockProfiler::writeReport(const QString& filename)
 {
-    newcheckpoint_ = name;
+    return Global::writeReport(filename, report());
 }
 
-void RWLockDbg::lockForRead()
+////////////////////////////////////////////////////////////////////////////////
+// An uncontended acquire reads the clock once
+qint64 RWLockDbg::lockForRead(const char* site)
 {
-    quint32 diff = ::GetTickCount() - tmdiff_; 
-    tmdiff_ += diff;
-    char buf[50];
-    sprintf_s(buf,50,"Rbefore %s %u: %u ms\n", 
-        newcheckpoint_.c_str(), (quint32)QThread::currentThreadId(), diff);
-    fwrite(buf,1,strlen(buf),fglob_); fflush(fglob_);
-
-    QReadWriteLock::lockForWrite();
-    oldcheckpoint_ = newcheckpoint_;
-
-    diff = ::GetTickCount() - tmdiff_; 
-    tmdiff_ += diff;
-    sprintf_s(buf,50,"Rafter %s %u: %u ms\n", 
-        newcheckpoint_.c_str(), (quint32)QThread::currentThreadId(), diff);
-    fwrite(buf,1,strlen(buf),fglob_); fflush(fglob_);
-
-    fflush(fglob_);
+    bool contended = !QReadWriteLock::tryLockForRead();
+    qint64 start = contended ? LockProfiler::now() : 0;
+    if( contended )
+        QReadWriteLock::lockForRead();
+
+    qint64 acquired = LockProfiler::now();
+    LockProfiler::acquired(name_, site, contended ? acquired - start : 0, contended);
+    return acquired;
 }
 
-void RWLockDbg::lockForWrite()
+qint64 RWLockDbg::lockForWrite(const char* site)
 {
-    quint32 diff = ::GetTickCount() - tmdiff_; 
-    tmdiff_ += diff;
-    char buf[50];
-    sprintf_s(buf,50,"Wbefore %s %u: %u ms\n", 
-        newcheckpoint_.c_str(), (quint32)QThread::currentThreadId(), diff);
-    fwrite(buf,1,strlen(buf),fglob_); fflush(fglob_);
-
-    QReadWriteLock::lockForWrite();
-    oldcheckpoint_ = newcheckpoint_;
-
-    diff = ::GetTickCount() - tmdiff_; 
-    tmdiff_ += diff;
-    sprintf_s(buf,50,"Wafter %s %u: %u ms\n", 
-        newcheckpoint_.c_str(), (quint32)QThread::currentThreadId(), diff);
-    fwrite(buf,1,strlen(buf),fglob_); fflush(fglob_);
-
-    fflush(fglob_);
+    bool contended = !QReadWriteLock::tryLockForWrite();
+    qint64 start = contended ? LockProfiler::now() : 0;
+    if( contended )
+        QReadWriteLock::lockForWrite();
+
+    qint64 acquired = LockProfiler::now();
+    LockProfiler::acquired(name_, site, contended ? acquired - start : 0, contended);
+    return acquired;
 }
 
-void RWLockDbg::unlock()
+void RWLockDbg::unlock(const char* site, qint64 acquired)
 {
+    qint64 held = LockProfiler::now() - acquired;
     QReadWriteLock::unlock();
+    LockProfiler::released(name_, site, held);
+}
+
+qint64 MutexDbg::lock(const char* site)
+{
+    bool contended = !QMutex::tryLock();
+    qint64 start = contended ? LockProfiler::now() : 0;
+    if( contended )
+        QMutex::lock();
+
+    qint64 acquired = LockProfiler::now();
+    LockProfiler::acquired(name_, site, contended ? acquired - start : 0, contended);
+    return acquired;
+}
 
-    quint32 diff = ::GetTickCount() - tmdiff_; tmdiff_ += diff;
-    char buf[50];
-    sprintf_s(buf,50,"Unlock %s %u: %u ms\n", 
-        oldcheckpoint_.c_str(), (quint32)QThread::currentThreadId(), diff);
-    fwrite(buf,1,strlen(buf),fglob_); fflush(fglob_);
-    fflush(fglob_);
+void MutexDbg::unlock(const char* site, qint64 acquired)
+{
+    qint64 held = LockProfiler::now() - acquired;
+    QMutex::unlock();
+    LockProfiler::released(name_, site, held);
 }
+
+#endif // LMAX_LOCK_PROFILE
@@ -1,119 +1,211 @@
 #ifndef __rwlock_dbg_h__
 #define __rwlock_dbg_h__
 
+#include "external.h"
+
 #include <QReadWriteLock>
-#include <string>
+#include <QMutex>
+#include <QString>
+
+// Call site of a locker, "file:line"
+#define LOCK_SITE_STR2(x)   #x
+#define LOCK_SITE_STR(x)    LOCK_SITE_STR2(x)
+#define LOCK_SITE           __FILE__ ":" LOCK_SITE_STR(__LINE__)
+
+/////////////////////////////////////////////////////////////////
+// Lock contention profiler, built with LMAX_LOCK_PROFILE. Every thread
+// records the acquires of its call sites into its own buffer: count,
+// contended count, wait and hold times. The report sums up the threads
+// and ranks the sites by the total wait. Without LMAX_LOCK_PROFILE the
+// profiled locks are plain Qt locks and the sites are dropped at compile time
+class LockProfiler
+{
+public:
+#ifdef LMAX_LOCK_PROFILE
+    static void acquired(const char* lock, const char* site, qint64 waitNanos, bool contended);
+    static void released(const char* lock, const char* site, qint64 holdNanos);
+    static qint64 now();
+
+    // Table of all sites since the start, empty when nothing is recorded
+    static QString report();
+    static bool writeReport(const QString& filename);
+#else
+    inline static QString report()
+    { return QString(); }
+    inline static bool writeReport(const QString&)
+    { return false; }
+#endif
+};
+
+/////////////////////////////////////////////////////////////////
+// QReadWriteLock timed by LockProfiler under its name. The lock
+// methods return the acquire time to be passed to unlock. The base is
+// private: Qt lockers don't compile on it, so no site skips the profiling
+class RWLockDbg: private QReadWriteLock
+{
+public:
+    RWLockDbg(const char* name) : name_(name) {}
+
+#ifdef LMAX_LOCK_PROFILE
+    qint64 lockForRead(const char* site);
+    qint64 lockForWrite(const char* site);
+    void unlock(const char* site, qint64 acquired);
+#else
+    inline qint64 lockForRead(const char*)
+    { QReadWriteLock::lockForRead(); return 0; }
+    inline qint64 lockForWrite(const char*)
+    { QReadWriteLock::lockForWrite(); return 0; }
+    inline void unlock(const char*, qint64)
+    { QReadWriteLock::unlock(); }
+#endif
+
+    inline const char* name() const
+    { return name_; }
+
+private:
+    Q_DISABLE_COPY(RWLockDbg)
+    const char* name_;
+};
 
 /////////////////////////////////////////////////////////////////
-class RWLockDbg: public QReadWriteLock
+// QMutex timed by LockProfiler under its name, the base is private as of RWLockDbg
+class MutexDbg: private QMutex
 {
 public:
-    RWLockDbg();
-    ~RWLockDbg();
+    MutexDbg(const char* name) : name_(name) {}
 
-    void lockForRead();
-    void lockForWrite();
-    void unlock();
-    void checkpoint(const char* name);
+#ifdef LMAX_LOCK_PROFILE
+    qint64 lock(const char* site);
+    void unlock(const char* site, qint64 acquired);
+#else
+    inline qint64 lock(const char*)
+    { QMutex::lock(); return 0; }
+    inline void unlock(const char*, qint64)
+    { QMutex::unlock(); }
+#endif
+
+    inline const char* name() const
+    { return name_; }
 
 private:
-    static FILE*    fglob_;
-    static quint32  tmdiff_;
-    std::string     newcheckpoint_;
-    std::string     oldcheckpoint_;
+    Q_DISABLE_COPY(MutexDbg)
+    const char* name_;
 };
 
 /////////////////////////////////////////////////
+// Lockers of the profiled locks, the same as QReadLocker, QWriteLocker
+// and QMutexLocker but for the call site: pass LOCK_SITE
 class DReadLocker
 {
 public:
-    inline DReadLocker(RWLockDbg *readWriteLock, const char* name);
+    inline DReadLocker(RWLockDbg* lock, const char* site)
+        : lock_(lock), site_(site), acquired_(0), locked_(false)
+    { relock(); }
 
     inline ~DReadLocker()
     { unlock(); }
 
     inline void unlock()
     {
-        if (q_val) {
-            if ((q_val & quintptr(1u)) == quintptr(1u)) {
-                q_val &= ~quintptr(1u);
-                readWriteLock()->unlock();
-            }
+        if( locked_ ) {
+            locked_ = false;
+            lock_->unlock(site_, acquired_);
         }
     }
 
     inline void relock()
     {
-        if (q_val) {
-            if ((q_val & quintptr(1u)) == quintptr(0u)) {
-                readWriteLock()->lockForRead();
-                q_val |= quintptr(1u);
-            }
+        if( !locked_ ) {
+            acquired_ = lock_->lockForRead(site_);
+            locked_ = true;
         }
     }
 
-    inline RWLockDbg *readWriteLock() const
-    { return reinterpret_cast<RWLockDbg *>(q_val & ~quintptr(1u)); }
+    inline RWLockDbg* readWriteLock() const
+    { return lock_; }
 
 private:
     Q_DISABLE_COPY(DReadLocker)
-    quintptr q_val;
+    RWLockDbg*  lock_;
+    const char* site_;
+    qint64      acquired_;
+    bool        locked_;
 };
 
-inline DReadLocker::DReadLocker(RWLockDbg *areadWriteLock, const char* name)
-    : q_val(reinterpret_cast<quintptr>(areadWriteLock))
-{
-    Q_ASSERT_X((q_val & quintptr(1u)) == quintptr(0),
-               "DReadLocker", "RWLockDbg pointer is misaligned");
-    areadWriteLock->checkpoint(name);
-    relock();
-}
-
 /////////////////////////////////////////////////////////////////////////////
 class DWriteLocker
 {
 public:
-    inline DWriteLocker(RWLockDbg *readWriteLock, const char* name);
+    inline DWriteLocker(RWLockDbg* lock, const char* site)
+        : lock_(lock), site_(site), acquired_(0), locked_(false)
+    { relock(); }
 
     inline ~DWriteLocker()
     { unlock(); }
 
     inline void unlock()
     {
-        if (q_val) {
-            if ((q_val & quintptr(1u)) == quintptr(1u)) {
-                q_val &= ~quintptr(1u);
-                readWriteLock()->unlock();
-            }
+        if( locked_ ) {
+            locked_ = false;
+            lock_->unlock(site_, acquired_);
         }
     }
 
     inline void relock()
     {
-        if (q_val) {
-            if ((q_val & quintptr(1u)) == quintptr(0u)) {
-                readWriteLock()->lockForWrite();
-                q_val |= quintptr(1u);
-            }
+        if( !locked_ ) {
+            acquired_ = lock_->lockForWrite(site_);
+            locked_ = true;
         }
     }
 
-    inline RWLockDbg *readWriteLock() const
-    { return reinterpret_cast<RWLockDbg *>(q_val & ~quintptr(1u)); }
-
+    inline RWLockDbg* readWriteLock() const
+    { return lock_; }
 
 private:
     Q_DISABLE_COPY(DWriteLocker)
-    quintptr q_val;
+    RWLockDbg*  lock_;
+    const char* site_;
+    qint64      acquired_;
+    bool        locked_;
 };
 
-inline DWriteLocker::DWriteLocker(RWLockDbg *areadWriteLock, const char* name)
-    : q_val(reinterpret_cast<quintptr>(areadWriteLock))
+/////////////////////////////////////////////////////////////////////////////
+class DMutexLocker
 {
-    Q_ASSERT_X((q_val & quintptr(1u)) == quintptr(0),
-               "DWriteLocker", "RWLockDbg pointer is misaligned");
-    areadWriteLock->checkpoint(name);
-    relock();
-}
+public:
+    inline DMutexLocker(MutexDbg* lock, const char* site)
+        : lock_(lock), site_(site), acquired_(0), locked_(false)
+    { relock(); }
+
+    inline ~DMutexLocker()
+    { unlock(); }
+
+    inline void unlock()
+    {
+        if( locked_ ) {
+            locked_ = false;
+            lock_->unlock(site_, acquired_);
+        }
+    }
+
+    inline void relock()
+    {
+        if( !locked_ ) {
+            acquired_ = lock_->lock(site_);
+            locked_ = true;
+        }
+    }
+
+    inline MutexDbg* mutex() const
+    { return lock_; }
+
+private:
+    Q_DISABLE_COPY(DMutexLocker)
+    MutexDbg*   lock_;
+    const char* site_;
+    qint64      acquired_;
+    bool        locked_;
+};
 
 #endif // __rwlock_dbg_h__
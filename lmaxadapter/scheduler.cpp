@@ -2,71 +2,221 @@
 
 #include "scheduler.h"
 #include "netmanager.h"
-#include "quotestablemodel.h"
+#include "fixdatamodel.h"
+#include "metrics.h"
 
 #include <QtCore>
 
+#include <limits.h>
+#include <math.h>
+
 ////////////////////////////////////////////////////////////////////////////////////
-class RequestTimer: public QTimer {
+class RequestTimer: public WheelTimer {
 public:
-    RequestTimer(Scheduler* parent) : QTimer(parent) {}
-    void timerEvent(QTimerEvent* e) { 
-        stop(); ((Scheduler*)parent())->exec(Scheduler::RequestTimerID); 
+    RequestTimer(Scheduler* parent) : parent_(parent) {}
+    void expired() { 
+        parent_->exec(Scheduler::RequestTimerID); 
     }
+private:
+    Scheduler* parent_;
 };
 
-class ResponseTimer: public QTimer {
+class ReconnectTimer: public WheelTimer {
 public:
-    ResponseTimer(Scheduler* parent) : QTimer(parent) {}
-    void timerEvent(QTimerEvent* e) { 
-        stop(); ((Scheduler*)parent())->exec(Scheduler::ResponseTimerID); 
+    ReconnectTimer(Scheduler* parent) : parent_(parent) {}
+    void expired() { 
+        parent_->exec(Scheduler::ReconnectTimerID); 
     }
+private:
+    Scheduler* parent_;
 };
 
-class ReconnectTimer: public QTimer {
+class HeartbeatTimer: public WheelTimer {
 public:
-    ReconnectTimer(Scheduler* parent) : QTimer(parent) {}
-    void timerEvent(QTimerEvent* e) { 
-        stop(); ((Scheduler*)parent())->exec(Scheduler::ReconnectTimerID); 
+    HeartbeatTimer(Scheduler* parent) : parent_(parent) {}
+    void expired() {
+        parent_->exec(Scheduler::HeartbeatTimerID); 
     }
+private:
+    Scheduler* parent_;
 };
 
-class HeartbeatTimer: public QTimer {
+class TestrequestTimer: public WheelTimer {
 public:
-    HeartbeatTimer(Scheduler* parent) : QTimer(parent) {}
-    void timerEvent(QTimerEvent* e) {
-        stop(); ((Scheduler*)parent())->exec(Scheduler::HeartbeatTimerID); 
+    TestrequestTimer(Scheduler* parent) : parent_(parent) {}
+    void expired() { 
+        parent_->exec(Scheduler::TestrequestTimerID); 
     }
-
+private:
+    Scheduler* parent_;
 };
 
-class TestrequestTimer: public QTimer {
+class StaleTimer: public WheelTimer {
 public:
-    TestrequestTimer(Scheduler* parent) : QTimer(parent) {}
-    void timerEvent(QTimerEvent* e) { 
-        stop(); ((Scheduler*)parent())->exec(Scheduler::TestrequestTimerID); 
+    StaleTimer(Scheduler* parent, const Instrument& inst) : parent_(parent), inst_(inst) {}
+    void expired() { 
+        parent_->onStaleEvent(inst_); 
     }
+private:
+    Scheduler* parent_;
+    Instrument inst_;
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+void InstrumentQueue::push(const Instrument& inst)
+{
+    QByteArray key(inst.first.c_str(), (int)inst.first.size());
+    Slot& slot = index_[key];
+    slot.inst_ = inst;
+    slot.seq_ = ++seq_;
+    fifo_.enqueue(Entry(key, seq_));
+}
+
+void InstrumentQueue::clear()
+{
+    index_.clear();
+    fifo_.clear();
+}
+
+void InstrumentQueue::take(QVector<Instrument>& out, qint32 maxCount)
+{
+    out.reserve(out.size() + qMin(maxCount, index_.size()));
+    while( !fifo_.isEmpty() && maxCount > 0 )
+    {
+        Entry entry = fifo_.dequeue();
+        QHash<QByteArray,Slot>::iterator It = index_.find(entry.first);
+        if( It == index_.end() || It->seq_ != entry.second )
+            continue;   // stale, requeued later
+        out.push_back(It->inst_);
+        index_.erase(It);
+        --maxCount;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+MessagePacer::MessagePacer()
+    : refilled_(Global::nanotime()),
+    tokens_(0),
+    rate_(0),
+    burst_(0)
+{
+}
+
+void MessagePacer::configure(qint32 rate, qint32 burst)
+{
+    QMutexLocker g(&lock_);
+    rate_ = qMax(rate, 0);
+    burst_ = qMax(burst, 1);
+    tokens_ = burst_;
+    refilled_ = Global::nanotime();
+}
+
+void MessagePacer::refill()
+{
+    qint64 now = Global::nanotime();
+    qint64 passed = now - refilled_;
+    refilled_ = now;
+    tokens_ = qMin(tokens_ + double(passed)*rate_/1000000000, double(burst_));
+}
+
+void MessagePacer::consume()
+{
+    QMutexLocker g(&lock_);
+    if( rate_ == 0 )
+        return;
+    refill();
+    tokens_ -= 1;
+}
+
+qint32 MessagePacer::available()
+{
+    QMutexLocker g(&lock_);
+    if( rate_ == 0 )
+        return INT_MAX;
+    refill();
+    return tokens_ < 1 ? 0 : qint32(tokens_);
+}
+
+qint32 MessagePacer::waitTime()
+{
+    QMutexLocker g(&lock_);
+    if( rate_ == 0 )
+        return 0;
+    refill();
+    return tokens_ >= 1 ? 0 : qint32(ceil((1 - tokens_)*1000/rate_));
+}
+
+qint32 MessagePacer::drainTime(qint32 depth)
+{
+    QMutexLocker g(&lock_);
+    if( rate_ == 0 )
+        return 0;
+    refill();
+    double missing = depth - tokens_;
+    return missing <= 0 ? 0 : qint32(ceil(missing*1000/rate_));
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+ReconnectBackoff::ReconnectBackoff()
+    : base_(500),
+    max_(30000),
+    jitter_(50),
+    attempts_(0),
+    random_(quint32(QDateTime::currentMSecsSinceEpoch()))
+{}
+
+void ReconnectBackoff::configure(qint32 base, qint32 max, qint32 jitter)
+{
+    base_ = qMax(base, 0);
+    max_ = qMax(max, base_);
+    jitter_ = qBound(0, jitter, 100);
+}
+
+qint32 ReconnectBackoff::next()
+{
+    qint64 delay = base_;
+    for(qint32 i = 0; i < attempts_ && delay < max_; ++i)
+        delay *= 2;
+    delay = qMin(delay, qint64(max_));
+    ++attempts_;
+
+    random_ = random_ * 1103515245 + 12345;
+    qint64 spread = delay * jitter_ / 100;
+    if( spread > 0 )
+        delay -= (random_ >> 8) % (spread + 1);
+    return qint32(delay);
+}
+
+void ReconnectBackoff::reset()
+{
+    attempts_ = 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 Scheduler::Scheduler(QObject* parent)
     : QObject(parent),
+    reconnectInterval_(0),
+    outageStart_(0),
+    attemptStart_(0),
+    awaitingFirstTick_(0),
+    lastFirstTick_(-1),
+    lastOutage_(-1),
+    allowReconnect_(true),
+    responsePosted_(false),
+    updatesObserved_(false),
+    throttled_(false),
+    wheel_(new TimerWheel(NULL) ),
     requeste_(new RequestTimer(this) ),
-    response_(new ResponseTimer(this) ),
     reconnect_(new ReconnectTimer(this) ),
     heartbeat_(new HeartbeatTimer(this) ),
-    testrequest_(new TestrequestTimer(this) ),
-    reconnectInterval_(0),
-    allowReconnect_(true)
+    testrequest_(new TestrequestTimer(this) )
 {}
 
 Scheduler::~Scheduler()
 {
-    requeste_->stop();
-    response_->stop();
-    reconnect_->stop();
-    heartbeat_->stop();
-    testrequest_->stop();
+    // no callbacks are running past the stop, the timers are safe to drop
+    wheel_->stop();
+    qDeleteAll(staleTimers_);
 }
 
 bool Scheduler::activateSSLReconnect()
@@ -74,26 +224,67 @@ bool Scheduler::activateSSLReconnect()
     if( !allowReconnect_ )
         return false;
 
-    if( manager()->getState() == ClosedRemoteState )
-        reconnectInterval_ = 0;
-    else
-        reconnectInterval_ = 2000;
+    MarketAbstractModel* settings = model();
+    QMutexLocker g(&guardReconnect_);
+    backoff_.configure(settings->value(ReconnectDelayParam).toInt(),
+                       settings->value(ReconnectMaxParam).toInt(),
+                       settings->value(ReconnectJitterParam).toInt());
+
+    // the outage lasts over the failed attempts
+    if( backoff_.attempts() == 0 )
+        outageStart_ = Global::nanotime();
+    reconnectInterval_ = backoff_.next();
 
-    reconnect_->setSingleShot(true);
-    reconnect_->start(reconnectInterval_);
+    wheel_->arm(reconnect_.data(), reconnectInterval_);
     return true;
 }
 
+void Scheduler::activateLoggedIn(qint32 heartbeatInterval)
+{
+    activateHeartbeat(heartbeatInterval);
+    activateTestrequest(heartbeatInterval);
+
+    QMutexLocker g(&guardReconnect_);
+    if( backoff_.attempts() > 0 )
+        CDebug() << "Reconnect: logged in by attempt " << backoff_.attempts();
+    backoff_.reset();
+}
+
+void Scheduler::recordFirstTick()
+{
+    QMutexLocker g(&guardReconnect_);
+    if( !awaitingFirstTick_ )
+        return;
+
+    awaitingFirstTick_ = 0;
+    qint64 now = Global::nanotime();
+    lastFirstTick_ = qint32((now - attemptStart_) / 1000000);
+    lastOutage_ = outageStart_ ? qint32((now - outageStart_) / 1000000) : -1;
+    outageStart_ = 0;
+    CDebug() << "Reconnect: first quote in " << lastFirstTick_ << " msecs after the attempt, " 
+             << lastOutage_ << " msecs after the disconnect";
+}
+
+qint32 Scheduler::lastFirstTick() const
+{
+    QMutexLocker g(&guardReconnect_);
+    return lastFirstTick_;
+}
+
+qint32 Scheduler::lastOutage() const
+{
+    QMutexLocker g(&guardReconnect_);
+    return lastOutage_;
+}
+
 void Scheduler::activateHeartbeat(qint32 ms)
 {
-    heartbeat_->setSingleShot(true);
-    heartbeat_->start(ms);
+    wheel_->arm(heartbeat_.data(), ms);
 }
 
 void Scheduler::activateTestrequest(qint32 ms)
 {
-    testrequest_->setSingleShot(true);
-    testrequest_->start(ms);
+    wheel_->arm(testrequest_.data(), ms);
 }
 
 void Scheduler::activateLogout()
@@ -101,49 +292,66 @@ void Scheduler::activateLogout()
     {
         QMutexLocker g(&guardReqQueue_);
         reqQueue_.clear();
+        manualQueue_.clear();
     }
-    requeste_->setSingleShot(true);
-    requeste_->start();
+    wheel_->arm(requeste_.data(), 0);
 }
 
 void Scheduler::activateRequest(const Instrument& inst)
 {
     QMutexLocker g(&guardReqQueue_);
 
-    // remove all with similar symbols OR symb codes, 
-    // insert ordinal last request instead
-    SPairQueue::iterator It;
-    do {
-        It = qFind(reqQueue_.begin(), reqQueue_.end(), inst);
-        if( It == reqQueue_.end() )
-            break;
-        It = reqQueue_.erase(It);
+    // the last request of a symbol replaces the queued one
+    reqQueue_.push(inst);
+
+    wheel_->arm(requeste_.data(), 0);
+
+    if( inst.first.substr(0,8) == "Disable_" ) {
+        QHash<qint32,WheelTimer*>::iterator It = staleTimers_.find(inst.second);
+        if( It != staleTimers_.end() )
+            wheel_->cancel(It.value());
     }
-    while(It != reqQueue_.end());
-    reqQueue_.push_back(inst);
+}
 
-    requeste_->setSingleShot(true);
-    requeste_->start();
+// Subscribes of logon go in one pass, as many as the pacing allows
+void Scheduler::activateRequests(const QVector<Instrument>& batch)
+{
+    QMutexLocker g(&guardReqQueue_);
+    for(qint32 i = 0; i < batch.size(); ++i)
+        reqQueue_.push(batch[i]);
+    wheel_->arm(requeste_.data(), 0);
+}
+
+void Scheduler::activateManual(const QByteArray& message)
+{
+    QMutexLocker g(&guardReqQueue_);
+    manualQueue_.enqueue(message);
+    wheel_->arm(requeste_.data(), 0);
 }
 
 void Scheduler::activateResponse(const Instrument& inst)
 {
+    // every quote rearms the staleness timer of its instrument
+    if( inst.second > 0 ) {
+        WheelTimer*& stale = staleTimers_[inst.second];
+        if( stale == NULL )
+            stale = new StaleTimer(this, inst);
+        wheel_->arm(stale, QUOTES_STALE_TIMEOUT);
+    }
+
+    if( !updatesObserved_ )
+        return;
+
     QMutexLocker g(&guardRespQueue_);
     
-    // remove all with similar symbols OR symb codes, 
-    // insert ordinal last response instead
-    SPairQueue::iterator It;
-    do {
-        It = qFind(respQueue_.begin(), respQueue_.end(), inst);
-        if( It == respQueue_.end() )
-            break;
-        It = respQueue_.erase(It);
-    }
-    while(It != respQueue_.end());
-    respQueue_.push_back(inst);
+    // the last response of a symbol replaces the queued one
+    respQueue_.push(inst);
 
-    response_->setSingleShot(true);
-    response_->start();
+    // one drain per event loop pass
+    if( !responsePosted_ ) {
+        responsePosted_ = true;
+        QMetaObject::invokeMethod(this, "exec", Qt::QueuedConnection, Q_ARG(int, ResponseTimerID));
+    }
 }
 
 void Scheduler::setReconnectEnabled(int on)
@@ -151,7 +359,27 @@ void Scheduler::setReconnectEnabled(int on)
     allowReconnect_ = on;
 }
 
-void Scheduler::exec(TimerID id)
+void Scheduler::configurePacing(qint32 rate, qint32 burst)
+{
+    pacer_.configure(rate, burst);
+    if( rate > 0 )
+        CDebug() << "Pacing: " << rate << " messages per sec, burst " << burst;
+    else
+        CDebug() << "Pacing: disabled";
+}
+
+qint32 Scheduler::pacingDepth()
+{
+    QMutexLocker g(&guardReqQueue_);
+    return reqQueue_.size() + manualQueue_.size();
+}
+
+qint32 Scheduler::pacingDrainTime()
+{
+    return pacer_.drainTime( pacingDepth() );
+}
+
+void Scheduler::exec(int id)
 {
     if( id == RequestTimerID)
         onRequestEvent();
@@ -171,53 +399,71 @@ void Scheduler::onRequestEvent()
     if(mgr == NULL)
         return;
 
-    Instrument inst;
+    // subscribes go before manual messages, as many as the tokens allow
+    QVector<Instrument> batch;
     {
         QMutexLocker g(&guardReqQueue_);
-        if( reqQueue_.isEmpty() )
-            return;
+        reqQueue_.take(batch, pacer_.available());
+    }
 
-        inst = *reqQueue_.begin();
-        reqQueue_.pop_front();
+    for(qint32 i = 0; i < batch.size(); ++i)
+    {
+        const Instrument& inst = batch[i];
+        if( inst.first.substr(0,8) == "Disable_")
+            mgr->onHaveToUnSubscribe(Instrument(inst.first.c_str()+8,inst.second));
+        else
+            mgr->onHaveToSubscribe(inst);
     }
 
-    if( inst.first.substr(0,8) == "Disable_")
-        mgr->onHaveToUnSubscribe(Instrument(inst.first.c_str()+8,inst.second));
-    else
-        mgr->onHaveToSubscribe(inst);
+    while( true )
+    {
+        QByteArray message;
+        {
+            QMutexLocker g(&guardReqQueue_);
+            if( manualQueue_.isEmpty() || !reqQueue_.isEmpty() || pacer_.available() == 0 )
+                break;
+            message = manualQueue_.dequeue();
+        }
+
+        // stamped with the session header in the order of sending
+        QMutexLocker s(mgr->sendLock_);
+        if( mgr->model()->normalize(message) )
+            mgr->onHaveToSendMessage(message);
+        else
+            CDebug() << "Pacing: manual message is not FIX, dropped";
+    }
 
     QMutexLocker g(&guardReqQueue_);
-    if(!requeste_->isActive() && !reqQueue_.isEmpty()) {
-        requeste_->setSingleShot(true);
-        requeste_->start();
+    qint32 depth = reqQueue_.size() + manualQueue_.size();
+    if( depth == 0 ) {
+        throttled_ = false;
+        return;
+    }
+
+    if( !throttled_ ) {
+        throttled_ = true;
+        CDebug() << "Pacing: " << depth << " messages queued, drain in " 
+                 << pacer_.drainTime(depth) << " msecs";
     }
+    wheel_->arm(requeste_.data(), qMax(pacer_.waitTime(), 1));
 }
 
 void Scheduler::onResponseEvent()
 {
-    NetworkManager* mgr = manager();
-    if(mgr == NULL)
-        return;
-
-    Instrument inst;
+    QVector<Instrument> batch;
     {
         QMutexLocker g(&guardRespQueue_);
-        if( respQueue_.isEmpty() )
-            return;
-
-        inst = *respQueue_.begin();
-        respQueue_.pop_front();
+        respQueue_.take(batch, INT_MAX);
+        responsePosted_ = false;
     }
 
-    if( inst.first == "FullUpdate" )
-        emit model()->onInstrumentUpdate();
-    else
-        emit model()->onInstrumentUpdate(inst);
-
-    QMutexLocker g(&guardRespQueue_);
-    if(!response_->isActive() && !respQueue_.isEmpty()) {
-        response_->setSingleShot(true);
-        response_->start();
+    for(qint32 i = 0; i < batch.size(); ++i)
+    {
+        const Instrument& inst = batch[i];
+        if( inst.first == "FullUpdate" )
+            emit notifyInstrumentsUpdate();
+        else
+            emit notifyInstrumentUpdate(inst);
     }
 }
 
@@ -229,6 +475,12 @@ void Scheduler::onReconnectEvent()
 
     if( mgr->getState() != ForcedClosingState ) {
         CDebug() << "Reconnect: passed " << reconnectInterval_ << " msecs";
+        Metrics::reconnect(Metrics::Primary);
+        {
+            QMutexLocker g(&guardReconnect_);
+            attemptStart_ = Global::nanotime();
+            awaitingFirstTick_ = 1;
+        }
         QTimer::singleShot(0, mgr->parent(), SLOT(asyncStart()) );
     }
 }
@@ -247,6 +499,14 @@ void Scheduler::onTestrequestEvent()
         mgr->onHaveToTestRequest();
 }
 
+void Scheduler::onStaleEvent(const Instrument& inst)
+{
+    NetworkManager* mgr = manager();
+    if( mgr && mgr->model()->loggedIn() )
+        CDebug() << "Scheduler: no quotes of \"" << inst.first.c_str() << ":" << inst.second 
+                 << "\" for " << QUOTES_STALE_TIMEOUT/1000 << " secs";
+}
+
 NetworkManager* Scheduler::manager() const
 {
     NetworkManager* netman = qobject_cast<NetworkManager*>(parent());
@@ -2,14 +2,110 @@
 #define __scheduler_h__
 
 #include "marketabstractmodel.h"
+#include "timerwheel.h"
 
-#include <QTimer>
 #include <QSharedPointer>
+#include <QScopedPointer>
 #include <QMutex>
+#include <QHash>
+#include <QQueue>
+#include <QVector>
 
 class NetworkManager;
 
 ////////////////////////////////////
+// FIFO of instruments deduplicated by symbol. Enqueueing a symbol which is
+// already queued replaces it and moves it to the tail in O(1): the overtaken
+// entry stays in the FIFO and is dropped as stale when taken
+class InstrumentQueue
+{
+public:
+    InstrumentQueue() : seq_(0) {}
+
+    inline bool isEmpty() const
+    { return index_.isEmpty(); }
+
+    inline qint32 size() const
+    { return index_.size(); }
+
+    void push(const Instrument& inst);
+    void clear();
+
+    // Moves up to maxCount queued instruments to out in queue order
+    void take(QVector<Instrument>& out, qint32 maxCount);
+
+private:
+    struct Slot {
+        Instrument inst_;
+        quint32    seq_;    // sequence of the live FIFO entry
+    };
+    typedef QPair<QByteArray,quint32> Entry;
+
+    QHash<QByteArray,Slot> index_;
+    QQueue<Entry> fifo_;
+    quint32 seq_;
+};
+
+////////////////////////////////////
+// Token bucket of the outbound messages rate. Every sent message takes a token,
+// session messages are never held and may overdraw the bucket. Rate 0 - no pacing
+class MessagePacer
+{
+public:
+    MessagePacer();
+
+    void configure(qint32 rate, qint32 burst);
+    void consume();
+
+    // whole tokens ready to be spent
+    qint32 available();
+    // msecs up to the next token
+    qint32 waitTime();
+    // msecs to send depth messages at the configured rate
+    qint32 drainTime(qint32 depth);
+
+private:
+    void refill();
+
+private:
+    QMutex lock_;
+    qint64 refilled_;   // nanotime of the last refill
+    double tokens_;
+    qint32 rate_;
+    qint32 burst_;
+};
+
+////////////////////////////////////
+// Delays of reconnect attempts: the base delay doubled by every failed attempt
+// up to the max one, a random part up to jitter percents is taken off so
+// the clients dropped together don't come back together
+class ReconnectBackoff
+{
+public:
+    ReconnectBackoff();
+
+    void configure(qint32 base, qint32 max, qint32 jitter);
+    // msecs before the next attempt
+    qint32 next();
+    void reset();
+
+    inline qint32 attempts() const
+    { return attempts_; }
+
+private:
+    qint32  base_;
+    qint32  max_;
+    qint32  jitter_;
+    qint32  attempts_;
+    quint32 random_;
+};
+
+////////////////////////////////////
+// Session timers run on the thread of the TimerWheel: heartbeat, test request,
+// reconnect, requests pacing and staleness of every quoted instrument.
+// Responses are drained on the thread of the Scheduler (GUI).
+// Outbound application messages are paced by priority: session messages at
+// once, then subscribes and unsubscribes, then manual messages
 class Scheduler : public QObject
 {
     Q_OBJECT
@@ -23,15 +119,16 @@ class Scheduler : public QObject
     };
 
     friend class RequestTimer;
-    friend class ResponseTimer;
     friend class ReconnectTimer;
     friend class HeartbeatTimer;
     friend class TestrequestTimer;
+    friend class StaleTimer;
 public:
     Scheduler(QObject* parent);
     ~Scheduler();
 
     bool activateSSLReconnect();
+    void activateLoggedIn(qint32 heartbeatInterval);
     void activateLogout();
     void activateStartDialog();
     void activateHeartbeat(qint32 ms);
@@ -41,10 +138,41 @@ public:
     bool reconnectEnabled() const
     { return allowReconnect_; }
 
+    void configurePacing(qint32 rate, qint32 burst);
+    inline MessagePacer& pacer()
+    { return pacer_; }
+
+    // paced messages waiting for tokens and msecs to send them all
+    qint32 pacingDepth();
+    qint32 pacingDrainTime();
+
+    // time to the first quote after the last reconnect: msecs from the attempt
+    // and from the disconnect, -1 - not measured yet
+    inline bool awaitingFirstTick() const
+    { return awaitingFirstTick_ != 0; }
+    void recordFirstTick();
+    qint32 lastFirstTick() const;
+    qint32 lastOutage() const;
+
+    // shared with the standby session timers
+    inline TimerWheel* wheel()
+    { return wheel_.data(); }
+
+    // quote updates are queued and drained only for an observer (GUI table),
+    // the service doesn't pay for them
+    inline void setUpdatesObserved(bool on)
+    { updatesObserved_ = on; }
+
+Q_SIGNALS:
+    void notifyInstrumentUpdate(const Instrument& inst);
+    void notifyInstrumentsUpdate();
+
 protected slots:
     void activateRequest(const Instrument& inst);
+    void activateRequests(const QVector<Instrument>& batch);
+    void activateManual(const QByteArray& message);
     void activateResponse(const Instrument& inst);
-    void exec(TimerID id);
+    void exec(int id);
 
 protected:
     void onRequestEvent();
@@ -52,7 +180,8 @@ protected:
     void onReconnectEvent();
     void onHeartbeatEvent();
     void onTestrequestEvent();
-    
+    void onStaleEvent(const Instrument& inst);
+
 private:
     NetworkManager* manager() const;
     MarketAbstractModel* model() const;
@@ -60,29 +189,34 @@ private:
 private:
     bool allowReconnect_;
     int  reconnectInterval_;
-    
-    class SPair : public Instrument 
-    {
-    public:
-        SPair(){}
-        SPair(const Instrument& r): Instrument(r) {}
-        SPair(const std::string& first, qint32& second) : Instrument(first, second) {}
-        bool operator==(const Instrument& other) const 
-        { return (first == other.first); } // we insterested only in symbols dublication
-    };
-    typedef QVector<SPair> SPairQueue;
 
-    SPairQueue reqQueue_;
+    ReconnectBackoff backoff_;
+    mutable QMutex guardReconnect_;
+    qint64 outageStart_;    // nanotime of the disconnect up to the first quote, 0 - none
+    qint64 attemptStart_;   // nanotime of the last reconnect attempt
+    QAtomicInt awaitingFirstTick_;
+    qint32 lastFirstTick_;
+    qint32 lastOutage_;
+
+    InstrumentQueue reqQueue_;
+    QQueue<QByteArray> manualQueue_;
     QMutex guardReqQueue_;
+    MessagePacer pacer_;
+    bool throttled_;
 
-    SPairQueue respQueue_;
+    InstrumentQueue respQueue_;
     QMutex guardRespQueue_;
+    bool   responsePosted_;
+    bool   updatesObserved_;
+
+    QScopedPointer<TimerWheel> wheel_;
+    QSharedPointer<WheelTimer> requeste_;
+    QSharedPointer<WheelTimer> reconnect_;
+    QSharedPointer<WheelTimer> heartbeat_;
+    QSharedPointer<WheelTimer> testrequest_;
 
-    QSharedPointer<QTimer> requeste_;
-    QSharedPointer<QTimer> response_;
-    QSharedPointer<QTimer> reconnect_;
-    QSharedPointer<QTimer> heartbeat_;
-    QSharedPointer<QTimer> testrequest_;
+    // by instrument code, touched by the Scheduler thread only
+    QHash<qint32,WheelTimer*> staleTimers_;
 };
 
 #endif // __scheduler_h__
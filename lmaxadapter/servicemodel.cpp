@@ -0,0 +1,42 @@
+#include "globals.h"
+#include "servicemodel.h"
+#include "mqlproxyserver.h"
+
+//////////////////////////////////////////////////////////////
+ServiceModel::ServiceModel(QSharedPointer<MqlProxyServer>& mqlProxy, QObject* parent)
+    : FixDataModel(mqlProxy, parent)
+{
+    QObject::connect(this, SIGNAL(notifyInstrumentAdd(Instrument)), this, SLOT(onInstrumentAdd(Instrument)), Qt::DirectConnection);
+    QObject::connect(this, SIGNAL(notifyInstrumentRemove(Instrument,qint16)), this, SLOT(onInstrumentRemove(Instrument,qint16)), Qt::DirectConnection);
+    QObject::connect(this, SIGNAL(notifyInstrumentChange(Instrument,Instrument)), this, SLOT(onInstrumentChange(Instrument,Instrument)), Qt::DirectConnection);
+}
+
+ServiceModel::~ServiceModel()
+{}
+
+void ServiceModel::onInstrumentAdd(const Instrument& inst)
+{
+    CDebug() << "ServiceModel::onInstrumentAdd: \"" << inst.first.c_str() << ":" << inst.second << "\"";
+}
+
+void ServiceModel::onInstrumentRemove(const Instrument& inst, qint16 orderRow)
+{
+    Q_UNUSED(orderRow);
+    CDebug() << "ServiceModel::onInstrumentRemove: \"" << inst.first.c_str() << "\"";
+    removeCached( inst.second );
+}
+
+void ServiceModel::onInstrumentChange(const Instrument& old, const Instrument& cur)
+{
+    CDebug() << "ServiceModel::onInstrumentChange: \"" << old.first.c_str() << ":" << old.second
+             << "\" --> \"" << cur.first.c_str() << ":" << cur.second << "\"";
+
+    if( old.second != cur.second )
+        setMonitoring(old, false, true);
+    else if( old.first != cur.first )
+        setMonitoring(cur, false, true);
+    else
+        return;
+
+    setMonitoring(cur, true, true);
+}
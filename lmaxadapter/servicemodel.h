@@ -0,0 +1,25 @@
+#ifndef __servicemodel_h__
+#define __servicemodel_h__
+
+#include "fixdatamodel.h"
+
+class MqlProxyServer;
+
+////////////////////////////////////////////////////////////////////////
+// Market core: session, cache and MQL publishing of FixDataModel.
+// The GUI observes it through QuotesTableModel, the service runs it alone.
+class ServiceModel : public FixDataModel
+{
+    Q_OBJECT
+
+public:
+    ServiceModel(QSharedPointer<MqlProxyServer>& mqlProxy, QObject* parent);
+    ~ServiceModel();
+
+protected slots:
+    void onInstrumentAdd(const Instrument& inst);
+    void onInstrumentRemove(const Instrument& inst, qint16 orderRow);
+    void onInstrumentChange(const Instrument& old, const Instrument& cur);
+};
+
+#endif // __servicemodel_h__
@@ -86,6 +86,7 @@ void SetupDialog::resetInfo()
     sslMethod_->addItem(ProtoTLSv1_2x);
     sslMethod_->addItem(ProtoTLSv1_SSLv3);
     sslMethod_->addItem(ProtoSSLAny);
+    sslMethod_->addItem(ProtoPlainTCP);
     sslMethod_->connect(sslMethod_, SIGNAL(currentIndexChanged(int)), this, SLOT(onSecureMethodSelectionChanged(int)));
 
     QString secMethod = model_.value(ProtocolParam);
@@ -2,6 +2,7 @@
 
 #include "globals.h"
 #include "syserrorinfo.h"
+#include "latencyrecorder.h"
 #include "fix.h"
 
 
@@ -10,22 +11,59 @@
 #include <QSslConfiguration>
 #include <QWaitCondition>
 
+#ifdef WIN32
 #include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#endif
 #include <string>
+#include <string.h>
 
 #define SOCKET_BUFSIZE 0x2000
 
+namespace {
+    // Session tickets by "host:port", shared by the clients of the process
+    // so a recreated client resumes the session of the previous one
+    QMutex sessionCacheLock;
+    QHash<QString,QByteArray> sessionCache;
+
+    QByteArray cachedSession(const QString& key)
+    {
+        QMutexLocker g(&sessionCacheLock);
+        return sessionCache.value(key);
+    }
+
+    void cacheSession(const QString& key, const QByteArray& ticket)
+    {
+        QMutexLocker g(&sessionCacheLock);
+        if( ticket.isEmpty() )
+            sessionCache.remove(key);
+        else
+            sessionCache.insert(key, ticket);
+    }
+}
+
 //FILE *fcheck = NULL;
 
 /////////////////
 SslClient::SslClient(QSsl::SslProtocol protocol, RequestHandler* handler)
     : handler_(handler),
     running_(false),
+    reconnecting_(false),
+    spinExit_(0),
     proto_(protocol),
     ssl_(NULL),
     host_("not_configured"),
-    port_(443)
+    port_(443),
+    encrypted_(true)
 {
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.handshakeTime_ = -1;
+    stats_.kind_ = QtTransport;
+    stats_.spinCpu_ = -1;
     connect(this, SIGNAL(asyncSending(QByteArray)), this, SLOT(socketSendMessage(QByteArray)));
 }
 
@@ -38,7 +76,22 @@ SslClient::~SslClient()
     threadLock_ = NULL;
 }
 
-void SslClient::establish(const QString& host, quint16 port)
+void SslClient::setProfile(const SocketProfile& profile)
+{
+    profile_ = profile;
+}
+
+const SocketProfile& SslClient::profile() const
+{
+    return profile_;
+}
+
+void SslClient::send(const QByteArray& message)
+{
+    emit asyncSending(message);
+}
+
+void SslClient::establish(const QString& host, quint16 port, bool encrypted)
 {
     threadLock_  = new QMutex();
     threadEvent_ = new QWaitCondition();
@@ -46,6 +99,7 @@ void SslClient::establish(const QString& host, quint16 port)
     QMutexLocker blocked(threadLock_);
     host_ = host;
     port_ = port;
+    encrypted_ = encrypted;
 
     start();
     threadEvent_->wait(threadLock_);
@@ -63,8 +117,6 @@ void SslClient::establish(const QString& host, quint16 port)
             this, SLOT(sslErrors(QList<QSslError>)), Qt::DirectConnection);
     connect(ssl_.data(), SIGNAL(readyRead()), 
             this, SLOT(socketReadyRead()), Qt::DirectConnection);
-
-    ConfigureForLMAX();
 }
 
 void SslClient::run()
@@ -73,25 +125,116 @@ void SslClient::run()
     Q_ASSERT_X(ssl_.isNull(),"SslClient::run", "Socket object reuse");
 
     ssl_.reset(new QSslSocket(this));
-    ssl_->connectToHostEncrypted(host_,port_);
+    ConfigureForLMAX();
+    connectSocket();
 
     running_ = true;
     threadEvent_->wakeOne();
 
     { QMutexLocker blocked(threadLock_); }
-    QThread::exec();
+
+    qint32 pinned = -1;
+    if( profile_.level_ == SocketProfile::SpinLevel && profile_.cpu_ >= 0 ) {
+        if( Global::pinThread(profile_.cpu_) )
+            pinned = profile_.cpu_;
+        else
+            CDebug() << "SslClient: cannot pin the receiving thread to CPU " << profile_.cpu_;
+    }
+    {
+        QMutexLocker g(&statsLock_);
+        stats_.spinCpu_ = pinned;
+    }
+
+    while( true )
+    {
+        runLoop();
+        if( !running_ || !reconnecting_ )
+            break;
+
+        // the same socket connects again, signals and configuration stay
+        QMutexLocker blocked(threadLock_);
+        reconnecting_ = false;
+        ssl_->abort();
+        connectSocket();
+    }
 
     QMutexLocker blocked(threadLock_);
     ssl_->close();
     ssl_.reset();
 }
 
+// The spinning loop polls the socket notifiers without sleeping
+void SslClient::runLoop()
+{
+    if( profile_.level_ != SocketProfile::SpinLevel ) {
+        QThread::exec();
+        return;
+    }
+
+    spinExit_ = 0;
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    while( !spinExit_ )
+        dispatcher->processEvents(QEventLoop::AllEvents);
+}
+
+void SslClient::quitLoop()
+{
+    if( profile_.level_ == SocketProfile::SpinLevel )
+        spinExit_ = 1;
+    else
+        exit();
+}
+
+void SslClient::connectSocket()
+{
+    framer_.reset();
+
+    bool resume = false;
+    if( encrypted_ )
+    {
+        QSslConfiguration config = config_;
+        QByteArray ticket = cachedSession(QString("%1:%2").arg(host_).arg(port_));
+        if( !ticket.isEmpty() ) {
+            config.setSessionTicket(ticket);
+            resume = true;
+        }
+        ssl_->setSslConfiguration(config);
+    }
+
+    {
+        QMutexLocker g(&statsLock_);
+        ++stats_.connects_;
+        stats_.resumeOffered_ += resume ? 1 : 0;
+        stats_.lastResumeOffered_ = resume;
+    }
+    connectClock_.start();
+
+    if( encrypted_ )
+        ssl_->connectToHostEncrypted(host_,port_);
+    else
+        ssl_->connectToHost(host_,port_);
+}
+
+bool SslClient::reconnect(QSsl::SslProtocol proto, const QString& host, quint16 port, bool encrypted)
+{
+    if( !running_ || !isRunning() || proto != proto_ )
+        return false;
+
+    QMutexLocker blocked(threadLock_);
+    host_ = host;
+    port_ = port;
+    encrypted_ = encrypted;
+    reconnecting_ = true;
+    quitLoop();
+    return true;
+}
+
 void SslClient::stop()
 {
     running_ = false;
     {
         QMutexLocker blocked(threadLock_);
-        exit();
+        quitLoop();
     }
     wait();
 }
@@ -106,9 +249,52 @@ void SslClient::ConfigureForLMAX()
 
     config.setPeerVerifyMode(QSslSocket::VerifyNone);
     config.setSslOption(QSsl::SslOptionDisableServerNameIndication, true);
+    // keep the session of the handshake to offer it on reconnect
+    config.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+    config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    config_ = config;
     ssl_->setSslConfiguration(config);
 }
 
+// Called on the thread of the socket when it's connected
+void SslClient::applyProfile()
+{
+    if( profile_.level_ >= SocketProfile::LowLatencyLevel )
+        ssl_->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    if( profile_.buffer_ > 0 ) {
+        ssl_->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, profile_.buffer_);
+        ssl_->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, profile_.buffer_);
+    }
+
+    qint32 busyPoll = 0;
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    if( profile_.level_ >= SocketProfile::LowLatencyLevel ) {
+        int fd = int(ssl_->socketDescriptor());
+        int usecs = SOCKET_BUSY_POLL_USECS;
+        if( 0 == setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) )
+            busyPoll = usecs;
+        else
+            CDebug() << "SslClient: SO_BUSY_POLL is not permitted, errno " << errno;
+    }
+#endif
+
+    QMutexLocker g(&statsLock_);
+    stats_.level_ = profile_.level_;
+    stats_.noDelay_ = ssl_->socketOption(QAbstractSocket::LowDelayOption).toInt();
+    stats_.recvBuffer_ = ssl_->socketOption(QAbstractSocket::ReceiveBufferSizeSocketOption).toInt();
+    stats_.sendBuffer_ = ssl_->socketOption(QAbstractSocket::SendBufferSizeSocketOption).toInt();
+    stats_.busyPoll_ = busyPoll;
+    CDebug() << "SslClient: socket profile " << stats_.level_ << ", nodelay " << stats_.noDelay_ 
+             << ", buffers " << stats_.recvBuffer_ << "/" << stats_.sendBuffer_ 
+             << ", busy poll " << stats_.busyPoll_ << " usecs, spin CPU " << stats_.spinCpu_;
+}
+
+TransportStats SslClient::stats() const
+{
+    QMutexLocker g(&statsLock_);
+    return stats_;
+}
+
 void SslClient::socketSendMessage(const QByteArray& message)
 {
     if( !running_ )
@@ -133,7 +319,17 @@ void SslClient::socketReadyRead()
     if( !ssl_->bytesAvailable() )
         return;
     
+    // QSslSocket has no kernel stamps, the read time is the nearest one
+    qint64 rxNanos = Global::nanotime();
     QByteArray message = ssl_->read(SOCKET_BUFSIZE);
+
+#if defined(__linux__) && defined(TCP_QUICKACK)
+    // the kernel falls back to delayed ACKs after every read
+    if( profile_.level_ >= SocketProfile::LowLatencyLevel ) {
+        int on = 1;
+        setsockopt(int(ssl_->socketDescriptor()), IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+    }
+#endif
     if( 0 == message.size() ) 
     {
         QList<QSslError> errLst = ssl_->sslErrors();
@@ -177,7 +373,13 @@ void SslClient::socketReadyRead()
                 }
             }
         }*/
-        handler_->onMessageReceived(message);
+        // a read may carry several messages or a part of one
+        framer_.append(message.constData(), message.size());
+        QByteArray fixMessage;
+        while( framer_.next(fixMessage) ) {
+            LatencyRecorder::record(LatencyRecorder::ReadToFrame, Global::nanotime() - rxNanos);
+            handler_->onMessageReceived(fixMessage, rxNanos);
+        }
     }
 }
 
@@ -200,6 +402,14 @@ void SslClient::socketStateChanged(QAbstractSocket::SocketState state)
         uiState = ProgressState;
         break;
     case QSslSocket::ConnectedState:
+        {
+            QMutexLocker g(&statsLock_);
+            stats_.connectTime_ = qint32(connectClock_.elapsed());
+            stats_.handshakeTime_ = -1;
+        }
+        connectClock_.start();
+        applyProfile();
+        // fall through
     case QSslSocket::BoundState:
     case QSslSocket::ListeningState:
         ioError_.clear();
@@ -218,6 +428,14 @@ void SslClient::socketEncrypted()
     QString cipher = QString("%1, %2 (%3/%4)").arg(ciph.authenticationMethod())
                      .arg(ciph.name()).arg(ciph.usedBits()).arg(ciph.supportedBits());
     CDebug() << "SSL cipher " << cipher;
+
+    QSslConfiguration config = ssl_->sslConfiguration();
+    cacheSession(QString("%1:%2").arg(host_).arg(port_), config.sessionTicket());
+
+    QMutexLocker g(&statsLock_);
+    stats_.handshakeTime_ = qint32(connectClock_.elapsed());
+    CDebug() << "SSL handshake " << stats_.handshakeTime_ << " msecs after TCP connect in " 
+             << stats_.connectTime_ << " msecs" << (stats_.lastResumeOffered_ ? ", session ticket offered" : "");
 }
 
 
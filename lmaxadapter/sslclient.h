@@ -1,22 +1,26 @@
 #ifndef __ssl_client_h__
 #define __ssl_client_h__
 
-#include "requesthandler.h"
+#include "fixtransport.h"
+#include "fixframer.h"
 
 #include <QThread>
 #include <QSsl>
 #include <QSslError>
 #include <QAbstractSocket>
 #include <QSharedPointer>
+#include <QSslConfiguration>
+#include <QElapsedTimer>
+#include <QMutex>
 
 QT_BEGIN_NAMESPACE;
 class QSslSocket;
 class QWaitCondition;
-class QMutex;
 QT_END_NAMESPACE;
 
 //////////////////////////////////////////////////////////////
-class SslClient : public QThread
+// QtTransport: QSslSocket driven by the event loop of the client thread
+class SslClient : public QThread, public FixTransport
 {
     Q_OBJECT
 
@@ -24,8 +28,15 @@ public:
     SslClient(QSsl::SslProtocol proto = QSsl::TlsV1_1OrLater, RequestHandler* handler = NULL);
     ~SslClient();
 
-    void establish(const QString& host, quint16 port);
+    void setProfile(const SocketProfile& profile);
+    const SocketProfile& profile() const;
+
+    void establish(const QString& host, quint16 port, bool encrypted = true);
+    // The thread, the socket and its TLS configuration are kept
+    bool reconnect(QSsl::SslProtocol proto, const QString& host, quint16 port, bool encrypted);
+    void send(const QByteArray& message);
     QString lastError() const; 
+    TransportStats stats() const;
 
 Q_SIGNALS:
     void asyncSending(const QByteArray& message);
@@ -42,6 +53,10 @@ private:
     void setIOError(const QString& error) const;
     void handleDisconnectError(QAbstractSocket::SocketError sockError);
     void ConfigureForLMAX();
+    void connectSocket();
+    void applyProfile();
+    void runLoop();
+    void quitLoop();
     void run();
     void stop();
 
@@ -51,10 +66,22 @@ private:
     QWaitCondition*     threadEvent_;
     QMutex*             threadLock_;
     QAtomicInt          running_;
+    QAtomicInt          reconnecting_;
     QSsl::SslProtocol   proto_;
     QString             host_;
     quint16             port_;
+    bool                encrypted_;
     mutable QString     ioError_;
+
+    // built once and reused by every connect, the session ticket
+    // of the last handshake with the host is set in before connecting
+    QSslConfiguration   config_;
+    SocketProfile       profile_;
+    QAtomicInt          spinExit_;
+    QElapsedTimer       connectClock_;
+    mutable QMutex      statsLock_;
+    TransportStats      stats_;
+    FixFramer           framer_;
 };
 
 #endif // __ssl_client_h__
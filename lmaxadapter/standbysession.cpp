@@ -0,0 +1,411 @@
+#include "globals.h"
+#include "standbysession.h"
+#include "fixdatamodel.h"
+#include "fixtransport.h"
+#include "metrics.h"
+
+#include <QtCore>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////
+class StandbyTimer: public WheelTimer {
+public:
+    StandbyTimer(StandbySession* parent, int id) : parent_(parent), id_(id) {}
+    void expired() {
+        parent_->exec(id_);
+    }
+private:
+    StandbySession* parent_;
+    int id_;
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+StandbySession::StandbySession(FixDataModel* primary, Scheduler* scheduler, QObject* parent)
+    : QObject(parent),
+    primary_(primary),
+    wheel_(scheduler->wheel()),
+    lock_(QMutex::Recursive),
+    active_(0),
+    rxNanos_(0),
+    port_(0),
+    proto_(QSsl::AnyProtocol),
+    encrypted_(true),
+    pacing_(new StandbyTimer(this, PacingTimerID) ),
+    reconnect_(new StandbyTimer(this, ReconnectTimerID) ),
+    heartbeat_(new StandbyTimer(this, HeartbeatTimerID) ),
+    testrequest_(new StandbyTimer(this, TestrequestTimerID) )
+{
+    // the same account and pacing as the primary, its own sequence numbers
+    setIniModel(dynamic_cast<const BaseIni*>(primary));
+    setJournalFile(FILENAME_JOURNAL_STANDBY);
+    pacer_.configure(primary->value(MessageRateParam).toInt(),
+                     primary->value(MessageBurstParam).toInt());
+}
+
+StandbySession::~StandbySession()
+{
+    stop();
+}
+
+void StandbySession::start(const QString& host, quint16 port, QSsl::SslProtocol proto, bool encrypted)
+{
+    host_ = host;
+    port_ = port;
+    proto_ = proto;
+    encrypted_ = encrypted;
+    active_ = 1;
+    asyncStart();
+}
+
+// The connection is closed first, its thread arms no more timers after that.
+// The callbacks in flight on the wheel thread are waited for, so the session
+// can be destroyed right after
+void StandbySession::stop()
+{
+    active_ = 0;
+    {
+        QScopedPointer<FixTransport> closing;
+        {
+            QMutexLocker g(&lock_);
+            onHaveToLogout();
+            closing.reset(connection_.take());
+        }
+    }
+
+    wheel_->cancelAndWait(pacing_.data());
+    wheel_->cancelAndWait(reconnect_.data());
+    wheel_->cancelAndWait(heartbeat_.data());
+    wheel_->cancelAndWait(testrequest_.data());
+}
+
+// Drops the connection if any and connects anew, on the GUI thread
+void StandbySession::asyncStart()
+{
+    {
+        QScopedPointer<FixTransport> closing;
+        {
+            QMutexLocker g(&lock_);
+            setLoggedIn(false);
+            closing.reset(connection_.take());
+        }
+    }
+
+    // the closed connection doesn't schedule one more reconnect
+    wheel_->cancel(reconnect_.data());
+    if( !active_ )
+        return;
+
+    CDebug() << "Standby: connecting to " << host_ << ":" << port_;
+    QMutexLocker g(&lock_);
+    connection_.reset(FixTransport::create(primary_->value(TransportParam).toInt(), proto_, this));
+
+    // socket options of the primary, the spinning CPU is left to the primary
+    SocketProfile profile;
+    profile.level_ = qMin(primary_->value(LatencyProfileParam).toInt(), qint32(SocketProfile::LowLatencyLevel));
+    profile.buffer_ = primary_->value(SocketBufferParam).toInt();
+    connection_->setProfile(profile);
+    connection_->establish(host_, port_, encrypted_);
+}
+
+void StandbySession::dropConnection()
+{
+    QMutexLocker g(&lock_);
+    setLoggedIn(false);
+    setTestRequestSent(false);
+    wheel_->cancel(pacing_.data());
+    wheel_->cancel(heartbeat_.data());
+    wheel_->cancel(testrequest_.data());
+    if( active_ )
+        wheel_->arm(reconnect_.data(), STANDBY_RECONNECT_DELAY);
+}
+
+// Called on the wheel thread
+void StandbySession::exec(int id)
+{
+    if( id == ReconnectTimerID ) {
+        if( active_ ) {
+            Metrics::reconnect(Metrics::Standby);
+            QMetaObject::invokeMethod(this, "asyncStart", Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    QMutexLocker g(&lock_);
+    if( !active_ )
+        return;
+
+    if( id == PacingTimerID )
+        onPacingEvent();
+    else if( id == HeartbeatTimerID )
+        onHaveToHeartbeat();
+    else if( id == TestrequestTimerID )
+        onHaveToTestRequest();
+}
+
+void StandbySession::subscribe(const Instrument& inst)
+{
+    QMutexLocker g(&lock_);
+    if( !loggedIn() || subscribed_.contains(inst.second) || pending_.contains(inst) )
+        return;     // all the monitored instruments are subscribed on logon
+
+    pending_.enqueue(inst);
+    wheel_->arm(pacing_.data(), 0);
+}
+
+void StandbySession::unsubscribe(const Instrument& inst)
+{
+    QMutexLocker g(&lock_);
+    pending_.removeAll(inst);
+    if( subscribed_.remove(inst.second) && loggedIn() )
+        onHaveToSendMessage( makeMarketUnSubscribe(inst.first.c_str(), inst.second) );
+}
+
+void StandbySession::onPacingEvent()
+{
+    if( !loggedIn() )
+        return;
+
+    qint32 tokens = pacer_.available();
+    while( tokens-- > 0 && !pending_.isEmpty() ) {
+        Instrument inst = pending_.dequeue();
+        subscribed_.insert(inst.second);
+        onHaveToSendMessage( makeMarketSubscribe(inst.first.c_str(), inst.second) );
+    }
+
+    if( !pending_.isEmpty() )
+        wheel_->arm(pacing_.data(), qMax(pacer_.waitTime(), 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+void StandbySession::onStateChanged(ConnectionState state)
+{
+    switch( state )
+    {
+    case Establish:
+    case EstablishWithWarning:
+        onHaveToLogin();
+        break;
+    case DisconnectByFailure:
+    case DisconnectByRemote:
+    case ForcedClosing:
+        // the GUI thread closes the connection out of the lock
+        CDebug() << "Standby: disconnected from " << host_ << ":" << port_;
+        dropConnection();
+        break;
+    default:
+        break;
+    }
+}
+
+void StandbySession::onMessageReceived(const QByteArray& message, qint64 rxNanos)
+{
+    QMutexLocker g(&lock_);
+    if( !active_ )
+        return;
+
+    lastIncomingTime_ = Global::time();
+    rxNanos_ = rxNanos;
+    setTestRequestSent(false);
+
+    string value = getField(message, "35");
+    char type = value.empty() ? 0 : value[0];
+    Metrics::messageIn(Metrics::Standby, type);
+
+    // the same sequencing as of the primary session
+    Admission admission = admitInbound(message, type);
+    if( admission != AdmitProcess ) {
+        if( admission == AdmitDrop ) {
+            flushOutgoing();
+            dropConnection();
+        }
+        return;
+    }
+
+    switch(type)
+    {
+    case 'A':
+        onLogon(message);
+        break;
+    case '0':
+        onHeartbeat(message);
+        break;
+    case '1':
+        onTestRequest(message);
+        break;
+    case '2':
+        onResendRequest(message);
+        break;
+    case '3':
+        onSessionReject(message);
+        break;
+    case '4':
+        applySequenceReset(message);
+        break;
+    case '5':
+        onLogout(message);
+        break;
+    case 'W':
+        onMarketData(message);
+        break;
+    case 'Y':
+        onMarketDataReject(message);
+        break;
+    default:
+        CDebug() << "Standby: unexpected message type=\"" << value.c_str() << "\" received";
+        break;
+    }
+    flushOutgoing();
+}
+
+void StandbySession::flushOutgoing()
+{
+    QByteArray message = takeOutgoing();
+    while( !message.isEmpty() ) {
+        onHaveToSendMessage(message);
+        message = takeOutgoing();
+    }
+}
+
+void StandbySession::onHaveToLogin()
+{
+    QMutexLocker g(&lock_);
+    if( loggedIn() )
+        return;
+    onHaveToSendMessage( makeLogon() );
+}
+
+void StandbySession::onHaveToLogout()
+{
+    QMutexLocker g(&lock_);
+    pending_.clear();
+    subscribed_.clear();
+    if( !loggedIn() )
+        return;
+
+    onHaveToSendMessage( makeLogout() );
+    setLoggedIn(false);
+}
+
+void StandbySession::onHaveToTestRequest()
+{
+    if( !loggedIn() )
+        return;
+
+    int hbi = getHeartbeatInterval() + 1000;
+    qint64 delta = Global::time() - getLastIncoming();
+    if( delta >= hbi )
+    {
+        if( testRequestSent() ) {
+            CDebug() << "Standby: no answer on TestRequest, reconnecting";
+            dropConnection();
+            return;
+        }
+        onHaveToSendMessage( makeTestRequest() );
+        delta = hbi;
+    }
+    else
+        delta = hbi - delta;
+
+    wheel_->arm(testrequest_.data(), qint32(delta));
+}
+
+void StandbySession::onHaveToHeartbeat()
+{
+    if( !loggedIn() )
+        return;
+
+    int hbi = getHeartbeatInterval();
+    qint64 delta = Global::time() - getLastOutgoing();
+    if( delta >= hbi )
+    {
+        onHaveToSendMessage( makeHeartBeat() );
+        delta = hbi;
+    }
+    else
+        delta = hbi - delta;
+
+    wheel_->arm(heartbeat_.data(), qint32(delta));
+}
+
+bool StandbySession::onHaveToSendMessage(const QByteArray& message)
+{
+    QMutexLocker g(&lock_);
+    if( message.isEmpty() || connection_.isNull() )
+        return false;
+
+    string type = getField(message,"35");
+    if( type != "0" )
+        CDebug() << "Standby >> " << message;
+
+    pacer_.consume();
+    journalOutgoing(message);
+    lastOutgoingTime_ = Global::time();
+    connection_->send(message);
+    if( !type.empty() )
+        Metrics::messageOut(Metrics::Standby, type[0]);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+void StandbySession::onLogon(const QByteArray& message)
+{
+    CDebug() << "Standby: logged in to " << host_ << ":" << port_;
+    setLoggedIn(true);
+    wheel_->arm(heartbeat_.data(), getHeartbeatInterval());
+    wheel_->arm(testrequest_.data(), getHeartbeatInterval());
+
+    // every instrument of the primary is subscribed anew
+    QVector<string> monitored;
+    primary_->getSymbolsUnderMonitoring(monitored);
+
+    pending_.clear();
+    subscribed_.clear();
+    for(qint32 i = 0; i < monitored.size(); ++i) {
+        qint32 code = primary_->getCode(monitored[i].c_str());
+        if( code != -1 )
+            pending_.enqueue( Instrument(monitored[i], code) );
+    }
+    wheel_->arm(pacing_.data(), 0);
+}
+
+void StandbySession::onLogout(const QByteArray& message)
+{
+    CDebug() << "Standby: logout received, reason \"" << getField(message,"58").c_str() << "\"";
+    dropConnection();
+}
+
+void StandbySession::onHeartbeat(const QByteArray& message)
+{}
+
+void StandbySession::onTestRequest(const QByteArray& message)
+{
+    string reqId = getField(message,"112");
+    if( !reqId.empty() )
+        queueOutgoing("0", QByteArray("112=").append(reqId.c_str()).append(SOH));
+}
+
+void StandbySession::onResendRequest(const QByteArray& message)
+{
+    quint32 beginSeq = strtoul(getField(message,"7").c_str(), NULL, 10);
+    quint32 endSeq = strtoul(getField(message,"16").c_str(), NULL, 10);
+    if( beginSeq )
+        resend(beginSeq, endSeq);
+}
+
+void StandbySession::onMarketData(const QByteArray& message)
+{
+    primary_->feedMarketData(message, rxNanos_);
+}
+
+void StandbySession::onMarketDataReject(const QByteArray& message)
+{
+    CDebug() << "Standby: MarketDataRequestReject type=\"Y\" of \"" << getField(message,"262").c_str()
+             << "\", reason \"" << getField(message,"58").c_str() << "\"";
+}
+
+void StandbySession::onSessionReject(const QByteArray& message)
+{
+    CDebug() << "Standby: SessionReject type=\"3\" of MsgSeqNum " << getField(message,"45").c_str()
+             << ", reason \"" << getField(message,"58").c_str() << "\"";
+}
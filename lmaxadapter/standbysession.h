@@ -0,0 +1,104 @@
+#ifndef __standbysession_h__
+#define __standbysession_h__
+
+#include "requesthandler.h"
+#include "marketabstractmodel.h"
+#include "scheduler.h"
+#include "fix.h"
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QSsl>
+
+class FixDataModel;
+class FixTransport;
+
+////////////////////////////////////////////////////////////////////////////////
+// Hot standby FIX session to the same or a secondary host, logged in and
+// subscribed in parallel with the primary one. Its market data is merged into
+// the cache of the primary model where the freshest quote wins, so quotes go on
+// while either session is down. Subscribes are mirrored from the primary,
+// the session reconnects by itself and its timers run on the Scheduler wheel
+class StandbySession : public QObject, public RequestHandler, public FIX
+{
+    Q_OBJECT
+
+    enum TimerID {
+        PacingTimerID = 0,
+        ReconnectTimerID,
+        HeartbeatTimerID,
+        TestrequestTimerID,
+    };
+
+    friend class StandbyTimer;
+public:
+    StandbySession(FixDataModel* primary, Scheduler* scheduler, QObject* parent);
+    ~StandbySession();
+
+    void start(const QString& host, quint16 port, QSsl::SslProtocol proto, bool encrypted);
+    void stop();
+
+    void subscribe(const Instrument& inst);
+    void unsubscribe(const Instrument& inst);
+
+    // called by the thread of the connection
+    void onStateChanged(ConnectionState state);
+    void onMessageReceived(const QByteArray& message, qint64 rxNanos);
+
+    void onHaveToLogin();
+    void onHaveToLogout();
+    void onHaveToTestRequest();
+    void onHaveToHeartbeat();
+    bool onHaveToSendMessage(const QByteArray& message);
+
+protected slots:
+    void asyncStart();
+
+protected:
+    void exec(int id);
+    void onPacingEvent();
+
+protected:
+    void onLogon(const QByteArray& message);
+    void onLogout(const QByteArray& message);
+    void onHeartbeat(const QByteArray& message);
+    void onTestRequest(const QByteArray& message);
+    void onResendRequest(const QByteArray& message);
+    void onMarketData(const QByteArray& message);
+    void onMarketDataReject(const QByteArray& message);
+    void onSessionReject(const QByteArray& message);
+
+private:
+    void dropConnection();
+    void flushOutgoing();
+
+private:
+    FixDataModel* primary_;
+    TimerWheel*   wheel_;
+    QScopedPointer<FixTransport> connection_;
+
+    // session state and the connection, taken by the connection,
+    // the wheel and the GUI threads
+    QMutex      lock_;
+    QAtomicInt  active_;
+    qint64      rxNanos_;   // receive time of the message in process
+
+    QString     host_;
+    quint16     port_;
+    QSsl::SslProtocol proto_;
+    bool        encrypted_;
+
+    MessagePacer pacer_;
+    QQueue<Instrument> pending_;
+    QSet<qint32> subscribed_;
+
+    QScopedPointer<WheelTimer> pacing_;
+    QScopedPointer<WheelTimer> reconnect_;
+    QScopedPointer<WheelTimer> heartbeat_;
+    QScopedPointer<WheelTimer> testrequest_;
+};
+
+#endif // __standbysession_h__
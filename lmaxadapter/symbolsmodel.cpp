@@ -1,8 +1,6 @@
 #include "globals.h"
 #include "symbolsmodel.h"
 
-#include <QWidget>
-
 using namespace std;
 ///////////////////////////////////////////////////////////////////////////////////
 
@@ -177,10 +175,10 @@ const int DefaultCodes[] = {
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
-SymbolsModel::SymbolsModel(QWidget* parent)
-    : QAbstractTableModel(parent),
+SymbolsModel::SymbolsModel(QObject* parent)
+    : QObject(parent),
     hash_(new SymHash()),
-    hashLock_(new QReadWriteLock()),
+    hashLock_(new RWLockDbg("hashLock_")),
     monitoringStateLock_(new QReadWriteLock()),
     suspend_(false)
 {
@@ -301,7 +299,7 @@ void SymbolsModel::loadIni()
 
 void SymbolsModel::saveIni()
 {
-    QWriteLocker g(hashLock_);
+    DWriteLocker g(hashLock_, LOCK_SITE);
 
     BaseIni::saveIni();
 
@@ -357,7 +355,7 @@ void SymbolsModel::setMonitoring(const Instrument& inst, bool enable, bool force
     Instrument fixed = inst;
     qint16 orderRow = -1;
     {
-        QWriteLocker g(hashLock_);
+        DWriteLocker g(hashLock_, LOCK_SITE);
         const char* sym = inst.first.c_str();
         qint32 code = (*hash_)[sym];
         if( code != -1 && code != inst.second ) {
@@ -3,6 +3,7 @@
 
 #include "baseini.h"
 #include "marketabstractmodel.h"
+#include "rwlock-dbg.h"
 
 #include <QReadWriteLock>
 #include <QMap>
@@ -132,13 +133,13 @@ private:
 };
 
 ////////////////////////////////////////////////////////////////////////
-class SymbolsModel : public QAbstractTableModel, 
+class SymbolsModel : public QObject, 
                      public BaseIni,
                      public MarketAbstractModel
 {
     Q_OBJECT
 public:
-    SymbolsModel(QWidget* parent);
+    SymbolsModel(QObject* parent);
     ~SymbolsModel();
 
     inline const char* getSymbol(qint32 code) const;
@@ -179,6 +180,7 @@ public:
 
 Q_SIGNALS:
     void activateRequest(const Instrument& instrument);
+    void activateRequests(const QVector<Instrument>& instruments);
     void activateResponse(const Instrument& instrument);
     void notifySendingManual(const QByteArray& message);
     void notifyInstrumentAdd(const Instrument& inst);
@@ -204,7 +206,7 @@ private:
 
 private:
     SymHash* hash_;
-    QReadWriteLock*  hashLock_;
+    RWLockDbg*  hashLock_;
     QReadWriteLock*  monitoringStateLock_;
     std::set<QString> clobalCommitToAdd_;
     std::set<QString> clobalCommitToRemove_;
@@ -214,7 +216,7 @@ private:
 
 inline qint16 SymbolsModel::monitoredCount() const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return hash_->mountedCount();
 }
 
@@ -225,7 +227,7 @@ inline qint16 SymbolsModel::monitoredCount_unlocked() const
 
 inline bool SymbolsModel::isMonitored(const Instrument& inst) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
 
     const char* sym = inst.first.c_str();
     qint32 code = (*hash_)[sym];
@@ -259,7 +261,7 @@ inline void SymbolsModel::setMonitoringEnabled(bool enable)
 
 inline const char* SymbolsModel::getSymbol(qint32 code) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return (*hash_)[code];
 }
 
@@ -270,25 +272,25 @@ inline std::string SymbolsModel::getSymbol_unlocked(qint32 code) const
 
 inline qint32 SymbolsModel::getCode(const QString& sym) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return (*hash_)[sym];
 }
 
 inline qint32 SymbolsModel::getCode(const char* sym) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return (*hash_)[sym];
 }
 
 inline qint16 SymbolsModel::getOrderRow(const char* sym) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return hash_->orderRow(sym);
 }
 
 inline qint16 SymbolsModel::getOrderRow(const QString& sym) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     return hash_->orderRow(sym);
 }
 
@@ -300,7 +302,7 @@ inline qint16 SymbolsModel::getOrderRow_unlocked(const char* sym) const
 
 inline Instrument SymbolsModel::getByOrderRow(qint16 row) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     const char* sym = hash_->byOrderRow(row);
     return Instrument(sym ? sym : "", sym ? (*hash_)[sym] : -1);
 }
@@ -312,7 +314,7 @@ inline void SymbolsModel::getSymbolsSupported(QVector<const char*>& out) const
 
 inline void SymbolsModel::getSymbolsUnderMonitoring(QVector<std::string>& out) const
 {
-    QReadLocker g(hashLock_);
+    DReadLocker g(hashLock_, LOCK_SITE);
     hash_->symbolsMounted(out);
 }
 
@@ -0,0 +1,227 @@
+#include "globals.h"
+#include "timerwheel.h"
+
+namespace {
+    inline void initHead(WheelLink& head)
+    {
+        head.next_ = head.prev_ = &head;
+    }
+
+    const quint64 NeverTick = ~quint64(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TimerWheel::TimerWheel(QObject* parent)
+    : QThread(parent),
+    running_(NULL),
+    now_(0),
+    wakeAt_(NeverTick),
+    armed_(0),
+    stopping_(false)
+{
+    for(qint32 i = 0; i < NearSize; ++i)
+        initHead(near_[i]);
+    for(qint32 l = 0; l < Levels; ++l)
+        for(qint32 i = 0; i < LevelSize; ++i)
+            initHead(levels_[l][i]);
+
+    clock_.start();
+    start();
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+void TimerWheel::stop()
+{
+    {
+        QMutexLocker g(&lock_);
+        stopping_ = true;
+        wakeup_.wakeOne();
+    }
+    wait();
+}
+
+quint32 TimerWheel::armedCount() const
+{
+    QMutexLocker g(&lock_);
+    return armed_;
+}
+
+void TimerWheel::arm(WheelTimer* timer, qint32 msecs)
+{
+    QMutexLocker g(&lock_);
+    if( timer->isActive() )
+        unlink(timer);
+    else
+        ++armed_;
+
+    // now_ lags the clock while the thread sleeps, delays are counted from the clock
+    quint64 current = qMax(now_, (quint64)clock_.elapsed());
+    timer->expires_ = current + qMax(msecs, 0);
+    link(timer);
+
+    if( timer->expires_ < wakeAt_ )
+        wakeup_.wakeOne();
+}
+
+void TimerWheel::cancel(WheelTimer* timer)
+{
+    QMutexLocker g(&lock_);
+    if( timer->isActive() ) {
+        unlink(timer);
+        --armed_;
+    }
+}
+
+void TimerWheel::cancelAndWait(WheelTimer* timer)
+{
+    QMutexLocker g(&lock_);
+    while( running_ == timer && QThread::currentThread() != this )
+        finished_.wait(&lock_);
+
+    // the finished callback may have rearmed it
+    if( timer->isActive() ) {
+        unlink(timer);
+        --armed_;
+    }
+}
+
+void TimerWheel::link(WheelTimer* timer)
+{
+    if( timer->expires_ < now_ )
+        timer->expires_ = now_;
+
+    quint64 delta = timer->expires_ - now_;
+    WheelLink* head = NULL;
+    if( delta < NearSize ) {
+        head = &near_[timer->expires_ & (NearSize - 1)];
+    }
+    else {
+        qint32 level = 0;
+        quint64 span = quint64(NearSize) << LevelBits;
+        while( level < Levels - 1 && delta >= span ) {
+            ++level;
+            span <<= LevelBits;
+        }
+        if( delta >= span )
+            timer->expires_ = now_ + span - 1;
+
+        quint32 index = (timer->expires_ >> (NearBits + level*LevelBits)) & (LevelSize - 1);
+        head = &levels_[level][index];
+    }
+
+    WheelLink* node = timer;
+    node->next_ = head;
+    node->prev_ = head->prev_;
+    head->prev_->next_ = node;
+    head->prev_ = node;
+}
+
+void TimerWheel::unlink(WheelTimer* timer)
+{
+    WheelLink* node = timer;
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->next_ = node->prev_ = NULL;
+}
+
+// Moves the timers of the current slot of the level down to the lower levels
+void TimerWheel::cascade(qint32 level)
+{
+    quint32 index = (now_ >> (NearBits + level*LevelBits)) & (LevelSize - 1);
+    WheelLink& head = levels_[level][index];
+    while( !isEmpty(head) )
+    {
+        WheelTimer* timer = static_cast<WheelTimer*>(head.next_);
+        unlink(timer);
+        link(timer);
+    }
+
+    if( index == 0 && level + 1 < Levels )
+        cascade(level + 1);
+}
+
+// Runs the timers of tick now_, the lock is released around the callbacks
+void TimerWheel::expire()
+{
+    quint32 index = now_ & (NearSize - 1);
+    if( index == 0 )
+        cascade(0);
+
+    // detached, so the callbacks rearming their timers link them behind
+    WheelLink due;
+    initHead(due);
+    WheelLink& head = near_[index];
+    if( !isEmpty(head) ) {
+        due.next_ = head.next_;
+        due.prev_ = head.prev_;
+        due.next_->prev_ = &due;
+        due.prev_->next_ = &due;
+        initHead(head);
+    }
+    ++now_;
+
+    while( !isEmpty(due) && !stopping_ )
+    {
+        WheelTimer* timer = static_cast<WheelTimer*>(due.next_);
+        unlink(timer);
+        --armed_;
+
+        running_ = timer;
+        lock_.unlock();
+        timer->expired();
+        lock_.lock();
+        running_ = NULL;
+        finished_.wakeAll();
+    }
+
+    // stopping: the rest are left unarmed
+    while( !isEmpty(due) ) {
+        unlink(static_cast<WheelTimer*>(due.next_));
+        --armed_;
+    }
+}
+
+// Tick of the nearest armed slot before the next cascade
+quint64 TimerWheel::nearestTick() const
+{
+    if( armed_ == 0 )
+        return NeverTick;
+
+    quint64 boundary = (now_ | (NearSize - 1)) + 1;
+    for(quint64 tick = now_; tick < boundary; ++tick)
+        if( !isEmpty(near_[tick & (NearSize - 1)]) )
+            return tick;
+    return boundary;
+}
+
+void TimerWheel::run()
+{
+    lock_.lock();
+    while( !stopping_ )
+    {
+        quint64 target = (quint64)clock_.elapsed();
+        if( armed_ == 0 && now_ < target )
+            now_ = target;      // nothing to cascade or expire
+
+        while( now_ <= target && !stopping_ )
+            expire();
+        if( stopping_ )
+            break;
+
+        wakeAt_ = nearestTick();
+        if( wakeAt_ == NeverTick ) {
+            wakeup_.wait(&lock_);
+        }
+        else {
+            qint64 sleep = (qint64)wakeAt_ - clock_.elapsed();
+            if( sleep > 0 )
+                wakeup_.wait(&lock_, (unsigned long)sleep);
+        }
+        wakeAt_ = NeverTick;
+    }
+    lock_.unlock();
+}
@@ -0,0 +1,99 @@
+#ifndef __timerwheel_h__
+#define __timerwheel_h__
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+class TimerWheel;
+
+////////////////////////////////////////////////////////////////////////////////
+// Node of the circular slot lists, slot heads are bare nodes
+struct WheelLink
+{
+    WheelLink() : next_(NULL), prev_(NULL) {}
+
+    WheelLink* next_;
+    WheelLink* prev_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Timer of TimerWheel, owned by the caller and linked into a wheel slot
+// while armed. expired() is called on the wheel thread
+class WheelTimer : private WheelLink
+{
+    friend class TimerWheel;
+public:
+    WheelTimer() : expires_(0) {}
+    virtual ~WheelTimer() {}
+
+    inline bool isActive() const
+    { return prev_ != NULL; }
+
+protected:
+    virtual void expired() = 0;
+
+private:
+    quint64 expires_;   // wheel tick
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Hierarchical timer wheel of 1 msec ticks: 256 slots of the near level and
+// three levels of 64 slots, a slot of a level covers the whole level below.
+// Arm and cancel are O(1) from any thread, far timers are cascaded down
+// once per level. Delays longer than ~18 hours are clamped.
+// The thread sleeps up to the nearest armed slot of the near level
+class TimerWheel : public QThread
+{
+public:
+    TimerWheel(QObject* parent);
+    ~TimerWheel();
+
+    // Rearms an active timer. Owner must cancel the timer before destroying it
+    void arm(WheelTimer* timer, qint32 msecs);
+    void cancel(WheelTimer* timer);
+    // Cancels and waits for the callback of the timer running on the wheel
+    // thread, so the timer and its owner can be destroyed. Not from a callback
+    void cancelAndWait(WheelTimer* timer);
+    void stop();
+
+    quint32 armedCount() const;
+
+protected:
+    void run();
+
+private:
+    enum {
+        NearBits  = 8,
+        NearSize  = 1 << NearBits,
+        LevelBits = 6,
+        LevelSize = 1 << LevelBits,
+        Levels    = 3,
+    };
+
+    void link(WheelTimer* timer);
+    void unlink(WheelTimer* timer);
+    void cascade(qint32 level);
+    void expire();
+    quint64 nearestTick() const;
+
+    static inline bool isEmpty(const WheelLink& head)
+    { return head.next_ == &head; }
+
+private:
+    mutable QMutex lock_;
+    QWaitCondition wakeup_;
+    QWaitCondition finished_;   // of the running callback
+    WheelTimer* running_;       // callback out of the lock, NULL - none
+    QElapsedTimer clock_;
+    quint64 now_;           // next tick to expire
+    quint64 wakeAt_;        // tick the thread sleeps up to
+    quint32 armed_;
+    bool    stopping_;
+
+    WheelLink near_[NearSize];
+    WheelLink levels_[Levels][LevelSize];
+};
+
+#endif // __timerwheel_h__
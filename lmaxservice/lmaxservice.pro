@@ -0,0 +1,62 @@
+# Headless build of LMAX adapter for servers without desktop
+# qmake lmaxservice.pro && make
+
+TEMPLATE = app
+TARGET = lmaxservice
+CONFIG += console release
+CONFIG -= app_bundle
+QT = core network
+DEFINES += LMAX_HEADLESS
+
+ADAPTER = ../lmaxadapter
+INCLUDEPATH += $$ADAPTER
+DEPENDPATH += $$ADAPTER
+
+HEADERS += servicecontroller.h \
+           $$ADAPTER/fixlogger.h \
+           $$ADAPTER/metrics.h \
+           $$ADAPTER/mqlproxyserver.h \
+           $$ADAPTER/netmanager.h \
+           $$ADAPTER/scheduler.h \
+           $$ADAPTER/servicemodel.h \
+           $$ADAPTER/sslclient.h \
+           $$ADAPTER/standbysession.h \
+           $$ADAPTER/symbolsmodel.h
+
+SOURCES += main.cpp \
+           servicecontroller.cpp \
+           $$ADAPTER/baseini.cpp \
+           $$ADAPTER/fix.cpp \
+           $$ADAPTER/fixdatamodel.cpp \
+           $$ADAPTER/fixframer.cpp \
+           $$ADAPTER/fixjournal.cpp \
+           $$ADAPTER/fixlogger.cpp \
+           $$ADAPTER/fixreplay.cpp \
+           $$ADAPTER/fixtransport.cpp \
+           $$ADAPTER/globals.cpp \
+           $$ADAPTER/latencyrecorder.cpp \
+           $$ADAPTER/nanohistogram.cpp \
+           $$ADAPTER/logger.cpp \
+           $$ADAPTER/metrics.cpp \
+           $$ADAPTER/monoclock.cpp \
+           $$ADAPTER/mqlproxyserver.cpp \
+           $$ADAPTER/netmanager.cpp \
+           $$ADAPTER/rwlock-dbg.cpp \
+           $$ADAPTER/scheduler.cpp \
+           $$ADAPTER/servicemodel.cpp \
+           $$ADAPTER/sslclient.cpp \
+           $$ADAPTER/standbysession.cpp \
+           $$ADAPTER/symbolsmodel.cpp \
+           $$ADAPTER/timerwheel.cpp
+
+# lock contention profiler of rwlock-dbg.h: qmake CONFIG+=lockprofile
+lockprofile {
+    DEFINES += LMAX_LOCK_PROFILE
+}
+
+# epoll and OpenSSL transport, see TransportParam
+linux {
+    DEFINES += LMAX_EPOLL_TRANSPORT
+    SOURCES += $$ADAPTER/epollclient.cpp
+    LIBS += -lssl -lcrypto
+}
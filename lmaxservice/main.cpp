@@ -0,0 +1,170 @@
+#include "globals.h"
+#include "servicecontroller.h"
+#include "baseini.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDir>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////
+namespace {
+    void usage()
+    {
+        printf("Headless LMAX adapter: FIX session, quotes cache and MQL publishing without GUI.\n"
+               "Account and instruments are taken from %s of the working directory,\n"
+               "the session is started at once and kept up until SIGINT/SIGTERM (Ctrl+C).\n\n"
+               "Options:\n"
+               "  --workdir DIR       working directory with the INI file and logs\n"
+               "  --logging           debug log \"%s\" and FIX messages log \"%s\"\n"
+               "  --no-reconnect      don't reconnect after connection failures\n"
+               "  --cpu N             pin the process to CPU N\n"
+               "  --probe N           send N TestRequests one by one after logon, print their\n"
+               "                      round trip latency and exit\n"
+               "  --probe-ab WHAT     with --probe, run the probe with every value of the\n"
+               "                      setting WHAT and print the comparison, the INI value\n"
+               "                      is restored at exit:\n"
+               "                        transport - Transport 0 (QSslSocket) and 1 (epoll)\n"
+               "                        profile   - LatencyProfile 0, 1 and 2\n"
+               "                      Run against the local simulator, lmaxsimulator --plain\n",
+               FILENAME_SETTINGS, FILENAME_DEBUGINFO, FILENAME_FIXMESSAGES);
+    }
+
+#ifdef WIN32
+    BOOL WINAPI consoleHandler(DWORD ctrlType)
+    {
+        Q_UNUSED(ctrlType);
+        ServiceController::requestShutdown();
+        return TRUE;
+    }
+
+    void installShutdownHandler()
+    {
+        ::SetConsoleCtrlHandler(consoleHandler, TRUE);
+    }
+
+    bool pinToCpu(qint32 cpu)
+    {
+        return 0 != ::SetProcessAffinityMask(::GetCurrentProcess(), DWORD_PTR(1) << cpu);
+    }
+#else
+    void signalHandler(int)
+    {
+        ServiceController::requestShutdown();
+    }
+
+    void installShutdownHandler()
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = signalHandler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    bool pinToCpu(qint32 cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return 0 == sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+// Service main
+////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+    int code = 0;
+    try {
+        QCoreApplication app(argc, argv);
+
+        bool reconnect = true;
+        qint32 cpu = -1;
+        qint32 probe = 0;
+        const char* abParam = NULL;
+        QStringList abValues;
+        QStringList args = app.arguments();
+        for(qint32 i = 1; i < args.size(); i++)
+        {
+            const QString& arg = args[i];
+            bool hasValue = (i + 1 < args.size());
+            bool ok = true;
+
+            if( arg == "--logging" )
+                Global::logging_ = true;
+            else if( arg == "--no-reconnect" )
+                reconnect = false;
+            else if( arg == "--workdir" && hasValue )
+                ok = QDir::setCurrent(args[++i]);
+            else if( arg == "--cpu" && hasValue )
+                cpu = args[++i].toInt(&ok);
+            else if( arg == "--probe" && hasValue )
+                probe = args[++i].toInt(&ok);
+            else if( arg == "--probe-ab" && hasValue ) {
+                QString what = args[++i];
+                if( what == "transport" ) {
+                    abParam = TransportParam;
+                    abValues << "0" << "1";
+                }
+                else if( what == "profile" ) {
+                    abParam = LatencyProfileParam;
+                    abValues << "0" << "1" << "2";
+                }
+                else
+                    ok = false;
+            }
+            else
+                ok = false;
+
+            if( !ok ) {
+                usage();
+                return -1;
+            }
+        }
+
+        if( abParam && probe <= 0 ) {
+            usage();
+            return -1;
+        }
+
+        if( cpu >= 0 && !pinToCpu(cpu) )
+            fprintf(stderr, "Cannot pin to CPU %d, running unpinned\n", cpu);
+
+        installShutdownHandler();
+
+        ServiceController controller(reconnect);
+        if( probe > 0 )
+            controller.startProbe(probe, abParam, abValues);
+        QTimer::singleShot(0, &controller, SLOT(asyncStart()));
+        printf("%s is running, Ctrl+C to stop\n", Global::productFullName().toLocal8Bit().constData());
+        app.exec();
+    }
+    catch(const exception& ex)
+    {
+        fprintf(stderr, "Service error: %s\n", ex.what());
+        code = -1;
+    }
+
+    if(code == 0) {
+        string info = "Session closed at " + Global::timestamp();
+        CDebug(false) << info.c_str() << "\n\n";
+    }
+    return code;
+}
@@ -0,0 +1,142 @@
+#include "globals.h"
+#include "servicecontroller.h"
+
+#include "netmanager.h"
+#include "scheduler.h"
+#include "fixdatamodel.h"
+
+#include <QCoreApplication>
+#include <QAtomicInt>
+
+#include <stdio.h>
+
+namespace {
+    QAtomicInt shutdownRequested(0);
+    const qint32 shutdownPollMs = 200;
+}
+
+////////////////////////////////////////////////////////////////////////
+ServiceController::ServiceController(bool reconnect)
+    : stopping_(false),
+    probeCount_(0),
+    abParam_(NULL),
+    abIndex_(0),
+    switching_(false)
+{
+    Global::init();
+    netman_.reset(new NetworkManager(this, true));
+    netman_->scheduler()->setReconnectEnabled(reconnect);
+
+    QObject::connect(&shutdownPoll_, SIGNAL(timeout()), this, SLOT(onShutdownPoll()));
+    shutdownPoll_.start(shutdownPollMs);
+}
+
+ServiceController::~ServiceController()
+{}
+
+void ServiceController::requestShutdown()
+{
+    shutdownRequested = 1;
+}
+
+void ServiceController::startProbe(qint32 count, const char* abParam, const QStringList& abValues)
+{
+    QObject::connect(netman_.data(), SIGNAL(notifyProbeFinished(QString)), 
+                     this, SLOT(onProbeFinished(QString)));
+    probeCount_ = count;
+    if( abParam && !abValues.empty() ) {
+        abParam_ = abParam;
+        abValues_ = abValues;
+        abOriginal_ = netman_->model()->value(abParam_);
+        netman_->model()->setValue(abParam_, abValues_[0]);
+    }
+    netman_->startProbe(count);
+}
+
+void ServiceController::onProbeFinished(const QString& report)
+{
+    CDebug() << report;
+    printf("%s", report.toLocal8Bit().constData());
+    if( abParam_ == NULL ) {
+        requestShutdown();
+        return;
+    }
+
+    // the third and fourth lines of the report are the round trip percentiles
+    QString label = QString("%1=%2").arg(abParam_).arg(abValues_[abIndex_]);
+    abHeader_ = QString(20, ' ') + report.section('\n', 2, 2);
+    abResults_.append(QString("%1 ").arg(label, -19) + report.section('\n', 3, 3));
+    if( ++abIndex_ < abValues_.size() ) {
+        switching_ = true;
+        netman_->stop();
+        QTimer::singleShot(0, this, SLOT(onProbeNext()));
+        return;
+    }
+
+    QString comparison = QString("A/B probe of %1, %2 TestRequest round trips each:\n")
+                         .arg(abParam_).arg(probeCount_);
+    comparison += abHeader_ + "\n" + abResults_.join("\n") + "\n";
+    CDebug() << comparison;
+    printf("\n%s", comparison.toLocal8Bit().constData());
+    requestShutdown();
+}
+
+void ServiceController::onProbeNext()
+{
+    switching_ = false;
+    if( stopping_ )
+        return;
+
+    CDebug() << "Service: probe with " << abParam_ << "=" << abValues_[abIndex_];
+    netman_->model()->setValue(abParam_, abValues_[abIndex_]);
+    netman_->startProbe(probeCount_);
+    netman_->start();
+}
+
+void ServiceController::onReconnectSetCheck(bool on)
+{
+    if( !on )
+        CDebug() << "Service: reconnect is disabled by the server logout";
+}
+
+void ServiceController::asyncStart()
+{
+    if( !stopping_ )
+        netman_->start();
+}
+
+void ServiceController::asyncStop()
+{
+    netman_->stop();
+}
+
+void ServiceController::onStateChanged(quint8 state, const QString& reason)
+{
+    if( state == ProgressState )
+        CDebug() << "Service: connecting to " << netman_->model()->value(ServerParam);
+    else if( state == EstablishState || state == EstablishWarnState )
+        CDebug() << "Service: established " << reason;
+    else if( state == ForcedClosingState )
+        CDebug() << "Service: logged out " << reason;
+    else if( state == ClosedFailureState || state == ClosedRemoteState ) {
+        CDebug() << "Service: disconnected " << reason;
+        if( !stopping_ && !switching_ )
+            netman_->reconnect();
+    }
+}
+
+void ServiceController::onShutdownPoll()
+{
+    if( stopping_ || shutdownRequested.loadAcquire() == 0 )
+        return;
+
+    stopping_ = true;
+    shutdownPoll_.stop();
+    CDebug() << "Service: shutdown requested";
+
+    netman_->scheduler()->setReconnectEnabled(false);
+    netman_->stop();
+    if( abParam_ )
+        netman_->model()->setValue(abParam_, abOriginal_);
+    QTimer::singleShot(0, qApp, SLOT(quit()));
+}
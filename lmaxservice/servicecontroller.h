@@ -0,0 +1,58 @@
+#ifndef __servicecontroller_h__
+#define __servicecontroller_h__
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QStringList>
+
+class NetworkManager;
+
+////////////////////////////////////////////////////////////////////////
+// Headless counterpart of MainDialog: owns NetworkManager, keeps the
+// session up by reconnecting after failures and stops it cleanly
+// when the process is asked to terminate.
+class ServiceController : public QObject
+{
+    Q_OBJECT
+
+public:
+    ServiceController(bool reconnect);
+    ~ServiceController();
+
+    // Called from the signal/console handler, served by the poll timer
+    static void requestShutdown();
+
+    // Runs the latency probe of NetworkManager, the service stops after its report.
+    // A/B probe: the session is run anew for every value of the abParam setting,
+    // the round trips of the values are compared and the setting is restored
+    void startProbe(qint32 count, const char* abParam = NULL,
+                    const QStringList& abValues = QStringList());
+
+public slots:
+    void onReconnectSetCheck(bool on);
+    void asyncStart();
+    void asyncStop();
+
+protected slots:
+    void onStateChanged(quint8 state, const QString& reason);
+    void onShutdownPoll();
+    void onProbeFinished(const QString& report);
+    void onProbeNext();
+
+private:
+    QScopedPointer<NetworkManager> netman_;
+    QTimer shutdownPoll_;
+    bool stopping_;
+
+    qint32 probeCount_;
+    const char* abParam_;       // NULL - single probe
+    QStringList abValues_;
+    qint32  abIndex_;
+    QString abOriginal_;
+    QString abHeader_;
+    QStringList abResults_;
+    bool switching_;            // between the sessions of A/B probe, no reconnect
+};
+
+#endif // __servicecontroller_h__
@@ -0,0 +1,659 @@
+#include "fixsimulator.h"
+
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QStringList>
+#include <stdio.h>
+
+using namespace std;
+
+// Session reject reasons (373)
+#define REJECT_REQUIRED_TAG_MISSING     1
+#define REJECT_INVALID_MSGTYPE          11
+
+// Market data request reject reasons (281)
+#define MDREJECT_UNKNOWN_SYMBOL         '0'
+#define MDREJECT_UNSUPPORTED_SUBSCRIPTION '4'
+#define MDREJECT_UNSUPPORTED_DEPTH      '5'
+
+namespace {
+    void simlog(const QString& text)
+    {
+        printf("%s %s\n", QDateTime::currentDateTime().toString("hh:mm:ss.zzz").toLocal8Bit().constData(),
+                          text.toLocal8Bit().constData());
+        fflush(stdout);
+    }
+
+    quint16 getChecksum(const char* buf, int buflen)
+    {
+        quint32 cks = 0;
+        for(int i = 0; i < buflen; ++i) cks += (unsigned char)buf[i];
+        return cks % 256;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FixSession::FixSession(QSslSocket* socket, const SimulatorConfig& config, QObject* parent)
+    : QObject(parent),
+    socket_(socket),
+    config_(config),
+    loggedIn_(false),
+    outSeqNum_(0),
+    inSeqNum_(0),
+    heartbeatSecs_(30),
+    testRequestSent_(false),
+    next_(0),
+    scheduled_(0),
+    nextBurst_(0),
+    random_(12345),
+    testRequests_(0),
+    marketDataSent_(0),
+    gapCounter_(0)
+{
+    socket_->setParent(this);
+    lastIncoming_.start();
+    lastOutgoing_.start();
+
+    connect(socket_, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(socket_, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(socket_, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(onSslErrors(const QList<QSslError>&)));
+
+    // 1ms ticks keep the stream close to the configured rate without a busy loop
+    tickTimer_.setTimerType(Qt::PreciseTimer);
+    tickTimer_.setInterval(1);
+    connect(&tickTimer_, SIGNAL(timeout()), this, SLOT(onTick()));
+
+    heartbeatTimer_.setInterval(1000);
+    connect(&heartbeatTimer_, SIGNAL(timeout()), this, SLOT(onHeartbeatTimer()));
+
+    log("connected");
+}
+
+FixSession::~FixSession()
+{
+    tickTimer_.stop();
+    heartbeatTimer_.stop();
+}
+
+void FixSession::log(const QString& text) const
+{
+    simlog(QString("[%1:%2] %3").arg(socket_->peerAddress().toString())
+                                .arg(socket_->peerPort())
+                                .arg(text));
+}
+
+QByteArray FixSession::getField(const QByteArray& message, const char* tag)
+{
+    QByteArray key = QByteArray(1, SOH).append(tag).append('=');
+    qint32 begin = message.indexOf(key);
+    if( begin < 0 )
+        return QByteArray();
+
+    begin += key.size();
+    qint32 end = message.indexOf(SOH, begin);
+    if( end < 0 )
+        return QByteArray();
+    return message.mid(begin, end - begin);
+}
+
+QByteArray FixSession::sendingTime()
+{
+    return QDateTime::currentDateTimeUtc().toString("yyyyMMdd-hh:mm:ss.zzz").toLatin1();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FixSession::onReadyRead()
+{
+    inbound_.append(socket_->readAll());
+
+    while( !inbound_.isEmpty() )
+    {
+        qint32 begin = inbound_.indexOf("8=FIX");
+        if( begin < 0 ) {
+            // keep the tail, it may be the beginning of the next message
+            inbound_.remove(0, qMax(0, inbound_.size() - 4));
+            break;
+        }
+        if( begin > 0 )
+            inbound_.remove(0, begin);
+
+        qint32 lengthPos = inbound_.indexOf(QByteArray(1, SOH).append("9="));
+        if( lengthPos < 0 )
+            break;
+        qint32 lengthEnd = inbound_.indexOf(SOH, lengthPos + 3);
+        if( lengthEnd < 0 )
+            break;
+
+        bool ok = false;
+        qint32 bodyLength = inbound_.mid(lengthPos + 3, lengthEnd - lengthPos - 3).toInt(&ok);
+        if( !ok || bodyLength <= 0 ) {
+            log("Garbled message: invalid BodyLength(9), skipped");
+            inbound_.remove(0, 1);
+            continue;
+        }
+
+        // header, body and "10=xxx<SOH>"
+        qint32 total = lengthEnd + 1 + bodyLength + 7;
+        if( inbound_.size() < total )
+            break;
+
+        QByteArray message = inbound_.left(total);
+        inbound_.remove(0, total);
+
+        if( message.mid(total - 7, 3) != "10=" ) {
+            log("Garbled message: CheckSum(10) is not at BodyLength(9), skipped");
+            continue;
+        }
+        process(message);
+        if( socket_->state() != QAbstractSocket::ConnectedState )
+            break;
+    }
+}
+
+void FixSession::onDisconnected()
+{
+    tickTimer_.stop();
+    heartbeatTimer_.stop();
+    loggedIn_ = false;
+
+    log(QString("disconnected, %1 market data messages sent").arg(marketDataSent_));
+    emit finished(this);
+}
+
+void FixSession::onSslErrors(const QList<QSslError>& errors)
+{
+    for(qint32 i = 0; i < errors.size(); i++)
+        log("SSL error: " + errors[i].errorString());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FixSession::process(const QByteArray& message)
+{
+    if( loggedIn_ && injectFault() )
+        return;
+    lastIncoming_.restart();
+    testRequestSent_ = false;
+
+    QByteArray msgType = getField(message, "35");
+    QByteArray msgSeqNum = getField(message, "34");
+    if( !loggedIn_ && msgType != "A" ) {
+        log("First message is not Logon(A), disconnecting");
+        socket_->disconnectFromHost();
+        return;
+    }
+    inSeqNum_ = msgSeqNum.toUInt();
+
+    if( msgType == "A" )
+        onLogon(message);
+    else if( msgType == "0" ) {
+        // heartbeat only refreshes the incoming time
+    }
+    else if( msgType == "1" )
+        onTestRequest(message);
+    else if( msgType == "2" )
+        onResendRequest(message);
+    else if( msgType == "4" )
+        onSequenceReset(message);
+    else if( msgType == "5" )
+        onLogout(message);
+    else if( msgType == "V" )
+        onMarketDataRequest(message);
+    else if( msgType == "3" )
+        log("Reject(3) received: " + QString(getField(message, "58")));
+    else {
+        log("Unsupported MsgType(35)=" + QString(msgType));
+        sendReject(msgSeqNum, REJECT_INVALID_MSGTYPE, "Unsupported MsgType", "35");
+    }
+}
+
+void FixSession::onLogon(const QByteArray& message)
+{
+    if( loggedIn_ ) {
+        log("Repeated Logon(A) ignored");
+        return;
+    }
+
+    // the replies go back to the initiator
+    senderCompID_ = getField(message, "56");
+    targetCompID_ = getField(message, "49");
+
+    if( !config_.password_.isEmpty() && getField(message, "554") != config_.password_.toLatin1() ) {
+        log("Logon(A) of " + QString(targetCompID_) + " rejected: wrong password");
+        sendLogout("BAD_CREDENTIALS");
+        socket_->disconnectFromHost();
+        return;
+    }
+
+    heartbeatSecs_ = getField(message, "108").toInt();
+    if( heartbeatSecs_ <= 0 )
+        heartbeatSecs_ = 30;
+
+    outSeqNum_ = 0;
+    loggedIn_ = true;
+    send("A", QByteArray("98=0").append(SOH)
+                .append("108=").append(QByteArray::number(heartbeatSecs_)).append(SOH));
+
+    sessionClock_.start();
+    heartbeatTimer_.start();
+    tickTimer_.start();
+    log(QString("Logon(A) of %1, HeartBtInt=%2").arg(QString(targetCompID_)).arg(heartbeatSecs_));
+}
+
+void FixSession::onTestRequest(const QByteArray& message)
+{
+    send("0", QByteArray("112=").append(getField(message, "112")).append(SOH));
+}
+
+void FixSession::onResendRequest(const QByteArray& message)
+{
+    // market data is not worth resending, the range is filled by a gap
+    QByteArray beginSeqNo = getField(message, "7");
+    qint32 msgSeqNum = beginSeqNo.toInt();
+    if( msgSeqNum <= 0 || quint32(msgSeqNum) > outSeqNum_ )
+        msgSeqNum = outSeqNum_ + 1;
+
+    log(QString("ResendRequest(2) from %1, answered by GapFill to %2")
+        .arg(QString(beginSeqNo)).arg(outSeqNum_ + 1));
+
+    send("4", QByteArray("123=Y").append(SOH)
+                .append("43=Y").append(SOH)
+                .append("36=").append(QByteArray::number(outSeqNum_ + 1)).append(SOH), msgSeqNum);
+}
+
+void FixSession::onSequenceReset(const QByteArray& message)
+{
+    quint32 newSeqNo = getField(message, "36").toUInt();
+    if( newSeqNo == 0 ) {
+        sendReject(getField(message, "34"), REJECT_REQUIRED_TAG_MISSING, "NewSeqNo is missing", "36");
+        return;
+    }
+    log(QString("SequenceReset(4), NewSeqNo=%1").arg(newSeqNo));
+    inSeqNum_ = newSeqNo - 1;
+}
+
+void FixSession::onLogout(const QByteArray&)
+{
+    log("Logout(5) received");
+    sendLogout("Logout confirmed");
+    loggedIn_ = false;
+    socket_->disconnectFromHost();
+}
+
+void FixSession::onMarketDataRequest(const QByteArray& message)
+{
+    QByteArray mdReqID = getField(message, "262");
+    if( mdReqID.isEmpty() ) {
+        sendReject(getField(message, "34"), REJECT_REQUIRED_TAG_MISSING, "MDReqID is missing", "262");
+        return;
+    }
+
+    qint32 index = -1;
+    for(qint32 i = 0; i < subscriptions_.size(); i++) {
+        if( subscriptions_[i].mdReqID_ == mdReqID ) {
+            index = i;
+            break;
+        }
+    }
+
+    QByteArray requestType = getField(message, "263");
+    if( requestType == "2" ) {
+        if( index >= 0 ) {
+            subscriptions_.removeAt(index);
+            if( next_ >= subscriptions_.size() )
+                next_ = 0;
+        }
+        return;
+    }
+    if( requestType != "0" && requestType != "1" ) {
+        sendMarketDataReject(mdReqID, MDREJECT_UNSUPPORTED_SUBSCRIPTION, "Unsupported SubscriptionRequestType");
+        return;
+    }
+
+    QByteArray depth = getField(message, "264");
+    if( !depth.isEmpty() && depth != "0" && depth != "1" ) {
+        sendMarketDataReject(mdReqID, MDREJECT_UNSUPPORTED_DEPTH, "Unsupported MarketDepth");
+        return;
+    }
+
+    QByteArray securityID = getField(message, "48");
+    if( securityID.toUInt() == 0 ) {
+        sendMarketDataReject(mdReqID, MDREJECT_UNKNOWN_SYMBOL, "Unknown SecurityID");
+        return;
+    }
+
+    Subscription snapshot;
+    if( index < 0 ) {
+        snapshot.mdReqID_ = mdReqID;
+        snapshot.securityID_ = securityID;
+        snapshot.bid_ = 1.0 + (securityID.toUInt() % 100) * 0.01;
+
+        if( requestType == "1" ) {
+            if( quint32(subscriptions_.size()) >= config_.instruments_ ) {
+                sendMarketDataReject(mdReqID, MDREJECT_UNKNOWN_SYMBOL, "Instruments limit of the simulator");
+                return;
+            }
+            subscriptions_.append(snapshot);
+            index = subscriptions_.size() - 1;
+        }
+    }
+
+    // the first snapshot goes at once, then the subscription joins the stream
+    Subscription& target = (index >= 0) ? subscriptions_[index] : snapshot;
+    QByteArray data = makeMarketData(target, sendingTime());
+    socket_->write(data);
+    lastOutgoing_.restart();
+    ++marketDataSent_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FixSession::onTick()
+{
+    if( loggedIn_ && injectFault() )
+        return;
+    if( !loggedIn_ || subscriptions_.empty() ) {
+        streamClock_.invalidate();
+        return;
+    }
+
+    // messages are scheduled from the first subscription at the fixed rate
+    if( !streamClock_.isValid() ) {
+        streamClock_.start();
+        scheduled_ = 0;
+        nextBurst_ = config_.burstPeriod_;
+    }
+
+    quint64 expected = (quint64)(streamClock_.nsecsElapsed() / 1000) * config_.rate_ / 1000000;
+    quint64 due = expected - scheduled_;
+    scheduled_ = expected;
+
+    if( config_.burstSize_ > 0 && streamClock_.elapsed() >= nextBurst_ ) {
+        due += config_.burstSize_;
+        nextBurst_ = streamClock_.elapsed() + config_.burstPeriod_;
+    }
+    if( due == 0 )
+        return;
+
+    if( socket_->bytesToWrite() > SIMULATOR_HIGH_WATERMARK ) {
+        // reader is slower than the rate, keep the schedule without queueing
+        return;
+    }
+
+    QByteArray time = sendingTime();
+    QByteArray batch;
+    batch.reserve(due * 200);
+    for(quint64 i = 0; i < due; i++) {
+        batch.append(makeMarketData(subscriptions_[next_], time));
+        if( ++next_ >= subscriptions_.size() )
+            next_ = 0;
+    }
+
+    socket_->write(batch);
+    lastOutgoing_.restart();
+    marketDataSent_ += due;
+}
+
+void FixSession::onHeartbeatTimer()
+{
+    if( !loggedIn_ || injectFault() )
+        return;
+
+    qint64 interval = qint64(heartbeatSecs_) * 1000;
+    qint64 silence = lastIncoming_.elapsed();
+    if( testRequestSent_ && silence > interval * 2 ) {
+        log("No answer on TestRequest(1), disconnecting");
+        sendLogout("Heartbeat timeout");
+        loggedIn_ = false;
+        socket_->disconnectFromHost();
+        return;
+    }
+    if( !testRequestSent_ && silence > interval * 6 / 5 ) {
+        send("1", QByteArray("112=SIM").append(QByteArray::number(++testRequests_)).append(SOH));
+        testRequestSent_ = true;
+        return;
+    }
+    if( lastOutgoing_.elapsed() >= interval )
+        send("0", QByteArray());
+}
+
+// A dropped session is gone at once, a stalled one neither sends nor answers
+bool FixSession::injectFault()
+{
+    qint64 elapsed = sessionClock_.elapsed();
+    if( config_.dropAfter_ > 0 && elapsed >= qint64(config_.dropAfter_) * 1000 ) {
+        log("Fault: connection aborted without Logout");
+        loggedIn_ = false;
+        socket_->abort();
+        return true;
+    }
+    return config_.stallAfter_ > 0 && elapsed >= qint64(config_.stallAfter_) * 1000;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FixSession::sendReject(const QByteArray& refSeqNum, int reason, const char* text, const char* refTag)
+{
+    QByteArray body = QByteArray("45=").append(refSeqNum).append(SOH);
+    if( refTag )
+        body.append("371=").append(refTag).append(SOH);
+    body.append("373=").append(QByteArray::number(reason)).append(SOH)
+        .append("58=").append(text).append(SOH);
+    send("3", body);
+}
+
+void FixSession::sendMarketDataReject(const QByteArray& mdReqID, char reason, const char* text)
+{
+    log("MarketDataRequestReject(Y) of " + QString(mdReqID) + ": " + text);
+    send("Y", QByteArray("262=").append(mdReqID).append(SOH)
+                .append("281=").append(reason).append(SOH)
+                .append("58=").append(text).append(SOH));
+}
+
+void FixSession::sendLogout(const char* text)
+{
+    send("5", QByteArray("58=").append(text).append(SOH));
+}
+
+void FixSession::send(const char* msgType, const QByteArray& body, qint32 msgSeqNum)
+{
+    socket_->write(makeMessage(msgType, body, sendingTime(), msgSeqNum));
+    lastOutgoing_.restart();
+}
+
+QByteArray FixSession::makeMessage(const char* msgType, const QByteArray& body,
+                                   const QByteArray& time, qint32 msgSeqNum)
+{
+    if( msgSeqNum < 0 )
+        msgSeqNum = ++outSeqNum_;
+
+    char tmp[32];
+    QByteArray message;
+    message.reserve(body.size() + 128);
+    message.append("35=").append(msgType).append(SOH)
+           .append("49=").append(senderCompID_).append(SOH)
+           .append("56=").append(targetCompID_).append(SOH);
+    sprintf(tmp, "34=%d%c", msgSeqNum, SOH);
+    message.append(tmp)
+           .append("52=").append(time).append(SOH)
+           .append(body);
+
+    sprintf(tmp, "8=FIX.4.4%c9=%d%c", SOH, message.size(), SOH);
+    message.prepend(tmp);
+
+    sprintf(tmp, "10=%03d%c", getChecksum(message.constData(), message.size()), SOH);
+    message.append(tmp);
+    return message;
+}
+
+QByteArray FixSession::makeMarketData(Subscription& subscription, const QByteArray& time)
+{
+    // the skipped MsgSeqNum is requested for resend and answered by GapFill
+    if( config_.gapEvery_ > 0 && ++gapCounter_ % config_.gapEvery_ == 0 )
+        ++outSeqNum_;
+
+    random_ = random_ * 1103515245 + 12345;
+    subscription.bid_ += (double((random_ >> 16) % 3) - 1.0) * 0.00001;
+    if( subscription.bid_ < 0.0001 )
+        subscription.bid_ = 0.0001;
+    quint32 size = 1 + (random_ >> 8) % 100;
+
+    char body[256];
+    sprintf(body, "262=%s%c48=%s%c22=8%c268=2%c"
+                  "269=0%c270=%.5f%c271=%u%c"
+                  "269=1%c270=%.5f%c271=%u%c",
+            subscription.mdReqID_.constData(), SOH, subscription.securityID_.constData(), SOH, SOH, SOH,
+            SOH, subscription.bid_, SOH, size, SOH,
+            SOH, subscription.bid_ + 0.0002, SOH, size, SOH);
+    return makeMessage("W", QByteArray(body), time);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FixSimulator::FixSimulator(const SimulatorConfig& config, QObject* parent)
+    : QTcpServer(parent),
+    config_(config),
+    finishedSent_(0),
+    lastReported_(0),
+    sweepIndex_(-1)
+{
+    reportTimer_.setInterval(5000);
+    connect(&reportTimer_, SIGNAL(timeout()), this, SLOT(onReport()));
+
+    sweepTimer_.setInterval(config_.sweepStep_ * 1000);
+    connect(&sweepTimer_, SIGNAL(timeout()), this, SLOT(onSweepStep()));
+}
+
+bool FixSimulator::start(QString* error)
+{
+    if( !listen(config_.address_, config_.port_) ) {
+        if( error )
+            *error = errorString();
+        return false;
+    }
+
+    simlog(QString("Listening on %1:%2 (%3), %4 W/sec per session, burst %5 every %6 msecs")
+           .arg(config_.address_.toString()).arg(config_.port_)
+           .arg(config_.plain_ ? "plain TCP" : "TLS")
+           .arg(config_.rate_).arg(config_.burstSize_).arg(config_.burstPeriod_));
+
+    reportClock_.start();
+    reportTimer_.start();
+
+    if( !config_.sweepRates_.empty() ) {
+        if( !config_.sweepLog_.isEmpty() ) {
+            sweepLog_.setFileName(config_.sweepLog_);
+            if( !sweepLog_.open(QIODevice::ReadOnly) )
+                simlog("Sweep: can't open " + config_.sweepLog_ + ", the adapter load is not reported");
+        }
+        onSweepStep();
+        sweepTimer_.start();
+    }
+    return true;
+}
+
+void FixSimulator::incomingConnection(qintptr socketDescriptor)
+{
+    QSslSocket* socket = new QSslSocket;
+    if( !socket->setSocketDescriptor(socketDescriptor) ) {
+        simlog("Can't accept connection: " + socket->errorString());
+        delete socket;
+        return;
+    }
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    FixSession* session = new FixSession(socket, config_, this);
+    connect(session, SIGNAL(finished(FixSession*)), this, SLOT(onSessionFinished(FixSession*)));
+    sessions_.append(session);
+
+    if( !config_.plain_ ) {
+        socket->setLocalCertificate(config_.certificate_);
+        socket->setPrivateKey(config_.key_);
+        socket->setPeerVerifyMode(QSslSocket::VerifyNone);
+        socket->startServerEncryption();
+    }
+}
+
+void FixSimulator::onSessionFinished(FixSession* session)
+{
+    finishedSent_ += session->marketDataSent();
+    sessions_.removeAll(session);
+    session->deleteLater();
+}
+
+void FixSimulator::onReport()
+{
+    quint64 total = finishedSent_;
+    for(qint32 i = 0; i < sessions_.size(); i++)
+        total += sessions_[i]->marketDataSent();
+
+    double secs = reportClock_.restart() / 1000.0;
+    if( sessions_.empty() && total == lastReported_ )
+        return;
+
+    simlog(QString("sessions=%1, W sent=%2 (%3/sec)")
+           .arg(sessions_.size()).arg(total)
+           .arg(secs > 0 ? (total - lastReported_) / secs : 0.0, 0, 'f', 0));
+    lastReported_ = total;
+}
+
+void FixSimulator::onSweepStep()
+{
+    if( sweepIndex_ >= 0 ) {
+        QString result = QString("%1 W/sec: %2").arg(config_.rate_).arg(readSweepStats());
+        simlog("Sweep " + result);
+        sweepResults_.append(result);
+    }
+
+    if( ++sweepIndex_ >= config_.sweepRates_.size() ) {
+        sweepTimer_.stop();
+        simlog("Sweep finished, GUI load of the adapter per session rate:");
+        for(qint32 i = 0; i < sweepResults_.size(); i++)
+            simlog("  " + sweepResults_[i]);
+        QCoreApplication::quit();
+        return;
+    }
+
+    config_.rate_ = config_.sweepRates_[sweepIndex_];
+    for(qint32 i = 0; i < sessions_.size(); i++)
+        sessions_[i]->restartStream();
+    if( sweepLog_.isOpen() )
+        sweepLog_.seek(sweepLog_.size());
+
+    simlog(QString("Sweep step %1/%2: %3 W/sec per session for %4 secs")
+           .arg(sweepIndex_ + 1).arg(config_.sweepRates_.size())
+           .arg(config_.rate_).arg(config_.sweepStep_));
+}
+
+// "GUI refresh: N quote updates/sec, N refreshes/sec, N rows/refresh, GUI thread CPU N.N%"
+QString FixSimulator::readSweepStats()
+{
+    if( !sweepLog_.isOpen() )
+        return "no adapter log, see --sweep-log";
+    if( sweepLog_.size() < sweepLog_.pos() )
+        sweepLog_.seek(0);      // the log was started anew
+
+    const QString marker = "GUI refresh: ";
+    qint32 reports = 0, skipped = 0;
+    double updates = 0, refreshes = 0, rows = 0, cpu = 0;
+    while( !sweepLog_.atEnd() )
+    {
+        QString line = QString::fromLocal8Bit(sweepLog_.readLine()).trimmed();
+        qint32 pos = line.indexOf(marker);
+        if( pos < 0 )
+            continue;
+
+        QStringList fields = line.mid(pos + marker.size()).split(", ");
+        if( fields.size() < 4 || skipped++ == 0 )
+            continue;
+
+        updates   += fields[0].section(' ', 0, 0).toDouble();
+        refreshes += fields[1].section(' ', 0, 0).toDouble();
+        rows      += fields[2].section(' ', 0, 0).toDouble();
+        QString share = fields[3].section(' ', 3, 3);
+        cpu += share.left(share.size() - 1).toDouble();
+        ++reports;
+    }
+
+    if( reports == 0 )
+        return "no GUI refresh stats of the adapter, make --sweep-step longer";
+    return QString("%1 quote updates/sec, %2 refreshes/sec, %3 rows/refresh, GUI thread CPU %4% (%5 reports)")
+           .arg(updates / reports, 0, 'f', 0).arg(refreshes / reports, 0, 'f', 0)
+           .arg(rows / reports, 0, 'f', 0).arg(cpu / reports, 0, 'f', 1).arg(reports);
+}
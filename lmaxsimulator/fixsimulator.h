@@ -0,0 +1,177 @@
+#ifndef __fixsimulator_h__
+#define __fixsimulator_h__
+
+#include <QTcpServer>
+#include <QSslSocket>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QList>
+#include <QStringList>
+#include <QFile>
+
+#define SOH (char(0x01))
+
+// Output buffer limit of a slow session, market data above it is skipped
+#define SIMULATOR_HIGH_WATERMARK    (4*1024*1024)
+
+//////////////////////////////////////////////////////////////
+struct SimulatorConfig
+{
+    QHostAddress    address_;
+    quint16         port_;
+    bool            plain_;         // plain TCP instead of TLS
+    QSslCertificate certificate_;
+    QSslKey         key_;
+    QString         password_;      // empty: any password is accepted
+    quint32         instruments_;   // subscriptions per session at most
+    quint32         rate_;          // steady W messages per second per session
+    quint32         burstSize_;     // W messages of one burst, 0 - no bursts
+    quint32         burstPeriod_;   // msecs between bursts
+
+    // faults injected into every session, 0 - off
+    quint32         dropAfter_;     // secs after logon the connection is aborted without Logout
+    quint32         stallAfter_;    // secs after logon the session goes silent
+    quint32         gapEvery_;      // a MsgSeqNum is skipped every N market data messages
+
+    // rate sweep: rate_ steps through sweepRates_ every sweepStep_ secs, the GUI
+    // refresh stats of the adapter debug log sweepLog_ are reported per step
+    QList<quint32>  sweepRates_;
+    quint32         sweepStep_;
+    QString         sweepLog_;
+
+    SimulatorConfig()
+        : address_(QHostAddress::LocalHost), port_(9443), plain_(false),
+        instruments_(100), rate_(1000), burstSize_(0), burstPeriod_(1000),
+        dropAfter_(0), stallAfter_(0), gapEvery_(0), sweepStep_(40)
+    {}
+};
+
+//////////////////////////////////////////////////////////////
+// One FIX 4.4 acceptor session: logon, heartbeat, test request,
+// market data request (V) answered by snapshots (W) or rejects (Y),
+// session reject (3), sequence reset (4) and logout (5)
+class FixSession : public QObject
+{
+    Q_OBJECT
+public:
+    FixSession(QSslSocket* socket, const SimulatorConfig& config, QObject* parent);
+    ~FixSession();
+
+    inline quint64 marketDataSent() const
+    { return marketDataSent_; }
+
+    // The stream is scheduled anew at the changed rate
+    inline void restartStream()
+    { streamClock_.invalidate(); }
+
+Q_SIGNALS:
+    void finished(FixSession* session);
+
+private Q_SLOTS:
+    void onReadyRead();
+    void onDisconnected();
+    void onSslErrors(const QList<QSslError>& errors);
+    void onTick();
+    void onHeartbeatTimer();
+
+private:
+    void process(const QByteArray& message);
+    void onLogon(const QByteArray& message);
+    void onTestRequest(const QByteArray& message);
+    void onResendRequest(const QByteArray& message);
+    void onSequenceReset(const QByteArray& message);
+    void onLogout(const QByteArray& message);
+    void onMarketDataRequest(const QByteArray& message);
+
+    // true when the injected fault took the session down or silenced it
+    bool injectFault();
+
+    void sendReject(const QByteArray& refSeqNum, int reason, const char* text, const char* refTag = NULL);
+    void sendMarketDataReject(const QByteArray& mdReqID, char reason, const char* text);
+    void sendLogout(const char* text);
+    void send(const char* msgType, const QByteArray& body, qint32 msgSeqNum = -1);
+    void log(const QString& text) const;
+
+    static QByteArray getField(const QByteArray& message, const char* tag);
+    static QByteArray sendingTime();
+
+private:
+    struct Subscription {
+        QByteArray mdReqID_;
+        QByteArray securityID_;
+        double     bid_;
+    };
+
+    // Header and trailer are added here, msgSeqNum < 0 takes the next sequence number
+    QByteArray makeMessage(const char* msgType, const QByteArray& body,
+                           const QByteArray& time, qint32 msgSeqNum = -1);
+    QByteArray makeMarketData(Subscription& subscription, const QByteArray& time);
+
+    QSslSocket*     socket_;
+    const SimulatorConfig& config_;
+    QByteArray      inbound_;
+
+    bool            loggedIn_;
+    QByteArray      senderCompID_;
+    QByteArray      targetCompID_;
+    quint32         outSeqNum_;
+    quint32         inSeqNum_;
+    qint32          heartbeatSecs_;
+    QElapsedTimer   lastIncoming_;
+    QElapsedTimer   lastOutgoing_;
+    bool            testRequestSent_;
+
+    QList<Subscription> subscriptions_;
+    qint32          next_;
+    QElapsedTimer   streamClock_;
+    quint64         scheduled_;
+    qint64          nextBurst_;
+    quint32         random_;
+    quint32         testRequests_;
+    quint64         marketDataSent_;
+    QElapsedTimer   sessionClock_;  // from logon
+    quint64         gapCounter_;
+
+    QTimer          tickTimer_;
+    QTimer          heartbeatTimer_;
+};
+
+//////////////////////////////////////////////////////////////
+class FixSimulator : public QTcpServer
+{
+    Q_OBJECT
+public:
+    FixSimulator(const SimulatorConfig& config, QObject* parent = NULL);
+
+    bool start(QString* error);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor);
+
+private Q_SLOTS:
+    void onSessionFinished(FixSession* session);
+    void onReport();
+    void onSweepStep();
+
+private:
+    // Averages the GUI refresh stats of the adapter logged since the step start,
+    // the first report of the step is skipped as it covers the previous rate
+    QString readSweepStats();
+
+private:
+    SimulatorConfig     config_;
+    QList<FixSession*>  sessions_;
+    quint64             finishedSent_;
+    quint64             lastReported_;
+    QElapsedTimer       reportClock_;
+    QTimer              reportTimer_;
+
+    qint32              sweepIndex_;
+    QFile               sweepLog_;
+    QStringList         sweepResults_;
+    QTimer              sweepTimer_;
+};
+
+#endif // __fixsimulator_h__
@@ -0,0 +1,13 @@
+# Linux build of the FIX simulator
+# qmake lmaxsimulator.pro && make
+
+TEMPLATE = app
+TARGET = lmaxsimulator
+CONFIG += console release
+CONFIG -= app_bundle
+QT = core network
+
+HEADERS += fixsimulator.h
+
+SOURCES += main.cpp \
+           fixsimulator.cpp
@@ -0,0 +1,173 @@
+#include "fixsimulator.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+
+#include <stdio.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////////
+namespace {
+    void usage()
+    {
+        printf("Local LMAX FIX 4.4 market data simulator for load and latency testing of LMAX adapter.\n"
+               "Point the adapter to it with Server=127.0.0.1 and ServerPort in the INI file,\n"
+               "choose PlainTCP protocol in the settings when the simulator runs with --plain.\n\n"
+               "Options:\n"
+               "  --listen ADDRESS    listening address (127.0.0.1)\n"
+               "  --port N            listening port (9443)\n"
+               "  --plain             plain TCP instead of TLS\n"
+               "  --cert FILE         PEM certificate of TLS server\n"
+               "  --key FILE          PEM private key of the certificate\n"
+               "  --password TEXT     required Logon password (554), any when not given\n"
+               "  --instruments N     subscriptions per session at most (100)\n"
+               "  --rate N            steady market data messages per second per session (1000)\n"
+               "  --burst N           extra messages of one burst, 0 - no bursts (0)\n"
+               "  --burst-period MS   msecs between bursts (1000)\n\n"
+               "GUI load sweep, --rate steps through the list and the simulator quits at the end:\n"
+               "  --sweep N,N,...     W/sec per session of the steps\n"
+               "  --sweep-step SECS   duration of a step (40)\n"
+               "  --sweep-log FILE    lmax_debug.log of the adapter, the GUI thread CPU share\n"
+               "                      it reports every 10 secs is averaged per step\n"
+               "For example, with the adapter logging to its working directory:\n"
+               "  lmaxsimulator --plain --sweep 1000,5000,20000,50000 --sweep-log lmax_debug.log\n\n"
+               "Faults injected into every session:\n"
+               "  --drop-after SECS   abort the connection SECS after logon, no Logout\n"
+               "  --stall-after SECS  go silent SECS after logon, the socket stays open\n"
+               "  --gap-every N       skip a MsgSeqNum every N market data messages\n\n"
+               "Failover check: run one simulator per session, the faulty one as primary,\n"
+               "  lmaxsimulator --plain --port 9443 --drop-after 30\n"
+               "  lmaxsimulator --plain --port 9444\n"
+               "with ServerPort=9443, StandbyDomain=127.0.0.1 and StandbyPort=9444,\n"
+               "quotes of the MQL clients go on while the primary session reconnects.\n"
+               "lmaxtest --failover SECS runs both, kills the primary and checks the quotes.\n");
+    }
+
+    bool parseOptions(const QStringList& args, SimulatorConfig& config)
+    {
+        QString certFile, keyFile;
+        for(qint32 i = 1; i < args.size(); i++)
+        {
+            const QString& arg = args[i];
+            bool hasValue = (i + 1 < args.size());
+            bool ok = true;
+
+            if( arg == "--plain" )
+                config.plain_ = true;
+            else if( arg == "--help" || arg == "-h" )
+                return false;
+            else if( !hasValue ) {
+                fprintf(stderr, "Missing value of %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
+            else if( arg == "--listen" )
+                ok = config.address_.setAddress(args[++i]);
+            else if( arg == "--port" )
+                config.port_ = args[++i].toUShort(&ok);
+            else if( arg == "--cert" )
+                certFile = args[++i];
+            else if( arg == "--key" )
+                keyFile = args[++i];
+            else if( arg == "--password" )
+                config.password_ = args[++i];
+            else if( arg == "--instruments" )
+                config.instruments_ = args[++i].toUInt(&ok);
+            else if( arg == "--rate" )
+                config.rate_ = args[++i].toUInt(&ok);
+            else if( arg == "--burst" )
+                config.burstSize_ = args[++i].toUInt(&ok);
+            else if( arg == "--burst-period" )
+                config.burstPeriod_ = args[++i].toUInt(&ok);
+            else if( arg == "--drop-after" )
+                config.dropAfter_ = args[++i].toUInt(&ok);
+            else if( arg == "--stall-after" )
+                config.stallAfter_ = args[++i].toUInt(&ok);
+            else if( arg == "--gap-every" )
+                config.gapEvery_ = args[++i].toUInt(&ok);
+            else if( arg == "--sweep" ) {
+                QStringList rates = args[++i].split(',', QString::SkipEmptyParts);
+                for(qint32 r = 0; ok && r < rates.size(); r++)
+                    config.sweepRates_.append(rates[r].toUInt(&ok));
+                ok = ok && !rates.empty();
+            }
+            else if( arg == "--sweep-step" )
+                config.sweepStep_ = args[++i].toUInt(&ok);
+            else if( arg == "--sweep-log" )
+                config.sweepLog_ = args[++i];
+            else {
+                fprintf(stderr, "Unknown option %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
+
+            if( !ok ) {
+                fprintf(stderr, "Invalid value of %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
+        }
+
+        if( config.burstSize_ > 0 && config.burstPeriod_ == 0 ) {
+            fprintf(stderr, "Burst period must not be zero\n");
+            return false;
+        }
+        if( !config.sweepRates_.empty() && config.sweepStep_ < 2*10 ) {
+            fprintf(stderr, "Sweep step must cover two GUI refresh reports, 20 secs at least\n");
+            return false;
+        }
+        if( config.plain_ )
+            return true;
+
+        if( certFile.isEmpty() || keyFile.isEmpty() ) {
+            fprintf(stderr, "TLS requires --cert and --key, or use --plain\n");
+            return false;
+        }
+
+        QFile cert(certFile);
+        if( !cert.open(QIODevice::ReadOnly) ) {
+            fprintf(stderr, "Can't open %s\n", certFile.toLocal8Bit().constData());
+            return false;
+        }
+        config.certificate_ = QSslCertificate(&cert, QSsl::Pem);
+
+        QFile key(keyFile);
+        if( !key.open(QIODevice::ReadOnly) ) {
+            fprintf(stderr, "Can't open %s\n", keyFile.toLocal8Bit().constData());
+            return false;
+        }
+        config.key_ = QSslKey(&key, QSsl::Rsa, QSsl::Pem);
+
+        if( config.certificate_.isNull() || config.key_.isNull() ) {
+            fprintf(stderr, "Invalid PEM certificate or RSA key\n");
+            return false;
+        }
+        return true;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    SimulatorConfig config;
+    if( !parseOptions(app.arguments(), config) ) {
+        usage();
+        return -1;
+    }
+
+    if( !config.plain_ && !QSslSocket::supportsSsl() ) {
+        fprintf(stderr, "OpenSSL is not available, use --plain\n");
+        return -1;
+    }
+
+    FixSimulator simulator(config);
+    QString error;
+    if( !simulator.start(&error) ) {
+        fprintf(stderr, "Can't listen on %s:%u: %s\n",
+                config.address_.toString().toLocal8Bit().constData(), config.port_,
+                error.toLocal8Bit().constData());
+        return -1;
+    }
+    return app.exec();
+}
@@ -0,0 +1,155 @@
+#include "benchmark.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include "mqlbridge.h"
+#include <QString>
+#include <time.h>
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+#ifdef Q_OS_WIN
+namespace {
+    HINSTANCE hBridge = NULL;
+}
+
+bool BridgeApi::load(string& error)
+{
+#ifndef NDEBUG
+    const char* dllname = "mqld.dll";
+#else
+    const char* dllname = "mql.dll";
+#endif
+    hBridge = ::LoadLibraryA(dllname);
+    if( hBridge == NULL ) {
+        error = string("Can't load ") + dllname;
+        return false;
+    }
+
+    getBid_ = (GetFunction)::GetProcAddress(hBridge, "__getBid");
+    getAsk_ = (GetFunction)::GetProcAddress(hBridge, "__getAsk");
+    getQuoteInfo_ = (GetInfoFunction)::GetProcAddress(hBridge, "__getQuoteInfo");
+    if( getBid_ == NULL || getAsk_ == NULL || getQuoteInfo_ == NULL ) {
+        error = string("Can't import __getBid, __getAsk or __getQuoteInfo from ") + dllname;
+        unload();
+        return false;
+    }
+    return true;
+}
+
+void BridgeApi::unload()
+{
+    getBid_ = getAsk_ = NULL;
+    getQuoteInfo_ = NULL;
+    if( hBridge ) {
+        ::FreeLibrary(hBridge);
+        hBridge = NULL;
+    }
+}
+
+qint64 nanotime()
+{
+    static LARGE_INTEGER frequency = {0};
+    if( frequency.QuadPart == 0 )
+        ::QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    ::QueryPerformanceCounter(&counter);
+    return (counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           (counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
+#else
+// Same conversions as the exports of mqlbridge/dllmain.cpp
+namespace {
+    double getBid(const wchar_t* symbol)
+    {
+        return spMqlBridge()->getBid(QString::fromWCharArray(symbol).toLocal8Bit());
+    }
+
+    double getAsk(const wchar_t* symbol)
+    {
+        return spMqlBridge()->getAsk(QString::fromWCharArray(symbol).toLocal8Bit());
+    }
+
+    int getQuoteInfo(const wchar_t* symbol, qint64* info, int size)
+    {
+        return spMqlBridge()->getQuoteInfo(QString::fromWCharArray(symbol).toLocal8Bit(), info, size);
+    }
+}
+
+bool BridgeApi::load(string&)
+{
+    spMqlBridge()->attach();
+    getBid_ = getBid;
+    getAsk_ = getAsk;
+    getQuoteInfo_ = getQuoteInfo;
+    return true;
+}
+
+void BridgeApi::unload()
+{
+    getBid_ = getAsk_ = NULL;
+    getQuoteInfo_ = NULL;
+    spMqlBridge()->detach();
+}
+
+qint64 nanotime()
+{
+    return MqlBridge::nanotime();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+BenchmarkThread::BenchmarkThread(const BridgeApi& api, const vector<wstring>& symbols, quint32 firstSymbol)
+    : api_(api),
+    symbols_(symbols),
+    firstSymbol_(firstSymbol),
+    stopping_(0),
+    errors_(0)
+{
+}
+
+void BenchmarkThread::run()
+{
+    // threads start from different symbols to not walk the same slots in lockstep
+    quint32 count = symbols_.size();
+    quint32 i = firstSymbol_ % count;
+    vector<quint32> lastSequence(count, 0);
+    qint64 info[InfoCount];
+
+    while( stopping_.loadAcquire() == 0 )
+    {
+        const wchar_t* sym = symbols_[i].c_str();
+
+        qint64 t0 = nanotime();
+        double ask = api_.getAsk_(sym);
+        qint64 t1 = nanotime();
+        double bid = api_.getBid_(sym);
+        qint64 t2 = nanotime();
+
+        calls_.record(t1 - t0);
+        calls_.record(t2 - t1);
+        if( ask < 0 || bid < 0 )
+            ++errors_;
+
+        if( api_.getQuoteInfo_(sym, info, InfoCount) == InfoCount )
+        {
+            quint32 sequence = (quint32)info[InfoSequence];
+            if( sequence != lastSequence[i] ) {
+                // the first seen quote may be an old one, so it's not measured
+                if( lastSequence[i] != 0 ) {
+                    propagation_.record(info[InfoNowNanos] - info[InfoAdapterNanos]);
+                    pipe_.record(info[InfoBridgeNanos] - info[InfoAdapterNanos]);
+                }
+                lastSequence[i] = sequence;
+            }
+        }
+
+        if( ++i == count )
+            i = 0;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef __benchmark_h__
+#define __benchmark_h__
+
+#include "nanohistogram.h"
+
+#include <QThread>
+#include <QAtomicInt>
+
+#include <vector>
+#include <string>
+
+#ifdef Q_OS_WIN
+#define BRIDGECALL __stdcall
+#else
+#define BRIDGECALL
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Exports of mql.dll, on Linux the bridge is linked in statically
+// and these are served by the same code as the dll exports
+struct BridgeApi
+{
+    typedef double (BRIDGECALL *GetFunction)(const wchar_t*);
+    typedef int    (BRIDGECALL *GetInfoFunction)(const wchar_t*, qint64*, int);
+
+    GetFunction     getBid_;
+    GetFunction     getAsk_;
+    GetInfoFunction getQuoteInfo_;
+
+    BridgeApi() : getBid_(NULL), getAsk_(NULL), getQuoteInfo_(NULL) {}
+
+    // Resolves the exports, returns false with description in error
+    bool load(std::string& error);
+    void unload();
+};
+
+// Values order of __getQuoteInfo
+enum BridgeQuoteInfo {
+    InfoServerTime = 0,
+    InfoAdapterNanos,
+    InfoBridgeNanos,
+    InfoSequence,
+    InfoNowNanos,
+    InfoCount
+};
+
+// Monotonic clock of mql.dll and LMAX adapter (QueryPerformanceCounter, CLOCK_MONOTONIC)
+qint64 nanotime();
+
+////////////////////////////////////////////////////////////////////////////////
+// Calls __getAsk/__getBid in a tight loop over the symbols
+// and tracks the delay of new quotes by __getQuoteInfo
+class BenchmarkThread : public QThread
+{
+public:
+    BenchmarkThread(const BridgeApi& api, const std::vector<std::wstring>& symbols, quint32 firstSymbol);
+
+    inline void stop()
+    { stopping_ = 1; }
+
+    // valid after the thread is finished
+    inline const NanoHistogram& calls() const { return calls_; }
+    inline const NanoHistogram& propagation() const { return propagation_; }
+    inline const NanoHistogram& pipe() const { return pipe_; }
+    inline quint64 errors() const { return errors_; }
+
+protected:
+    void run();
+
+private:
+    const BridgeApi& api_;
+    std::vector<std::wstring> symbols_;
+    quint32 firstSymbol_;
+    QAtomicInt stopping_;
+
+    NanoHistogram calls_;        // single __getAsk/__getBid call
+    NanoHistogram propagation_;  // publisher stamp -> first observed by this thread
+    NanoHistogram pipe_;         // publisher stamp -> received by mql.dll
+    quint64 errors_;
+};
+
+#endif // __benchmark_h__
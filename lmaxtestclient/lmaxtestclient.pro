@@ -0,0 +1,24 @@
+# Linux build of the benchmark: mql.dll sources are linked in statically
+# qmake lmaxtestclient.pro && make
+
+TEMPLATE = app
+TARGET = lmaxtest
+CONFIG += console release
+CONFIG -= app_bundle
+QT = core network
+
+INCLUDEPATH += ../lmaxadapter ../mqlbridge
+
+HEADERS += benchmark.h \
+           ../lmaxadapter/nanohistogram.h \
+           publisher.h \
+           ../mqlbridge/mqlbridge.h \
+           ../mqlbridge/mqlproxyclient.h \
+           ../lmaxadapter/mqlprotocol.h
+
+SOURCES += main.cpp \
+           benchmark.cpp \
+           publisher.cpp \
+           ../lmaxadapter/nanohistogram.cpp \
+           ../mqlbridge/mqlbridge.cpp \
+           ../mqlbridge/mqlproxyclient.cpp
@@ -1,328 +1,369 @@
-#include <windows.h>
+#include "benchmark.h"
+#include "publisher.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QProcess>
+
+#include <stdio.h>
 #include <vector>
 #include <string>
-#include <algorithm>
-
-#include <conio.h>
-#include <ctype.h>
-#include <time.h>
 
 using namespace std;
 
-const int   timestamp_ms_size  = sizeof("YYYYMMDD-HH:MM:SS.sss");
-FILE* fcheck;
+#include "symbols.cpp"
 
+///////////////////////////////////////////////////////////////////////////////////
 namespace {
-    void setCursorPos(int row, int column)
-    {
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        COORD c;
-        c.X = column;
-        c.Y = row;
-        SetConsoleCursorPosition(hConsoleOutput, c);
-        fflush(stdout);
-    }
+    struct Options {
+        quint32 threads_;
+        quint32 duration_;      // secs
+        quint32 warmup_;        // secs of waiting for the first quotes
+        quint32 rate_;          // quotes per sec of the synthetic publisher
+        bool    external_;      // quotes are published by running LMAX adapter
+        QString json_;          // "-" for stdout
+        vector<wstring> symbols_;
+
+        quint32 failover_;      // secs of the failover scenario, 0 - benchmark
+        quint32 maxStall_;      // msecs without quotes allowed after the primary is killed
+        QString simulator_;     // lmaxsimulator executable of the scenario
+
+        Options()
+            : threads_(1), duration_(10), warmup_(5), rate_(10000), external_(false),
+            failover_(0), maxStall_(1000)
+        {}
+    };
 
-    void getCursorPos(int* row, int* column)
+    void usage()
     {
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        CONSOLE_SCREEN_BUFFER_INFO info;
-        GetConsoleScreenBufferInfo( hConsoleOutput, &info);
-        *column = info.dwCursorPosition.X;
-        *row = info.dwCursorPosition.Y;
+        printf("Benchmark of mql.dll: calls __getAsk() and __getBid() from N threads over the symbols\n"
+               "and measures the call latency and the delay of quotes from the publisher to the reader.\n\n"
+               "Options:\n"
+               "  --threads N         number of reading threads (1)\n"
+               "  --duration SECS     measuring time (10)\n"
+               "  --symbols A,B,...   symbols to read\n"
+               "  --symbol-count N    first N of the default symbols when --symbols is not given (20)\n"
+               "  --rate N            quotes per second of the synthetic publisher (10000)\n"
+               "  --external          don't start the synthetic publisher, use running LMAX adapter\n"
+               "  --warmup SECS       waiting for the first quote of every symbol (5)\n"
+               "  --json FILE         write results in JSON, \"-\" for stdout\n\n"
+               "Failover scenario instead of the benchmark, with running LMAX adapter configured\n"
+               "with Protocol PlainTCP, ServerPort=9443, StandbyDomain=127.0.0.1, StandbyPort=9444:\n"
+               "  --failover SECS     start primary and standby simulators, kill the primary in\n"
+               "                      the middle of SECS and check the quotes go on, exit code 1\n"
+               "                      when they stop\n"
+               "  --max-stall MS      msecs without quotes allowed after the kill (1000)\n"
+               "  --simulator FILE    lmaxsimulator executable (lmaxsimulator of this directory)\n"
+               "For example: lmaxtest --failover 60 --warmup 30\n");
     }
 
-    void getConsoleSize(int* width, int* height) 
+    bool parseOptions(const QStringList& args, Options& opts)
     {
-        CONSOLE_SCREEN_BUFFER_INFO info;
-        memset(&info, 0, sizeof(info));
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        if( GetConsoleScreenBufferInfo(hConsoleOutput, &info) )
+        quint32 symbolCount = 20;
+        for(qint32 i = 1; i < args.size(); i++)
         {
-            *width  = info.srWindow.Right;
-            *height = info.srWindow.Bottom;
+            const QString& arg = args[i];
+            bool hasValue = (i + 1 < args.size());
+            bool ok = true;
+
+            if( arg == "--external" )
+                opts.external_ = true;
+            else if( arg == "--help" || arg == "-h" )
+                return false;
+            else if( !hasValue ) {
+                fprintf(stderr, "Missing value of %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
+            else if( arg == "--threads" )
+                opts.threads_ = args[++i].toUInt(&ok);
+            else if( arg == "--duration" )
+                opts.duration_ = args[++i].toUInt(&ok);
+            else if( arg == "--warmup" )
+                opts.warmup_ = args[++i].toUInt(&ok);
+            else if( arg == "--rate" )
+                opts.rate_ = args[++i].toUInt(&ok);
+            else if( arg == "--symbol-count" )
+                symbolCount = args[++i].toUInt(&ok);
+            else if( arg == "--json" )
+                opts.json_ = args[++i];
+            else if( arg == "--failover" )
+                opts.failover_ = args[++i].toUInt(&ok);
+            else if( arg == "--max-stall" )
+                opts.maxStall_ = args[++i].toUInt(&ok);
+            else if( arg == "--simulator" )
+                opts.simulator_ = args[++i];
+            else if( arg == "--symbols" ) {
+                QStringList list = args[++i].split(',', QString::SkipEmptyParts);
+                for(qint32 j = 0; j < list.size(); j++)
+                    opts.symbols_.push_back(list[j].trimmed().toStdWString());
+            }
+            else {
+                fprintf(stderr, "Unknown option %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
+
+            if( !ok ) {
+                fprintf(stderr, "Invalid value of %s\n", arg.toLocal8Bit().constData());
+                return false;
+            }
         }
+
+        if( opts.symbols_.empty() ) {
+            quint32 defaults = sizeof(InstNameDefaults)/sizeof(wstring);
+            for(quint32 i = 0; i < symbolCount && i < defaults; i++)
+                opts.symbols_.push_back(InstNameDefaults[i]);
+        }
+        if( opts.threads_ == 0 || opts.duration_ == 0 || opts.symbols_.empty() ) {
+            fprintf(stderr, "Threads, duration and symbols must not be zero\n");
+            return false;
+        }
+        if( opts.failover_ > 0 ) {
+            // quotes come from the adapter connected to the simulators
+            opts.external_ = true;
+            if( opts.simulator_.isEmpty() )
+                opts.simulator_ = QCoreApplication::applicationDirPath() + "/lmaxsimulator";
+        }
+        return true;
     }
 
-    void clearCell(HANDLE hConsoleOutput, int consoleLine, int consoleColumn)
+    // Registers symbols in the bridge and waits for their first quotes
+    quint32 warmup(const BridgeApi& api, const Options& opts)
     {
-        COORD c;
-        c.X = consoleColumn;
-        c.Y = consoleLine;
-        unsigned long written;
-        SetConsoleCursorPosition(hConsoleOutput, c);
-        WriteConsoleA(hConsoleOutput, "                   ", 19, &written, NULL);
-        SetConsoleCursorPosition(hConsoleOutput, c);
+        QElapsedTimer timer;
+        timer.start();
+
+        qint64 info[InfoCount];
+        quint32 ready = 0;
+        do
+        {
+            ready = 0;
+            for(quint32 i = 0; i < opts.symbols_.size(); i++) {
+                api.getAsk_(opts.symbols_[i].c_str());
+                if( api.getQuoteInfo_(opts.symbols_[i].c_str(), info, InfoCount) > 0 )
+                    ++ready;
+            }
+            if( ready == opts.symbols_.size() )
+                break;
+            QThread::msleep(10);
+        }
+        while( timer.elapsed() < qint64(opts.warmup_) * 1000 );
+        return ready;
     }
 
-    void printTransCell(long long trans, int consoleLine)
-    {
-        char szTrans[15];
-        unsigned long written;
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        clearCell(hConsoleOutput, consoleLine, 13);
-        sprintf_s(szTrans, 15, "%llu", trans);
-        WriteConsoleA(hConsoleOutput, szTrans, strlen(szTrans), &written, NULL);
-    }    
-
-    void printBidCell(double bid, int consoleLine)
+    // Primary and standby simulators feed the running adapter, the primary is killed
+    // half way through like a crashed server and the quotes read through the bridge
+    // have to go on from the standby session
+    int failover(const BridgeApi& api, const Options& opts)
     {
-        char szBid[15];
-        unsigned long written;
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        clearCell(hConsoleOutput, consoleLine, 44);
-        sprintf_s(szBid, 15, "%f", bid);
-        WriteConsoleA(hConsoleOutput, szBid, strlen(szBid), &written, NULL);
-    } 
-
-    void printAskCell(double ask, int consoleLine)
-    {
-        char szAsk[15];
-        unsigned long written;
-        HANDLE hConsoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-        clearCell(hConsoleOutput, consoleLine, 19);
-        sprintf_s(szAsk, 15, "%f", ask);
-        WriteConsoleA(hConsoleOutput, szAsk, strlen(szAsk), &written, NULL);
-    } 
-
-    typedef unsigned char  u8;
-    typedef unsigned short u16;
-
-    u8 sprintfTimeStamp( u16 year, 
-                         u8 month, 
-                         u8 day, 
-                         u8 hour, 
-                         u8 minute, 
-                         u8 second, 
-                         wchar_t* buf )
-    {
-    	u8 pos = 0;
-//    	assert(year >= 1000);
-//    	assert(year <= 9999);
-    	buf[pos + 3] = 48 + year%10; year/=10;
-    	buf[pos + 2] = 48 + year%10; year/=10;
-    	buf[pos + 1] = 48 + year%10; year/=10;
-    	buf[pos + 0] = 48 + year%10; 
-    	pos = 4;
-//    	assert(month <= 12);
-    	buf[pos + 1] = 48 + month%10; month/=10;
-    	buf[pos + 0] = 48 + month%10; 
-    	pos = 6;
-//    	assert(day <= 31);
-    	buf[pos + 1] = 48 + day%10; day/=10;
-    	buf[pos + 0] = 48 + day%10; 
-    	pos = 8; buf[pos] = '-';
-    	pos = 9;
-//    	assert(hour <= 24);
-    	buf[pos + 1] = 48 + hour%10; hour/=10;
-    	buf[pos + 0] = 48 + hour%10; 
-    	pos = 11; buf[pos] = ':';
-    	pos = 12;
-//    	assert(minute <= 60);
-    	buf[pos + 1] = 48 + minute%10; minute/=10;
-    	buf[pos + 0] = 48 + minute%10; 
-    	pos = 14; buf[pos] = ':';
-    	pos = 15;
-//    	assert(second <= 60);
-    	buf[pos + 1] = 48 + second%10; second/=10;
-    	buf[pos + 0] = 48 + second%10; 
-    	buf[17] = 0;
-    	return 17;
+        QProcess primary, standby;
+        primary.setProcessChannelMode(QProcess::ForwardedChannels);
+        standby.setProcessChannelMode(QProcess::ForwardedChannels);
+        primary.start(opts.simulator_, QStringList() << "--plain" << "--port" << "9443");
+        standby.start(opts.simulator_, QStringList() << "--plain" << "--port" << "9444");
+        if( !primary.waitForStarted() || !standby.waitForStarted() ) {
+            fprintf(stderr, "Can't start %s\n", opts.simulator_.toLocal8Bit().constData());
+            primary.kill();
+            standby.kill();
+            primary.waitForFinished();
+            standby.waitForFinished();
+            return -1;
+        }
+
+        quint32 ready = warmup(api, opts);
+        printf("Failover: %u of %u symbols have quotes, the primary is killed in %u secs\n",
+               ready, (quint32)opts.symbols_.size(), opts.failover_ / 2);
+
+        quint32 count = opts.symbols_.size();
+        vector<quint32> lastSequence(count, 0);
+        qint64 info[InfoCount];
+        quint64 before = 0, after = 0;
+        qint64 killedAt = -1, lastQuote = 0, maxStall = 0;
+
+        QElapsedTimer clock;
+        clock.start();
+        while( clock.elapsed() < qint64(opts.failover_) * 1000 )
+        {
+            quint32 fresh = 0;
+            for(quint32 i = 0; i < count; i++) {
+                if( api.getQuoteInfo_(opts.symbols_[i].c_str(), info, InfoCount) != InfoCount )
+                    continue;
+                quint32 sequence = (quint32)info[InfoSequence];
+                if( sequence != lastSequence[i] && lastSequence[i] != 0 )
+                    ++fresh;
+                lastSequence[i] = sequence;
+            }
+
+            qint64 now = clock.elapsed();
+            if( fresh > 0 ) {
+                if( killedAt >= 0 ) {
+                    after += fresh;
+                    maxStall = qMax(maxStall, now - lastQuote);
+                }
+                else
+                    before += fresh;
+                lastQuote = now;
+            }
+
+            if( killedAt < 0 && now >= qint64(opts.failover_) * 500 ) {
+                printf("Failover: killing the primary simulator\n");
+                fflush(stdout);
+                primary.kill();
+                primary.waitForFinished();
+                killedAt = lastQuote = clock.elapsed();
+            }
+            QThread::msleep(1);
+        }
+        // quotes stopped for good are a stall up to the end
+        maxStall = qMax(maxStall, clock.elapsed() - lastQuote);
+
+        standby.kill();
+        standby.waitForFinished();
+
+        bool passed = before > 0 && after > 0 && maxStall <= qint64(opts.maxStall_);
+        printf("\nFailover: %llu quote updates before the kill, %llu after, longest stall %lld msecs (%u allowed)\n"
+               "%s\n", (unsigned long long)before, (unsigned long long)after, maxStall, opts.maxStall_,
+               passed ? "PASSED: quotes went on through the standby session"
+                      : "FAILED: quotes stopped with the primary session");
+        return passed ? 0 : 1;
     }
 
-    u8 sprintfTimeStampWithMSec(u16 year, 
-                                u8  month, 
-                                u8  day, 
-                                u8  hour, 
-                                u8  minute, 
-                                u8  second, 
-                                u16 msecond, 
-                                wchar_t*  buf)
+    void printHistogram(const char* name, const NanoHistogram& h)
     {
-    	u8 pos = sprintfTimeStamp(year, month, day, hour, minute, second, buf);
-    	buf[pos] = '.';
-    	pos = 18;
-//      assert(msecond <= 999);
-    	buf[pos + 2] = 48 + msecond%10; msecond/=10;
-    	buf[pos + 1] = 48 + msecond%10; msecond/=10;
-    	buf[pos + 0] = 48 + msecond%10; 
-    	buf[21] = 0;
-        return 21;
+        printf("%-12s count=%-12llu p50=%-10lld p99=%-10lld p99.9=%-10lld max=%-10lld mean=%.1f negative=%llu (nsecs)\n",
+               name, (unsigned long long)h.count(), h.percentile(0.5), h.percentile(0.99),
+               h.percentile(0.999), h.max(), h.mean(), (unsigned long long)h.negative());
     }
 
-    std::wstring timestamp()
+    void jsonHistogram(FILE* out, const char* name, const NanoHistogram& h, bool last)
     {
-        wchar_t out[timestamp_ms_size];
-        SYSTEMTIME t;
-        ::GetSystemTime(&t);
-	    sprintfTimeStampWithMSec(t.wYear, (u8)t.wMonth , (u8)t.wDay, (u8)t.wHour , (u8)t.wMinute , (u8)t.wSecond, t.wMilliseconds, out);
-        return out;
+        fprintf(out, "    \"%s\": {\"count\": %llu, \"min\": %lld, \"p50\": %lld, \"p99\": %lld, "
+                     "\"p999\": %lld, \"max\": %lld, \"mean\": %.1f, \"negative\": %llu}%s\n",
+                name, (unsigned long long)h.count(), h.min(), h.percentile(0.5), h.percentile(0.99),
+                h.percentile(0.999), h.max(), h.mean(), (unsigned long long)h.negative(), last ? "" : ",");
     }
 }
 
-#include "symbols.cpp"
-///////////////////////////////////////////////////////////////////////////////////
-typedef double (__stdcall *importGetFunction)(const wchar_t*);
-
-///////////////////////////////////////////////////////////////////////////////////
-struct find_string {
-    const string& lvalue_;
-    find_string(const string& value) : lvalue_(value) {}
-    bool operator()(const string& rvalue) const
-    { return lvalue_ == rvalue; }
-};
-
 ///////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char* argv[])
 {
-#ifndef NDEBUG
-    HINSTANCE hInst = ::LoadLibraryA("mqld.dll");
-    if( hInst == NULL ) {
-        ::MessageBoxA(NULL, "Can't load mqld.dll!", "Error", MB_OK|MB_ICONSTOP);
+    QCoreApplication app(argc, argv);
+
+    Options opts;
+    if( !parseOptions(app.arguments(), opts) ) {
+        usage();
         return -1;
     }
-#else
-    HINSTANCE hInst = ::LoadLibraryA("mql.dll");
-    if( hInst == NULL )
-        ::MessageBoxA(NULL, "Can't load mqld.dll!", "Error", MB_OK|MB_ICONSTOP);
-#endif
-
-    importGetFunction __getBid = (importGetFunction)::GetProcAddress(hInst, "__getBid");
-    importGetFunction __getAsk = (importGetFunction)::GetProcAddress(hInst, "__getAsk");
 
-    bool good = false;
-    if( NULL == __getBid )
+    QScopedPointer<SyntheticPublisher> publisher;
+    if( !opts.external_ )
     {
-        ::MessageBoxA(NULL, "Can't import __getBid from dll!", "Error", MB_OK|MB_ICONSTOP);
-    }
-    else if( NULL == __getAsk )
-    {
-        ::MessageBoxA(NULL, "Can't import __getAsk from dll!", "Error", MB_OK|MB_ICONSTOP);
-    }
-    else
-    {
-        good = true;
+        publisher.reset(new SyntheticPublisher(opts.rate_));
+        publisher->start();
+
+        QString error;
+        if( !publisher->waitListening(&error) ) {
+            fprintf(stderr, "Synthetic publisher failed to listen (LMAX adapter is running?): %s\n",
+                    error.toLocal8Bit().constData());
+            publisher->wait();
+            return -1;
+        }
     }
 
-    if( !good ) {
-        FreeLibrary(hInst);
+    BridgeApi api;
+    string error;
+    if( !api.load(error) ) {
+        fprintf(stderr, "%s\n", error.c_str());
+        if( publisher ) {
+            publisher->stop();
+            publisher->wait();
+        }
         return -1;
     }
 
-    ////////////////////////////////////////////////////////////////////////////////////////
-    // Testing __getAsk and __getBid calls with maximum intensity
-    // Delay and latency calculated from number of passed transactions 
-    // on enough amount of instruments.
-    // Test duration about 5 min.
-
-    fcheck = fopen("fromshare.log", "wc+");
-
-    printf("Testing __getAsk() and __getBid() calls with maximum intensity.\n"
-           "Delay and latency calculated from number of passed transactions\n"
-           "for some amount of instruments (20). Queries for symbols are not randomized and\n"
-           "each test iteration is repeating by order of symbols declaration in hardcode.\n"
-           "Test duration about 2 min.\n\n");
-
-    int MAX_INSTRUMENT = 2;
-    int JOB_TIME = 5; // seconds
-
-    int startRow = 0; 
-    int startColumn = 0;
-    double bid,ask;
-    const wchar_t* szSym;
-
-    struct Query {
-        wstring name_;
-        double lastBid_;
-        double lastAsk_;
-    };
-
-    getConsoleSize(&startColumn, &startRow);
-
-    time_t starttime = time(0);
-    int count = sizeof(InstNameDefaults)/sizeof(wstring);
-
-    int i = 0;
-    for(; i < startRow-6; ++i)
-        printf("\n");
-    setCursorPos(7,0);
+    if( opts.failover_ > 0 ) {
+        int code = failover(api, opts);
+        api.unload();
+        return code;
+    }
 
-    vector<Query> insts;
+    quint32 ready = warmup(api, opts);
+    if( ready < opts.symbols_.size() )
+        fprintf(stderr, "Warning: only %u of %u symbols have quotes after warmup\n",
+                ready, (quint32)opts.symbols_.size());
 
-    for(i = 0; i < MAX_INSTRUMENT && i < startRow-6; ++i)
-    {
-        Query q = {InstNameDefaults[i], 0.0f, 0.0f};
-        insts.push_back(q);
-        wprintf(L"\"%s\"", q.name_.c_str());
-
-        int r, c; 
-        getCursorPos(&r,&c);
-        setCursorPos(r,15);
-        printf("ask=                    ", q.lastAsk_);
-        setCursorPos(r,40);
-        printf("bid=                    \n", q.lastBid_);
-        startRow--;
+    ////////////////////////////////////////////////////////////////////////////////////////
+    printf("Running %u threads over %u symbols for %u secs...\n",
+           opts.threads_, (quint32)opts.symbols_.size(), opts.duration_);
+
+    vector<BenchmarkThread*> threads;
+    for(quint32 i = 0; i < opts.threads_; i++)
+        threads.push_back(new BenchmarkThread(api, opts.symbols_, i * opts.symbols_.size() / opts.threads_));
+
+    QElapsedTimer timer;
+    timer.start();
+    for(quint32 i = 0; i < threads.size(); i++)
+        threads[i]->start();
+
+    QThread::sleep(opts.duration_);
+
+    for(quint32 i = 0; i < threads.size(); i++)
+        threads[i]->stop();
+    for(quint32 i = 0; i < threads.size(); i++)
+        threads[i]->wait();
+    double elapsed = timer.nsecsElapsed() / 1e9;
+
+    quint64 published = 0;
+    if( publisher ) {
+        publisher->stop();
+        publisher->wait();
+        published = publisher->published();
     }
-    MAX_INSTRUMENT = i;
-
-    printf("\nTransactions=0\n");
-    startRow = 7;
-   
-    int ck = 0;
-    long long transactions = 0;
-    for(;;)
-    {
-        bool noChangeTransactBefore = false;
 
-        if( ck == MAX_INSTRUMENT ) {
-            printTransCell(transactions, startRow+ck+1);
-            ck = 0;
-        }
+    NanoHistogram calls, propagation, pipe;
+    quint64 errors = 0;
+    for(quint32 i = 0; i < threads.size(); i++) {
+        calls.merge(threads[i]->calls());
+        propagation.merge(threads[i]->propagation());
+        pipe.merge(threads[i]->pipe());
+        errors += threads[i]->errors();
+        delete threads[i];
+    }
+    api.unload();
 
-        szSym = insts[ck].name_.c_str();
-        ask = __getAsk(szSym);
-        if( ask < 0 ) {
-            ::MessageBoxA(NULL, "Error calling __getAsk()", "Error", MB_OK|MB_ICONSTOP);
-            return -1;
-        }
-        bid = __getBid(szSym);
-        if( bid < 0 ) {
-            ::MessageBoxA(NULL, "Error calling __getBid()", "Error", MB_OK|MB_ICONSTOP);
+    ////////////////////////////////////////////////////////////////////////////////////////
+    double callsPerSec = calls.count() / elapsed;
+    printf("\nCalls per sec: %.0f, errors: %llu, published quotes: %llu\n",
+           callsPerSec, (unsigned long long)errors, (unsigned long long)published);
+    printHistogram("call", calls);
+    printHistogram("pipe", pipe);
+    printHistogram("propagation", propagation);
+
+    if( !opts.json_.isEmpty() )
+    {
+        FILE* out = (opts.json_ == "-") ? stdout : fopen(opts.json_.toLocal8Bit().constData(), "w");
+        if( out == NULL ) {
+            fprintf(stderr, "Can't open %s\n", opts.json_.toLocal8Bit().constData());
             return -1;
         }
-        transactions += 2;
 
-        bool changed = false;
-        if( ask != insts[ck].lastAsk_ ) {
-            insts[ck].lastAsk_ = ask;
-            printAskCell(ask,startRow+ck);
-            changed = true;
-        }
-        if( bid != insts[ck].lastBid_ ) {
-            insts[ck].lastBid_ = bid;
-            printBidCell(bid,startRow+ck);
-            changed = true;
-        }
-
-        if( changed )
-        {
-            wchar_t buf[256];
-            swprintf_s(buf, 256, L"%s: \"%s\"\task=%f, bid=%f\n", timestamp().c_str(), szSym, ask, bid);
-            fwrite(buf, 1, wcslen(buf), fcheck);
-            fflush(fcheck);
-        }
-        
-        if( time(0) - starttime > JOB_TIME*60 )
-            break;
-        ck++;
+        fprintf(out, "{\n");
+        fprintf(out, "  \"config\": {\"threads\": %u, \"symbols\": %u, \"duration\": %.3f, "
+                     "\"rate\": %u, \"publisher\": \"%s\"},\n",
+                opts.threads_, (quint32)opts.symbols_.size(), elapsed,
+                opts.external_ ? 0 : opts.rate_, opts.external_ ? "external" : "synthetic");
+        fprintf(out, "  \"calls_per_sec\": %.0f,\n", callsPerSec);
+        fprintf(out, "  \"errors\": %llu,\n", (unsigned long long)errors);
+        fprintf(out, "  \"published\": %llu,\n", (unsigned long long)published);
+        fprintf(out, "  \"latency_ns\": {\n");
+        jsonHistogram(out, "call", calls, false);
+        jsonHistogram(out, "pipe", pipe, false);
+        jsonHistogram(out, "propagation", propagation, true);
+        fprintf(out, "  }\n}\n");
+
+        if( out != stdout )
+            fclose(out);
     }
-
-    long long val = transactions/(time(0)-starttime);
-    printf("\nTest passed: transactions per sec = %llu, testing time = %d secs\n\n", val, time(0)-starttime);
-
-    printf("Press a key to exit...\n");
-    fflush(stdin);
-    _getch();
-
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,175 @@
+#include "external.h"
+#include "mqlprotocol.h"
+#include "publisher.h"
+#include "benchmark.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+
+using namespace std;
+
+// Pipe buffer limit of the slow client, publisher skips the quotes above it
+#define PUBLISHER_HIGH_WATERMARK    (1024*1024)
+// Quotes in one frame at most
+#define PUBLISHER_MAX_BATCH         256
+
+////////////////////////////////////////////////////////////////////////////////
+SyntheticPublisher::SyntheticPublisher(quint32 quotesPerSecond)
+    : rate_(quotesPerSecond),
+    stopping_(0),
+    listening_(0),
+    published_(0)
+{
+}
+
+bool SyntheticPublisher::waitListening(QString* error)
+{
+    while( listening_.loadAcquire() == 0 )
+        QThread::msleep(1);
+
+    if( listening_.loadAcquire() < 0 ) {
+        if( error )
+            *error = error_;
+        return false;
+    }
+    return true;
+}
+
+void SyntheticPublisher::subscribe(const char* symbol, quint16 length)
+{
+    QByteArray name(symbol, length);
+    for(quint32 i = 0; i < instruments_.size(); i++)
+        if( instruments_[i].symbol_ == name )
+            return;
+
+    Instrument inst;
+    inst.symbol_ = name;
+    inst.bid_ = 1.0 + instruments_.size() * 0.1;
+    inst.sequence_ = 0;
+    inst.announced_ = false;
+    instruments_.push_back(inst);
+}
+
+void SyntheticPublisher::run()
+{
+    QLocalServer server;
+    QLocalServer::removeServer(MQL_PROXY_PIPE);
+    if( !server.listen(MQL_PROXY_PIPE) ) {
+        error_ = server.errorString();
+        listening_ = -1;
+        return;
+    }
+    listening_ = 1;
+
+    // client connects its reader channel first, it's the publisher's writer
+    QLocalSocket* writer = NULL;
+    QLocalSocket* reader = NULL;
+    MqlFrameDecoder decoder;
+    quint32 outSequence = 0;
+
+    QElapsedTimer clock;
+    quint64 scheduled = 0;
+    quint32 next = 0;
+    quint32 random = 12345;
+
+    while( stopping_.loadAcquire() == 0 )
+    {
+        if( server.waitForNewConnection(0) ) {
+            while( server.hasPendingConnections() ) {
+                QLocalSocket* cnt = server.nextPendingConnection();
+                if( writer == NULL )
+                    writer = cnt;
+                else if( reader == NULL )
+                    reader = cnt;
+                else
+                    cnt->abort();
+            }
+        }
+
+        if( (writer && writer->state() != QLocalSocket::ConnectedState) ||
+            (reader && reader->state() != QLocalSocket::ConnectedState) )
+        {
+            // symbol ids are valid during the connection only
+            delete writer;
+            delete reader;
+            writer = reader = NULL;
+            decoder.reset();
+            instruments_.clear();
+            outSequence = 0;
+            continue;
+        }
+
+        if( reader && reader->waitForReadyRead(0) )
+        {
+            QByteArray data = reader->readAll();
+            decoder.feed(data.constData(), data.size());
+
+            MqlFrame frame;
+            while( decoder.next(&frame) ) {
+                if( frame.header_.type_ != MqlSymbolsFrame )
+                    continue;
+                MqlRecordReader records(frame);
+                const char* sym;
+                quint16 length;
+                while( records.readSymbol(&sym, &length) )
+                    subscribe(sym, length);
+            }
+            if( decoder.hasError() )
+                reader->abort();
+        }
+
+        if( writer == NULL || instruments_.empty() ) {
+            QThread::msleep(1);
+            continue;
+        }
+
+        // quotes are scheduled from the first subscription at the fixed rate
+        if( !clock.isValid() )
+            clock.start();
+        quint64 expected = (quint64)(clock.nsecsElapsed() / 1000) * rate_ / 1000000;
+        if( expected <= scheduled ) {
+            QThread::usleep(50);
+            continue;
+        }
+
+        quint64 batch = qMin(expected - scheduled, (quint64)PUBLISHER_MAX_BATCH);
+        scheduled += batch;
+        if( writer->bytesToWrite() > PUBLISHER_HIGH_WATERMARK ) {
+            // reader is slower than the rate, keep the schedule without queueing
+            scheduled = expected;
+            writer->waitForBytesWritten(0);
+            continue;
+        }
+
+        MqlFrameWriter symbols(MqlSymbolMapFrame);
+        MqlFrameWriter quotes(MqlQuotesFrame);
+        qint64 serverTime = QDateTime::currentMSecsSinceEpoch();
+        qint64 stamp = nanotime();
+        for(quint64 i = 0; i < batch; i++)
+        {
+            Instrument& inst = instruments_[next];
+            if( !inst.announced_ ) {
+                symbols.addSymbolId(next, inst.symbol_.constData(), inst.symbol_.size());
+                inst.announced_ = true;
+            }
+
+            random = random * 1103515245 + 12345;
+            inst.bid_ += (double((random >> 16) % 3) - 1.0) * 0.00001;
+            quotes.addQuote(next, inst.bid_, inst.bid_ + 0.0002, serverTime, stamp, ++inst.sequence_);
+
+            if( ++next == instruments_.size() )
+                next = 0;
+        }
+
+        if( !symbols.empty() )
+            writer->write(symbols.finish(++outSequence));
+        writer->write(quotes.finish(++outSequence));
+        writer->flush();
+        published_ += batch;
+    }
+
+    delete writer;
+    delete reader;
+    server.close();
+}
@@ -0,0 +1,53 @@
+#ifndef __publisher_h__
+#define __publisher_h__
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QByteArray>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Stand-in of LMAX adapter's pipe server for benchmarking of mql.dll without
+// LMAX connection: accepts one MQL client on MQL_PROXY_PIPE, answers its symbol
+// requests and publishes synthetic quotes at the given total rate.
+// Quotes are stamped with nanotime() at writing to the pipe as the adapter does
+// at receiving from LMAX, so the reader measures the delay from the publisher.
+class SyntheticPublisher : public QThread
+{
+public:
+    SyntheticPublisher(quint32 quotesPerSecond);
+
+    inline void stop()
+    { stopping_ = 1; }
+
+    // Returns false and error description when pipe server can't listen
+    bool waitListening(QString* error);
+
+    // valid after the thread is finished
+    inline quint64 published() const { return published_; }
+
+protected:
+    void run();
+
+private:
+    struct Instrument {
+        QByteArray symbol_;
+        double     bid_;
+        quint32    sequence_;
+        bool       announced_;
+    };
+
+    void subscribe(const char* symbol, quint16 length);
+
+private:
+    quint32 rate_;
+    QAtomicInt stopping_;
+    QAtomicInt listening_;      // 0 - starting, 1 - listening, -1 - failed
+    QString error_;
+
+    std::vector<Instrument> instruments_;
+    quint64 published_;
+};
+
+#endif // __publisher_h__
@@ -74,6 +74,17 @@ DLLEXPORT(void) __setAsk(const wchar_t* symbol, double value)
     bridge->setAsk(QString::fromWCharArray(symbol).toLocal8Bit(), value);
 }
 
+// MQL: int __getQuoteInfo(string symbol, long& info[], int size);
+// info: LMAX SendingTime (msecs since epoch), adapter receive nsecs, mql.dll receive nsecs,
+// per-instrument sequence, current nsecs; nsecs values are of one monotonic clock
+DLLEXPORT(int) __getQuoteInfo(const wchar_t* symbol, qint64* info, int size)
+{
+    BridgeOrZero;
+    if( info == NULL || size <= 0 )
+        return 0;
+    return bridge->getQuoteInfo(QString::fromWCharArray(symbol).toLocal8Bit(), info, size);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,58 +1,58 @@
 #include "mqlbridge.h"
 #include "mqlproxyclient.h"
 
+#include <string.h>
+
+#ifdef Q_OS_WIN
 #include <Windows.h>
+#else
+#include <stdio.h>
+#include <time.h>
+#endif
 
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////
 MqlBridge::MqlBridge()
-    : connection_(NULL),
-    quotesLock_(new QReadWriteLock()),
-    proxyWaiter_(InitEvent()),
-    proxyConnected_(0),
+    : index_(new SymbolIndexT()),
+    connection_(new MqlProxyClient()),
+    started_(0),
     attached_(0)
-{}
+{
+    // reader thread notifications are processed on the reader thread itself
+    QObject::connect(connection_.data(), SIGNAL(notifyReadyRead(const char*,qint32)),
+                     this, SLOT(onTransaction(const char*,qint32)), Qt::DirectConnection);
+    QObject::connect(connection_.data(), SIGNAL(notifyNewConnection()),
+                     this, SLOT(onNewConnection()), Qt::DirectConnection);
+    QObject::connect(connection_.data(), SIGNAL(notifyDisconnect()),
+                     this, SLOT(onDisconnect()), Qt::DirectConnection);
+}
 
 MqlBridge::~MqlBridge()
 {
-    // inactive is lost
-    if( connection_ ) {
-        delete connection_;
-        connection_ = NULL;
-    }
+    if( connection_->isRunning() && !connection_->stopClient(1000) )
+        connection_->terminate();
+    connection_.reset();
+
+    delete index_.loadAcquire();
+    for(quint32 i = 0; i < retired_.size(); i++)
+        delete retired_[i];
+    for(quint32 i = 0; i < slots_.size(); i++)
+        delete slots_[i];
 }
 
 void MqlBridge::attach()
 {
     attached_ = 1;
-    return ;
 }
 
 void MqlBridge::detach()
 {
     attached_ = 0;
-    terminate();
-
-    // active connection should be flushed first
-    if( proxyConnected_ == 1 ) 
-    {
-        QMutexLocker guard(&proxyLock_);
-        delete connection_;
-        connection_ = NULL;
-    }
-    
-    {
-        SignalEvent(proxyWaiter_);
-        DeleteEvent(proxyWaiter_);
-        proxyWaiter_ = NULL;
-    }
 
-    { 
-        QReadLocker g(quotesLock_); 
-    }
-    delete quotesLock_;
-    quotesLock_ = NULL;
+    // loader lock is held here, so the reader thread is not waited for
+    if( !connection_->stopClient(0) )
+        connection_->terminate();
 }
 
 bool MqlBridge::isAttached()
@@ -60,266 +60,249 @@ bool MqlBridge::isAttached()
     return (attached_ == 1);
 }
 
-void MqlBridge::run()
+void MqlBridge::ensureStarted()
 {
-    // This signal to runner what thread is started
-    QObject::connect(connection_, SIGNAL(notifyReadyRead(const char*,qint32,qint32*)), 
-                     this, SLOT(onTransaction(const char*,qint32,qint32*)), Qt::DirectConnection);
-    QObject::connect(connection_, SIGNAL(notifyNewConnection()), 
-                     this, SLOT(onNewConnection()), Qt::DirectConnection);
-    QObject::connect(connection_, SIGNAL(notifyDisconnect()), 
-                     this, SLOT(onDisconnect()), Qt::DirectConnection);
-
-    // !wake one: thread starter
-    SignalEvent(proxyWaiter_);
-
-    while(1)
-    {
-        // on first entering this region will be accessed after full pipe initialization or when connection failed
-        // on second entering when connection is established or failed
-        {
-            QMutexLocker guard(&proxyLock_);
-        }
-
-        // !wait two: events loop
-        if( NULL == proxyWaiter_ || !WaitForEvent(proxyWaiter_))
-        {
-            // waiter returns false in one case of destroying and waiter is in waiting state
-            break;
-        }
-
-        if( proxyConnected_ == 1 ) // starting reading
-        {
-            (*connection_).readSync();
-            if( proxyWaiter_ )
-                SignalEvent(proxyWaiter_);
-            else
-                break;
-        }
-        else // or closing the pipe if already opened
-            (*connection_).checkPipeState();
-    }
-    // thread should be destroyed with exit(0)
-    QThread::exec();
+    if( started_.loadAcquire() == 1 )
+        return;
+    if( started_.testAndSetOrdered(0, 1) )
+        connection_->startClient();
 }
 
-bool MqlBridge::proxyStart(QScopedPointer<QMutexLocker>& autolock)
+void MqlBridge::onNewConnection()
 {
-    bool res = false;
-    autolock.reset(new QMutexLocker(&proxyLock_) );
+    decoder_.reset();
+    symbolIds_.clear();
 
-    if( NULL != (connection_ = new MqlProxyClient(this)) )
-    {
-        start();
-        // !wait one: thread starter
-        if( !(res = TimedWaitForEvent(proxyWaiter_,500)) )
-            apiShowError("Starting the thread of pipe client is timed out (MqlBridge::proxyStart)");
-    }
-    return res;
-}
-
-void MqlBridge::proxyConnect(QScopedPointer<QMutexLocker>& autolock)
-{
-    if( autolock.isNull() )
-        autolock.reset(new QMutexLocker(&proxyLock_));
+    // Sending symbols which registered in MQL, adapter skips ones already monitored
+    const SymbolIndexT* index = index_.loadAcquire();
+    if( index->empty() )
+        return;
 
-    if( 1 == (proxyConnected_ = ((*connection_).connectToServer()?1:0))) {
-        incomingQuotes_.clear();
-        autolock.reset();
-        SignalEvent(proxyWaiter_); // !wake two: proxy connected and have to start the pipe reading
-    }
+    MqlFrameWriter message(MqlSymbolsFrame);
+    SymbolIndexT::const_iterator It = index->begin();
+    for(; It != index->end(); ++It)
+        message.addSymbol(It->first.c_str(), It->first.size());
+    connection_->sendMessage(message);
 }
 
 void MqlBridge::onDisconnect()
 {
-    QMutexLocker g(&proxyLock_);
-    proxyConnected_ = 0;
+    symbolIds_.clear();
 }
 
-void MqlBridge::onTransaction(const char* buffer, qint32 size, qint32* remainder)
+void MqlBridge::onTransaction(const char* buffer, qint32 size)
 {
-    *remainder = 0;
-    //(*connection_).dbgInfo("MqlBridge::onTransaction");
-
-    if( size < 2 ) {
-        //(*connection_).dbgInfo("Error in MqlBridge::onTransaction: Received an empty data");
-        Q_ASSERT_X(size >= 2, "MqlBridge::onTransaction()", "Received an empty data");
-        return;
-    }
+    qint64 bridgeNanos = nanotime();
+    decoder_.feed(buffer, size);
 
-    qint32 parsed = 0;
-    while( parsed < size )
+    MqlFrame frame;
+    while( decoder_.next(&frame) )
     {
-        MqlProxyQuotes* transaction = (MqlProxyQuotes*)buffer;
-        if( transaction->numOfQuotes_ >= MAX_SYMBOLS ) {
-            //(*connection_).dbgInfo("Error in MqlBridge::onTransaction: Received an unexpected amount of symbols");
-            Q_ASSERT_X(transaction->numOfQuotes_ < MAX_SYMBOLS, "MqlBridge::onTransaction()", "Received an unexpected amount of symbols");
-            return;
-        }
-
-        if( size - parsed < qint32(2 + transaction->numOfQuotes_*sizeof(MqlProxyQuotes::Quote)) ) {
-            *remainder = size - parsed;
-            //char buf[256];
-            //sprintf_s(buf, 256, "buffer is truncated with %u bytes - move ahead", *remainder);
-            //(*connection_).dbgInfo(buf);
-            return;
-        }
-
-/*        string txt = "Received transactions:";
-        for(int i = 0; i < transaction->numOfQuotes_; i++) {
-            const char* sym = transaction->quotes_[i].symbol_;
-            char buf[60];
-            sprintf_s(buf, 60,"\n\"%s\" (%f,%f)", sym, transaction->quotes_[i].ask_, transaction->quotes_[i].bid_);
-            txt += buf;
+        MqlRecordReader records(frame);
+        if( frame.header_.type_ == MqlSymbolMapFrame )
+        {
+            vector<quint32> ids;
+            vector<string> names;
+            quint32 id;
+            const char* ptr;
+            quint16 length;
+            while( records.readSymbolId(&id, &ptr, &length) ) {
+                ids.push_back(id);
+                names.push_back(string(ptr, length));
+            }
+
+            // Insert LMAX adapter symbols which not registered in MQL
+            vector<MqlQuoteSlot*> slots;
+            addSlots(names, slots);
+            for(quint32 i = 0; i < ids.size(); i++) {
+                if( ids[i] >= symbolIds_.size() )
+                    symbolIds_.resize(ids[i] + 1, NULL);
+                symbolIds_[ids[i]] = slots[i];
+            }
+            continue;
         }
-        (*connection_).dbgInfo(txt);
-*/
-
-        QScopedPointer<QReadLocker> autolock(new QReadLocker(quotesLock_));
-        // Insert LMAX adapter symbols which not registered in MQL
-
-        for(int i = 0; i < transaction->numOfQuotes_; i++) {
-            bool newAdded = false;
-            if(transaction->quotes_[i].ask_ >= 0)
-                newAdded = setQuote(transaction->quotes_[i].symbol_, transaction->quotes_[i].ask_, false, autolock);
-            if(transaction->quotes_[i].bid_ >= 0)
-                newAdded = setQuote(transaction->quotes_[i].symbol_, transaction->quotes_[i].bid_, true, autolock);
-            if(newAdded)
-                incomingQuotes_.insert(transaction->quotes_[i].symbol_);
+        if( frame.header_.type_ != MqlQuotesFrame )
+            continue;
+
+        quint32 id, sequence;
+        double ask, bid;
+        qint64 serverTime, adapterNanos;
+        while( records.readQuote(&id, &bid, &ask, &serverTime, &adapterNanos, &sequence) ) {
+            if( id >= symbolIds_.size() || symbolIds_[id] == NULL ) {
+                Q_ASSERT_X(false, "MqlBridge::onTransaction()", "Received a quote of unregistered symbol id");
+                continue;
+            }
+
+            MqlQuoteSlot* slot = symbolIds_[id];
+            MqlQuote* quote = slot->beginWrite();
+            if(ask >= 0)
+                quote->ask_ = ask;
+            if(bid >= 0)
+                quote->bid_ = bid;
+            quote->serverTime_ = serverTime;
+            quote->adapterNanos_ = adapterNanos;
+            quote->bridgeNanos_ = bridgeNanos;
+            quote->sequence_ = sequence;
+            slot->endWrite();
         }
-
-        parsed += (2 + transaction->numOfQuotes_*sizeof(MqlProxyQuotes::Quote));
-        buffer += (2 + transaction->numOfQuotes_*sizeof(MqlProxyQuotes::Quote));
     }
-}
 
-void MqlBridge::onNewConnection()
-{
-//    (*connection_).dbgInfo("MqlBridge::onNewConnection");
-
-    set<string> existing;
-    QReadLocker guard(quotesLock_);
-    QuotesT::iterator It = quotes_.begin();
-    for(; It != quotes_.end(); ++It)
-        if(incomingQuotes_.end() == incomingQuotes_.find(It->first))
-            existing.insert(It->first);
-
-    // Sending symbols which registered in MQL but not found in adapter transaction
-    if( !existing.empty() ) {
-        char* message = createMultipleTransaction(existing);
-        if(message)
-            (*connection_).sendMessage(message);
-        free(message);
+    // the stream can't be resynchronized, the adapter sends all quotes anew on reconnect
+    if( decoder_.hasError() ) {
+        decoder_.reset();
+        symbolIds_.clear();
+        connection_->reconnect("Error in MqlBridge::onTransaction: Received an invalid frame, reconnecting");
     }
 }
 
 void MqlBridge::apiShowError(const std::string& info)
 {
+#ifdef Q_OS_WIN
 #ifndef NDEBUG
     ::MessageBoxA(NULL,info.c_str(),"mqld.dll internal error", MB_OK|MB_ICONSTOP);
 #else
     ::MessageBoxA(NULL,info.c_str(),"mql.dll internal error", MB_OK|MB_ICONSTOP);
 #endif
+#else
+    fprintf(stderr, "mql internal error: %s\n", info.c_str());
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////
-MqlQuote* MqlBridge::addQuote(const char* szSymbol, QScopedPointer<QWriteLocker>& autolock)
+MqlQuoteSlot* MqlBridge::findSlot(const char* szSymbol) const
 {
-    autolock.reset(new QWriteLocker(quotesLock_));
-    QuotesT::iterator It = quotes_.insert(QuotesT::value_type(szSymbol, MqlQuote(0,0))).first;
-    return &It->second;
+    const SymbolIndexT* index = index_.loadAcquire();
+    SymbolIndexT::const_iterator It = index->find(szSymbol);
+    if( It == index->end() )
+        return NULL;
+    return It->second;
 }
 
-MqlQuote* MqlBridge::findQuote(const char* szSymbol, QScopedPointer<QReadLocker>& autolock)
+void MqlBridge::addSlots(const vector<string>& symbols, vector<MqlQuoteSlot*>& out, bool* added)
 {
-    if( autolock.isNull() )
-        autolock.reset(new QReadLocker(quotesLock_));
-    QuotesT::iterator It = quotes_.find(szSymbol);
-    if( It == quotes_.end() ) {
-        autolock.reset();
-        return NULL;
+    QMutexLocker g(&indexLock_);
+    SymbolIndexT* current = index_.loadAcquire();
+    SymbolIndexT* next = NULL;
+
+    out.resize(symbols.size());
+    for(quint32 i = 0; i < symbols.size(); i++)
+    {
+        const SymbolIndexT* index = next ? next : current;
+        SymbolIndexT::const_iterator It = index->find(symbols[i]);
+        if( It != index->end() ) {
+            out[i] = It->second;
+            continue;
+        }
+        if( next == NULL )
+            next = new SymbolIndexT(*current);
+        MqlQuoteSlot* slot = new MqlQuoteSlot();
+        slots_.push_back(slot);
+        next->insert(SymbolIndexT::value_type(symbols[i], slot));
+        out[i] = slot;
+    }
+
+    if( next ) {
+        retired_.push_back(current);
+        index_.storeRelease(next);
     }
-    return &It->second;
+    if( added )
+        *added = (next != NULL);
 }
 
 double MqlBridge::getQuote(const char* sym, bool bid)
 {
-    {
-        QScopedPointer<QMutexLocker> autolock;
-        if( connection_ == NULL && !proxyStart(autolock) )
-            return 0;
+    ensureStarted();
 
-        if( (attached_ == 1) && (proxyConnected_ == 0) )
-            proxyConnect(autolock);
+    MqlQuoteSlot* slot = findSlot(sym);
+    if( slot ) {
+        MqlQuote quote(0,0);
+        slot->read(&quote);
+        return (bid ? quote.bid_ : quote.ask_);
     }
-
-    QScopedPointer<QReadLocker> readlock;
-    MqlQuote* quote = findQuote(sym, readlock);
-    if(quote)
-        return (bid ? quote->bid_ : quote->ask_);
-    else if( (proxyConnected_ == 0) || (attached_ == 0) ) // don't add symbols when no pipe (or detach progress)
+    if( attached_ == 0 ) // don't add symbols while detach in progress
         return 0;
 
-    // readlock is already released inside findQuote() in such condition
-    {
-        QScopedPointer<QWriteLocker> writelock;
-        if( NULL == addQuote(sym, writelock) )
-            return 0;
+    // the first request of symbol: register it and ask adapter to monitor
+    bool added = false;
+    vector<MqlQuoteSlot*> slots;
+    addSlots(vector<string>(1, sym), slots, &added);
+    if( added )
         sendSingleTransaction(sym);
-    }
     return 0;
 }
 
-void MqlBridge::setAsk(const char* sym, double ask)
+qint32 MqlBridge::getQuoteInfo(const char* sym, qint64* info, qint32 size)
 {
-    QScopedPointer<QReadLocker> autolock;
-    setQuote(sym, ask, false, autolock);
+    MqlQuoteSlot* slot = findSlot(sym);
+    if( slot == NULL )
+        return 0;
+
+    MqlQuote quote(0,0);
+    slot->read(&quote);
+    if( quote.sequence_ == 0 )
+        return 0;
+
+    qint64 values[InfoCount];
+    values[InfoServerTime] = quote.serverTime_;
+    values[InfoAdapterNanos] = quote.adapterNanos_;
+    values[InfoBridgeNanos] = quote.bridgeNanos_;
+    values[InfoSequence] = quote.sequence_;
+    values[InfoNowNanos] = nanotime();
+
+    qint32 count = qMin(size, (qint32)InfoCount);
+    for(qint32 i = 0; i < count; i++)
+        info[i] = values[i];
+    return count;
 }
 
+void MqlBridge::setAsk(const char* sym, double ask)
+{
+    setQuote(sym, ask, false);
+}
 
 void MqlBridge::setBid(const char* sym, double bid)
 {
-    QScopedPointer<QReadLocker> autolock;
-    setQuote(sym, bid, true, autolock);
+    setQuote(sym, bid, true);
 }
 
-bool MqlBridge::setQuote(const char* sym, double value, bool bid, QScopedPointer<QReadLocker>& readlock)
+void MqlBridge::setQuote(const char* sym, double value, bool bid)
 {
-    bool added = false;
-    MqlQuote* quote = findQuote(sym, readlock);
-    while(1) {
-        if( quote ) {
-            if( bid )
-                quote->bid_ = value;
-            else
-                quote->ask_ = value;
-            break;
-        }
-        QScopedPointer<QWriteLocker> writelock;
-        if( NULL == (quote = addQuote(sym, writelock))) break;
-        added = true;
+    MqlQuoteSlot* slot = findSlot(sym);
+    if( slot == NULL ) {
+        vector<MqlQuoteSlot*> slots;
+        addSlots(vector<string>(1, sym), slots);
+        slot = slots[0];
     }
-    return added;
+
+    MqlQuote* quote = slot->beginWrite();
+    if( bid )
+        quote->bid_ = value;
+    else
+        quote->ask_ = value;
+    slot->endWrite();
 }
 
-void MqlBridge::sendSingleTransaction(const char* sym)
+qint64 MqlBridge::nanotime()
 {
-    if( incomingQuotes_.end() != incomingQuotes_.find(sym) )
-        return;
-
-    MqlProxySymbols message;
-    message.numOfSymbols_ = 1;
-    strcpy_s(message.symbols_[0], MAX_SYMBOL_LENGTH, sym);
-    (*connection_).sendMessage((const char*)&message);
-    incomingQuotes_.insert(sym);
+#ifdef Q_OS_WIN
+    static LARGE_INTEGER frequency = {0};
+    if( frequency.QuadPart == 0 )
+        ::QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    ::QueryPerformanceCounter(&counter);
+    return (counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           (counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
 }
 
-char* MqlBridge::createMultipleTransaction(const set<string>& symbols)
+void MqlBridge::sendSingleTransaction(const char* sym)
 {
-    MqlProxySymbols* message = (MqlProxySymbols*)malloc( 2 + symbols.size()*sizeof(MqlProxySymbols().symbols_[0]) );
-    message->numOfSymbols_ = symbols.size();
-    set<string>::const_iterator It = symbols.begin();
-    for(qint16 i = 0; It != symbols.end(); ++It, ++i)
-        strcpy_s(message->symbols_[i], MAX_SYMBOL_LENGTH, It->c_str());
-    return (char*)message;
+    MqlFrameWriter message(MqlSymbolsFrame);
+    message.addSymbol(sym, strlen(sym));
+    connection_->sendMessage(message);
 }
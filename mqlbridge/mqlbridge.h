@@ -2,6 +2,7 @@
 #define __mqlbridge_h__
 
 #include "external.h"
+#include "mqlprotocol.h"
 
 #ifndef VERSION_MAJOR
 #define VERSION_MAJOR 1
@@ -13,35 +14,87 @@
 
 #include <QScopedPointer>
 #include <QAtomicPointer>
-#include <QReadWriteLock>
-#include <QThread>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
 
-#include <set>
+#include <vector>
+#include <string>
 #include <map>
 
-////////////////////////////////////////////////////////////////////////////////
-// Macros for Windows API Event
-
-#define InitEvent() ((quintptr)CreateEvent(NULL,FALSE,FALSE,NULL))
-#define DeleteEvent(waiter) (CloseHandle((HANDLE)waiter))
-#define SignalEvent(waiter) (SetEvent((HANDLE)waiter))
-#define WaitForEvent(waiter) (WAIT_OBJECT_0 == WaitForSingleObject((HANDLE)waiter,INFINITE))
-#define TimedWaitForEvent(waiter,tm) (WAIT_OBJECT_0 == WaitForSingleObject((HANDLE)waiter,tm))
-
 ////////////////////////////////////////////////////////////////////////////////
 struct MqlQuote {
-    double ask_;
-    double bid_;
-    MqlQuote(double ask, double bid) 
-        : ask_(ask), bid_(bid)
+    double  ask_;
+    double  bid_;
+    qint64  serverTime_;    // SendingTime(52) of LMAX, msecs since epoch
+    qint64  adapterNanos_;  // adapter receive time, monotonic nsecs
+    qint64  bridgeNanos_;   // mql.dll receive time, monotonic nsecs
+    quint32 sequence_;      // per-instrument sequence of adapter
+    MqlQuote(double ask, double bid)
+        : ask_(ask), bid_(bid), serverTime_(0), adapterNanos_(0), bridgeNanos_(0), sequence_(0)
     {}
 };
 
+// Quote storage read without locks: writers make the version odd while updating,
+// readers retry when the version is odd or changed during the copying
+class MqlQuoteSlot
+{
+public:
+    MqlQuoteSlot()
+        : version_(0), quote_(0,0)
+    {}
+
+    inline void read(MqlQuote* out) const
+    {
+        // volatile copying keeps loads of the quote between two loads of the version (x86 ordering)
+        const volatile MqlQuote& src = quote_;
+        while(1) {
+            int before = version_.loadAcquire();
+            if( before & 1 )
+                continue;
+            out->ask_ = src.ask_;
+            out->bid_ = src.bid_;
+            out->serverTime_ = src.serverTime_;
+            out->adapterNanos_ = src.adapterNanos_;
+            out->bridgeNanos_ = src.bridgeNanos_;
+            out->sequence_ = src.sequence_;
+            if( version_.loadAcquire() == before )
+                break;
+        }
+    }
+
+    // Writers may be the pipe reader and MQL threads (setBid/setAsk)
+    inline MqlQuote* beginWrite()
+    {
+        while(1) {
+            int current = version_.loadAcquire();
+            if( !(current & 1) && version_.testAndSetAcquire(current, current+1) )
+                return &quote_;
+        }
+    }
+
+    inline void endWrite()
+    { version_.fetchAndAddRelease(1); }
+
+private:
+    QAtomicInt version_;
+    MqlQuote   quote_;
+};
+
+// Order of values returned by MqlBridge::getQuoteInfo
+enum MqlQuoteInfo {
+    InfoServerTime = 0,     // msecs since epoch
+    InfoAdapterNanos,       // monotonic nsecs of the host
+    InfoBridgeNanos,        // monotonic nsecs of the host
+    InfoSequence,
+    InfoNowNanos,           // monotonic nsecs of the host at the call time
+    InfoCount
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 class MqlProxyClient;
-struct MqlProxySymbols;
 
-class MqlBridge : private QThread
+class MqlBridge : public QObject
 {
     Q_OBJECT
 public:
@@ -61,44 +114,56 @@ public:
     void setBid(const char* symbol, double bid);
     void setAsk(const char* symbol, double ask);
 
+    // Fills up to size values in MqlQuoteInfo order, returns number of filled values
+    // or 0 when symbol has no quotes yet
+    qint32 getQuoteInfo(const char* symbol, qint64* info, qint32 size);
+
+    // Monotonic clock shared by all processes of the host (QueryPerformanceCounter)
+    static qint64 nanotime();
+
 protected slots:
-    void onTransaction(const char* buffer, qint32 size, qint32* remainder);
+    void onTransaction(const char* buffer, qint32 size);
     void onNewConnection();
     void onDisconnect();
 
-protected:
-    MqlQuote* MqlBridge::addQuote(const char* sym, QScopedPointer<QWriteLocker>& autolock);
-    MqlQuote* MqlBridge::findQuote(const char* sym, QScopedPointer<QReadLocker>& autolock);
-    bool proxyStart(QScopedPointer<QMutexLocker>& autolock);
-    void proxyConnect(QScopedPointer<QMutexLocker>& autolock);
-    void run();
-
 private:
+    typedef std::map<std::string,MqlQuoteSlot*> SymbolIndexT;
+
     double getQuote(const char* symbol, bool bid);
-    bool   setQuote(const char* symbol, double value, bool bid, QScopedPointer<QReadLocker>& readlock);
+    void   setQuote(const char* symbol, double value, bool bid);
+
+    // Lock-free lookup in the published index
+    MqlQuoteSlot* findSlot(const char* symbol) const;
+
+    // Publishes a new index with added symbols, returns slots in the order of symbols
+    void addSlots(const std::vector<std::string>& symbols, std::vector<MqlQuoteSlot*>& out, bool* added = NULL);
+
+    // Starts the pipe client once on the first use
+    void ensureStarted();
 
     // creates transaction message about new instrument request
     void sendSingleTransaction(const char* sym);
 
-    // returned buffer must be freed
-    char* createMultipleTransaction(const std::set<std::string>& symbols);
-
     static void apiShowError(const std::string& info);
 
 private:
-    typedef std::map<std::string,MqlQuote> QuotesT;
-    QuotesT         quotes_;
-    QReadWriteLock* quotesLock_;
-    quintptr        proxyWaiter_;
-    QMutex          proxyLock_;
-
-    QAtomicPointer<MqlProxyClient> connection_;
-    QAtomicInt proxyConnected_;
+    // Copy-on-write symbol index: readers take the current pointer without locks,
+    // writers publish a modified copy; replaced indexes are kept until destruction
+    // because a reader may still walk them (the amount is bounded by number of symbols)
+    QAtomicPointer<SymbolIndexT> index_;
+    std::vector<SymbolIndexT*> retired_;
+    std::vector<MqlQuoteSlot*> slots_;
+    QMutex indexLock_;
+
+    QScopedPointer<MqlProxyClient> connection_;
+    QAtomicInt started_;
     QAtomicInt attached_;
 
-    std::set<std::string> incomingQuotes_;
+    // pipe framing state of the reader thread, reset on each connection
+    MqlFrameDecoder decoder_;
+    std::vector<MqlQuoteSlot*> symbolIds_;
 };
 
 Q_GLOBAL_STATIC(MqlBridge, spMqlBridge)
 
-#endif __mqlbridge_h__
+#endif // __mqlbridge_h__
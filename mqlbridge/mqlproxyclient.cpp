@@ -1,257 +1,309 @@
 #include "external.h"
 #include "mqlproxyclient.h"
-#include "syserrorinfo.h"
 
 #include <QtCore>
-#include <QLocalSocket>
+
+#ifdef Q_OS_WIN
+#include "syserrorinfo.h"
 #include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
 
 using namespace std;
-static FILE* localsocklog = NULL;
-
 
 /////////////////////////////////////////////////////////////////
-MqlProxyClient::MqlProxyClient(QObject* parent)
-    : reader_(INVALID_HANDLE_VALUE), 
-    writer_(NULL), 
-    pipeBroken_(false)
-{
-//    if( localsocklog == NULL)
-//        localsocklog = fopen("lmax_cnt.log", "wc+");
-}
-MqlProxyClient::~MqlProxyClient()
+// Native pipe routines
+namespace
 {
-    destroyPipe();
-}
+#ifdef Q_OS_WIN
+    const qintptr InvalidPipe = (qintptr)INVALID_HANDLE_VALUE;
 
-bool MqlProxyClient::connectToServer()
-{
-//    dbgInfo("MqlProxyClient::connectToServer...");
+    qintptr openPipe(bool forReading, string& error)
+    {
+        string pipename = string("\\\\.\\pipe\\") + MQL_PROXY_PIPE;
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        while(1)
+        {
+            pipe = CreateFileA( pipename.c_str(), forReading ? GENERIC_READ : GENERIC_WRITE,
+                                0, NULL, OPEN_EXISTING, 0, NULL);
+            if( pipe != INVALID_HANDLE_VALUE )
+                break;
 
-    // set starting state
-    errorString_.clear();
-    pipeBroken_ = false;
+            qint32 errcode = (qint32)GetLastError();
+            if( ERROR_PIPE_BUSY != errcode ) {
+                error = SysErrorInfo("Failed to open the pipe", errcode).get();
+                break;
+            }
+            if( !WaitNamedPipeA(pipename.c_str(), 1000) )
+                break;
+        }
+        return (qintptr)pipe;
+    }
 
-    string pipename = string("\\\\.\\pipe\\") + MQL_PROXY_PIPE;
-    HANDLE localSocket;
-    while(1) 
+    // Blocks until some data, returns 0 when pipe is closed
+    qint32 readPipe(qintptr pipe, char* buffer, qint32 size)
     {
-        localSocket = CreateFileA( pipename.c_str(), GENERIC_READ,
-                                   0, NULL, OPEN_EXISTING, 0, NULL);
-        if( localSocket != INVALID_HANDLE_VALUE )
-            break;
-
-        if( ERROR_PIPE_BUSY != GetLastError() ) 
-            break;
-        // 5 secs waiting to be sure
-        if( !WaitNamedPipeA(pipename.c_str(),5000) )
-            break;
-    }
-    if( localSocket == INVALID_HANDLE_VALUE ) {
-//        logInternalError( SysErrorInfo("Failed to create the pipe client "
-//                                       "(MqlProxyClient::connectToServer)\n",
-//                                       (qint32)GetLastError()).get());
-        return false;
+        DWORD bytes = 0;
+        if( !ReadFile((HANDLE)pipe, buffer, size, &bytes, NULL) && GetLastError() != ERROR_MORE_DATA )
+            return 0;
+        return (qint32)bytes;
     }
 
-    reader_ = localSocket;
+    bool writePipe(qintptr pipe, const char* data, qint32 size)
+    {
+        while( size > 0 ) {
+            DWORD bytes = 0;
+            if( !WriteFile((HANDLE)pipe, data, size, &bytes, NULL) )
+                return false;
+            data += bytes;
+            size -= bytes;
+        }
+        return true;
+    }
 
-    DWORD dwMode = 0;
-    DWORD instancesCount = 0;
-    DWORD flags = 0;
-    DWORD outBufferSize = 0;
-    DWORD inBufferSize = 0;
-    char username[50] = {0};
+    void unblockPipe(qintptr pipe, void* thread)
+    {
+        if( thread )
+            CancelSynchronousIo((HANDLE)thread);
+    }
 
-    //dbgInfo("MqlProxyClient::connectToServer connected!");
-    return true;
-}
+    void closeNativePipe(qintptr pipe)
+    {
+        CloseHandle((HANDLE)pipe);
+    }
+#else
+    const qintptr InvalidPipe = -1;
 
-void MqlProxyClient::readSync()
-{
-//    dbgInfo("MqlProxyClient::readSync...");
+    qintptr openPipe(bool forReading, string& error)
+    {
+        // QLocalServer creates the socket in the temp directory
+        QByteArray path = QFile::encodeName(QDir::tempPath() + "/" + MQL_PROXY_PIPE);
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.constData(), sizeof(addr.sun_path)-1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if( fd == -1 ) {
+            error = string("Failed to create the socket: ") + strerror(errno);
+            return InvalidPipe;
+        }
+        if( ::connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1 ) {
+            error = string("Failed to connect the socket: ") + strerror(errno);
+            ::close(fd);
+            return InvalidPipe;
+        }
+        if( !forReading )
+            ::shutdown(fd, SHUT_RD);
+        return fd;
+    }
 
-    DWORD available = 0;
-    qint32 curBufferSize = 0;
-    bool startedWithCheckbyte = false;
-    do 
+    // Blocks until some data, returns 0 when pipe is closed
+    qint32 readPipe(qintptr pipe, char* buffer, qint32 size)
     {
-        const qint32 minReadBufferSize = 1;
-        
-        DWORD bytesToRead = qMax(checkPipeState(), minReadBufferSize);
-        if( pipeBroken_ ) {
-            return;
+        while(1) {
+            ssize_t bytes = ::recv((int)pipe, buffer, size, 0);
+            if( bytes >= 0 )
+                return (qint32)bytes;
+            if( errno != EINTR )
+                return 0;
         }
+    }
 
-        qint32 maxReadBufferSize = MqlProxyQuotes::maxProxyServerBufferSize();
-        if ( maxReadBufferSize && (qint32)bytesToRead > (maxReadBufferSize - curBufferSize)) 
-        {
-            bytesToRead = maxReadBufferSize - curBufferSize;
-            if (bytesToRead == 0) {
-                // Buffer is full. It can happense only when invalid data recevied.
-                logInternalError("An invalid data received from pipe (reading buffer is full)");
-                onDisconnect();
-                return;
+    bool writePipe(qintptr pipe, const char* data, qint32 size)
+    {
+        while( size > 0 ) {
+            ssize_t bytes = ::send((int)pipe, data, size, MSG_NOSIGNAL);
+            if( bytes < 0 ) {
+                if( errno == EINTR )
+                    continue;
+                return false;
             }
+            data += bytes;
+            size -= bytes;
         }
+        return true;
+    }
 
-        if( !writer_ )
-            onNewConnection();
+    void unblockPipe(qintptr pipe, void*)
+    {
+        if( pipe != InvalidPipe )
+            ::shutdown((int)pipe, SHUT_RDWR);
+    }
 
-        char* ptr = readBuffer_.reserve(bytesToRead);
-        if( !ReadFile(reader_, ptr, bytesToRead, &available, NULL)) 
-        {
-            startedWithCheckbyte = false;
+    void closeNativePipe(qintptr pipe)
+    {
+        ::close((int)pipe);
+    }
+#endif
+}
 
-            const qint32 errcode = (qint32)GetLastError();
-            switch (errcode) {
-            case ERROR_IO_PENDING:
-                break;
-            case ERROR_MORE_DATA:
-                curBufferSize += available;
-                break;
-            case ERROR_BROKEN_PIPE:
-            case ERROR_PIPE_NOT_CONNECTED:
-                break;
-            default:
-                logInternalError(SysErrorInfo("MqlProxyClient::readSync", errcode).get());
-                break;
-            }
-        }
-        else if(available == 1) // next ReadFile must obtain rest data, PeekNamedPipe receives num of bytes before
-        {
-            curBufferSize = 1;
-            // EOF received: exit
-            if(*ptr == -1)
-                break;
-            startedWithCheckbyte = true;
-        }
-        else 
-        {
-            curBufferSize += available;
-            
-            //fprintf(localsocklog, "MqlProxyClient::readSync: notifyReadyRead %d bytes\n", curBufferSize); fflush(localsocklog);
-            qint32 remainder = 0;
-            emit notifyReadyRead(ptr - qint32(startedWithCheckbyte), curBufferSize, &remainder);
-
-            if( remainder )
-                readBuffer_.truncate(curBufferSize-remainder);
-            else
-                readBuffer_.clear();
-            curBufferSize = remainder;
-            startedWithCheckbyte = false;
-        }
-    } 
-    while(available);
+/////////////////////////////////////////////////////////////////
+MqlProxyClient::MqlProxyClient()
+    : reader_(InvalidPipe),
+    writer_(InvalidPipe),
+    readerThread_(NULL),
+    stopping_(0),
+    connected_(0),
+    reconnecting_(0),
+    outSequence_(0)
+{}
 
-    onDisconnect();
-//    dbgInfo("MqlProxyClient::readSync ends with success");
+MqlProxyClient::~MqlProxyClient()
+{
+    if( isRunning() && !stopClient(1000) )
+        terminate();
+    closePipe();
 }
 
-void MqlProxyClient::sendMessage(const char* message)
+void MqlProxyClient::startClient()
 {
-//    dbgInfo("MqlProxyServer::sendMessage...");
-    if( pipeBroken_ || reader_ == INVALID_HANDLE_VALUE ) {
-//        dbgInfo("MqlProxyServer::sendMessage pipe broken"); 
-        return;
-    }
+    stopping_ = 0;
+    start();
+}
 
-    if(writer_ == NULL)
-        if(!createWriter())
-            return;
-
-    MqlProxySymbols* trans = (MqlProxySymbols*)message;
-
-    /*
-    string names;
-    for(int i = 0; i < trans->numOfSymbols_; i++ ) 
-        names += "\"" + string(trans->symbols_[i]) + "\"" + string(i == trans->numOfSymbols_-1 ? "" : ", ");
-    fprintf(localsocklog, "... to LMAX adapter: %s\n", names.c_str());  fflush(localsocklog);
-    */
-    qint32 transSize = 2 + trans->numOfSymbols_*sizeof(trans->symbols_[0]);
-
-    qint32 written = (qint32)writer_->write(message, transSize);
-    if(written != transSize) {
-        logInternalError("MqlProxyClient::sendMessage " + writer_->errorString().toStdString());
-        writer_->close();
-        writer_->deleteLater();
-        writer_ = NULL;
+bool MqlProxyClient::stopClient(unsigned long msecs)
+{
+    const unsigned long step = 10;
+    unsigned long waited = 0;
+    do
+    {
+        // reader may be just entering the blocking read, so repeat unblocking
+        {
+            QMutexLocker g(&stopLock_);
+            stopping_ = 1;
+            stopCondition_.wakeAll();
+            unblockPipe(reader_, readerThread_);
+        }
+        if( wait(qMin(step, msecs)) )
+            return true;
+        waited += step;
     }
-    //dbgInfo("MqlProxyServer::sendMessage end"); 
+    while( waited < msecs );
+    return !isRunning();
 }
 
-qint32 MqlProxyClient::checkPipeState()
+void MqlProxyClient::run()
 {
-    DWORD bytes;
-    if( PeekNamedPipe(reader_, NULL, 0, NULL, &bytes, NULL) ) {
-        return bytes;
-    } else {
-        if( !pipeBroken_ )
-            onDisconnect();
+#ifdef Q_OS_WIN
+    readerThread_ = OpenThread(THREAD_TERMINATE, FALSE, GetCurrentThreadId());
+#endif
+
+    unsigned long delay = MQL_RECONNECT_MIN_DELAY;
+    while( stopping_.loadAcquire() == 0 )
+    {
+        if( !connectToServer() ) {
+            if( !sleepInterruptible(delay) )
+                break;
+            delay = qMin(delay*2, (unsigned long)MQL_RECONNECT_MAX_DELAY);
+            continue;
+        }
+        delay = MQL_RECONNECT_MIN_DELAY;
+
+        connected_ = 1;
+        emit notifyNewConnection();
+
+        // frames are decoded straight from the fixed buffer
+        qint32 bytes;
+        reconnecting_ = 0;
+        while( (bytes = readPipe(reader_, buffer_, sizeof(buffer_))) > 0 ) {
+            emit notifyReadyRead(buffer_, bytes);
+            if( reconnecting_.loadAcquire() )
+                break;
+        }
+
+        connected_ = 0;
+        closePipe();
+        emit notifyDisconnect();
     }
-    return 0;
+    closePipe();
+
+#ifdef Q_OS_WIN
+    if( readerThread_ ) {
+        QMutexLocker g(&stopLock_);
+        CloseHandle((HANDLE)readerThread_);
+        readerThread_ = NULL;
+    }
+#endif
 }
 
-bool MqlProxyClient::createWriter()
+bool MqlProxyClient::connectToServer()
 {
-    QMutexLocker guard(&writerLock_);
+    string error;
 
-//    dbgInfo("MqlProxyServer::createWriter"); 
-    if( pipeBroken_ || reader_ == INVALID_HANDLE_VALUE ) {
-//        dbgInfo("MqlProxyServer::createWriter pipe broken"); 
+    // server takes the first connection of client as its writer and the second one as its reader
+    qintptr reader = openPipe(true, error);
+    if( reader == InvalidPipe ) {
+        logInternalError(error);
+        return false;
+    }
+
+    qintptr writer = openPipe(false, error);
+    if( writer == InvalidPipe ) {
+        logInternalError(error);
+        closeNativePipe(reader);
         return false;
     }
-    if( writer_ )
-        return true;
 
-    writer_ = new QLocalSocket();
-    writer_->connectToServer(MQL_PROXY_PIPE, QIODevice::WriteOnly);
-    return writer_->waitForConnected(1000);
+    QMutexLocker g(&stopLock_);
+    QMutexLocker w(&writerLock_);
+    reader_ = reader;
+    writer_ = writer;
+    outSequence_ = 0;
+    errorString_.clear();
+    return stopping_.loadAcquire() == 0;
 }
 
-void MqlProxyClient::destroyPipe()
+void MqlProxyClient::closePipe()
 {
-    if( reader_ != INVALID_HANDLE_VALUE ) 
-    {
-        FlushFileBuffers(reader_);
-        DisconnectNamedPipe(reader_);
-        CloseHandle(reader_);
-        reader_ = INVALID_HANDLE_VALUE;
-
-        if( writer_ != NULL ) {
-            writer_->disconnectFromServer();
-            writer_->deleteLater();
-            writer_ = NULL;
-        }
+    QMutexLocker g(&stopLock_);
+    QMutexLocker w(&writerLock_);
+    if( reader_ != InvalidPipe ) {
+        closeNativePipe(reader_);
+        reader_ = InvalidPipe;
+    }
+    if( writer_ != InvalidPipe ) {
+        closeNativePipe(writer_);
+        writer_ = InvalidPipe;
     }
 }
 
-void MqlProxyClient::onNewConnection()
+bool MqlProxyClient::sleepInterruptible(unsigned long msecs)
 {
-//    dbgInfo("MqlProxyClient::onNewConnection...");
-    if( createWriter() )
-        emit notifyNewConnection();
+    QMutexLocker g(&stopLock_);
+    if( stopping_.loadAcquire() == 0 )
+        stopCondition_.wait(&stopLock_, msecs);
+    return stopping_.loadAcquire() == 0;
 }
 
-void MqlProxyClient::onDisconnect()
+bool MqlProxyClient::sendMessage(MqlFrameWriter& message)
 {
-//    dbgInfo("MqlProxyClient::onDisconnect...");
-
-/*    if( !errorString_.empty() )
-        fprintf(localsocklog, "Error: %s\n", errorString_.c_str());
-        */
-    pipeBroken_ = true;
-    destroyPipe();
-    emit notifyDisconnect();
+    QMutexLocker w(&writerLock_);
+    if( writer_ == InvalidPipe )
+        return false;
+
+    const QByteArray& frame = message.finish(++outSequence_);
+    if( !writePipe(writer_, frame.constData(), frame.size()) ) {
+        // reader thread detects the broken pipe and reconnects
+        logInternalError("MqlProxyClient::sendMessage failed to write the pipe");
+        return false;
+    }
+    return true;
 }
 
-void MqlProxyClient::logInternalError(const std::string& desc)
+void MqlProxyClient::reconnect(const std::string& reason)
 {
-    errorString_ = desc;
-//    fprintf(localsocklog, "Error: %s\n", desc.c_str()); fflush(localsocklog);
+    logInternalError(reason);
+    reconnecting_ = 1;
 }
 
-void MqlProxyClient::dbgInfo(const std::string& info)
+void MqlProxyClient::logInternalError(const std::string& desc)
 {
-//    fprintf(localsocklog, "%s\n", info.c_str()); fflush(localsocklog);
+    errorString_ = desc;
 }
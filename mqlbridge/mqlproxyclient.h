@@ -1,57 +1,82 @@
 #ifndef __mqlproxyclient_h__
 #define __mqlproxyclient_h__
 
-#include <QObject>
-#include <qringbuffer_p.h>
+#include "mqlprotocol.h"
 
-QT_BEGIN_NAMESPACE;
-class QLocalSocket;
-QT_END_NAMESPACE;
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include <string>
+
+// Reconnection backoff of the pipe client
+#define MQL_RECONNECT_MIN_DELAY     100
+#define MQL_RECONNECT_MAX_DELAY     5000
 
 ///////////////////////////////////////////////////////
-class MqlProxyClient: public QObject
+// Pipe client I/O engine.
+// One reader thread connects both channels of the adapter's pipe server,
+// does blocking reads into the fixed buffer and reconnects with backoff.
+// Notifications are emitted on the reader thread (use Qt::DirectConnection).
+// Windows: named pipe \\.\pipe\<MQL_PROXY_PIPE>, Linux: unix domain socket in the temp directory
+class MqlProxyClient: public QThread
 {
     Q_OBJECT
-    friend class MqlBridge;
 public:
-    MqlProxyClient(QObject* parent);
+    MqlProxyClient();
     ~MqlProxyClient();
 
-    bool    connectToServer();
-    void    sendMessage(const char* transaction);
-    void    readSync();
-    qint32  checkPipeState(); // returns the buffer size if pipe is not broken
+    // Starts the reader thread, returns immediately
+    void    startClient();
+    // Stops the reader thread and closes the pipe, waits not more than msecs
+    // returns false when the thread is still running
+    bool    stopClient(unsigned long msecs);
 
-    inline const std::string& errorString() const
-    { return errorString_; }
+    // Completes the frame with the next sequence and sends it,
+    // may be called from any thread, returns false when not connected
+    bool    sendMessage(MqlFrameWriter& frame);
+
+    inline bool isConnected() const
+    { return connected_.loadAcquire() == 1; }
 
-    inline bool hasError() const 
-    { return !errorString_.empty(); }
+    // Called on the reader thread: logs the reason and closes the pipe
+    // after the current notification, the client connects anew
+    void    reconnect(const std::string& reason);
 
-    void dbgInfo(const std::string& info);
+    inline const std::string& errorString() const
+    { return errorString_; }
 
 Q_SIGNALS:
-    void notifyReadyRead(const char*, qint32, qint32*);
+    void notifyReadyRead(const char*, qint32);
     void notifyNewConnection();
     void notifyDisconnect();
 
-protected slots:
-    void onDisconnect();
-    void onNewConnection();
+protected:
+    void run();
 
 private:
+    bool connectToServer();
+    void closePipe();
+    bool sleepInterruptible(unsigned long msecs);
     void logInternalError(const std::string& desc);
-    void destroyPipe();
-    bool createWriter();
 
 private:
-    void* reader_;
-    QRingBuffer readBuffer_;
-    std::string errorString_;
-    bool pipeBroken_;
+    // native handles: HANDLE on Windows, socket descriptor on Linux
+    qintptr reader_;
+    qintptr writer_;
+    void*   readerThread_;
 
     QMutex writerLock_;
-    QLocalSocket* writer_;
+    QMutex stopLock_;
+    QWaitCondition stopCondition_;
+    QAtomicInt stopping_;
+    QAtomicInt connected_;
+    QAtomicInt reconnecting_;
+    quint32 outSequence_;
+
+    std::string errorString_;
+    char buffer_[MQL_PIPE_BUFFER_SIZE];
 };
 
 #endif // __mqlproxyclient_h__